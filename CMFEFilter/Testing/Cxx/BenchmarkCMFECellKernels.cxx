@@ -0,0 +1,340 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: BenchmarkCMFECellKernels.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Times the point location kernels of vtkCMFECellKernels.h against the
+// vtkCell path they replace: GetCell into a vtkGenericCell, followed by
+// CMFEUtility::CellContainsPoint and vtkCell::EvaluatePosition.  This is
+// done separately for tetrahedra, hexahedra, wedges and pyramids.
+// Half of the query points are inside their cell and half are random
+// points around it.  The two paths have to agree on which points are
+// inside.  They also have to agree on the weights, up to the convergence
+// tolerance of Newton's method.
+//
+// Usage: BenchmarkCMFECellKernels [-Q queriesPerCellType]
+
+#include "vtkCMFECellKernels.h"
+#include "vtkCMFEUtility.h"
+#include "vtkCellType.h"
+#include "vtkGenericCell.h"
+#include "vtkPoints.h"
+#include "vtkTimerLog.h"
+#include "vtkUnstructuredGrid.h"
+
+#include <vtkstd/algorithm>
+#include <vtkstd/vector>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+// Small deterministic generator so every run queries the same points.
+class BenchmarkRandom
+{
+public:
+  BenchmarkRandom() : State(12345) {}
+  double Next()
+    {
+    this->State = this->State * 1103515245u + 12345u;
+    return ((this->State >> 8) & 0xFFFFFF) / double(0x1000000);
+    }
+private:
+  unsigned int State;
+};
+
+const int numberOfCells = 4096;
+
+struct CellTypeInfo
+{
+  const char *Name;
+  int Type;
+  int NumberOfPoints;
+  double Points[8][3];
+};
+
+const CellTypeInfo cellTypes[4] =
+{
+  { "tetra", VTK_TETRA, 4,
+    { {0,0,0}, {1,0,0}, {0,1,0}, {0,0,1} } },
+  { "hexahedron", VTK_HEXAHEDRON, 8,
+    { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} } },
+  { "wedge", VTK_WEDGE, 6,
+    { {0,0,0}, {1,0,0}, {0,1,0}, {0,0,1}, {1,0,1}, {0,1,1} } },
+  { "pyramid", VTK_PYRAMID, 5,
+    { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0.5,0.5,1} } }
+};
+
+// Parametric coordinates well inside the cell.
+void InsideParametricCoordinates(int type, BenchmarkRandom &random,
+                                 double pcoords[3])
+{
+  if (type == VTK_TETRA)
+    {
+    double b[4], sum = 0.;
+    for (int i = 0 ; i < 4 ; i++)
+      {
+      b[i] = 0.05 + random.Next();
+      sum += b[i];
+      }
+    for (int i = 0 ; i < 3 ; i++)
+      {
+      pcoords[i] = b[i+1] / sum;
+      }
+    }
+  else if (type == VTK_WEDGE)
+    {
+    pcoords[0] = 0.05 + 0.4*random.Next();
+    pcoords[1] = 0.05 + 0.4*random.Next();
+    pcoords[2] = 0.1 + 0.8*random.Next();
+    }
+  else
+    {
+    for (int i = 0 ; i < 3 ; i++)
+      {
+      pcoords[i] = 0.2 + 0.6*random.Next();
+      }
+    }
+}
+
+struct PathResult
+{
+  double Time;
+  vtkstd::vector<unsigned char> Inside;
+  vtkstd::vector<double> Weights;
+};
+
+// Locates every query point in its cell through vtkCell, the way
+// vtkCMFEFastLookupGrouping did before it had the kernels.
+class CellPath
+{
+public:
+  CellPath(vtkUnstructuredGrid *grid) : Grid(grid)
+    {
+    this->Cell = vtkGenericCell::New();
+    }
+  ~CellPath()
+    {
+    this->Cell->Delete();
+    }
+  bool operator()(int cellId, const double *pt, double *weights) const
+    {
+    double x[3] = { pt[0], pt[1], pt[2] };
+    double closestPt[3], pcoords[3], dist2;
+    int subId;
+    this->Grid->GetCell(cellId, this->Cell);
+    if (!CMFEUtility::CellContainsPoint(this->Cell, x))
+      {
+      return false;
+      }
+    this->Cell->EvaluatePosition(x, closestPt, subId, pcoords, dist2,
+                                 weights);
+    return true;
+    }
+private:
+  vtkUnstructuredGrid *Grid;
+  vtkGenericCell *Cell;
+
+  CellPath(const CellPath&);  // Not implemented.
+  void operator=(const CellPath&);  // Not implemented.
+};
+
+// Locates every query point with the kernels, falling back on the vtkCell
+// path for the cells they do not handle.
+class KernelPath
+{
+public:
+  KernelPath(vtkUnstructuredGrid *grid) : Grid(grid), Fallback(grid)
+    {
+    this->Points = static_cast<const double *>(
+      grid->GetPoints()->GetVoidPointer(0));
+    }
+  bool operator()(int cellId, const double *pt, double *weights) const
+    {
+    vtkIdType nPts, *ids;
+    this->Grid->GetCellPoints(cellId, nPts, ids);
+    int result = CMFECellKernels::LocatePoint(this->Grid->GetCellType(cellId),
+      this->Points, ids, nPts, pt, weights);
+    if (result == CMFECellKernels::NOT_HANDLED)
+      {
+      return this->Fallback(cellId, pt, weights);
+      }
+    return (result == CMFECellKernels::INSIDE);
+    }
+private:
+  vtkUnstructuredGrid *Grid;
+  const double *Points;
+  CellPath Fallback;
+};
+
+template <class Path>
+void TimePath(const Path &path, const vtkstd::vector<double> &points,
+              int nPts, PathResult &result)
+{
+  const int nPasses = 3;
+  int nQueries = static_cast<int>(points.size() / 3);
+  result.Inside.resize(nQueries);
+  result.Weights.resize(nQueries * CMFECellKernels::MaximumNumberOfPoints);
+  for (int pass = 0 ; pass < nPasses ; pass++)
+    {
+    double start = vtkTimerLog::GetUniversalTime();
+    for (int q = 0 ; q < nQueries ; q++)
+      {
+      double weights[CMFECellKernels::MaximumNumberOfPoints];
+      bool inside = path(q % numberOfCells, &points[3*q], weights);
+      if (pass == 0)
+        {
+        result.Inside[q] = inside;
+        for (int i = 0 ; i < nPts && inside ; i++)
+          {
+          result.Weights[q*CMFECellKernels::MaximumNumberOfPoints + i] =
+            weights[i];
+          }
+        }
+      }
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    if (pass == 0 || elapsed < result.Time)
+      {
+      result.Time = elapsed;
+      }
+    }
+}
+
+bool RunCellType(const CellTypeInfo &info, int nQueries)
+{
+  BenchmarkRandom random;
+
+  // Every cell gets its own, perturbed copy of the reference points, on a
+  // grid of cells so that they do not overlap.
+  vtkPoints *points = vtkPoints::New();
+  points->SetDataTypeToDouble();
+  vtkUnstructuredGrid *grid = vtkUnstructuredGrid::New();
+  grid->Allocate(numberOfCells);
+  vtkIdType ids[8];
+  for (int c = 0 ; c < numberOfCells ; c++)
+    {
+    double offset[3] = { 2.*(c % 16), 2.*((c / 16) % 16), 2.*(c / 256) };
+    for (int i = 0 ; i < info.NumberOfPoints ; i++)
+      {
+      double pt[3];
+      for (int k = 0 ; k < 3 ; k++)
+        {
+        pt[k] = offset[k] + info.Points[i][k] + 0.1*(random.Next() - 0.5);
+        }
+      ids[i] = points->InsertNextPoint(pt);
+      }
+    grid->InsertNextCell(info.Type, info.NumberOfPoints, ids);
+    }
+  grid->SetPoints(points);
+  points->Delete();
+
+  // Every other query point is mapped from parametric coordinates inside
+  // the cell; the others are anywhere in a box around the cell.
+  vtkstd::vector<double> queries(3*nQueries);
+  vtkGenericCell *cell = vtkGenericCell::New();
+  for (int q = 0 ; q < nQueries ; q++)
+    {
+    int c = q % numberOfCells;
+    grid->GetCell(c, cell);
+    double *pt = &queries[3*q];
+    if (q % 2 == 0)
+      {
+      double pcoords[3], weights[8];
+      int subId = 0;
+      InsideParametricCoordinates(info.Type, random, pcoords);
+      cell->EvaluateLocation(subId, pcoords, pt, weights);
+      }
+    else
+      {
+      double bounds[6];
+      cell->GetBounds(bounds);
+      for (int k = 0 ; k < 3 ; k++)
+        {
+        double size = bounds[2*k+1] - bounds[2*k];
+        pt[k] = bounds[2*k] - 0.25*size + 1.5*size*random.Next();
+        }
+      }
+    }
+  cell->Delete();
+
+  PathResult reference, kernel;
+  CellPath cellPath(grid);
+  KernelPath kernelPath(grid);
+  TimePath(cellPath, queries, info.NumberOfPoints, reference);
+  TimePath(kernelPath, queries, info.NumberOfPoints, kernel);
+  grid->Delete();
+
+  int nInside = 0, nMismatches = 0;
+  double maxWeightError = 0.;
+  for (int q = 0 ; q < nQueries ; q++)
+    {
+    if (reference.Inside[q] != kernel.Inside[q])
+      {
+      nMismatches++;
+      continue;
+      }
+    if (!reference.Inside[q])
+      {
+      continue;
+      }
+    nInside++;
+    for (int i = 0 ; i < info.NumberOfPoints ; i++)
+      {
+      int w = q*CMFECellKernels::MaximumNumberOfPoints + i;
+      maxWeightError = vtkstd::max(maxWeightError,
+        fabs(reference.Weights[w] - kernel.Weights[w]));
+      }
+    }
+
+  cout << info.Name << ": " << nQueries << " queries, " << nInside
+       << " inside" << endl;
+  cout << "  vtkCell " << reference.Time << " s, kernel " << kernel.Time
+       << " s (" << reference.Time / vtkstd::max(kernel.Time, 1e-9)
+       << "x), " << nMismatches << " disagreements, weight error "
+       << maxWeightError << endl;
+
+  // Points within the parametric tolerance of a face may be classified
+  // differently, but that should be exceedingly rare.
+  if (nMismatches > nQueries / 1000 || maxWeightError > 1e-4)
+    {
+    cerr << "The " << info.Name << " kernel does not agree with vtkCell"
+         << endl;
+    return false;
+    }
+  return true;
+}
+}
+
+int BenchmarkCMFECellKernels(int argc, char *argv[])
+{
+  int nQueries = 1000000;
+  for (int i = 1 ; i < argc ; i++)
+    {
+    if (strcmp(argv[i], "-Q") == 0 && i+1 < argc)
+      {
+      nQueries = atoi(argv[++i]);
+      }
+    }
+  if (nQueries < 1)
+    {
+    cerr << "Usage: BenchmarkCMFECellKernels [-Q queriesPerCellType]" << endl;
+    return 1;
+    }
+
+  bool ok = true;
+  for (int t = 0 ; t < 4 ; t++)
+    {
+    ok = RunCellType(cellTypes[t], nQueries) && ok;
+    }
+  return (ok ? 0 : 1);
+}
@@ -0,0 +1,289 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: BenchmarkCMFEIntervalTree.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Builds a vtkCMFEIntervalTree over the cell boxes of a synthetic, slightly
+// perturbed hexahedral grid and times point and ray queries with the heap
+// and the flat node layouts.  The flat layout stores its boxes as floats
+// rounded outwards, so it must return every candidate the heap layout
+// returns.
+//
+// Usage: BenchmarkCMFEIntervalTree [-N cellsPerAxis] [-Q numberOfQueries] [-S]
+// The default of 216 cells per axis gives about ten million boxes.  One
+// ray is cast for every hundred point queries.  -S numbers the cells in a
+// random order, as an unstructured mesh without spatial ordering would.
+
+#include "vtkCMFEIntervalTree.h"
+#include "vtkTimerLog.h"
+
+#include <vtkstd/algorithm>
+#include <vtkstd/vector>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+// Small deterministic generator so every run queries the same points.
+class BenchmarkRandom
+{
+public:
+  BenchmarkRandom() : State(12345) {}
+  double Next()
+    {
+    this->State = this->State * 1103515245u + 12345u;
+    return ((this->State >> 8) & 0xFFFFFF) / double(0x1000000);
+    }
+private:
+  unsigned int State;
+};
+
+struct QueryResult
+{
+  double Time;
+  // Sorted candidates of query q are Ids[Offsets[q]] to Ids[Offsets[q+1]].
+  vtkstd::vector<int> Offsets;
+  vtkstd::vector<int> Ids;
+};
+
+struct LayoutResult
+{
+  double BuildTime;
+  QueryResult Points;
+  QueryResult Rays;
+};
+
+// Runs query q of a set with 'run', timing the best of a few passes to keep
+// the numbers stable on a busy machine.  The candidates are only recorded
+// on the first pass.
+template <class Query>
+void TimeQueries(const Query &run, int nQueries, QueryResult &result)
+{
+  const int nPasses = 3;
+  vtkstd::vector<int> list;
+  result.Offsets.resize(nQueries+1);
+  result.Offsets[0] = 0;
+  result.Ids.clear();
+  for (int pass = 0 ; pass < nPasses ; pass++)
+    {
+    double start = vtkTimerLog::GetUniversalTime();
+    for (int q = 0 ; q < nQueries ; q++)
+      {
+      run(q, list);
+      if (pass == 0)
+        {
+        result.Ids.insert(result.Ids.end(), list.begin(), list.end());
+        result.Offsets[q+1] = static_cast<int>(result.Ids.size());
+        }
+      }
+    double elapsed = vtkTimerLog::GetUniversalTime() - start;
+    if (pass == 0 || elapsed < result.Time)
+      {
+      result.Time = elapsed;
+      }
+    }
+
+  for (int q = 0 ; q < nQueries ; q++)
+    {
+    vtkstd::sort(result.Ids.begin() + result.Offsets[q],
+                 result.Ids.begin() + result.Offsets[q+1]);
+    }
+}
+
+class PointQuery
+{
+public:
+  PointQuery(const vtkCMFEIntervalTree &tree, const vtkstd::vector<double> &pts)
+    : Tree(tree), Points(pts) {}
+  void operator()(int q, vtkstd::vector<int> &list) const
+    {
+    const double *pt = &this->Points[3*q];
+    this->Tree.GetElementsListFromRange(pt, pt, list);
+    }
+private:
+  const vtkCMFEIntervalTree &Tree;
+  const vtkstd::vector<double> &Points;
+};
+
+class RayQuery
+{
+public:
+  RayQuery(const vtkCMFEIntervalTree &tree, const vtkstd::vector<double> &rays)
+    : Tree(tree), Rays(rays) {}
+  void operator()(int q, vtkstd::vector<int> &list) const
+    {
+    double origin[3], dir[3];
+    for (int i = 0 ; i < 3 ; i++)
+      {
+      origin[i] = this->Rays[6*q+i];
+      dir[i] = this->Rays[6*q+3+i];
+      }
+    this->Tree.GetElementsList(origin, dir, list);
+    }
+private:
+  const vtkCMFEIntervalTree &Tree;
+  const vtkstd::vector<double> &Rays;
+};
+
+void RunLayout(int layout, int n, bool shuffle,
+               const vtkstd::vector<double> &points,
+               const vtkstd::vector<double> &rays, LayoutResult &result)
+{
+  int nCells = n*n*n;
+  double h = 1.0 / n;
+  BenchmarkRandom random;
+
+  vtkstd::vector<int> ids(nCells);
+  for (int i = 0 ; i < nCells ; i++)
+    {
+    ids[i] = i;
+    }
+  if (shuffle)
+    {
+    for (int i = nCells-1 ; i > 0 ; i--)
+      {
+      int j = static_cast<int>(random.Next() * (i+1));
+      vtkstd::swap(ids[i], ids[j]);
+      }
+    }
+
+  double start = vtkTimerLog::GetUniversalTime();
+  vtkCMFEIntervalTree tree(nCells, 3, false, layout);
+  int index = 0;
+  for (int k = 0 ; k < n ; k++)
+    {
+    for (int j = 0 ; j < n ; j++)
+      {
+      for (int i = 0 ; i < n ; i++)
+        {
+        // Grow each box by up to 10% of a cell so that neighbors overlap,
+        // as the bounding boxes of a curvilinear mesh would.
+        double bounds[6];
+        bounds[0] = i*h - 0.1*h*random.Next();
+        bounds[1] = (i+1)*h + 0.1*h*random.Next();
+        bounds[2] = j*h - 0.1*h*random.Next();
+        bounds[3] = (j+1)*h + 0.1*h*random.Next();
+        bounds[4] = k*h - 0.1*h*random.Next();
+        bounds[5] = (k+1)*h + 0.1*h*random.Next();
+        tree.AddElement(ids[index++], bounds);
+        }
+      }
+    }
+  tree.Calculate(true);
+  result.BuildTime = vtkTimerLog::GetUniversalTime() - start;
+
+  TimeQueries(PointQuery(tree, points), static_cast<int>(points.size()/3),
+              result.Points);
+  TimeQueries(RayQuery(tree, rays), static_cast<int>(rays.size()/6),
+              result.Rays);
+}
+
+bool ContainsAll(const QueryResult &flat, const QueryResult &heap,
+                 const char *kind)
+{
+  int nQueries = static_cast<int>(heap.Offsets.size()) - 1;
+  for (int q = 0 ; q < nQueries ; q++)
+    {
+    if (!vtkstd::includes(flat.Ids.begin() + flat.Offsets[q],
+                          flat.Ids.begin() + flat.Offsets[q+1],
+                          heap.Ids.begin() + heap.Offsets[q],
+                          heap.Ids.begin() + heap.Offsets[q+1]))
+      {
+      cerr << "The flat layout missed a candidate for " << kind
+           << " query " << q << endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+void Report(const char *kind, const QueryResult &result)
+{
+  int nQueries = static_cast<int>(result.Offsets.size()) - 1;
+  cout << "  " << nQueries << " " << kind << " queries " << result.Time
+       << " s (" << nQueries / vtkstd::max(result.Time, 1e-9)
+       << " queries/s, " << double(result.Ids.size()) / nQueries
+       << " candidates/query)" << endl;
+}
+}
+
+int BenchmarkCMFEIntervalTree(int argc, char *argv[])
+{
+  int n = 216;
+  int nQueries = 1000000;
+  bool shuffle = false;
+  for (int i = 1 ; i < argc ; i++)
+    {
+    if (strcmp(argv[i], "-N") == 0 && i+1 < argc)
+      {
+      n = atoi(argv[++i]);
+      }
+    else if (strcmp(argv[i], "-Q") == 0 && i+1 < argc)
+      {
+      nQueries = atoi(argv[++i]);
+      }
+    else if (strcmp(argv[i], "-S") == 0)
+      {
+      shuffle = true;
+      }
+    }
+  if (n < 1 || nQueries < 1)
+    {
+    cerr << "Usage: BenchmarkCMFEIntervalTree [-N cellsPerAxis] [-Q numberOfQueries] [-S]" << endl;
+    return 1;
+    }
+
+  BenchmarkRandom random;
+  vtkstd::vector<double> points(3*nQueries);
+  for (int i = 0 ; i < 3*nQueries ; i++)
+    {
+    points[i] = random.Next();
+    }
+  int nRays = vtkstd::max(nQueries / 100, 1);
+  vtkstd::vector<double> rays(6*nRays);
+  for (int r = 0 ; r < nRays ; r++)
+    {
+    double *ray = &rays[6*r];
+    for (int i = 0 ; i < 3 ; i++)
+      {
+      ray[i] = random.Next();
+      ray[3+i] = random.Next() - 0.5;
+      }
+    // Make every third ray axis aligned to exercise the zero direction case.
+    if (r % 3 == 0)
+      {
+      ray[3 + (r/3) % 3] = 0.;
+      }
+    }
+
+  const char *names[2] = { "heap", "flat" };
+  LayoutResult results[2];
+  for (int layout = 0 ; layout < 2 ; layout++)
+    {
+    int treeLayout = (layout == 0 ? vtkCMFEIntervalTree::HEAP_LAYOUT
+                                  : vtkCMFEIntervalTree::FLAT_LAYOUT);
+    RunLayout(treeLayout, n, shuffle, points, rays, results[layout]);
+    cout << names[layout] << " layout: " << n*n*n << " boxes, build "
+         << results[layout].BuildTime << " s" << endl;
+    Report("point", results[layout].Points);
+    Report("ray", results[layout].Rays);
+    }
+
+  if (!ContainsAll(results[1].Points, results[0].Points, "point") ||
+      !ContainsAll(results[1].Rays, results[0].Rays, "ray"))
+    {
+    return 1;
+    }
+
+  return 0;
+}
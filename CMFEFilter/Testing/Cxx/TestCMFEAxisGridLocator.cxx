@@ -0,0 +1,252 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: TestCMFEAxisGridLocator.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks that image data and rectilinear grids, which
+// vtkCMFEFastLookupGrouping locates points in directly, give the same
+// values as the same cells in an unstructured grid, which go through the
+// interval tree.  The points are on the faces of the cells, on the upper
+// boundary of the domain, inside the cells and outside of the domain.
+// The grids include a rectilinear grid with uneven spacing and grids
+// that are a single slice along one axis.  The coordinates are exact in
+// single precision, so the points lie exactly on the faces.
+//
+// Usage: TestCMFEAxisGridLocator
+
+#include "vtkCMFEFastLookupGrouping.h"
+#include "vtkCellType.h"
+#include "vtkDoubleArray.h"
+#include "vtkIdList.h"
+#include "vtkImageData.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkRectilinearGrid.h"
+#include "vtkUnstructuredGrid.h"
+
+#include <math.h>
+#include <vtkstd/vector>
+
+namespace
+{
+double Field(const double *x)
+{
+  return x[0]*x[0] + 2.*x[1]*x[2] - x[2];
+}
+
+void AddField(vtkDataSet *mesh)
+{
+  vtkDoubleArray *field = vtkDoubleArray::New();
+  field->SetName("f");
+  field->SetNumberOfTuples(mesh->GetNumberOfPoints());
+  for (vtkIdType i = 0 ; i < mesh->GetNumberOfPoints() ; i++)
+    {
+    field->SetValue(i, Field(mesh->GetPoint(i)));
+    }
+  mesh->GetPointData()->AddArray(field);
+  field->Delete();
+}
+
+vtkImageData *MakeImage(const int dims[3], const double origin[3],
+                        const double spacing[3])
+{
+  vtkImageData *image = vtkImageData::New();
+  image->SetDimensions(dims[0], dims[1], dims[2]);
+  image->SetOrigin(origin[0], origin[1], origin[2]);
+  image->SetSpacing(spacing[0], spacing[1], spacing[2]);
+  AddField(image);
+  return image;
+}
+
+vtkRectilinearGrid *MakeRectilinear(const vtkstd::vector<double> coords[3])
+{
+  vtkRectilinearGrid *rgrid = vtkRectilinearGrid::New();
+  rgrid->SetDimensions((int) coords[0].size(), (int) coords[1].size(),
+                       (int) coords[2].size());
+  vtkDoubleArray *arrays[3];
+  for (int a = 0 ; a < 3 ; a++)
+    {
+    arrays[a] = vtkDoubleArray::New();
+    for (size_t i = 0 ; i < coords[a].size() ; i++)
+      {
+      arrays[a]->InsertNextValue(coords[a][i]);
+      }
+    }
+  rgrid->SetXCoordinates(arrays[0]);
+  rgrid->SetYCoordinates(arrays[1]);
+  rgrid->SetZCoordinates(arrays[2]);
+  for (int a = 0 ; a < 3 ; a++)
+    {
+    arrays[a]->Delete();
+    }
+  AddField(rgrid);
+  return rgrid;
+}
+
+// The same points, cells and field as an unstructured grid.
+vtkUnstructuredGrid *MakeUnstructured(vtkDataSet *mesh)
+{
+  vtkUnstructuredGrid *grid = vtkUnstructuredGrid::New();
+  vtkPoints *points = vtkPoints::New();
+  points->SetDataTypeToDouble();
+  for (vtkIdType i = 0 ; i < mesh->GetNumberOfPoints() ; i++)
+    {
+    points->InsertNextPoint(mesh->GetPoint(i));
+    }
+  grid->SetPoints(points);
+  points->Delete();
+  vtkIdList *ids = vtkIdList::New();
+  grid->Allocate(mesh->GetNumberOfCells());
+  for (vtkIdType c = 0 ; c < mesh->GetNumberOfCells() ; c++)
+    {
+    mesh->GetCellPoints(c, ids);
+    grid->InsertNextCell(mesh->GetCellType(c), ids);
+    }
+  ids->Delete();
+  grid->GetPointData()->ShallowCopy(mesh->GetPointData());
+  return grid;
+}
+
+// The coordinates of the points along each axis.
+void GetAxes(vtkDataSet *mesh, const int dims[3],
+             vtkstd::vector<double> axes[3])
+{
+  for (int a = 0 ; a < 3 ; a++)
+    {
+    int stride = (a == 0 ? 1 : (a == 1 ? dims[0] : dims[0]*dims[1]));
+    axes[a].resize(dims[a]);
+    for (int i = 0 ; i < dims[a] ; i++)
+      {
+      axes[a][i] = mesh->GetPoint((vtkIdType) i*stride)[a];
+      }
+    }
+}
+
+// Positions along an axis: the points, which are on the faces of the
+// cells and include the upper boundary, the middles of the cells, and a
+// position on either side of the axis.
+vtkstd::vector<double> Positions(const vtkstd::vector<double> &axis)
+{
+  vtkstd::vector<double> positions(axis);
+  for (size_t i = 0 ; i + 1 < axis.size() ; i++)
+    {
+    positions.push_back(0.5*(axis[i] + axis[i+1]));
+    }
+  positions.push_back(axis.front() - 0.5);
+  positions.push_back(axis.back() + 0.5);
+  return positions;
+}
+
+bool Compare(const char *what, vtkDataSet *mesh, const int dims[3])
+{
+  vtkUnstructuredGrid *unstructured = MakeUnstructured(mesh);
+  vtkCMFEFastLookupGrouping direct("f", true);
+  direct.AddMesh(mesh);
+  vtkCMFEFastLookupGrouping tree("f", true);
+  tree.AddMesh(unstructured);
+  bool ok = direct.Finalize() && tree.Finalize();
+  if (!ok)
+    {
+    cerr << what << ": the groupings could not be finalized" << endl;
+    }
+
+  vtkstd::vector<double> axes[3];
+  GetAxes(mesh, dims, axes);
+  vtkstd::vector<double> positions[3];
+  for (int a = 0 ; a < 3 ; a++)
+    {
+    positions[a] = Positions(axes[a]);
+    }
+
+  int nFound = 0;
+  for (size_t k = 0 ; ok && k < positions[2].size() ; k++)
+    {
+    for (size_t j = 0 ; ok && j < positions[1].size() ; j++)
+      {
+      for (size_t i = 0 ; ok && i < positions[0].size() ; i++)
+        {
+        float pt[3] = { (float) positions[0][i], (float) positions[1][j],
+                        (float) positions[2][k] };
+        double directValue = 0.;
+        double treeValue = 0.;
+        bool directFound = direct.GetValue(pt, &directValue);
+        bool treeFound = tree.GetValue(pt, &treeValue);
+        if (directFound != treeFound ||
+            (directFound && fabs(directValue - treeValue) > 1e-9))
+          {
+          cerr << what << ", (" << pt[0] << ", " << pt[1] << ", " << pt[2]
+               << "): found " << directFound << " with " << directValue
+               << " directly, " << treeFound << " with " << treeValue
+               << " through the tree" << endl;
+          ok = false;
+          }
+        nFound += (directFound ? 1 : 0);
+        }
+      }
+    }
+
+  // Every position but the ones outside of an axis is in the domain.
+  int nInside = 1;
+  for (int a = 0 ; a < 3 ; a++)
+    {
+    nInside *= (int) positions[a].size() - 2;
+    }
+  if (ok && nFound != nInside)
+    {
+    cerr << what << ": found " << nFound << " of the " << nInside
+         << " positions in the domain" << endl;
+    ok = false;
+    }
+
+  unstructured->Delete();
+  return ok;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestCMFEAxisGridLocator(int, char *[])
+{
+  bool ok = true;
+
+  const int dims[3] = { 5, 4, 3 };
+  const double origin[3] = { -1., 0.5, 2. };
+  const double spacing[3] = { 0.5, 1., 0.25 };
+  vtkImageData *image = MakeImage(dims, origin, spacing);
+  ok = Compare("Image data", image, dims) && ok;
+  image->Delete();
+
+  const int flatDims[3] = { 6, 5, 1 };
+  vtkImageData *flatImage = MakeImage(flatDims, origin, spacing);
+  ok = Compare("Image data with a single slice", flatImage, flatDims) && ok;
+  flatImage->Delete();
+
+  const double x[] = { 0., 0.125, 0.5, 1.75, 2. };
+  const double y[] = { -1., 0., 3. };
+  const double z[] = { 0., 0.1875, 0.25, 1. };
+  vtkstd::vector<double> coords[3];
+  coords[0].assign(x, x + 5);
+  coords[1].assign(y, y + 3);
+  coords[2].assign(z, z + 4);
+  const int rdims[3] = { 5, 3, 4 };
+  vtkRectilinearGrid *rgrid = MakeRectilinear(coords);
+  ok = Compare("Rectilinear grid", rgrid, rdims) && ok;
+  rgrid->Delete();
+
+  coords[1].assign(1, 0.75);
+  const int flatRdims[3] = { 5, 1, 4 };
+  vtkRectilinearGrid *flatRgrid = MakeRectilinear(coords);
+  ok = Compare("Rectilinear grid with a single slice", flatRgrid,
+               flatRdims) && ok;
+  flatRgrid->Delete();
+
+  return (ok ? 0 : 1);
+}
@@ -0,0 +1,167 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: TestCMFEFallbackRelocation.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks that relocating a vtkCMFEFastLookupGrouping sends a cell to the
+// processor of a region that is within FallbackTolerance of the cell,
+// even when the cell does not overlap that region.  The partition of the
+// test has a single region that ends at x = 2, as if the space beyond
+// belonged to another processor.  The donor is one cell just across that
+// boundary, and the sample point lies just inside it, so it can only get
+// its value from the fallback if the cell was relocated along with it.
+// The donor is given both as an unstructured grid and as image data,
+// which is relocated in blocks.
+//
+// Usage: TestCMFEFallbackRelocation
+
+#include "vtkCMFEDesiredPoints.h"
+#include "vtkCMFEFastLookupGrouping.h"
+#include "vtkCMFESpatialPartition.h"
+#include "vtkDataSet.h"
+#include "vtkFloatArray.h"
+#include "vtkImageData.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkUnstructuredGrid.h"
+
+#include <math.h>
+#include <vtkstd/vector>
+
+namespace
+{
+const double boundary = 2.;
+const double tolerance = 0.2;
+const double cellOrigin[3] = { 2.1, 0., 0. };
+
+double Field(const double *x)
+{
+  return x[0] + 2.*x[1] + 3.*x[2];
+}
+
+// A partition with a single region that ends at the boundary.
+class BoundaryPartition : public vtkCMFESpatialPartition
+{
+public:
+  virtual void CreatePartition(vtkCMFEDesiredPoints *,
+                               vtkCMFEFastLookupGrouping *, double *bounds)
+    {
+    vtkstd::vector<double> boxes(bounds, bounds + 6);
+    boxes[1] = boundary;
+    this->SetRegions(boxes, vtkstd::vector<int>(1, 0));
+    }
+};
+
+void AddField(vtkDataSet *mesh)
+{
+  vtkFloatArray *field = vtkFloatArray::New();
+  field->SetName("f");
+  for (vtkIdType i = 0 ; i < mesh->GetNumberOfPoints() ; i++)
+    {
+    field->InsertNextValue((float) Field(mesh->GetPoint(i)));
+    }
+  mesh->GetPointData()->AddArray(field);
+  field->Delete();
+}
+
+// A single hexahedron of unit size at cellOrigin.
+vtkDataSet *MakeHexahedron()
+{
+  vtkUnstructuredGrid *grid = vtkUnstructuredGrid::New();
+  vtkPoints *points = vtkPoints::New();
+  const int offsets[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0},
+                              {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+  vtkIdType ids[8];
+  for (int c = 0 ; c < 8 ; c++)
+    {
+    ids[c] = points->InsertNextPoint(cellOrigin[0] + offsets[c][0],
+                                     cellOrigin[1] + offsets[c][1],
+                                     cellOrigin[2] + offsets[c][2]);
+    }
+  grid->SetPoints(points);
+  points->Delete();
+  grid->Allocate(1);
+  grid->InsertNextCell(VTK_HEXAHEDRON, 8, ids);
+  AddField(grid);
+  return grid;
+}
+
+// The same cell as image data.
+vtkDataSet *MakeImage()
+{
+  vtkImageData *image = vtkImageData::New();
+  image->SetDimensions(2, 2, 2);
+  image->SetOrigin(cellOrigin[0], cellOrigin[1], cellOrigin[2]);
+  image->SetSpacing(1., 1., 1.);
+  AddField(image);
+  return image;
+}
+
+bool CheckDonor(const char *what, vtkDataSet *donor)
+{
+  const double sample[3] = { boundary - 0.05, 0.5, 0.25 };
+  vtkPolyData *list = vtkPolyData::New();
+  vtkPoints *points = vtkPoints::New();
+  points->InsertNextPoint(sample);
+  list->SetPoints(points);
+  points->Delete();
+
+  vtkCMFEFastLookupGrouping flg("f", true);
+  flg.SetFallbackTolerance(tolerance);
+  flg.AddMesh(donor);
+  vtkCMFEDesiredPoints dp(true, 1);
+  dp.AddDataset(list);
+  dp.Finalize();
+
+  double bounds[6] = { 0., 4., 0., 1., 0., 1. };
+  BoundaryPartition spat_part;
+  spat_part.CreatePartition(&dp, &flg, bounds);
+  dp.RelocatePointsUsingPartition(&spat_part);
+  flg.RelocateDataUsingPartition(&spat_part);
+  flg.Finalize();
+
+  // The closest point of the cell is straight across the boundary.
+  const double nearest[3] = { cellOrigin[0], sample[1], sample[2] };
+  float pt[3] = { (float) sample[0], (float) sample[1], (float) sample[2] };
+  double value = 0.;
+  bool ok = true;
+  if (!flg.GetValue(pt, &value))
+    {
+    cerr << what << ": the sample point was not found" << endl;
+    ok = false;
+    }
+  else if (fabs(value - Field(nearest)) > 1e-4)
+    {
+    cerr << what << ": got " << value << ", expected " << Field(nearest)
+         << endl;
+    ok = false;
+    }
+
+  list->Delete();
+  return ok;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestCMFEFallbackRelocation(int, char *[])
+{
+  vtkDataSet *hexahedron = MakeHexahedron();
+  vtkDataSet *image = MakeImage();
+
+  bool ok = CheckDonor("Unstructured grid", hexahedron);
+  ok = CheckDonor("Image data", image) && ok;
+
+  hexahedron->Delete();
+  image->Delete();
+  return (ok ? 0 : 1);
+}
@@ -0,0 +1,251 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: TestCMFEFilterRemapReuse.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Runs vtkCMFEFilter with kept interpolation weights and checks what a
+// later execution reuses.  The mesh to map from has two arrays.  When
+// only one of them changes, the result of the other one is the very same
+// array, and the changed one is mapped again.  When the geometry of the
+// mesh changes, the weights are computed again and both results follow
+// the moved points.  After every execution the number of points located
+// and missed has to match the point list, whose last point is outside of
+// the mesh and takes the value of its own array.
+//
+// Usage: TestCMFEFilterRemapReuse
+
+#include "vtkCMFEFilter.h"
+#include "vtkDataArray.h"
+#include "vtkDataObject.h"
+#include "vtkFloatArray.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkUnstructuredGrid.h"
+
+#include <math.h>
+
+namespace
+{
+const int nSamples = 4;
+const double samples[nSamples][3] = { { 0.5, 0.6, 0.2 }, { 2.7, 1.1, 2.4 },
+                                      { 1.5, 2.25, 0.9 }, { -1., 0.5, 0.5 } };
+
+double Field(const double *x)
+{
+  return x[0] + 2.*x[1] + 3.*x[2];
+}
+
+vtkFloatArray *AddArray(vtkDataSet *mesh, const char *name)
+{
+  vtkFloatArray *array = vtkFloatArray::New();
+  array->SetName(name);
+  array->SetNumberOfTuples(mesh->GetNumberOfPoints());
+  mesh->GetPointData()->AddArray(array);
+  array->Delete();
+  return array;
+}
+
+// Sets the values of an array of the mesh to scale times the field at
+// the point, shifted by offset along x.
+void SetValues(vtkDataSet *mesh, vtkFloatArray *array, double scale,
+               double offset)
+{
+  for (vtkIdType i = 0 ; i < mesh->GetNumberOfPoints() ; i++)
+    {
+    double x[3];
+    mesh->GetPoint(i, x);
+    x[0] -= offset;
+    array->SetValue(i, (float) (scale*Field(x)));
+    }
+  array->Modified();
+}
+
+// A grid of n^3 hexahedra of unit size starting at the origin.
+vtkUnstructuredGrid *MakeHexGrid(int n)
+{
+  vtkUnstructuredGrid *grid = vtkUnstructuredGrid::New();
+  vtkPoints *points = vtkPoints::New();
+  for (int k = 0 ; k <= n ; k++)
+    {
+    for (int j = 0 ; j <= n ; j++)
+      {
+      for (int i = 0 ; i <= n ; i++)
+        {
+        points->InsertNextPoint(i, j, k);
+        }
+      }
+    }
+  grid->SetPoints(points);
+  points->Delete();
+
+  grid->Allocate(n*n*n);
+  const int offsets[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0},
+                              {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+  for (int k = 0 ; k < n ; k++)
+    {
+    for (int j = 0 ; j < n ; j++)
+      {
+      for (int i = 0 ; i < n ; i++)
+        {
+        vtkIdType ids[8];
+        for (int c = 0 ; c < 8 ; c++)
+          {
+          ids[c] = (i + offsets[c][0]) + (n + 1)*((j + offsets[c][1]) +
+                   (n + 1)*(k + offsets[c][2]));
+          }
+        grid->InsertNextCell(VTK_HEXAHEDRON, 8, ids);
+        }
+      }
+    }
+  return grid;
+}
+
+// Checks a result against scale times the field, shifted by offset along
+// x, and the fallback for the point outside of the mesh.
+bool CheckResult(const char *what, vtkDataArray *result, double scale,
+                 double offset)
+{
+  if (result == NULL)
+    {
+    cerr << what << ": no result" << endl;
+    return false;
+    }
+  bool ok = true;
+  for (int i = 0 ; i < nSamples ; i++)
+    {
+    double x[3] = { samples[i][0] - offset, samples[i][1], samples[i][2] };
+    double want = (i < nSamples - 1 ? scale*Field(x) : 100. + i);
+    double got = result->GetTuple1(i);
+    if (fabs(got - want) > 1e-4)
+      {
+      cerr << what << ", sample " << i << ": got " << got << ", expected "
+           << want << endl;
+      ok = false;
+      }
+    }
+  return ok;
+}
+
+bool CheckCounts(const char *what, vtkCMFEFilter *filter)
+{
+  if (filter->GetNumberOfPointsLocated() != nSamples - 1 ||
+      filter->GetNumberOfPointsNearest() != 0 ||
+      filter->GetNumberOfPointsMissed() != 1)
+    {
+    cerr << what << ": located " << filter->GetNumberOfPointsLocated()
+         << ", nearest " << filter->GetNumberOfPointsNearest()
+         << ", missed " << filter->GetNumberOfPointsMissed() << endl;
+    return false;
+    }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestCMFEFilterRemapReuse(int, char *[])
+{
+  vtkUnstructuredGrid *mesh = MakeHexGrid(3);
+  vtkFloatArray *f = AddArray(mesh, "f");
+  vtkFloatArray *h = AddArray(mesh, "h");
+  SetValues(mesh, f, 1., 0.);
+  SetValues(mesh, h, 2., 0.);
+
+  vtkPolyData *list = vtkPolyData::New();
+  vtkPoints *points = vtkPoints::New();
+  vtkFloatArray *g = vtkFloatArray::New();
+  g->SetName("g");
+  for (int i = 0 ; i < nSamples ; i++)
+    {
+    points->InsertNextPoint(samples[i]);
+    g->InsertNextValue(100.f + i);
+    }
+  list->SetPoints(points);
+  list->GetPointData()->AddArray(g);
+  points->Delete();
+  g->Delete();
+
+  vtkCMFEFilter *filter = vtkCMFEFilter::New();
+  filter->SetInputConnection(0, mesh->GetProducerPort());
+  filter->SetSourceConnection(list->GetProducerPort());
+  filter->SetInputArrayToProcess(0, 0, 0,
+    vtkDataObject::FIELD_ASSOCIATION_POINTS, "f");
+  filter->SetInputArrayToProcess(1, 1, 0,
+    vtkDataObject::FIELD_ASSOCIATION_POINTS, "g");
+  filter->AddArrayToMap("h");
+  filter->UseRemapOperatorOn();
+
+  // The first execution computes the weights.  The points outside of the
+  // mesh take the values of g, which the list has for f but not for h.
+  filter->Update();
+  vtkPointData *out = vtkDataSet::SafeDownCast(
+    filter->GetOutputDataObject(0))->GetPointData();
+  vtkDataArray *fFirst = out->GetArray("f");
+  vtkDataArray *hFirst = out->GetArray("h");
+  bool ok = CheckResult("f", fFirst, 1., 0.);
+  ok = CheckCounts("First execution", filter) && ok;
+
+  // Only h changes, so f keeps its result.
+  SetValues(mesh, h, 3., 0.);
+  filter->Modified();
+  filter->Update();
+  out = vtkDataSet::SafeDownCast(filter->GetOutputDataObject(0))->GetPointData();
+  if (out->GetArray("f") != fFirst)
+    {
+    cerr << "The result of the unchanged array was not reused" << endl;
+    ok = false;
+    }
+  if (out->GetArray("h") == hFirst)
+    {
+    cerr << "The result of the changed array was reused" << endl;
+    ok = false;
+    }
+  vtkDataArray *hResult = out->GetArray("h");
+  for (int i = 0 ; hResult && i < nSamples - 1 ; i++)
+    {
+    if (fabs(hResult->GetTuple1(i) - 3.*Field(samples[i])) > 1e-4)
+      {
+      cerr << "h, sample " << i << ": got " << hResult->GetTuple1(i)
+           << ", expected " << 3.*Field(samples[i]) << endl;
+      ok = false;
+      }
+    }
+  ok = CheckCounts("Reused weights", filter) && ok;
+
+  // Moving the points changes the geometry, so the weights are computed
+  // again, and the values, which stay attached to the points, move along.
+  const double shift = 0.25;
+  vtkPoints *meshPoints = mesh->GetPoints();
+  for (vtkIdType i = 0 ; i < meshPoints->GetNumberOfPoints() ; i++)
+    {
+    double x[3];
+    meshPoints->GetPoint(i, x);
+    x[0] += shift;
+    meshPoints->SetPoint(i, x);
+    }
+  meshPoints->Modified();
+  filter->Modified();
+  filter->Update();
+  out = vtkDataSet::SafeDownCast(filter->GetOutputDataObject(0))->GetPointData();
+  if (out->GetArray("f") == fFirst)
+    {
+    cerr << "The result of f was reused after the geometry changed" << endl;
+    ok = false;
+    }
+  ok = CheckResult("Moved f", out->GetArray("f"), 1., shift) && ok;
+  ok = CheckCounts("Moved mesh", filter) && ok;
+
+  filter->Delete();
+  list->Delete();
+  mesh->Delete();
+  return (ok ? 0 : 1);
+}
@@ -0,0 +1,127 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: TestCMFEKdTree.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks the queries of vtkCMFEKdTree against a brute force search over
+// point clouds of several sizes, from an empty cloud to one large enough
+// for the tree to be built by several threads.  The clouds are flat along
+// z so that the split axes vary.
+//
+// Usage: TestCMFEKdTree
+
+#include "vtkCMFEKdTree.h"
+
+#include <vtkstd/algorithm>
+#include <vtkstd/vector>
+
+namespace
+{
+typedef vtkstd::pair<double, vtkIdType> Neighbor;
+
+const int numberOfNeighbors = 8;
+const double radius = 0.05;
+
+// Small deterministic generator so every run queries the same points.
+class TestRandom
+{
+public:
+  TestRandom() : State(12345) {}
+  double Next()
+    {
+    this->State = this->State * 1103515245u + 12345u;
+    return ((this->State >> 8) & 0xFFFFFF) / double(0x1000000);
+    }
+private:
+  unsigned int State;
+};
+
+bool CheckCloud(vtkIdType n, int nQueries, TestRandom &random)
+{
+  vtkstd::vector<double> points(3*n);
+  vtkstd::vector<vtkIdType> ids(n);
+  for (vtkIdType i = 0 ; i < n ; i++)
+    {
+    points[3*i] = random.Next();
+    points[3*i+1] = random.Next();
+    points[3*i+2] = 0.1*random.Next();
+    ids[i] = 3*i + 1;
+    }
+  vtkCMFEKdTree tree;
+  tree.Build(n, (n > 0 ? &points[0] : NULL), (n > 0 ? &ids[0] : NULL), 0);
+
+  int nErrors = 0;
+  vtkstd::vector<Neighbor> all;
+  vtkstd::vector<Neighbor> result;
+  for (int q = 0 ; q < nQueries ; q++)
+    {
+    double x[3] = { random.Next(), random.Next(), 0.1*random.Next() };
+    all.clear();
+    for (vtkIdType i = 0 ; i < n ; i++)
+      {
+      double dx = points[3*i] - x[0];
+      double dy = points[3*i+1] - x[1];
+      double dz = points[3*i+2] - x[2];
+      all.push_back(Neighbor(dx*dx + dy*dy + dz*dz, ids[i]));
+      }
+    vtkstd::sort(all.begin(), all.end());
+
+    double dist2;
+    vtkIdType closest = tree.FindClosestPoint(x, dist2);
+    if (closest != (n > 0 ? all[0].second : -1))
+      {
+      nErrors++;
+      }
+
+    tree.FindClosestNPoints(numberOfNeighbors, x, result);
+    size_t k = vtkstd::min<size_t>(numberOfNeighbors, all.size());
+    if (result.size() != k ||
+        !vtkstd::equal(result.begin(), result.end(), all.begin()))
+      {
+      nErrors++;
+      }
+
+    tree.FindPointsWithinRadius(radius, x, result);
+    vtkstd::sort(result.begin(), result.end());
+    size_t nWithin = 0;
+    while (nWithin < all.size() && all[nWithin].first <= radius*radius)
+      {
+      nWithin++;
+      }
+    if (result.size() != nWithin ||
+        !vtkstd::equal(result.begin(), result.end(), all.begin()))
+      {
+      nErrors++;
+      }
+    }
+
+  if (nErrors > 0)
+    {
+    cerr << nErrors << " wrong queries over " << n << " points" << endl;
+    }
+  return (nErrors == 0);
+}
+}
+
+//----------------------------------------------------------------------------
+int TestCMFEKdTree(int, char *[])
+{
+  TestRandom random;
+  bool ok = true;
+  const vtkIdType sizes[6] = { 0, 1, vtkCMFEKdTree::LeafSize,
+                               vtkCMFEKdTree::LeafSize + 1, 1000, 200000 };
+  for (int i = 0 ; i < 6 ; i++)
+    {
+    ok = CheckCloud(sizes[i], 200, random) && ok;
+    }
+  return (ok ? 0 : 1);
+}
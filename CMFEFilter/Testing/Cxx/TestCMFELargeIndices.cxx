@@ -0,0 +1,180 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: TestCMFELargeIndices.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks that vtkCMFEDesiredPoints indexes sample points past 2^31.  The
+// desired points are a small point list followed by a rectilinear grid of
+// 2048x1024x1025 points.  A rectilinear grid only stores its coordinate
+// arrays, and no values are allocated when there are no components, so
+// the test needs a few kilobytes no matter how many points it indexes.
+//
+// It also checks that vtkCMFEFastLookupGrouping refuses to finalize, rather
+// than build a tree over wrapped ids, when it is given image data with
+// 2^31 cells, one more than its 32 bit element ids can address.  Image
+// data stores no cells, and the grouping counts them before allocating
+// anything.
+//
+// Usage: TestCMFELargeIndices
+
+#include "vtkCMFEDesiredPoints.h"
+#include "vtkCMFEFastLookupGrouping.h"
+#include "vtkFloatArray.h"
+#include "vtkImageData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkRectilinearGrid.h"
+
+namespace
+{
+const int gridDims[3] = { 2048, 1024, 1025 };
+const int numberOfListPoints = 10;
+
+// The coordinate of index i along axis a of the grid.
+float GridCoordinate(int a, vtkIdType i)
+{
+  return (float) (a + 1) * 0.5f * (float) i;
+}
+
+bool CheckPoint(const char *what, const float *pt, float x, float y, float z)
+{
+  if (pt[0] != x || pt[1] != y || pt[2] != z)
+    {
+    cerr << what << ": got (" << pt[0] << ", " << pt[1] << ", " << pt[2]
+         << "), expected (" << x << ", " << y << ", " << z << ")" << endl;
+    return false;
+    }
+  return true;
+}
+
+// Checks the point at the given index of the grid, both through GetPoint,
+// which has to find the grid first, and through GetRGridPoints.
+bool CheckGridPoint(vtkCMFEDesiredPoints &dp, vtkIdType index)
+{
+  vtkIdType i = index % gridDims[0];
+  vtkIdType j = (index / gridDims[0]) % gridDims[1];
+  vtkIdType k = index / ((vtkIdType) gridDims[0] * gridDims[1]);
+  float x = GridCoordinate(0, i);
+  float y = GridCoordinate(1, j);
+  float z = GridCoordinate(2, k);
+
+  float pt[3];
+  dp.GetPoint(dp.GetRGridStart() + index, pt);
+  bool ok = CheckPoint("GetPoint", pt, x, y, z);
+  dp.GetRGridPoints(0, index, 1, pt);
+  return CheckPoint("GetRGridPoints", pt, x, y, z) && ok;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestCMFELargeIndices(int, char *[])
+{
+  if (sizeof(vtkIdType) < 8)
+    {
+    cerr << "vtkIdType is 32 bits, there is nothing to test." << endl;
+    return 0;
+    }
+
+  bool ok = true;
+
+  vtkPolyData *list = vtkPolyData::New();
+  vtkPoints *points = vtkPoints::New();
+  for (int i = 0 ; i < numberOfListPoints ; i++)
+    {
+    points->InsertNextPoint(-i, -2*i, -3*i);
+    }
+  list->SetPoints(points);
+  points->Delete();
+
+  vtkRectilinearGrid *grid = vtkRectilinearGrid::New();
+  grid->SetDimensions(gridDims[0], gridDims[1], gridDims[2]);
+  vtkFloatArray *coords[3];
+  for (int a = 0 ; a < 3 ; a++)
+    {
+    coords[a] = vtkFloatArray::New();
+    coords[a]->SetNumberOfTuples(gridDims[a]);
+    for (int i = 0 ; i < gridDims[a] ; i++)
+      {
+      coords[a]->SetValue(i, GridCoordinate(a, i));
+      }
+    }
+  grid->SetXCoordinates(coords[0]);
+  grid->SetYCoordinates(coords[1]);
+  grid->SetZCoordinates(coords[2]);
+  for (int a = 0 ; a < 3 ; a++)
+    {
+    coords[a]->Delete();
+    }
+
+  vtkCMFEDesiredPoints dp(true, 0);
+  dp.AddDataset(list);
+  dp.AddDataset(grid);
+  dp.Finalize();
+  list->Delete();
+  grid->Delete();
+
+  const vtkIdType gridSize =
+    (vtkIdType) gridDims[0] * gridDims[1] * gridDims[2];
+  if (dp.GetNumberOfPoints() != numberOfListPoints + gridSize ||
+      dp.GetRGridStart() != numberOfListPoints ||
+      dp.GetDataSetStart(1) != numberOfListPoints ||
+      dp.GetDataSetSize(0) != numberOfListPoints ||
+      dp.GetDataSetSize(1) != gridSize)
+    {
+    cerr << "Wrong sizes: " << dp.GetNumberOfPoints() << " points, grid "
+         << "starts at " << dp.GetDataSetStart(1) << " with "
+         << dp.GetDataSetSize(1) << " points" << endl;
+    ok = false;
+    }
+
+  float pt[3];
+  dp.GetPoint(numberOfListPoints-1, pt);
+  ok = CheckPoint("GetPoint", pt, 1.f-numberOfListPoints,
+                  2.f*(1-numberOfListPoints), 3.f*(1-numberOfListPoints)) && ok;
+
+  // The first point, the points around index 2^31 of the desired points
+  // and the last point of the grid.
+  const vtkIdType indices[4] =
+    { 0, (vtkIdType) VTK_INT_MAX - numberOfListPoints,
+      (vtkIdType) VTK_INT_MAX + 1, gridSize - 1 };
+  for (int i = 0 ; i < 4 ; i++)
+    {
+    ok = CheckGridPoint(dp, indices[i]) && ok;
+    }
+
+  // A run of points that crosses 2^31 and wraps around to the next
+  // row and plane of the grid.
+  const vtkIdType runStart = gridSize - (vtkIdType) gridDims[0] * gridDims[1] - 2;
+  float run[3*4];
+  dp.GetRGridPoints(0, runStart, 4, run);
+  for (int i = 0 ; i < 4 ; i++)
+    {
+    vtkIdType index = runStart + i;
+    ok = CheckPoint("GetRGridPoints run", run + 3*i,
+      GridCoordinate(0, index % gridDims[0]),
+      GridCoordinate(1, (index / gridDims[0]) % gridDims[1]),
+      GridCoordinate(2, index / ((vtkIdType) gridDims[0] * gridDims[1]))) && ok;
+    }
+
+  vtkImageData *image = vtkImageData::New();
+  image->SetDimensions(2049, 1025, 1025);
+  vtkCMFEFastLookupGrouping flg("", false);
+  flg.AddMesh(image);
+  image->Delete();
+  if (flg.Finalize() || flg.IsFinalized())
+    {
+    cerr << "The grouping finalized with more cells than it can index" << endl;
+    ok = false;
+    }
+
+  return (ok ? 0 : 1);
+}
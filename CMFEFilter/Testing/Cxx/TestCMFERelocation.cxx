@@ -0,0 +1,164 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: TestCMFERelocation.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Relocates a vtkCMFEFastLookupGrouping of two unstructured meshes with
+// different numbers of points, the larger one first, and checks that the
+// relocated meshes hold the same cells and still sample a linear field
+// exactly.  On a single processor the relocation sends every piece to
+// itself, which still packs and unpacks all of them.
+//
+// Usage: TestCMFERelocation
+
+#include "vtkCMFEDesiredPoints.h"
+#include "vtkCMFEFastLookupGrouping.h"
+#include "vtkCMFESpatialPartition.h"
+#include "vtkDataSet.h"
+#include "vtkFloatArray.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkUnstructuredGrid.h"
+
+#include <math.h>
+
+namespace
+{
+double Field(const double *x)
+{
+  return x[0] + 2.*x[1] + 3.*x[2];
+}
+
+// A grid of n^3 hexahedra of unit size starting at origin, with the
+// field as point data.
+vtkUnstructuredGrid *MakeHexGrid(int n, const double *origin)
+{
+  vtkUnstructuredGrid *grid = vtkUnstructuredGrid::New();
+  vtkPoints *points = vtkPoints::New();
+  vtkFloatArray *field = vtkFloatArray::New();
+  field->SetName("f");
+  for (int k = 0 ; k <= n ; k++)
+    {
+    for (int j = 0 ; j <= n ; j++)
+      {
+      for (int i = 0 ; i <= n ; i++)
+        {
+        double x[3] = { origin[0] + i, origin[1] + j, origin[2] + k };
+        points->InsertNextPoint(x);
+        field->InsertNextValue((float) Field(x));
+        }
+      }
+    }
+  grid->SetPoints(points);
+  grid->GetPointData()->AddArray(field);
+  points->Delete();
+  field->Delete();
+
+  grid->Allocate(n*n*n);
+  const int offsets[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0},
+                              {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+  for (int k = 0 ; k < n ; k++)
+    {
+    for (int j = 0 ; j < n ; j++)
+      {
+      for (int i = 0 ; i < n ; i++)
+        {
+        vtkIdType ids[8];
+        for (int c = 0 ; c < 8 ; c++)
+          {
+          ids[c] = (i + offsets[c][0]) + (n + 1)*((j + offsets[c][1]) +
+                   (n + 1)*(k + offsets[c][2]));
+          }
+        grid->InsertNextCell(VTK_HEXAHEDRON, 8, ids);
+        }
+      }
+    }
+  return grid;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestCMFERelocation(int, char *[])
+{
+  const double largeOrigin[3] = { 0., 0., 0. };
+  const double smallOrigin[3] = { 10., 0., 0. };
+  vtkUnstructuredGrid *large = MakeHexGrid(4, largeOrigin);
+  vtkUnstructuredGrid *small = MakeHexGrid(1, smallOrigin);
+
+  // Points inside both meshes, away from the faces of their cells.
+  const int nSamples = 4;
+  const double samples[nSamples][3] = { { 0.3, 0.6, 0.2 }, { 3.7, 3.1, 2.4 },
+                                        { 1.5, 2.25, 3.9 }, { 10.4, 0.7, 0.1 } };
+  vtkPolyData *list = vtkPolyData::New();
+  vtkPoints *points = vtkPoints::New();
+  for (int i = 0 ; i < nSamples ; i++)
+    {
+    points->InsertNextPoint(samples[i]);
+    }
+  list->SetPoints(points);
+  points->Delete();
+
+  vtkCMFEFastLookupGrouping flg("f", true);
+  flg.AddMesh(large);
+  flg.AddMesh(small);
+  vtkCMFEDesiredPoints dp(true, 1);
+  dp.AddDataset(list);
+  dp.Finalize();
+
+  double bounds[6] = { 0., 11., 0., 4., 0., 4. };
+  vtkCMFESpatialPartition spat_part;
+  spat_part.CreatePartition(&dp, &flg, bounds);
+  dp.RelocatePointsUsingPartition(&spat_part);
+  flg.RelocateDataUsingPartition(&spat_part);
+  flg.Finalize();
+
+  bool ok = true;
+  vtkIdType nPoints = 0;
+  vtkIdType nCells = 0;
+  for (size_t i = 0 ; i < flg.GetMeshes().size() ; i++)
+    {
+    nPoints += flg.GetMeshes()[i]->GetNumberOfPoints();
+    nCells += flg.GetMeshes()[i]->GetNumberOfCells();
+    }
+  if (nPoints != large->GetNumberOfPoints() + small->GetNumberOfPoints() ||
+      nCells != large->GetNumberOfCells() + small->GetNumberOfCells())
+    {
+    cerr << "Relocated meshes have " << nPoints << " points and " << nCells
+         << " cells" << endl;
+    ok = false;
+    }
+
+  for (int i = 0 ; i < nSamples ; i++)
+    {
+    float pt[3] = { (float) samples[i][0], (float) samples[i][1],
+                    (float) samples[i][2] };
+    double x[3] = { pt[0], pt[1], pt[2] };
+    double value = 0.;
+    if (!flg.GetValue(pt, &value))
+      {
+      cerr << "Sample " << i << " was not found" << endl;
+      ok = false;
+      }
+    else if (fabs(value - Field(x)) > 1e-4)
+      {
+      cerr << "Sample " << i << ": got " << value << ", expected "
+           << Field(x) << endl;
+      ok = false;
+      }
+    }
+
+  list->Delete();
+  large->Delete();
+  small->Delete();
+  return (ok ? 0 : 1);
+}
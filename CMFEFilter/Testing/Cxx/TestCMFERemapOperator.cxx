@@ -0,0 +1,261 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: TestCMFERemapOperator.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Builds a vtkCMFERemapOperator from an unstructured mesh to a list of
+// points, writes it to a file and reads it back, and checks that applying
+// it gives the same values as the direct cross mesh field evaluation.
+// Some of the points are outside the mesh, so they take the values of the
+// fallback array of the point list.  It also checks that a truncated file
+// and a file with more data than its header counts are rejected, and that
+// Apply rejects a donor with the wrong number of tuples and a fallback
+// with the wrong number of components.
+//
+// Usage: TestCMFERemapOperator
+
+#include "vtkCMFEAlgorithm.h"
+#include "vtkCMFEFastLookupGrouping.h"
+#include "vtkCMFERemapOperator.h"
+#include "vtkDataArray.h"
+#include "vtkDataSet.h"
+#include "vtkFloatArray.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkUnstructuredGrid.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <vtkstd/string>
+#include <vtkstd/vector>
+
+namespace
+{
+const char *operatorFile = "TestCMFERemapOperator.op";
+const char *brokenFile = "TestCMFERemapOperatorBroken.op";
+
+double Field(const double *x)
+{
+  return x[0] + 2.*x[1] + 3.*x[2];
+}
+
+// A grid of n^3 hexahedra of unit size starting at the origin, with the
+// field as point data.
+vtkUnstructuredGrid *MakeHexGrid(int n)
+{
+  vtkUnstructuredGrid *grid = vtkUnstructuredGrid::New();
+  vtkPoints *points = vtkPoints::New();
+  vtkFloatArray *field = vtkFloatArray::New();
+  field->SetName("f");
+  for (int k = 0 ; k <= n ; k++)
+    {
+    for (int j = 0 ; j <= n ; j++)
+      {
+      for (int i = 0 ; i <= n ; i++)
+        {
+        double x[3] = { (double) i, (double) j, (double) k };
+        points->InsertNextPoint(x);
+        field->InsertNextValue((float) Field(x));
+        }
+      }
+    }
+  grid->SetPoints(points);
+  grid->GetPointData()->AddArray(field);
+  points->Delete();
+  field->Delete();
+
+  grid->Allocate(n*n*n);
+  const int offsets[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0},
+                              {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+  for (int k = 0 ; k < n ; k++)
+    {
+    for (int j = 0 ; j < n ; j++)
+      {
+      for (int i = 0 ; i < n ; i++)
+        {
+        vtkIdType ids[8];
+        for (int c = 0 ; c < 8 ; c++)
+          {
+          ids[c] = (i + offsets[c][0]) + (n + 1)*((j + offsets[c][1]) +
+                   (n + 1)*(k + offsets[c][2]));
+          }
+        grid->InsertNextCell(VTK_HEXAHEDRON, 8, ids);
+        }
+      }
+    }
+  return grid;
+}
+
+// Reads the whole file, or returns an empty buffer.
+vtkstd::vector<char> ReadFile(const char *fileName)
+{
+  vtkstd::vector<char> bytes;
+  FILE *file = fopen(fileName, "rb");
+  if (file != NULL)
+    {
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      {
+      bytes.insert(bytes.end(), buffer, buffer + n);
+      }
+    fclose(file);
+    }
+  return bytes;
+}
+
+void WriteFile(const char *fileName, const vtkstd::vector<char> &bytes)
+{
+  FILE *file = fopen(fileName, "wb");
+  if (file != NULL)
+    {
+    if (!bytes.empty())
+      {
+      fwrite(&bytes[0], 1, bytes.size(), file);
+      }
+    fclose(file);
+    }
+}
+
+bool CheckRejected(const char *what, const vtkstd::vector<char> &bytes)
+{
+  WriteFile(brokenFile, bytes);
+  vtkCMFERemapOperator op;
+  if (op.Read(brokenFile) || op.IsValid())
+    {
+    cerr << "A " << what << " file was read" << endl;
+    return false;
+    }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestCMFERemapOperator(int, char *[])
+{
+  vtkUnstructuredGrid *mesh = MakeHexGrid(3);
+
+  // Points inside the mesh, on the face of a cell, and outside of it.
+  const int nSamples = 6;
+  const double samples[nSamples][3] = { { 0.3, 0.6, 0.2 }, { 2.7, 1.1, 2.4 },
+                                        { 1.5, 2.25, 0.9 }, { 1., 0.5, 0.5 },
+                                        { -1., 0.5, 0.5 }, { 1.5, 1.5, 4. } };
+  vtkPolyData *list = vtkPolyData::New();
+  vtkPoints *points = vtkPoints::New();
+  vtkFloatArray *fallback = vtkFloatArray::New();
+  fallback->SetName("f");
+  for (int i = 0 ; i < nSamples ; i++)
+    {
+    points->InsertNextPoint(samples[i]);
+    fallback->InsertNextValue(100.f + i);
+    }
+  list->SetPoints(points);
+  list->GetPointData()->AddArray(fallback);
+  points->Delete();
+  fallback->Delete();
+
+  bool ok = true;
+  vtkDataSet *direct = vtkCMFEAlgorithm::PerformCMFE(list, mesh, "f", "f",
+                                                     "fResult");
+  vtkDataArray *expected =
+    (direct ? direct->GetPointData()->GetArray("fResult") : NULL);
+  if (expected == NULL)
+    {
+    cerr << "The direct evaluation failed" << endl;
+    ok = false;
+    }
+
+  vtkCMFERemapOperator built;
+  vtkCMFEFastLookupGrouping flg("f", true);
+  flg.AddMesh(mesh);
+  if (!built.Build(&flg, list, true) || !built.Write(operatorFile))
+    {
+    cerr << "The operator could not be built and written" << endl;
+    ok = false;
+    }
+
+  vtkCMFERemapOperator op;
+  vtkDataArray *donor = mesh->GetPointData()->GetArray("f");
+  if (!op.Read(operatorFile) || op.GetNumberOfTargets() != nSamples ||
+      op.GetNumberOfDonors() != mesh->GetNumberOfPoints())
+    {
+    cerr << "The operator could not be read back" << endl;
+    ok = false;
+    }
+  else
+    {
+    vtkDataArray *result = op.Apply(donor, fallback, "fResult", 0);
+    for (int i = 0 ; expected && result && i < nSamples ; i++)
+      {
+      double want = expected->GetTuple1(i);
+      double got = result->GetTuple1(i);
+      if (fabs(got - want) > 1e-6)
+        {
+        cerr << "Sample " << i << ": got " << got << ", expected " << want
+             << endl;
+        ok = false;
+        }
+      }
+    if (result == NULL)
+      {
+      cerr << "The operator could not be applied" << endl;
+      ok = false;
+      }
+    else
+      {
+      result->Delete();
+      }
+    }
+
+  // Apply checks its arrays against the operator before using them.
+  vtkFloatArray *shortDonor = vtkFloatArray::New();
+  shortDonor->SetNumberOfTuples(donor->GetNumberOfTuples() - 1);
+  vtkFloatArray *vectors = vtkFloatArray::New();
+  vectors->SetNumberOfComponents(3);
+  vectors->SetNumberOfTuples(nSamples);
+  vtkDataArray *wrong = op.Apply(shortDonor, NULL, "fResult", 0);
+  if (wrong != NULL)
+    {
+    cerr << "A donor with the wrong number of tuples was applied" << endl;
+    wrong->Delete();
+    ok = false;
+    }
+  wrong = op.Apply(donor, vectors, "fResult", 0);
+  if (wrong != NULL)
+    {
+    cerr << "A fallback with the wrong number of components was applied"
+         << endl;
+    wrong->Delete();
+    ok = false;
+    }
+  shortDonor->Delete();
+  vectors->Delete();
+
+  vtkstd::vector<char> bytes = ReadFile(operatorFile);
+  vtkstd::vector<char> truncated(bytes.begin(),
+                                 bytes.begin() + bytes.size() / 2);
+  ok = CheckRejected("truncated", truncated) && ok;
+  vtkstd::vector<char> longer(bytes);
+  longer.resize(bytes.size() + sizeof(vtkIdType), 0);
+  ok = CheckRejected("longer", longer) && ok;
+
+  remove(operatorFile);
+  remove(brokenFile);
+  if (direct)
+    {
+    direct->Delete();
+    }
+  list->Delete();
+  mesh->Delete();
+  return (ok ? 0 : 1);
+}
@@ -55,72 +55,354 @@
 #include <vtkCMFEUtility.h>
 #include <vtkCMFEDesiredPoints.h>
 #include <vtkCMFEFastLookupGrouping.h>
+#include <vtkCMFESFCPartition.h>
 #include <vtkCMFESpatialPartition.h>
 
 #include <vtkCellData.h>
+#include <vtkDataArray.h>
 #include <vtkDataSet.h>
-#include <vtkFloatArray.h>
+#include <vtkMultiThreader.h>
 #include <vtkPointData.h>
+#include <vtkStdString.h>
+#include <vtkTimerLog.h>
 #include <vtkUnstructuredGrid.h>
 #include <vtkToolkits.h>
 
-#include <float.h>
+#include <string.h>
 #include <vtkstd/algorithm>
+#include <vtkstd/vector>
+
+namespace
+{
+  // Below this many sample points per thread it is not worth spawning
+  // threads.
+  const int minimumPointsPerThread = 1024;
+
+  // Number of sample points that are passed to the lookup grouping at once.
+  const int sampleBatchSize = 16384;
+
+  struct SampleThreadData
+  {
+    vtkCMFEDesiredPoints *DesiredPoints;
+    vtkCMFEFastLookupGrouping *LookupGrouping;
+    vtkstd::vector<vtkCMFEFastLookupGrouping::SearchState *> States;
+    int NumberOfComponents;
+    vtkIdType NumberOfPoints;
+  };
+
+  //----------------------------------------------------------------------------
+  // Locates and evaluates a contiguous range of the sample points.  Every
+  // thread writes to a disjoint set of values in the desired points.  The
+  // values are evaluated in double precision and converted to the type of
+  // the desired points once per batch.  The points are handed to the
+  // lookup grouping in batches, straight from the point lists of the
+  // desired points; only the points of rectilinear grids have to be
+  // generated from their coordinate arrays.
+  VTK_THREAD_RETURN_TYPE SampleThread(void *arg)
+  {
+    vtkMultiThreader::ThreadInfo *info =
+      static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+    SampleThreadData *data = static_cast<SampleThreadData *>(info->UserData);
+
+    int tid = info->ThreadID;
+    int nThreads = info->NumberOfThreads;
+    vtkIdType start = data->NumberOfPoints / nThreads * tid +
+      vtkstd::min<vtkIdType>(tid, data->NumberOfPoints % nThreads);
+    vtkIdType end = start + data->NumberOfPoints / nThreads +
+      (tid < data->NumberOfPoints % nThreads ? 1 : 0);
+
+    vtkCMFEDesiredPoints *dp = data->DesiredPoints;
+    vtkCMFEFastLookupGrouping::SearchState &state = *data->States[tid];
+    int nComps = data->NumberOfComponents;
+    int nLists = dp->GetNumberOfPointLists();
+    vtkstd::vector<double> values(sampleBatchSize*nComps);
+    vtkstd::vector<unsigned char> found(sampleBatchSize);
+    vtkstd::vector<float> gridPts;
+
+    for (int ds = 0 ; ds < dp->GetNumberOfDatasets() ; ds++)
+      {
+      vtkIdType dsStart = dp->GetDataSetStart(ds);
+      vtkIdType first = vtkstd::max(start, dsStart);
+      vtkIdType last = vtkstd::min(end, dsStart + dp->GetDataSetSize(ds));
+      for (vtkIdType i = first ; i < last ; i += sampleBatchSize)
+        {
+        int n = (int) vtkstd::min<vtkIdType>(sampleBatchSize, last - i);
+        const float *pts;
+        if (ds < nLists)
+          {
+          pts = dp->GetPointList(ds) + 3*(i - dsStart);
+          }
+        else
+          {
+          gridPts.resize(3*sampleBatchSize);
+          dp->GetRGridPoints(ds - nLists, i - dsStart, n, &gridPts[0]);
+          pts = &gridPts[0];
+          }
+        data->LookupGrouping->GetValues(n, pts, pts+1, pts+2, 3,
+          &values[0], nComps, &found[0], state);
+        dp->SetValues(i, n, &values[0], &found[0]);
+        }
+      }
+    return VTK_THREAD_RETURN_VALUE;
+  }
+
+  //----------------------------------------------------------------------------
+  // Extends bounds, min and max along each axis, with those of the
+  // datasets that have points.
+  void AddBounds(const vtkstd::vector<vtkDataSet *> &datasets, double bounds[6])
+  {
+    for (size_t d = 0 ; d < datasets.size() ; d++)
+      {
+      if (datasets[d]->GetNumberOfPoints() == 0)
+        {
+        continue;
+        }
+      double dsBounds[6];
+      datasets[d]->GetBounds(dsBounds);
+      for (int i = 0 ; i < 6 ; i += 2)
+        {
+        bounds[i] = vtkstd::min(bounds[i], dsBounds[i]);
+        bounds[i+1] = vtkstd::max(bounds[i+1], dsBounds[i+1]);
+        }
+      }
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkCMFEAlgorithm::vtkCMFEAlgorithm()
+{
+  this->LookupCache = NULL;
+  this->NumberOfThreads = 0;
+  this->RelocationMemoryBudget = 0;
+  this->PointWeight = 1.;
+  this->MaximumSplitAttempts = 4;
+  this->PartitionMethod = RECURSIVE_BISECTION;
+  this->MeasuredPointCost = 0.;
+  this->MeasuredCellCost = 0.;
+  this->FallbackTolerance = 0.;
+  this->Interpolation = vtkCMFEFastLookupGrouping::CELL_CONTAINMENT;
+  this->NumberOfNeighbors = 8;
+  this->Radius = 0.;
+  this->NumberOfPointsLocated = 0;
+  this->NumberOfPointsNearest = 0;
+  this->NumberOfPointsMissed = 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEAlgorithm::SetCellWeight(int cellType, double w)
+{
+  this->CellWeights.push_back(vtkstd::make_pair(cellType, w));
+}
+
+//----------------------------------------------------------------------------
+vtkCMFEAlgorithm::~vtkCMFEAlgorithm()
+{
+}
 
 //----------------------------------------------------------------------------
 vtkDataSet* vtkCMFEAlgorithm::PerformCMFE(vtkDataSet *output_mesh, vtkDataSet *mesh_to_be_sampled,
   const std::string &output_var, const std::string &mesh_var,  const std::string &outvar)
 {
-  int pointProperty;
-  int numberOfComponents;
+  vtkCMFEAlgorithm alg;
+  return alg.Execute(output_mesh, mesh_to_be_sampled, output_var, mesh_var, outvar);
+}
 
+//----------------------------------------------------------------------------
+vtkDataSet* vtkCMFEAlgorithm::Execute(vtkDataSet *output_mesh, vtkDataSet *mesh_to_be_sampled,
+  const std::string &output_var, const std::string &mesh_var,  const std::string &outvar)
+{
+  return this->Execute(output_mesh, mesh_to_be_sampled,
+    vtkstd::vector<vtkstd::string>(1, output_var),
+    vtkstd::vector<vtkstd::string>(1, mesh_var),
+    vtkstd::vector<vtkstd::string>(1, outvar));
+}
+
+//----------------------------------------------------------------------------
+vtkDataSet* vtkCMFEAlgorithm::Execute(vtkDataSet *output_mesh, vtkDataSet *mesh_to_be_sampled,
+  const vtkstd::vector<vtkstd::string> &output_vars,
+  const vtkstd::vector<vtkstd::string> &mesh_vars,
+  const vtkstd::vector<vtkstd::string> &outvars)
+{
+  vtkstd::vector<vtkDataSet *> outputs = this->Execute(
+    vtkstd::vector<vtkDataSet *>(1, output_mesh),
+    vtkstd::vector<vtkDataSet *>(1, mesh_to_be_sampled),
+    output_vars, mesh_vars, outvars);
+  return (outputs.empty() ? NULL : outputs[0]);
+}
+
+//----------------------------------------------------------------------------
+vtkstd::vector<vtkDataSet *> vtkCMFEAlgorithm::Execute(
+  const vtkstd::vector<vtkDataSet *> &output_meshes,
+  const vtkstd::vector<vtkDataSet *> &meshes_to_be_sampled,
+  const vtkstd::vector<vtkstd::string> &output_vars,
+  const vtkstd::vector<vtkstd::string> &mesh_vars,
+  const vtkstd::vector<vtkstd::string> &outvars)
+{
   //setup all the mpi related information
   CMFEUtility::Setup();
+  this->NumberOfPointsLocated = 0;
+  this->NumberOfPointsNearest = 0;
+  this->NumberOfPointsMissed = 0;
 
-  if ( mesh_to_be_sampled->GetPointData()->HasArray( mesh_var.c_str() ) )
+  // Nodal variables are sampled at the points of the output mesh and zonal
+  // ones at its cell centers, so each centering takes a pass of its own.
+  vtkstd::vector<CMFEVariable> vars[2];
+  for (size_t i = 0 ; i < mesh_vars.size() ; i++)
     {
-    pointProperty = 1;
-    numberOfComponents = mesh_to_be_sampled->GetPointData()->GetArray(
-      mesh_var.c_str() )->GetNumberOfComponents();
+    CMFEVariable var;
+    var.OutputVar = output_vars[i];
+    var.MeshVar = mesh_vars[i];
+    var.OutVar = outvars[i];
+
+    // The first mesh that has the variable decides its centering.
+    int pointProperty = 0;
+    vtkDataArray *arr = NULL;
+    for (size_t m = 0 ; !arr && m < meshes_to_be_sampled.size() ; m++)
+      {
+      arr = meshes_to_be_sampled[m]->GetPointData()->GetArray( mesh_vars[i].c_str() );
+      if ( arr )
+        {
+        pointProperty = 1;
+        }
+      else
+        {
+        arr = meshes_to_be_sampled[m]->GetCellData()->GetArray( mesh_vars[i].c_str() );
+        }
+      }
+    int numberOfComponents = (arr ? arr->GetNumberOfComponents() : 0);
+    int valueType = (arr ? arr->GetDataType() : -1);
+
+    //make sure we have the updated values on all processors
+    pointProperty = CMFEUtility::UnifyMaximumValue(pointProperty);
+    var.NumberOfComponents = CMFEUtility::UnifyMaximumValue(numberOfComponents);
+    valueType = CMFEUtility::UnifyMaximumValue(valueType);
+    var.ResultType = CMFEUtility::GetResultType(valueType, pointProperty == 1);
+    vars[pointProperty].push_back(var);
     }
-  else
+
+  vtkstd::vector<vtkDataSet *> outputs = output_meshes;
+  bool copied = false;
+  for (int pointProperty = 1 ; pointProperty >= 0 ; pointProperty--)
+    {
+    if ( vars[pointProperty].empty() )
+      {
+      continue;
+      }
+    vtkstd::vector<vtkDataSet *> next = this->ExecutePass(outputs,
+      meshes_to_be_sampled, vars[pointProperty], pointProperty == 1);
+    for (size_t m = 0 ; copied && m < outputs.size() ; m++)
+      {
+      outputs[m]->Delete();
+      }
+    if ( next.size() != output_meshes.size() )
+      {
+      return vtkstd::vector<vtkDataSet *>();
+      }
+    outputs = next;
+    copied = true;
+    }
+  for (size_t m = 0 ; !copied && m < outputs.size() ; m++)
     {
-    pointProperty = 0;
-    numberOfComponents =  mesh_to_be_sampled->GetCellData()->GetArray( 
-      mesh_var.c_str() )->GetNumberOfComponents();
+    outputs[m] = output_meshes[m]->NewInstance();
+    outputs[m]->ShallowCopy( output_meshes[m] );
     }
+  return outputs;
+}
 
-  //make sure we have the updated values on all processors
-  pointProperty = CMFEUtility::UnifyMaximumValue(pointProperty);
-  numberOfComponents = CMFEUtility::UnifyMaximumValue(numberOfComponents);
-
-  bool isNodal = (pointProperty==1);
+//----------------------------------------------------------------------------
+vtkstd::vector<vtkDataSet *> vtkCMFEAlgorithm::ExecutePass(
+  const vtkstd::vector<vtkDataSet *> &output_meshes,
+  const vtkstd::vector<vtkDataSet *> &meshes_to_be_sampled,
+  const vtkstd::vector<CMFEVariable> &vars, bool isNodal)
+{
+  vtkstd::vector<vtkStdString> meshVars;
+  for (size_t i = 0 ; i < vars.size() ; i++)
+    {
+    meshVars.push_back(vars[i].MeshVar);
+    }
       
   // Set up the data structure so that we can locate sample points in the
-  // mesh to be sampled quickly.    
-  vtkCMFEFastLookupGrouping flg(mesh_var, isNodal);
-  flg.AddMesh( mesh_to_be_sampled );
+  // mesh to be sampled quickly.  When we have a cached grouping and are
+  // running serially, the interval tree built by a previous execution is
+  // reused, since it only depends on the geometry of the mesh.
+  vtkCMFEFastLookupGrouping *localFlg = NULL;
+  vtkCMFEFastLookupGrouping *cache = this->LookupCache;
+  if ( CMFEUtility::PAR_Size() > 1 )
+    {
+    cache = NULL;
+    }
+  // Every block of a composite dataset is a mesh of its own, which saves
+  // merging the blocks.
+  size_t m;
+  if ( cache )
+    {
+    cache->SetVariables(meshVars, isNodal);
+    if ( cache->GetMeshes().size() == 0 )
+      {
+      for (m = 0 ; m < meshes_to_be_sampled.size() ; m++)
+        {
+        cache->AddMesh( meshes_to_be_sampled[m] );
+        }
+      }
+    }
+  else
+    {
+    localFlg = new vtkCMFEFastLookupGrouping(meshVars[0], isNodal);
+    localFlg->SetVariables(meshVars, isNodal);
+    for (m = 0 ; m < meshes_to_be_sampled.size() ; m++)
+      {
+      localFlg->AddMesh( meshes_to_be_sampled[m] );
+      }
+    }
+  vtkCMFEFastLookupGrouping &flg = (cache ? *cache : *localFlg);
+  flg.SetFallbackTolerance(this->FallbackTolerance);
+  flg.SetInterpolation(this->Interpolation);
+  flg.SetNumberOfNeighbors(this->NumberOfNeighbors);
+  flg.SetRadius(this->Radius);
+  flg.SetNumberOfThreads(this->NumberOfThreads);
 
   // Set up the data structure that keeps track of the sample points we need.
-  vtkCMFEDesiredPoints dp(isNodal, numberOfComponents);
-  dp.AddDataset( output_mesh );
+  vtkCMFEDesiredPoints dp(isNodal, 0);
+  for (size_t i = 0 ; i < vars.size() ; i++)
+    {
+    dp.AddVariable(vars[i].NumberOfComponents, vars[i].ResultType);
+    }
+  for (m = 0 ; m < output_meshes.size() ; m++)
+    {
+    dp.AddDataset( output_meshes[m] );
+    }
 
-  vtkCMFESpatialPartition spat_part;    
+  vtkCMFESpatialPartition bisection;
+  vtkCMFESFCPartition curve;
+  vtkCMFESpatialPartition &spat_part =
+    (this->PartitionMethod == SPACE_FILLING_CURVE ? curve : bisection);
+  double pointWeight = this->PointWeight;
+  if (this->MeasuredPointCost > 0. && this->MeasuredCellCost > 0.)
+    {
+    pointWeight *= this->MeasuredPointCost / this->MeasuredCellCost;
+    }
+  spat_part.SetPointWeight(pointWeight);
+  for (size_t i = 0 ; i < this->CellWeights.size() ; i++)
+    {
+    spat_part.SetCellWeight(this->CellWeights[i].first,
+                            this->CellWeights[i].second);
+    }
+  spat_part.SetMaximumSplitAttempts(this->MaximumSplitAttempts);
 
 #ifdef VTK_USE_MPI
+  // Time spent on the mesh to be sampled and on the sample points on this
+  // processor, which is reported as the measured costs of a parallel
+  // execution.
+  double cellTime = 0.;
+  double pointTime = 0.;
+  double start;
+
   if ( CMFEUtility::PAR_Size() > 1 )
     {
-    double outBounds[6];
-    double meshBounds[6];
-    double bounds[6];
-    output_mesh->GetBounds( outBounds );
-    mesh_to_be_sampled->GetBounds( meshBounds );
-
-    for(int i=0; i < 6; i+=2)
-      {
-      bounds[i] = vtkstd::min(outBounds[i],meshBounds[i]);
-      bounds[i+1] = vtkstd::max(outBounds[i+1],meshBounds[i+1]);
-      }
+    double bounds[6] = { VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX,
+                         -VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+    AddBounds( output_meshes, bounds );
+    AddBounds( meshes_to_be_sampled, bounds );
     CMFEUtility::UnifyMinMax(bounds,6);
 
     // Need to "finalize" in pre-partitioned form so that the spatial
@@ -135,31 +417,73 @@ vtkDataSet* vtkCMFEAlgorithm::PerformCMFE(vtkDataSet *output_mesh, vtkDataSet *m
     //    
     spat_part.CreatePartition(&dp, &flg, bounds);
     dp.RelocatePointsUsingPartition(&spat_part);
+    flg.SetRelocationMemoryBudget(this->RelocationMemoryBudget);
+    start = vtkTimerLog::GetUniversalTime();
     flg.RelocateDataUsingPartition(&spat_part);
+    cellTime += vtkTimerLog::GetUniversalTime() - start;
     }
 #endif  
 
-  flg.Finalize();
+#ifdef VTK_USE_MPI
+  start = vtkTimerLog::GetUniversalTime();
+#endif
+  bool finalized = flg.Finalize();
+#ifdef VTK_USE_MPI
+  cellTime += vtkTimerLog::GetUniversalTime() - start;
+#endif
+  // Every processor gives up if one of them could not build its search
+  // structure, since the others would wait for it in the calls below.
+  if ( CMFEUtility::MaximumIntAcrossAllProcessors(finalized ? 0 : 1) != 0 )
+    {
+    delete localFlg;
+    return vtkstd::vector<vtkDataSet *>();
+    }
   dp.Finalize();
 
   //
   // Now, for each sample, locate the sample point in the mesh to be sampled
-  // and evaluate that point.
+  // and evaluate that point.  The points are split into contiguous ranges
+  // that are handled by separate threads, each with its own search state.
   //    
-  int npts = dp.GetNumberOfPoints();
-  float *comps = new float[numberOfComponents];
-  for (int i = 0 ; i < npts ; i++)
-    {
-    float pt[3];
-    dp.GetPoint(i, pt);
-    bool gotValue = flg.GetValue(pt, comps);
-    if (!gotValue)
-      {
-      comps[0] = FLT_MAX;
-      }
-    dp.SetValue(i, comps);
+  vtkIdType npts = dp.GetNumberOfPoints();
+  int nThreads = this->NumberOfThreads;
+  if (nThreads <= 0)
+    {
+    nThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+    }
+  nThreads = (int) vtkstd::min<vtkIdType>(nThreads, npts / minimumPointsPerThread);
+  nThreads = vtkstd::max(vtkstd::min(nThreads, VTK_MAX_THREADS), 1);
+
+  SampleThreadData data;
+  data.DesiredPoints = &dp;
+  data.LookupGrouping = &flg;
+  data.NumberOfComponents = dp.GetNumberOfComponents();
+  data.NumberOfPoints = npts;
+  for (int i = 0 ; i < nThreads ; i++)
+    {
+    data.States.push_back(new vtkCMFEFastLookupGrouping::SearchState);
+    }
+
+#ifdef VTK_USE_MPI
+  start = vtkTimerLog::GetUniversalTime();
+#endif
+  vtkMultiThreader *threader = vtkMultiThreader::New();
+  threader->SetNumberOfThreads(nThreads);
+  threader->SetSingleMethod(SampleThread, &data);
+  threader->SingleMethodExecute();
+  threader->Delete();
+#ifdef VTK_USE_MPI
+  pointTime = vtkTimerLog::GetUniversalTime() - start;
+#endif
+
+  vtkIdType counts[3] = { 0, 0, 0 };
+  for (int i = 0 ; i < nThreads ; i++)
+    {
+    counts[0] += data.States[i]->NumberOfPointsLocated;
+    counts[1] += data.States[i]->NumberOfPointsNearest;
+    counts[2] += data.States[i]->NumberOfPointsMissed;
+    delete data.States[i];
     }
-  delete [] comps;    
   
   // We had to distribute the "dp" and "flg" structures across all 
   // processors (see comments in sections above).  So now we need to
@@ -169,51 +493,85 @@ vtkDataSet* vtkCMFEAlgorithm::PerformCMFE(vtkDataSet *output_mesh, vtkDataSet *m
   if ( CMFEUtility::PAR_Size() > 1 )
     {
     dp.UnRelocatePoints(&spat_part);    
-    }
-#endif
-
-
-  // Now create the variable that contains all of the values for the sample
-  // points we evaluated.
-
-  //find the property on the output, can't trust isNodal
-  //since it was on the sampled mesh, not the output mesh    
-  vtkDataArray *outProp = output_mesh->GetPointData()->GetArray( output_var.c_str() );
-  if ( !outProp)
-    {
-    outProp = output_mesh->GetCellData()->GetArray( output_var.c_str() );
-    }
-
-  vtkFloatArray *resultArray = vtkFloatArray::New();    
-  resultArray->SetName( outvar.c_str() );
-  resultArray->SetNumberOfComponents( numberOfComponents );
-  int numValues = (isNodal) ? output_mesh->GetNumberOfPoints() : output_mesh->GetNumberOfCells();
-  resultArray->SetNumberOfTuples( numValues );
-
-  //copy over all the updated values from the desired points
-  //FLT_MAX signifies that dp doesn't have an updated value for the output
-  //GetValue supports multiple files, by 
-  int meshIndex = 0;
-  for (int i = 0 ; i < numValues ; ++i)
-    {
-    const float *val = dp.GetValue(meshIndex, i);
-    if (*val != FLT_MAX)
+    double nCells = 0.;
+    for (size_t i = 0 ; i < flg.GetMeshes().size() ; i++)
       {
-      resultArray->SetTuple(i, dp.GetValue(meshIndex, i));
+      nCells += flg.GetMeshes()[i]->GetNumberOfCells();
       }
-    else
+
+    // The costs are averaged over all processors, so that every processor
+    // partitions the next execution the same way.
+    double local[7] = { pointTime, (double) npts, cellTime, nCells,
+                        (double) counts[0], (double) counts[1],
+                        (double) counts[2] };
+    double global[7];
+    CMFEUtility::SumDoubleArrayAcrossAllProcessors(local, global, 7);
+    for (int i = 0 ; i < 3 ; i++)
       {
-      resultArray->SetTuple(i, outProp->GetTuple(i));
+      counts[i] = (vtkIdType) global[4+i];
       }
+    this->MeasuredPointCost = (global[1] > 0. ? global[0] / global[1] : 0.);
+    this->MeasuredCellCost = (global[3] > 0. ? global[2] / global[3] : 0.);
     }
+#endif
+  delete localFlg;
 
-  vtkDataSet *output = output_mesh->NewInstance();
-  output->ShallowCopy( output_mesh );  
+  this->NumberOfPointsLocated += counts[0];
+  this->NumberOfPointsNearest += counts[1];
+  this->NumberOfPointsMissed += counts[2];
 
-  (isNodal)? output->GetPointData()->AddArray( resultArray ) : output->GetCellData()->AddArray( resultArray );
-  resultArray->Delete();
-  return output;
-}
+  // Now create the variables that contain all of the values for the sample
+  // points we evaluated, in a shallow copy of each output mesh.
+  vtkstd::vector<vtkDataSet *> outputs(output_meshes.size());
+  for (m = 0 ; m < output_meshes.size() ; m++)
+    {
+    vtkDataSet *output_mesh = output_meshes[m];
+    vtkDataSet *output = output_mesh->NewInstance();
+    output->ShallowCopy( output_mesh );
+    outputs[m] = output;
+
+    vtkIdType numValues = (isNodal) ? output_mesh->GetNumberOfPoints() : output_mesh->GetNumberOfCells();
+    for (int v = 0 ; v < (int) vars.size() ; v++)
+      {
+      //find the property on the output, can't trust isNodal
+      //since it was on the sampled mesh, not the output mesh
+      const char *outputVar = vars[v].OutputVar.c_str();
+      vtkDataArray *outProp = output_mesh->GetPointData()->GetArray( outputVar );
+      if ( !outProp)
+        {
+        outProp = output_mesh->GetCellData()->GetArray( outputVar );
+        }
 
+      vtkDataArray *resultArray = vtkDataArray::CreateDataArray( vars[v].ResultType );
+      resultArray->SetName( vars[v].OutVar.c_str() );
+      resultArray->SetNumberOfComponents( vars[v].NumberOfComponents );
+      resultArray->SetNumberOfTuples( numValues );
 
+      //copy over all the updated values from the desired points
+      //a NULL value signifies that dp doesn't have an updated value for the output
+      int meshIndex = dp.GetDataSetIndex( (int) m );
+      char *result = static_cast<char *>(resultArray->GetVoidPointer(0));
+      int tupleSize = dp.GetTupleSize(v);
+      for (vtkIdType i = 0 ; i < numValues ; ++i)
+        {
+        const void *val = dp.GetValue(v, meshIndex, i);
+        if (val != NULL)
+          {
+          memcpy(result + i*tupleSize, val, tupleSize);
+          }
+        else if (outProp)
+          {
+          resultArray->SetTuple(i, outProp->GetTuple(i));
+          }
+        else
+          {
+          memset(result + i*tupleSize, 0, tupleSize);
+          }
+        }
 
+      (isNodal)? output->GetPointData()->AddArray( resultArray ) : output->GetCellData()->AddArray( resultArray );
+      resultArray->Delete();
+      }
+    }
+  return outputs;
+}
@@ -64,16 +64,210 @@
 #ifndef __vtkCMFEAlgorithm_h
 #define __vtkCMFEAlgorithm_h
 
+#include <vtkType.h>
 #include <vtkstd/string>
+#include <vtkstd/utility>
+#include <vtkstd/vector>
 
+class vtkCMFEFastLookupGrouping;
 class vtkDataSet;
 
 class vtkCMFEAlgorithm
 {
   public:
+    //BTX
+    enum PartitionMethods
+    {
+      RECURSIVE_BISECTION = 0,
+      SPACE_FILLING_CURVE = 1
+    };
+    //ETX
+
+    vtkCMFEAlgorithm();
+    ~vtkCMFEAlgorithm();
+
+    // Description:
+    // Performs the cross mesh field evaluation with the default settings.
     static vtkDataSet* PerformCMFE(vtkDataSet *output_mesh, vtkDataSet *sample_mesh,
       const vtkstd::string &invar,const vtkstd::string &default_var, const vtkstd::string &outvar);
 
+    // Description:
+    // Performs the cross mesh field evaluation with the current settings.
+    // Returns NULL if the search structure could not be built, as when a
+    // processor has more cells to search than it can index.
+    vtkDataSet* Execute(vtkDataSet *output_mesh, vtkDataSet *sample_mesh,
+      const vtkstd::string &invar,const vtkstd::string &default_var, const vtkstd::string &outvar);
+
+    // Description:
+    // Performs the cross mesh field evaluation of several variables at
+    // once.  The i-th entries of the lists make up one variable, as in the
+    // single variable version.  The variables share one search structure
+    // and one relocation, and every sample point is located once for all
+    // variables of the same centering.
+    vtkDataSet* Execute(vtkDataSet *output_mesh, vtkDataSet *sample_mesh,
+      const vtkstd::vector<vtkstd::string> &invars,
+      const vtkstd::vector<vtkstd::string> &default_vars,
+      const vtkstd::vector<vtkstd::string> &outvars);
+
+    // Description:
+    // Performs the cross mesh field evaluation from all the sample meshes,
+    // as if they were a single mesh, to each of the output meshes, such as
+    // the blocks of composite datasets.  The points of all output meshes
+    // are evaluated together, so the threads are shared among them.
+    // Returns a new dataset per output mesh, in order, or an empty list if
+    // the search structure could not be built.
+    vtkstd::vector<vtkDataSet *> Execute(
+      const vtkstd::vector<vtkDataSet *> &output_meshes,
+      const vtkstd::vector<vtkDataSet *> &sample_meshes,
+      const vtkstd::vector<vtkstd::string> &invars,
+      const vtkstd::vector<vtkstd::string> &default_vars,
+      const vtkstd::vector<vtkstd::string> &outvars);
+
+    // Description:
+    // Sets a fast lookup grouping owned by the caller that is used as the
+    // search structure for the mesh to be sampled.  If the grouping is empty
+    // the meshes are added to it, otherwise it is assumed to already contain
+    // them and its interval tree is reused.  The grouping is only used when
+    // running on a single processor, since in parallel the mesh is
+    // redistributed to match the sample points.
+    void SetLookupCache(vtkCMFEFastLookupGrouping *flg) { this->LookupCache = flg; };
+    vtkCMFEFastLookupGrouping *GetLookupCache() { return this->LookupCache; };
+
+    // Description:
+    // Sets the number of threads used to locate and evaluate the sample
+    // points.  A value of 0 or less uses vtkMultiThreader's default.
+    void SetNumberOfThreads(int n) { this->NumberOfThreads = n; };
+    int GetNumberOfThreads() { return this->NumberOfThreads; };
+
+    // Description:
+    // Sets the approximate number of megabytes of messages that may be in
+    // flight at once while the donor mesh is redistributed.  A value of 0
+    // sends everything at once.
+    void SetRelocationMemoryBudget(int mb) { this->RelocationMemoryBudget = mb; };
+    int GetRelocationMemoryBudget() { return this->RelocationMemoryBudget; };
+
+    // Description:
+    // Sets the costs that the spatial partition balances when running in
+    // parallel: the cost of a sample point, and the cost of a cell of the
+    // given type of the mesh to be sampled.  They all default to 1.
+    void SetPointWeight(double w) { this->PointWeight = w; };
+    double GetPointWeight() { return this->PointWeight; };
+    void SetCellWeight(int cellType, double w);
+    void RemoveAllCellWeights() { this->CellWeights.clear(); };
+
+    // Description:
+    // Sets how space is partitioned among the processors when running in
+    // parallel: RECURSIVE_BISECTION, the default, uses
+    // vtkCMFESpatialPartition, and SPACE_FILLING_CURVE uses
+    // vtkCMFESFCPartition, which needs fewer collective calls on large
+    // numbers of processors.
+    void SetPartitionMethod(int m) { this->PartitionMethod = m; };
+    int GetPartitionMethod() { return this->PartitionMethod; };
+
+    // Description:
+    // Sets the number of rounds of collective calls that each split of the
+    // spatial partition may take.  See vtkCMFESpatialPartition.
+    void SetMaximumSplitAttempts(int n) { this->MaximumSplitAttempts = n; };
+    int GetMaximumSplitAttempts() { return this->MaximumSplitAttempts; };
+
+    // Description:
+    // Sets the time per sample point and per cell that a previous execution
+    // measured, see GetMeasuredPointCost.  When both are positive, the
+    // weight of a sample point is scaled by their ratio, so that the
+    // partition balances the work the previous execution actually did.
+    void SetMeasuredCosts(double pointCost, double cellCost)
+      { this->MeasuredPointCost = pointCost; this->MeasuredCellCost = cellCost; };
+
+    // Description:
+    // After a parallel execution, the average number of seconds spent to
+    // evaluate a sample point, and to set up the search structure per cell
+    // of the redistributed mesh to be sampled.  0 if nothing was measured.
+    double GetMeasuredPointCost() { return this->MeasuredPointCost; };
+    double GetMeasuredCellCost() { return this->MeasuredCellCost; };
+
+    // Description:
+    // Sets the distance within which a sample point that no cell contains
+    // takes the value of the nearest cell, in the same pass, instead of the
+    // value of the output mesh.  See vtkCMFEFastLookupGrouping.  0, the
+    // default, turns this off.
+    void SetFallbackTolerance(double tol) { this->FallbackTolerance = tol; };
+    double GetFallbackTolerance() { return this->FallbackTolerance; };
+
+    // Description:
+    // Sets how the mesh to be sampled is evaluated, one of the
+    // Interpolations of vtkCMFEFastLookupGrouping.  CELL_CONTAINMENT, the
+    // default, interpolates within the cell that contains a sample point.
+    // The other modes interpolate from the nearest points of the mesh to
+    // be sampled, or its cell centers, which suits point clouds.  In
+    // parallel only the points that the spatial partition gives to the
+    // same processor as a sample point are searched, so points close to
+    // the boundary of a region may miss neighbors across it.
+    void SetInterpolation(int mode) { this->Interpolation = mode; };
+    int GetInterpolation() { return this->Interpolation; };
+
+    // Description:
+    // Sets the number of neighbors and the radius of the point modes.  See
+    // vtkCMFEFastLookupGrouping.
+    void SetNumberOfNeighbors(int n) { this->NumberOfNeighbors = n; };
+    int GetNumberOfNeighbors() { return this->NumberOfNeighbors; };
+    void SetRadius(double r) { this->Radius = r; };
+    double GetRadius() { return this->Radius; };
+
+    // Description:
+    // After an execution, the number of sample points, over all passes and
+    // processors, that were located in a cell, or interpolated from points
+    // in the point modes, that took the value of the nearest cell, and
+    // that were not found.
+    vtkIdType GetNumberOfPointsLocated() { return this->NumberOfPointsLocated; };
+    vtkIdType GetNumberOfPointsNearest() { return this->NumberOfPointsNearest; };
+    vtkIdType GetNumberOfPointsMissed() { return this->NumberOfPointsMissed; };
+
+protected:
+    //BTX
+    // Description:
+    // A variable that is evaluated: the array of the output mesh that
+    // fills in the points that are not found, the array that is sampled,
+    // the name of the result, and the number of components and the type
+    // of the result.
+    struct CMFEVariable
+    {
+      vtkstd::string OutputVar;
+      vtkstd::string MeshVar;
+      vtkstd::string OutVar;
+      int NumberOfComponents;
+      int ResultType;
+    };
+    //ETX
+
+    // Description:
+    // Evaluates variables that all have the given centering, and returns a
+    // shallow copy of each output mesh with their results added.
+    //BTX
+    vtkstd::vector<vtkDataSet *> ExecutePass(
+      const vtkstd::vector<vtkDataSet *> &output_meshes,
+      const vtkstd::vector<vtkDataSet *> &sample_meshes,
+      const vtkstd::vector<CMFEVariable> &vars, bool isNodal);
+    //ETX
+
+    vtkCMFEFastLookupGrouping *LookupCache;
+    int NumberOfThreads;
+    int RelocationMemoryBudget;
+    double PointWeight;
+    //BTX
+    vtkstd::vector<vtkstd::pair<int, double> > CellWeights;
+    //ETX
+    int MaximumSplitAttempts;
+    int PartitionMethod;
+    double MeasuredPointCost;
+    double MeasuredCellCost;
+    double FallbackTolerance;
+    int Interpolation;
+    int NumberOfNeighbors;
+    double Radius;
+    vtkIdType NumberOfPointsLocated;
+    vtkIdType NumberOfPointsNearest;
+    vtkIdType NumberOfPointsMissed;
+
 private:
   vtkCMFEAlgorithm(const vtkCMFEAlgorithm&);  // Not implemented.
   void operator=(const vtkCMFEAlgorithm&);  // Not implemented.
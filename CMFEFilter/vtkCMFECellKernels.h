@@ -0,0 +1,513 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: vtkCMFECellKernels.h,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+/*****************************************************************************
+*
+* Copyright (c) 2000 - 2009, Lawrence Livermore National Security, LLC
+* Produced at the Lawrence Livermore National Laboratory
+* LLNL-CODE-400124
+* All rights reserved.
+*
+* This file is  part of VisIt. For  details, see https://visit.llnl.gov/.  The
+* full copyright notice is contained in the file COPYRIGHT located at the root
+* of the VisIt distribution or at http://www.llnl.gov/visit/copyright.html.
+*
+* Redistribution  and  use  in  source  and  binary  forms,  with  or  without
+* modification, are permitted provided that the following conditions are met:
+*
+*  - Redistributions of  source code must  retain the above  copyright notice,
+*    this list of conditions and the disclaimer below.
+*  - Redistributions in binary form must reproduce the above copyright notice,
+*    this  list of  conditions  and  the  disclaimer (as noted below)  in  the
+*    documentation and/or other materials provided with the distribution.
+*  - Neither the name of  the LLNS/LLNL nor the names of  its contributors may
+*    be used to endorse or promote products derived from this software without
+*    specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT  HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR  IMPLIED WARRANTIES, INCLUDING,  BUT NOT  LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND  FITNESS FOR A PARTICULAR  PURPOSE
+* ARE  DISCLAIMED. IN  NO EVENT  SHALL LAWRENCE  LIVERMORE NATIONAL  SECURITY,
+* LLC, THE  U.S.  DEPARTMENT OF  ENERGY  OR  CONTRIBUTORS BE  LIABLE  FOR  ANY
+* DIRECT,  INDIRECT,   INCIDENTAL,   SPECIAL,   EXEMPLARY,  OR   CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT  LIMITED TO, PROCUREMENT OF  SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF  USE, DATA, OR PROFITS; OR  BUSINESS INTERRUPTION) HOWEVER
+* CAUSED  AND  ON  ANY  THEORY  OF  LIABILITY,  WHETHER  IN  CONTRACT,  STRICT
+* LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY  WAY
+* OUT OF THE  USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+* DAMAGE.
+*
+*****************************************************************************/
+
+// .NAME vtkCMFECellKernels -- point location kernels for linear cells.
+// .SECTION Description
+// Locates a point in a linear tetrahedron, hexahedron, wedge or pyramid
+// and computes its interpolation weights in a single pass.  The kernels
+// read the point coordinates straight from the raw buffer of a vtkPoints
+// object, so no vtkCell has to be filled in, and they use the same
+// parametric coordinates and tolerances as the VTK cells, so they agree
+// with vtkCell::EvaluatePosition.  Hexahedra use the face plane test of
+// CMFEUtility::CellContainsPoint to decide whether they contain the point.
+//
+// Tetrahedra are solved in closed form.  The other cells use Newton's
+// method on their interpolation functions, with the coordinates stored
+// one array per axis so that the sums over the points vectorize.
+//
+// The cells of image data and rectilinear grids are found by index
+// arithmetic, or a binary search per axis, and interpolated trilinearly.
+
+#ifndef __vtkCMFECellKernels_h
+#define __vtkCMFECellKernels_h
+
+#include "vtkCellType.h"
+#include "vtkType.h"
+#include "vtkCMFEUtility.h"
+
+#include <math.h>
+#include <vtkstd/algorithm>
+
+namespace CMFECellKernels
+{
+  // Description:
+  // Results of LocatePoint.  NOT_HANDLED means that there is no kernel for
+  // the cell, or that the cell is too degenerate for it, and that the
+  // caller has to fall back on vtkCell::EvaluatePosition.
+  enum { OUTSIDE = 0, INSIDE = 1, NOT_HANDLED = -1 };
+
+  // Description:
+  // Largest number of points of a cell that has a kernel.
+  const int MaximumNumberOfPoints = 8;
+
+  // The values the VTK cells use for Newton's method.
+  const int MaximumIterations = 10;
+  const double Converged = 1.e-03;
+  const double Diverged = 1.e6;
+  const double Tolerance = 0.001;
+
+  // How far, relative to its coordinate, a point may be off the single
+  // layer of points of a flat axis.
+  const double FlatTolerance = 1.e-6;
+
+  //----------------------------------------------------------------------------
+  // The coordinates of the points of a cell, one array per axis.
+  struct CellPoints
+  {
+    double X[3][MaximumNumberOfPoints];
+  };
+
+  //----------------------------------------------------------------------------
+  template <class T>
+  inline void GatherPoints(const T *coords, const vtkIdType *ids, int nPts,
+                           CellPoints &pts)
+  {
+    for (int i = 0 ; i < nPts ; i++)
+      {
+      const T *p = coords + 3*ids[i];
+      pts.X[0][i] = p[0];
+      pts.X[1][i] = p[1];
+      pts.X[2][i] = p[2];
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // Determinant of the 3x3 matrix with the columns a, b and c.
+  inline double Determinant(const double a[3], const double b[3],
+                            const double c[3])
+  {
+    return a[0]*(b[1]*c[2] - b[2]*c[1]) - b[0]*(a[1]*c[2] - a[2]*c[1]) +
+           c[0]*(a[1]*b[2] - a[2]*b[1]);
+  }
+
+  //----------------------------------------------------------------------------
+  inline bool InRange(double v)
+  {
+    return (v >= -Tolerance && v <= 1. + Tolerance);
+  }
+
+  //----------------------------------------------------------------------------
+  // Interpolation functions and their derivatives with respect to r, s and
+  // t of the cells solved with Newton's method, in the layout of
+  // vtkHexahedron::InterpolationDerivs.
+  struct HexahedronShape
+  {
+    enum { NumberOfPoints = 8 };
+    static void Center(double p[3])
+    {
+      p[0] = p[1] = p[2] = 0.5;
+    }
+    static void Functions(const double p[3], double w[8])
+    {
+      double rm = 1. - p[0], sm = 1. - p[1], tm = 1. - p[2];
+      w[0] = rm*sm*tm;
+      w[1] = p[0]*sm*tm;
+      w[2] = p[0]*p[1]*tm;
+      w[3] = rm*p[1]*tm;
+      w[4] = rm*sm*p[2];
+      w[5] = p[0]*sm*p[2];
+      w[6] = p[0]*p[1]*p[2];
+      w[7] = rm*p[1]*p[2];
+    }
+    static void Derivatives(const double p[3], double d[24])
+    {
+      double rm = 1. - p[0], sm = 1. - p[1], tm = 1. - p[2];
+      d[0] = -sm*tm;   d[1] = sm*tm;     d[2] = p[1]*tm;   d[3] = -p[1]*tm;
+      d[4] = -sm*p[2]; d[5] = sm*p[2];   d[6] = p[1]*p[2]; d[7] = -p[1]*p[2];
+      d[8] = -rm*tm;   d[9] = -p[0]*tm;  d[10] = p[0]*tm;  d[11] = rm*tm;
+      d[12] = -rm*p[2]; d[13] = -p[0]*p[2]; d[14] = p[0]*p[2]; d[15] = rm*p[2];
+      d[16] = -rm*sm;  d[17] = -p[0]*sm; d[18] = -p[0]*p[1]; d[19] = -rm*p[1];
+      d[20] = rm*sm;   d[21] = p[0]*sm;  d[22] = p[0]*p[1];  d[23] = rm*p[1];
+    }
+    static bool Contains(const double p[3])
+    {
+      return InRange(p[0]) && InRange(p[1]) && InRange(p[2]);
+    }
+  };
+
+  struct WedgeShape
+  {
+    enum { NumberOfPoints = 6 };
+    static void Center(double p[3])
+    {
+      p[0] = p[1] = 1./3.;
+      p[2] = 0.5;
+    }
+    static void Functions(const double p[3], double w[6])
+    {
+      double u = 1. - p[0] - p[1], tm = 1. - p[2];
+      w[0] = u*tm;
+      w[1] = p[0]*tm;
+      w[2] = p[1]*tm;
+      w[3] = u*p[2];
+      w[4] = p[0]*p[2];
+      w[5] = p[1]*p[2];
+    }
+    static void Derivatives(const double p[3], double d[18])
+    {
+      double u = 1. - p[0] - p[1], tm = 1. - p[2];
+      d[0] = -tm;  d[1] = tm;    d[2] = 0.;    d[3] = -p[2]; d[4] = p[2];  d[5] = 0.;
+      d[6] = -tm;  d[7] = 0.;    d[8] = tm;    d[9] = -p[2]; d[10] = 0.;   d[11] = p[2];
+      d[12] = -u;  d[13] = -p[0]; d[14] = -p[1]; d[15] = u;  d[16] = p[0]; d[17] = p[1];
+    }
+    static bool Contains(const double p[3])
+    {
+      return InRange(p[0]) && InRange(p[1]) && InRange(p[2]) &&
+             p[0] + p[1] <= 1. + Tolerance;
+    }
+  };
+
+  struct PyramidShape
+  {
+    enum { NumberOfPoints = 5 };
+    static void Center(double p[3])
+    {
+      p[0] = p[1] = 0.4;
+      p[2] = 0.2;
+    }
+    static void Functions(const double p[3], double w[5])
+    {
+      double rm = 1. - p[0], sm = 1. - p[1], tm = 1. - p[2];
+      w[0] = rm*sm*tm;
+      w[1] = p[0]*sm*tm;
+      w[2] = p[0]*p[1]*tm;
+      w[3] = rm*p[1]*tm;
+      w[4] = p[2];
+    }
+    static void Derivatives(const double p[3], double d[15])
+    {
+      double rm = 1. - p[0], sm = 1. - p[1], tm = 1. - p[2];
+      d[0] = -sm*tm;  d[1] = sm*tm;     d[2] = p[1]*tm;   d[3] = -p[1]*tm; d[4] = 0.;
+      d[5] = -rm*tm;  d[6] = -p[0]*tm;  d[7] = p[0]*tm;   d[8] = rm*tm;    d[9] = 0.;
+      d[10] = -rm*sm; d[11] = -p[0]*sm; d[12] = -p[0]*p[1]; d[13] = -rm*p[1]; d[14] = 1.;
+    }
+    static bool Contains(const double p[3])
+    {
+      return InRange(p[0]) && InRange(p[1]) && InRange(p[2]);
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  // Finds the parametric coordinates of pt with Newton's method, starting
+  // from the parametric center, and the weights that go with them.
+  template <class Shape>
+  inline int NewtonSolve(const CellPoints &pts, const double pt[3],
+                         double pcoords[3], double *weights)
+  {
+    const int n = Shape::NumberOfPoints;
+    double derivs[3*n];
+    Shape::Center(pcoords);
+    bool converged = false;
+    for (int iteration = 0 ; !converged && iteration < MaximumIterations ;
+         iteration++)
+      {
+      Shape::Functions(pcoords, weights);
+      Shape::Derivatives(pcoords, derivs);
+
+      double fcol[3], rcol[3], scol[3], tcol[3];
+      for (int k = 0 ; k < 3 ; k++)
+        {
+        const double *x = pts.X[k];
+        double f = -pt[k], dr = 0., ds = 0., dt = 0.;
+        for (int i = 0 ; i < n ; i++)
+          {
+          f += x[i]*weights[i];
+          dr += x[i]*derivs[i];
+          ds += x[i]*derivs[n+i];
+          dt += x[i]*derivs[2*n+i];
+          }
+        fcol[k] = f;
+        rcol[k] = dr;
+        scol[k] = ds;
+        tcol[k] = dt;
+        }
+
+      double det = Determinant(rcol, scol, tcol);
+      if (det == 0.)
+        {
+        return NOT_HANDLED;
+        }
+      double step[3];
+      step[0] = Determinant(fcol, scol, tcol) / det;
+      step[1] = Determinant(rcol, fcol, tcol) / det;
+      step[2] = Determinant(rcol, scol, fcol) / det;
+
+      converged = true;
+      for (int k = 0 ; k < 3 ; k++)
+        {
+        pcoords[k] -= step[k];
+        if (fabs(step[k]) >= Converged)
+          {
+          converged = false;
+          }
+        if (fabs(pcoords[k]) > Diverged)
+          {
+          return NOT_HANDLED;
+          }
+        }
+      }
+    if (!converged)
+      {
+      return NOT_HANDLED;
+      }
+
+    Shape::Functions(pcoords, weights);
+    return (Shape::Contains(pcoords) ? INSIDE : OUTSIDE);
+  }
+
+  //----------------------------------------------------------------------------
+  // Tetrahedra are affine, so their parametric coordinates come from a
+  // single 3x3 solve.
+  inline int Tetra(const CellPoints &pts, const double pt[3],
+                   double weights[4])
+  {
+    double c0[3], c1[3], c2[3], rhs[3];
+    for (int k = 0 ; k < 3 ; k++)
+      {
+      const double *x = pts.X[k];
+      c0[k] = x[1] - x[0];
+      c1[k] = x[2] - x[0];
+      c2[k] = x[3] - x[0];
+      rhs[k] = pt[k] - x[0];
+      }
+    double det = Determinant(c0, c1, c2);
+    if (det == 0.)
+      {
+      return NOT_HANDLED;
+      }
+    double r = Determinant(rhs, c1, c2) / det;
+    double s = Determinant(c0, rhs, c2) / det;
+    double t = Determinant(c0, c1, rhs) / det;
+    weights[0] = 1. - r - s - t;
+    weights[1] = r;
+    weights[2] = s;
+    weights[3] = t;
+    return (InRange(r) && InRange(s) && InRange(t) && InRange(weights[0]) ?
+            INSIDE : OUTSIDE);
+  }
+
+  //----------------------------------------------------------------------------
+  inline int Hexahedron(const CellPoints &pts, const double pt[3],
+                        double weights[8])
+  {
+    double xyz[24];
+    for (int i = 0 ; i < 8 ; i++)
+      {
+      xyz[3*i]   = pts.X[0][i];
+      xyz[3*i+1] = pts.X[1][i];
+      xyz[3*i+2] = pts.X[2][i];
+      }
+    if (!CMFEUtility::HexahedronContainsPoint(xyz, pt))
+      {
+      return OUTSIDE;
+      }
+
+    // The face planes decide; Newton's method only provides the weights.
+    double pcoords[3];
+    return (NewtonSolve<HexahedronShape>(pts, pt, pcoords, weights) ==
+            NOT_HANDLED ? NOT_HANDLED : INSIDE);
+  }
+
+  //----------------------------------------------------------------------------
+  inline int Wedge(const CellPoints &pts, const double pt[3],
+                   double weights[6])
+  {
+    double pcoords[3];
+    return NewtonSolve<WedgeShape>(pts, pt, pcoords, weights);
+  }
+
+  //----------------------------------------------------------------------------
+  inline int Pyramid(const CellPoints &pts, const double pt[3],
+                     double weights[5])
+  {
+    double pcoords[3];
+    return NewtonSolve<PyramidShape>(pts, pt, pcoords, weights);
+  }
+
+  //----------------------------------------------------------------------------
+  // Description:
+  // Locates pt in the cell of the given type whose points are ids[0] to
+  // ids[nPts-1] of the interleaved xyz buffer coords.  On INSIDE, weights
+  // holds the interpolation weights of the nPts points.
+  template <class T>
+  inline int LocatePoint(int cellType, const T *coords, const vtkIdType *ids,
+                         int nPts, const double pt[3], double *weights)
+  {
+    CellPoints pts;
+    switch (cellType)
+      {
+      case VTK_TETRA:
+        if (nPts != 4)
+          {
+          break;
+          }
+        GatherPoints(coords, ids, nPts, pts);
+        return Tetra(pts, pt, weights);
+      case VTK_HEXAHEDRON:
+        if (nPts != 8)
+          {
+          break;
+          }
+        GatherPoints(coords, ids, nPts, pts);
+        return Hexahedron(pts, pt, weights);
+      case VTK_WEDGE:
+        if (nPts != 6)
+          {
+          break;
+          }
+        GatherPoints(coords, ids, nPts, pts);
+        return Wedge(pts, pt, weights);
+      case VTK_PYRAMID:
+        if (nPts != 5)
+          {
+          break;
+          }
+        GatherPoints(coords, ids, nPts, pts);
+        return Pyramid(pts, pt, weights);
+      }
+    return NOT_HANDLED;
+  }
+
+  //----------------------------------------------------------------------------
+  // Description:
+  // Finds the cell of an axis with n points listed in increasing order in
+  // coords that contains v, and how far t through the cell v is.  An axis
+  // with a single point is flat, and v has to lie on it.  Returns false if
+  // v is outside the axis.
+  inline bool LocateOnAxis(double v, const double *coords, int n, int &cell,
+                           double &t)
+  {
+    cell = 0;
+    t = 0.;
+    if (n == 1)
+      {
+      return (fabs(v - coords[0]) <= FlatTolerance*(1. + fabs(coords[0])));
+      }
+    if (!(v >= coords[0] && v <= coords[n-1]))
+      {
+      return false;
+      }
+    cell = (int) (vtkstd::upper_bound(coords, coords + n, v) - coords) - 1;
+    cell = (cell > n-2 ? n-2 : cell);
+    double h = coords[cell+1] - coords[cell];
+    t = (h > 0. ? (v - coords[cell]) / h : 0.);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Description:
+  // Same as LocateOnAxis, for n points that start at origin and are
+  // spacing apart.  The spacing may be negative.
+  inline bool LocateOnUniformAxis(double v, double origin, double spacing,
+                                  int n, int &cell, double &t)
+  {
+    cell = 0;
+    t = 0.;
+    if (n == 1)
+      {
+      return (fabs(v - origin) <= FlatTolerance*(1. + fabs(origin)));
+      }
+    double u = (v - origin) / spacing;
+    if (!(u >= 0. && u <= n-1))
+      {
+      return false;
+      }
+    cell = (int) u;
+    cell = (cell > n-2 ? n-2 : cell);
+    t = u - cell;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Description:
+  // Id of cell ijk of a grid with dims points along each axis.
+  inline vtkIdType CellIndex(const int dims[3], const int ijk[3])
+  {
+    vtkIdType nx = (dims[0] > 1 ? dims[0]-1 : 1);
+    vtkIdType ny = (dims[1] > 1 ? dims[1]-1 : 1);
+    return ijk[0] + nx*(ijk[1] + ny*ijk[2]);
+  }
+
+  //----------------------------------------------------------------------------
+  // Description:
+  // Ids and weights of the points of cell ijk of a grid with dims points
+  // along each axis, for trilinear interpolation at the fractions t of the
+  // cell.  Flat axes have a single layer of points, so 2D cells have four
+  // points and 1D cells two.  Returns the number of points.
+  inline int Trilinear(const int dims[3], const int ijk[3], const double t[3],
+                       vtkIdType ids[8], double weights[8])
+  {
+    const vtkIdType stride[3] =
+      { 1, dims[0], (vtkIdType) dims[0]*dims[1] };
+    ids[0] = ijk[0]*stride[0] + ijk[1]*stride[1] + ijk[2]*stride[2];
+    weights[0] = 1.;
+    int n = 1;
+    for (int a = 0 ; a < 3 ; a++)
+      {
+      if (dims[a] == 1)
+        {
+        continue;
+        }
+      for (int i = 0 ; i < n ; i++)
+        {
+        ids[n+i] = ids[i] + stride[a];
+        weights[n+i] = weights[i]*t[a];
+        weights[i] *= 1. - t[a];
+        }
+      n *= 2;
+      }
+    return n;
+  }
+}
+
+#endif
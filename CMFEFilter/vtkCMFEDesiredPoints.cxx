@@ -61,116 +61,169 @@
 #include "vtkCMFEUtility.h"
 #include "vtkDataArray.h"
 #include "vtkDataSet.h"
+#include "vtkImageData.h"
+#include "vtkPoints.h"
 #include "vtkRectilinearGrid.h"
+#include "vtkStructuredGrid.h"
 
 #include <math.h>
+#include <string.h>
+#include <vtkstd/algorithm>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Converts the values of a variable of the found points to the value
+  // type.  The values of consecutive points are stride doubles apart.
+  template <class T>
+  void ConvertValues(const double *values, int stride,
+                     const unsigned char *found, int n, int nComps, T *out)
+  {
+    for (int i = 0 ; i < n ; i++)
+      {
+      if (found[i])
+        {
+        for (int c = 0 ; c < nComps ; c++)
+          {
+          out[i*nComps + c] = static_cast<T>(values[i*stride + c]);
+          }
+        }
+      }
+  }
+}
 
 //----------------------------------------------------------------------------
-vtkCMFEDesiredPoints::vtkCMFEDesiredPoints(bool isN, int nc)
+vtkCMFEDesiredPoints::vtkCMFEDesiredPoints(bool isN, int nc, int valueType)
 {
   this->IsNodal   = isN;
-  this->NumberOfComps    = nc;
-  this->MapToDataSets = NULL;
+  this->NumberOfComps    = 0;
+  this->TupleSize = 0;
   this->DataSetStartIndices  = NULL;
-  this->Values      = NULL;
+  this->Found       = NULL;
   this->TotalNumberOfValues  = 0;
   this->NumberOfDatasets = 0;
   this->NumberOfGrids   = 0;    
+  if (nc > 0)
+    {
+    this->AddVariable(nc, valueType);
+    }
 }
 
 //----------------------------------------------------------------------------
-vtkCMFEDesiredPoints::~vtkCMFEDesiredPoints()
+void vtkCMFEDesiredPoints::AddVariable(int nc, int valueType)
 {
-  delete [] this->MapToDataSets;
-  delete [] this->DataSetStartIndices;
-  delete [] this->Values;
+  int tupleSize = nc*vtkDataArray::GetDataTypeSize(valueType);
+  this->VariableComps.push_back(nc);
+  this->VariableTypes.push_back(valueType);
+  this->VariableTupleSizes.push_back(tupleSize);
+  this->Values.push_back(NULL);
+  this->NumberOfComps += nc;
+  this->TupleSize += tupleSize;
+}
 
-  for (int i = 0 ; i < this->pt_list.size() ; ++i)
+//----------------------------------------------------------------------------
+void vtkCMFEDesiredPoints::DeleteValues()
+{
+  for (size_t v = 0 ; v < this->Values.size() ; v++)
     {
-    delete [] this->pt_list[i];
+    delete [] this->Values[v];
+    this->Values[v] = NULL;
     }
+}
+
+//----------------------------------------------------------------------------
+vtkCMFEDesiredPoints::~vtkCMFEDesiredPoints()
+{
+  delete [] this->DataSetStartIndices;
+  this->DeleteValues();
+  delete [] this->Found;
+
+  this->DeletePointLists();
   for (int i = 0 ; i < this->rgrid_pts.size() ; ++i)
     {
     delete [] this->rgrid_pts[i];
     }
+  for (int i = 0 ; i < this->BorrowedFrom.size() ; ++i)
+    {
+    this->BorrowedFrom[i]->UnRegister(NULL);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEDesiredPoints::DeletePointLists()
+{
+  for (int i = 0 ; i < this->pt_list.size() ; ++i)
+    {
+    if (!this->pt_list_borrowed[i])
+      {
+      delete [] this->pt_list[i];
+      }
+    }
 }
 
 //----------------------------------------------------------------------------
 void vtkCMFEDesiredPoints::AddDataset(vtkDataSet *ds)
 {    
-  int  i;
+  vtkIdType  i;
 
-  int nValues= (this->IsNodal ? ds->GetNumberOfPoints() : ds->GetNumberOfCells());
+  vtkIdType nValues= (this->IsNodal ? ds->GetNumberOfPoints() : ds->GetNumberOfCells());
   if (ds->GetDataObjectType() == VTK_RECTILINEAR_GRID)
     {    
+    this->AddedDatasets.push_back(-1 - (int) this->rgrid_pts.size() / 3);
     // Get the rectilinear grid and determine its dimensions.  Be leery
     // of situations where the grid is flat in a dimension.    
     vtkRectilinearGrid *rgrid = (vtkRectilinearGrid *) ds;
     int dims[3];
     rgrid->GetDimensions(dims);
-    if (!this->IsNodal)
-      {
-      dims[0] = (dims[0] > 1 ? dims[0]-1 : 1);
-      dims[1] = (dims[1] > 1 ? dims[1]-1 : 1);
-      dims[2] = (dims[2] > 1 ? dims[2]-1 : 1);
-      }
-
-    // Set up the X-coordinates.
-    vtkDataArray *x = rgrid->GetXCoordinates();
-    float *newX = new float[dims[0]];
-    for (i = 0 ; i < dims[0] ; i++)
-      {
-      if (this->IsNodal || dims[0] == 1)
-        {
-        newX[i] = x->GetTuple1(i);
-        }      
-      else
-        {
-        newX[i] = (x->GetTuple1(i) + x->GetTuple1(i+1)) / 2.;
-        }
-      }
-    this->rgrid_pts_size.push_back(dims[0]);
-    this->rgrid_pts.push_back(newX);
-    
-    // Set up the Y-coordinates.    
-    vtkDataArray *y = rgrid->GetYCoordinates();
-    float *newY = new float[dims[1]];
-    for (i = 0 ; i < dims[1] ; i++)
+    vtkDataArray *axes[3] = { rgrid->GetXCoordinates(),
+                              rgrid->GetYCoordinates(),
+                              rgrid->GetZCoordinates() };
+    for (int a = 0 ; a < 3 ; a++)
       {
-      if (this->IsNodal || dims[1] == 1)
-        {
-        newY[i] = y->GetTuple1(i);
-        }
-      else
+      vtkstd::vector<double> coords(dims[a]);
+      for (i = 0 ; i < dims[a] ; i++)
         {
-        newY[i] = (y->GetTuple1(i) + y->GetTuple1(i+1)) / 2.;
+        coords[i] = axes[a]->GetTuple1(i);
         }
+      this->AddRGridAxis(&coords[0], dims[a]);
       }
-    this->rgrid_pts_size.push_back(dims[1]);
-    this->rgrid_pts.push_back(newY);
-
-    // Set up the Z-coordinates.
-    vtkDataArray *z = rgrid->GetZCoordinates();
-    float *newZ = new float[dims[2]];
-    for (i = 0 ; i < dims[2] ; i++)
+    }
+  else if (vtkImageData::SafeDownCast(ds) != NULL)
+    {
+    // Image data is a rectilinear grid whose coordinates are implied by
+    // its origin and spacing, so it is stored the same way.
+    this->AddedDatasets.push_back(-1 - (int) this->rgrid_pts.size() / 3);
+    vtkImageData *image = vtkImageData::SafeDownCast(ds);
+    int dims[3];
+    int extent[6];
+    double origin[3];
+    double spacing[3];
+    image->GetDimensions(dims);
+    image->GetExtent(extent);
+    image->GetOrigin(origin);
+    image->GetSpacing(spacing);
+    for (int a = 0 ; a < 3 ; a++)
       {
-      if (this->IsNodal || dims[2] == 1)
+      vtkstd::vector<double> coords(dims[a]);
+      for (i = 0 ; i < dims[a] ; i++)
         {
-        newZ[i] = z->GetTuple1(i);
-        }      
-      else
-        {
-        newZ[i] = (z->GetTuple1(i) + z->GetTuple1(i+1)) / 2.;
+        coords[i] = origin[a] + (extent[2*a] + i)*spacing[a];
         }
+      this->AddRGridAxis(&coords[0], dims[a]);
       }
-    this->rgrid_pts_size.push_back(dims[2]);
-    this->rgrid_pts.push_back(newZ);
+    }
+  else if (ds->GetDataObjectType() == VTK_STRUCTURED_GRID)
+    {
+    this->AddedDatasets.push_back((int) this->pt_list.size());
+    this->AddStructuredGrid((vtkStructuredGrid *) ds);
     }
   else
     {
+    this->AddedDatasets.push_back((int) this->pt_list.size());
     float *plist = new float[3*nValues];
     this->pt_list.push_back(plist);
     this->pt_list_size.push_back(nValues);
+    this->pt_list_borrowed.push_back(false);
 
     double dcp[3]; 
     for (i = 0 ; i <nValues; i++)
@@ -193,85 +246,174 @@ void vtkCMFEDesiredPoints::AddDataset(vtkDataSet *ds)
 }
 
 //----------------------------------------------------------------------------
-void vtkCMFEDesiredPoints::Finalize(void)
+void vtkCMFEDesiredPoints::AddRGridAxis(const double *coords, int n)
 {
-  int   i, j;
-  int   index = 0;
-
-  if (this->Values != NULL)
+  // A flat dimension keeps its single coordinate for cell data.
+  int nValues = (this->IsNodal || n <= 1 ? n : n-1);
+  float *axis = new float[nValues];
+  for (int i = 0 ; i < nValues ; i++)
     {
-    delete [] this->Values;
+    if (this->IsNodal || n <= 1)
+      {
+      axis[i] = coords[i];
+      }
+    else
+      {
+      axis[i] = (coords[i] + coords[i+1]) / 2.;
+      }
     }
+  this->rgrid_pts_size.push_back(nValues);
+  this->rgrid_pts.push_back(axis);
+}
 
-  if (this->DataSetStartIndices != NULL)
+//----------------------------------------------------------------------------
+void vtkCMFEDesiredPoints::AddStructuredGrid(vtkStructuredGrid *sgrid)
+{
+  vtkPoints *points = sgrid->GetPoints();
+  vtkIdType nPoints = (points != NULL ? points->GetNumberOfPoints() : 0);
+  vtkDataArray *coords = (points != NULL ? points->GetData() : NULL);
+
+  // The points of a nodal grid are already the desired points, so a float
+  // array is used in place for as long as we hold on to the grid.
+  if (this->IsNodal && points != NULL && points->GetDataType() == VTK_FLOAT)
     {
-    delete [] this->DataSetStartIndices;
+    sgrid->Register(NULL);
+    this->BorrowedFrom.push_back(sgrid);
+    this->pt_list.push_back((float *) coords->GetVoidPointer(0));
+    this->pt_list_size.push_back(nPoints);
+    this->pt_list_borrowed.push_back(true);
+    return;
     }
-  
-  if (this->MapToDataSets != NULL)
+
+  vtkIdType i;
+  if (this->IsNodal)
     {
-    delete [] this->MapToDataSets;
+    float *plist = new float[3*nPoints];
+    for (i = 0 ; i < nPoints ; i++)
+      {
+      double *pt = coords->GetTuple3(i);
+      plist[3*i]   = (float) pt[0];
+      plist[3*i+1] = (float) pt[1];
+      plist[3*i+2] = (float) pt[2];
+      }
+    this->pt_list.push_back(plist);
+    this->pt_list_size.push_back(nPoints);
+    this->pt_list_borrowed.push_back(false);
+    return;
     }
 
-  this->TotalNumberOfValues  = 0;
-  this->NumberOfGrids = this->rgrid_pts.size() / 3;
-
-  int numNonRGrid = this->pt_list_size.size();
-  this->NumberOfDatasets = numNonRGrid + this->NumberOfGrids;
-  
-  for (i = 0 ; i < numNonRGrid ; i++)
+  // Cell centers are the average of the corners of each hexahedron, which
+  // are found from the structure of the block rather than with GetCell.
+  int dims[3];
+  sgrid->GetDimensions(dims);
+  int cellDims[3];
+  int offsets[3];
+  int nCorners = 1;
+  for (int a = 0 ; a < 3 ; a++)
     {
-    this->TotalNumberOfValues += this->pt_list_size[i];
+    cellDims[a] = (dims[a] > 1 ? dims[a]-1 : 1);
+    offsets[a] = (dims[a] > 1 ? 1 : 0);
+    nCorners *= (dims[a] > 1 ? 2 : 1);
     }
-
-  this->GridStart = this->TotalNumberOfValues;
-  for (i = 0 ; i < this->NumberOfGrids ; i++)
+  vtkIdType nCells = (vtkIdType) cellDims[0] * cellDims[1] * cellDims[2];
+  if (nPoints == 0)
     {
-    int nValues = this->rgrid_pts_size[3*i] * this->rgrid_pts_size[3*i+1] *this->rgrid_pts_size[3*i+2];
-    this->TotalNumberOfValues += nValues;
+    nCells = 0;
     }
 
-  int *ds_size = new int[this->NumberOfDatasets];
-  for (i = 0 ; i < numNonRGrid ; i++)
+  float *plist = new float[3*nCells];
+  const vtkIdType rowSize = dims[0];
+  const vtkIdType planeSize = (vtkIdType) dims[0] * dims[1];
+  float *cur_pt = plist;
+  for (int k = 0 ; k < cellDims[2] && nCells > 0 ; k++)
     {
-    ds_size[i] = this->pt_list_size[i];
+    for (int j = 0 ; j < cellDims[1] ; j++)
+      {
+      for (int l = 0 ; l < cellDims[0] ; l++)
+        {
+        vtkIdType base = k*planeSize + j*rowSize + l;
+        double center[3] = { 0., 0., 0. };
+        for (int c = 0 ; c < 8 ; c++)
+          {
+          if (((c & 1) && !offsets[0]) || ((c & 2) && !offsets[1]) ||
+              ((c & 4) && !offsets[2]))
+            {
+            continue;
+            }
+          vtkIdType id = base + (c & 1 ? 1 : 0) + (c & 2 ? rowSize : 0) +
+                         (c & 4 ? planeSize : 0);
+          double *pt = coords->GetTuple3(id);
+          center[0] += pt[0];
+          center[1] += pt[1];
+          center[2] += pt[2];
+          }
+        cur_pt[0] = (float) (center[0] / nCorners);
+        cur_pt[1] = (float) (center[1] / nCorners);
+        cur_pt[2] = (float) (center[2] / nCorners);
+        cur_pt += 3;
+        }
+      }
     }
-  
-  for (i = 0 ; i < this->NumberOfGrids ; i++)
+  this->pt_list.push_back(plist);
+  this->pt_list_size.push_back(nCells);
+  this->pt_list_borrowed.push_back(false);
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEDesiredPoints::Finalize(void)
+{
+  int   i;
+
+  this->DeleteValues();
+
+  if (this->Found != NULL)
     {
-    ds_size[i+numNonRGrid] = this->rgrid_pts_size[3*i] * this->rgrid_pts_size[3*i+1] * this->rgrid_pts_size[3*i+2];
+    delete [] this->Found;
     }
 
-  this->DataSetStartIndices = new int[this->NumberOfDatasets];
-  this->DataSetStartIndices[0] = 0;
-  for (i = 1 ; i < this->NumberOfDatasets ; i++)
+  if (this->DataSetStartIndices != NULL)
     {
-    this->DataSetStartIndices[i] = this->DataSetStartIndices[i-1] + ds_size[i-1];
+    delete [] this->DataSetStartIndices;
     }
-  delete [] ds_size;
 
-  this->MapToDataSets = new int[this->TotalNumberOfValues];
-  index = 0;
+  this->TotalNumberOfValues  = 0;
+  this->NumberOfGrids = this->rgrid_pts.size() / 3;
+
+  int numNonRGrid = this->pt_list_size.size();
+  this->NumberOfDatasets = numNonRGrid + this->NumberOfGrids;
+  
+  // The datasets are stored one after the other, so the dataset a point
+  // belongs to is found with a binary search over where they start.
+  this->DataSetStartIndices = new vtkIdType[this->NumberOfDatasets+1];
   for (i = 0 ; i < numNonRGrid ; i++)
     {
-    for (j = 0 ; j < this->pt_list_size[i] ; j++)
-      {
-      this->MapToDataSets[index] = i;
-      index++;
-      }
+    this->DataSetStartIndices[i] = this->TotalNumberOfValues;
+    this->TotalNumberOfValues += this->pt_list_size[i];
     }
 
+  this->GridStart = this->TotalNumberOfValues;
   for (i = 0 ; i < this->NumberOfGrids ; i++)
     {
-    int nValues = this->rgrid_pts_size[3*i] * this->rgrid_pts_size[3*i+1] * this->rgrid_pts_size[3*i+2];
-    for (j = 0 ; j < nValues ; j++)
-      {
-      this->MapToDataSets[index] = i+numNonRGrid;
-      index++;
-      }
+    this->DataSetStartIndices[i+numNonRGrid] = this->TotalNumberOfValues;
+    this->TotalNumberOfValues += this->GetRGridSize(i);
+    }
+  this->DataSetStartIndices[this->NumberOfDatasets] = this->TotalNumberOfValues;
+
+  // Without components there is nothing to store, not even the mask.
+  vtkIdType nStored = (this->NumberOfComps > 0 ? this->TotalNumberOfValues : 0);
+  for (size_t v = 0 ; v < this->Values.size() ; v++)
+    {
+    this->Values[v] = new char[nStored*this->VariableTupleSizes[v]];
     }
+  this->Found = new unsigned char[nStored];
+  memset(this->Found, 0, nStored);
+}
 
-  this->Values = new float[this->TotalNumberOfValues*this->NumberOfComps];
+//----------------------------------------------------------------------------
+vtkIdType vtkCMFEDesiredPoints::GetRGridSize(int grid) const
+{
+  return (vtkIdType) this->rgrid_pts_size[3*grid] *
+         this->rgrid_pts_size[3*grid+1] * this->rgrid_pts_size[3*grid+2];
 }
 
 //----------------------------------------------------------------------------
@@ -291,16 +433,17 @@ void vtkCMFEDesiredPoints::GetRGrid(int idx, const float *&x, const float *&y, c
 
 
 //----------------------------------------------------------------------------
-void vtkCMFEDesiredPoints::GetPoint(int p, float *pt) const
+void vtkCMFEDesiredPoints::GetPoint(vtkIdType p, float *pt) const
 {
   if (p < 0 || p >= this->TotalNumberOfValues)
     {    
     return;
     }
 
-  int ds = this->MapToDataSets[p];
-  int start = this->DataSetStartIndices[ds];
-  int rel_index = p-start;
+  int ds = (int) (vtkstd::upper_bound(this->DataSetStartIndices,
+    this->DataSetStartIndices + this->NumberOfDatasets, p) -
+    this->DataSetStartIndices) - 1;
+  vtkIdType rel_index = p - this->DataSetStartIndices[ds];
   if (p < this->GridStart)
     {
     float *ptr = this->pt_list[ds] + 3*rel_index;
@@ -310,33 +453,115 @@ void vtkCMFEDesiredPoints::GetPoint(int p, float *pt) const
     }
   else
     {
-    int ds_rel_index = ds - this->GridStart;
-    int nX = this->rgrid_pts_size[3*ds_rel_index];
-    int xIdx = rel_index % nX;
-    pt[0] = this->rgrid_pts[3*ds_rel_index][xIdx];
-    int nY = this->rgrid_pts_size[3*ds_rel_index+1];
-    int yIdx = (rel_index/nX) % nY;
-    pt[1] = this->rgrid_pts[3*ds_rel_index+1][yIdx];
-    int zIdx = rel_index/(nX*nY);
-    pt[2] = this->rgrid_pts[3*ds_rel_index+2][zIdx];
+    this->GetRGridPoints(ds - (int) this->pt_list.size(), rel_index, 1, pt);
+    }
+}
+
+
+//----------------------------------------------------------------------------
+vtkIdType vtkCMFEDesiredPoints::GetDataSetSize(int ds) const
+{
+  if (ds < 0 || ds >= this->NumberOfDatasets)
+    {
+    return 0;
     }
+  return this->DataSetStartIndices[ds+1] - this->DataSetStartIndices[ds];
 }
 
+//----------------------------------------------------------------------------
+int vtkCMFEDesiredPoints::GetDataSetIndex(int added) const
+{
+  int idx = this->AddedDatasets[added];
+  return (idx >= 0 ? idx : (int) this->pt_list.size() - 1 - idx);
+}
 
 //----------------------------------------------------------------------------
-void  vtkCMFEDesiredPoints::SetValue(int p, float *v)
+void vtkCMFEDesiredPoints::GetRGridPoints(int idx, vtkIdType start, int n,
+                                          float *pts) const
 {
-  for (int i = 0 ; i < this->NumberOfComps ; i++)
+  if (idx < 0 || idx >= this->NumberOfGrids)
+    {
+    return;
+    }
+  const float *x = this->rgrid_pts[3*idx];
+  const float *y = this->rgrid_pts[3*idx+1];
+  const float *z = this->rgrid_pts[3*idx+2];
+  int nX = this->rgrid_pts_size[3*idx];
+  int nY = this->rgrid_pts_size[3*idx+1];
+
+  // Step through the grid in index order rather than dividing every index.
+  int xIdx = (int) (start % nX);
+  int yIdx = (int) ((start/nX) % nY);
+  int zIdx = (int) (start/((vtkIdType) nX*nY));
+  for (int i = 0 ; i < n ; i++)
     {
-    this->Values[p*this->NumberOfComps + i] = v[i];
+    pts[3*i]   = x[xIdx];
+    pts[3*i+1] = y[yIdx];
+    pts[3*i+2] = z[zIdx];
+    if (++xIdx == nX)
+      {
+      xIdx = 0;
+      if (++yIdx == nY)
+        {
+        yIdx = 0;
+        zIdx++;
+        }
+      }
     }
 }
 
 //----------------------------------------------------------------------------
-const float * vtkCMFEDesiredPoints::GetValue(int ds_idx, int pt_idx) const
+void vtkCMFEDesiredPoints::SetValues(vtkIdType p, int n, const double *v,
+                                     const unsigned char *found)
+{
+  for (size_t var = 0 ; var < this->Values.size() ; var++)
+    {
+    void *out = this->Values[var] + p*this->VariableTupleSizes[var];
+    switch (this->VariableTypes[var])
+      {
+      vtkTemplateMacro(
+        ConvertValues(v, this->NumberOfComps, found, n,
+                      this->VariableComps[var], static_cast<VTK_TT *>(out)));
+      }
+    v += this->VariableComps[var];
+    }
+  memcpy(this->Found + p, found, n);
+}
+
+//----------------------------------------------------------------------------
+const void * vtkCMFEDesiredPoints::GetValue(int var, int ds_idx,
+                                            vtkIdType pt_idx) const
 { 
-  int true_idx = this->DataSetStartIndices[ds_idx] + pt_idx;
-  return this->Values + this->NumberOfComps*true_idx;
+  vtkIdType true_idx = this->DataSetStartIndices[ds_idx] + pt_idx;
+  if (this->NumberOfComps == 0 || !this->Found[true_idx])
+    {
+    return NULL;
+    }
+  return this->Values[var] + this->VariableTupleSizes[var]*true_idx;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEDesiredPoints::PackRecord(vtkIdType p, char *record) const
+{
+  for (size_t v = 0 ; v < this->Values.size() ; v++)
+    {
+    int size = this->VariableTupleSizes[v];
+    memcpy(record, this->Values[v] + p*size, size);
+    record += size;
+    }
+  *record = this->Found[p];
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEDesiredPoints::UnpackRecord(vtkIdType p, const char *record)
+{
+  for (size_t v = 0 ; v < this->Values.size() ; v++)
+    {
+    int size = this->VariableTupleSizes[v];
+    memcpy(this->Values[v] + p*size, record, size);
+    record += size;
+    }
+  this->Found[p] = *record;
 }
 
 
@@ -469,12 +694,12 @@ void vtkCMFEDesiredPoints::RelocatePointsUsingPartition( vtkCMFESpatialPartition
   int   nProcs = CMFEUtility::PAR_Size();
   
   // Start off by assessing how much data needs to be sent, and to where. 
-  vtkstd::vector<int> pt_cts(nProcs, 0);
+  vtkstd::vector<vtkIdType> pt_cts(nProcs, 0);
   for (i = 0 ; i < this->pt_list_size.size() ; i++)
     {
-    const int npts = this->pt_list_size[i];
+    const vtkIdType npts = this->pt_list_size[i];
     float    *pts  = this->pt_list[i];
-    for (j = 0 ; j < npts ; j++)
+    for (vtkIdType p = 0 ; p < npts ; p++)
       {
       float pt[3];
       pt[0] = *pts++;
@@ -514,11 +739,11 @@ void vtkCMFEDesiredPoints::RelocatePointsUsingPartition( vtkCMFESpatialPartition
 
   // Now construct the messages to send to the other processors.
   // Construct the actual sizes for each message. 
-  int *sendcount = new int[nProcs];
-  int  total_msg_size = 0;
+  vtkIdType *sendcount = new vtkIdType[nProcs];
+  vtkIdType  total_msg_size = 0;
   for (j = 0 ; j < nProcs ; j++)
     {
-    sendcount[j] = sizeof(int); // npts for non-rgrids;
+    sendcount[j] = sizeof(vtkIdType); // npts for non-rgrids;
     sendcount[j] += 3*sizeof(float)*pt_cts[j];
     sendcount[j] += sizeof(int); // num rgrids;
     sendcount[j] += 3*grids[j]*sizeof(int); // dims for each rgrid
@@ -541,17 +766,17 @@ void vtkCMFEDesiredPoints::RelocatePointsUsingPartition( vtkCMFESpatialPartition
   // processor".
   for (j = 0 ; j < nProcs ; j++)
     {
-    int numFromMeToProcJ = pt_cts[j];
-    memcpy(sub_ptr[j], (void *) &numFromMeToProcJ, sizeof(int));
-    sub_ptr[j] += sizeof(int);
+    vtkIdType numFromMeToProcJ = pt_cts[j];
+    memcpy(sub_ptr[j], (void *) &numFromMeToProcJ, sizeof(vtkIdType));
+    sub_ptr[j] += sizeof(vtkIdType);
     }
 
   // Now add the actual points to the message.
   for (i = 0 ; i < this->pt_list_size.size() ; i++)
     {
-    const int npts = this->pt_list_size[i];
+    const vtkIdType npts = this->pt_list_size[i];
     float    *pts  = this->pt_list[i];
-    for (j = 0 ; j < npts ; j++)
+    for (vtkIdType p = 0 ; p < npts ; p++)
       {
       float pt[3];
       pt[0] = *pts++;
@@ -612,49 +837,32 @@ void vtkCMFEDesiredPoints::RelocatePointsUsingPartition( vtkCMFESpatialPartition
       }
     }
 
-  int *recvcount = new int[nProcs];
-
-#ifdef VTK_USE_MPI
-  MPI_Alltoall(sendcount, 1, MPI_INT, recvcount, 1, MPI_INT, *CMFEUtility::GetMPIComm());
-#endif
+  vtkIdType *recvcount = new vtkIdType[nProcs];
+  CMFEUtility::AllToAllCounts(sendcount, recvcount);
 
   char **recvmessages = new char*[nProcs];
   char *big_recv_msg = CMFEUtility::CreateMessageStrings(recvmessages, recvcount, nProcs);
 
-  int *senddisp  = new int[nProcs];
-  int *recvdisp  = new int[nProcs];
-  senddisp[0] = 0;
-  recvdisp[0] = 0;
-  for (j = 1 ; j < nProcs ; j++)
-    {
-    senddisp[j] = sendcount[j-1] + senddisp[j-1];
-    recvdisp[j] = recvcount[j-1] + recvdisp[j-1];
-    }
-#ifdef VTK_USE_MPI
-  MPI_Alltoallv(big_send_msg, sendcount, senddisp, MPI_CHAR,
-                big_recv_msg, recvcount, recvdisp, MPI_CHAR,
-                *CMFEUtility::GetMPIComm());
-#endif
+  CMFEUtility::AllToAllMessages(big_send_msg, sendcount, recvmessages, recvcount);
   delete [] sendcount;
-  delete [] senddisp;
   delete [] big_send_msg;
 
   // Set up the buffers so we can read the information out.
-  sub_ptr[0] = big_recv_msg;
-  for (i = 1 ; i < nProcs ; i++)
-  sub_ptr[i] = sub_ptr[i-1] + recvcount[i-1];
+  for (i = 0 ; i < nProcs ; i++)
+    {
+    sub_ptr[i] = recvmessages[i];
+    }
 
   // Translate the buffers we just received into the points we should look
   // at.
-  int numPts = 0;
   this->pt_list_came_from.clear();
   vtkstd::vector<float *> new_pt_list;
-  vtkstd::vector<int> new_pt_list_size;
+  vtkstd::vector<vtkIdType> new_pt_list_size;
   for (j = 0 ; j < nProcs ; j++)
     {
-    int numFromProcJ = 0;
-    memcpy((void *) &numFromProcJ, sub_ptr[j], sizeof(int));
-    sub_ptr[j] += sizeof(int);
+    vtkIdType numFromProcJ = 0;
+    memcpy((void *) &numFromProcJ, sub_ptr[j], sizeof(vtkIdType));
+    sub_ptr[j] += sizeof(vtkIdType);
     if (numFromProcJ == 0)
       {
       continue;
@@ -710,8 +918,10 @@ void vtkCMFEDesiredPoints::RelocatePointsUsingPartition( vtkCMFESpatialPartition
   // Now take our relocated points and use them as the new "desired points."
   this->orig_pt_list = this->pt_list;
   this->orig_pt_list_size = this->pt_list_size;
+  this->orig_pt_list_borrowed = this->pt_list_borrowed;
   this->pt_list = new_pt_list;
   this->pt_list_size = new_pt_list_size;
+  this->pt_list_borrowed.assign(new_pt_list.size(), false);
 
   this->orig_rgrid_pts = this->rgrid_pts;
   this->orig_rgrid_pts_size = this->rgrid_pts_size;
@@ -722,7 +932,6 @@ void vtkCMFEDesiredPoints::RelocatePointsUsingPartition( vtkCMFESpatialPartition
   delete [] recvmessages;
   delete [] big_recv_msg;
   delete [] recvcount;
-  delete [] recvdisp;    
 }
 
 
@@ -736,18 +945,18 @@ void vtkCMFEDesiredPoints::UnRelocatePoints( vtkCMFESpatialPartition *spat_part)
   // Clean up the current points and restore the "orig" points.
   // Do this first, because it will buy us a little memory in case we're
   // close to going over.
-  for (i = 0 ; i < this->pt_list.size() ; i++)
-    {
-    delete [] this->pt_list[i];
-    }
+  this->DeletePointLists();
   for (i = 0 ; i < this->rgrid_pts.size() ; i++)
     {
     delete [] this->rgrid_pts[i];
     }
   
   // We need to take the this->Values for our point list and send them back to the
-  // processor they came from.
-  int *sendcount = new int[nProcs];
+  // processor they came from.  Every point is sent as its tuple of each
+  // variable followed by its entry of the found mask, unless there are no
+  // values at all.
+  const int recordSize = (this->NumberOfComps > 0 ? this->TupleSize + 1 : 0);
+  vtkIdType *sendcount = new vtkIdType[nProcs];
   for (i = 0 ; i < nProcs ; i++)
     {
     sendcount[i] = 0;
@@ -755,16 +964,16 @@ void vtkCMFEDesiredPoints::UnRelocatePoints( vtkCMFESpatialPartition *spat_part)
   
   for (i = 0 ; i < this->pt_list_came_from.size() ; i++)
     {
-    sendcount[this->pt_list_came_from[i]]+=this->pt_list_size[i]*sizeof(float)*this->NumberOfComps;
+    sendcount[this->pt_list_came_from[i]]+=this->pt_list_size[i]*recordSize;
     }
   
   for (i = 0 ; i < this->rgrid_came_from.size() ; i++)
     {
-    int npts = this->rgrid_pts_size[3*i] * this->rgrid_pts_size[3*i+1] * this->rgrid_pts_size[3*i+2];
-    sendcount[this->rgrid_came_from[i]] += npts*sizeof(float)*this->NumberOfComps;
+    vtkIdType npts = this->GetRGridSize(i);
+    sendcount[this->rgrid_came_from[i]] += npts*recordSize;
     }
 
-  int  totalSend = 0;
+  vtkIdType  totalSend = 0;
   for (i = 0 ; i < nProcs ; i++)
     {
     totalSend += sendcount[i];
@@ -779,55 +988,49 @@ void vtkCMFEDesiredPoints::UnRelocatePoints( vtkCMFESpatialPartition *spat_part)
     sub_ptr[i] = sub_ptr[i-1] + sendcount[i-1];
     }
 
-  float *values_tmp = this->Values;
-  for (i = 0 ; i < this->pt_list_came_from.size() ; i++)
-    {
-    int msgGoingTo = this->pt_list_came_from[i];
-    memcpy(sub_ptr[msgGoingTo], values_tmp, this->pt_list_size[i]*sizeof(float)*this->NumberOfComps);
-    sub_ptr[msgGoingTo] += this->pt_list_size[i]*sizeof(float)*this->NumberOfComps;
-    values_tmp += this->pt_list_size[i]*this->NumberOfComps;
-    }
-  for (i = 0 ; i < this->rgrid_came_from.size() ; i++)
+  vtkIdType valIdx = 0;
+  for (i = 0 ; i < this->pt_list_came_from.size() + this->rgrid_came_from.size() ; i++)
     {
-    int msgGoingTo = this->rgrid_came_from[i];
-    int npts = this->rgrid_pts_size[3*i] * this->rgrid_pts_size[3*i+1] * this->rgrid_pts_size[3*i+2];
-    memcpy(sub_ptr[msgGoingTo], values_tmp, npts*sizeof(float)*this->NumberOfComps);
-    sub_ptr[msgGoingTo] += npts*sizeof(float)*this->NumberOfComps;
-    values_tmp += npts*this->NumberOfComps;
+    int nLists = this->pt_list_came_from.size();
+    int msgGoingTo;
+    vtkIdType npts;
+    if (i < nLists)
+      {
+      msgGoingTo = this->pt_list_came_from[i];
+      npts = this->pt_list_size[i];
+      }
+    else
+      {
+      msgGoingTo = this->rgrid_came_from[i-nLists];
+      npts = this->GetRGridSize(i-nLists);
+      }
+    for (vtkIdType n = 0 ; n < npts && recordSize > 0 ; n++, valIdx++)
+      {
+      this->PackRecord(valIdx, sub_ptr[msgGoingTo]);
+      sub_ptr[msgGoingTo] += recordSize;
+      }
     }
 
-  int *recvcount = new int[nProcs];
-#ifdef VTK_USE_MPI
-  MPI_Alltoall(sendcount, 1, MPI_INT, recvcount, 1, MPI_INT, *CMFEUtility::GetMPIComm());
-#endif
+  vtkIdType *recvcount = new vtkIdType[nProcs];
+  CMFEUtility::AllToAllCounts(sendcount, recvcount);
 
   char **recvmessages = new char*[nProcs];
   char *big_recv_msg = CMFEUtility::CreateMessageStrings(recvmessages, recvcount, nProcs);
 
-  int *senddisp  = new int[nProcs];
-  int *recvdisp  = new int[nProcs];
-  senddisp[0] = 0;
-  recvdisp[0] = 0;
-  for (j = 1 ; j < nProcs ; j++)
-    {
-    senddisp[j] = sendcount[j-1] + senddisp[j-1];
-    recvdisp[j] = recvcount[j-1] + recvdisp[j-1];
-    }
-#ifdef VTK_USE_MPI
-  MPI_Alltoallv(big_send_msg, sendcount, senddisp, MPI_CHAR,
-                big_recv_msg, recvcount, recvdisp, MPI_CHAR,
-                *CMFEUtility::GetMPIComm());
-#endif
+  CMFEUtility::AllToAllMessages(big_send_msg, sendcount, recvmessages, recvcount);
   delete [] sendcount;
-  delete [] senddisp;
+  delete [] big_send_msg;
+  delete [] sub_ptr;
 
 
   // Now put our point list back in order like it was never modified for
   // parallel reasons.
   this->pt_list = this->orig_pt_list;
   this->pt_list_size = this->orig_pt_list_size;
+  this->pt_list_borrowed = this->orig_pt_list_borrowed;
   this->orig_pt_list.clear();
   this->orig_pt_list_size.clear();
+  this->orig_pt_list_borrowed.clear();
   this->rgrid_pts = this->orig_rgrid_pts;
   this->rgrid_pts_size = this->orig_rgrid_pts_size;
   this->orig_rgrid_pts.clear();
@@ -839,32 +1042,27 @@ void vtkCMFEDesiredPoints::UnRelocatePoints( vtkCMFESpatialPartition *spat_part)
   // Now go through the recently sent messages and get the "this->Values" sent by
   // the other processors.  Encode them into a new "this->Values" array.
   //
-  int idx = 0;
+  vtkIdType idx = 0;
   for (i = 0 ; i < this->pt_list_size.size() ; i++)
     {
-    const int npts = this->pt_list_size[i];
+    const vtkIdType npts = this->pt_list_size[i];
     float *pts  = this->pt_list[i];
-    for (j = 0 ; j < npts ; j++)
+    for (vtkIdType n = 0 ; n < npts && recordSize > 0 ; n++)
       {
       float pt[3];
       pt[0] = *pts++;
       pt[1] = *pts++;
       pt[2] = *pts++;
       int proc = spat_part->GetProcessor(pt);
-      float *p = (float *) recvmessages[proc];
-      for (k = 0 ; k < this->NumberOfComps ; k++)
-        {
-        this->Values[idx++] = *p++;
-        }
-      recvmessages[proc] += sizeof(float)*this->NumberOfComps;
+      this->UnpackRecord(idx++, recvmessages[proc]);
+      recvmessages[proc] += recordSize;
       }
     }
   for (i = 0 ; i < this->NumberOfGrids ; i++) 
     {
     int realNX = this->rgrid_pts_size[3*i];
     int realNY = this->rgrid_pts_size[3*i+1];
-    int realNZ = this->rgrid_pts_size[3*i+2];
-    int npts = realNX * realNY * realNZ;
+    vtkIdType npts = this->GetRGridSize(i);
     vtkstd::vector<int> procId;
     vtkstd::vector<float> procBoundary;
     this->GetProcessorsForGrid(i, procId, procBoundary, spat_part);
@@ -881,7 +1079,7 @@ void vtkCMFEDesiredPoints::UnRelocatePoints( vtkCMFESpatialPartition *spat_part)
       // is is how much data that processor is sending us back.
       bool overlaps = this->GetSubgridForBoundary(i, bounds, extents);
       
-      if (!overlaps)
+      if (!overlaps || recordSize == 0)
         {
         continue;
         }
@@ -891,22 +1089,17 @@ void vtkCMFEDesiredPoints::UnRelocatePoints( vtkCMFESpatialPartition *spat_part)
           {
           for (int x = extents[0] ; x <= extents[1] ; x++)
             {
-            int valIDX = z*realNX*realNY + y*realNX + x;
-            float *p = (float *) recvmessages[procId[j]];
-            for (k = 0 ; k < this->NumberOfComps ; k++)
-              {
-              this->Values[idx + this->NumberOfComps*valIDX + k] = *p;
-              }
-            recvmessages[procId[j]] += sizeof(float)*this->NumberOfComps;
+            vtkIdType valIDX = idx + ((vtkIdType) z*realNY + y)*realNX + x;
+            this->UnpackRecord(valIDX, recvmessages[procId[j]]);
+            recvmessages[procId[j]] += recordSize;
             }
           }
         }
       }
-    idx += npts*this->NumberOfComps;
+    idx += npts;
     }
 
   delete [] recvmessages;
   delete [] big_recv_msg;
   delete [] recvcount;
-  delete [] recvdisp;
 }
\ No newline at end of file
@@ -22,6 +22,13 @@
 // example, this->pt_list and this->pt_list_size correspond to non-rectilinear grids,
 // while this->rgrid_pts and this->rgrid_pts_size correspond to rectilinear grids.
 // But this->TotalNumberOfValues corresponds to the total number of values across both.
+// Image data is stored the same way as rectilinear grids, so its points
+// only take the coordinates along each axis.  The point lists of
+// structured grids are built from their block structure, and nodal ones
+// with float points use the points of the grid in place.
+// Several variables can be sampled at once.  The values of each are stored
+// with the type that its output array will have, and a separate mask
+// records which points were found.
 // The thinking is that the interface for the class should be
 // generalized, except where having knowledge of rectilinear layout will
 // impact performance, such as is the case for pivot finding.  Of course,
@@ -78,20 +85,27 @@
 #ifndef __vtkCMFEDesiredPoints_h
 #define __vtkCMFEDesiredPoints_h
 
+#include <vtkType.h>
 #include <vtkstd/vector>
 
 class vtkCMFESpatialPartition;
 class vtkDataSet;
+class vtkStructuredGrid;
 
 
 class vtkCMFEDesiredPoints
 {
 public:
-  vtkCMFEDesiredPoints(bool, int);
+  vtkCMFEDesiredPoints(bool, int, int valueType = VTK_FLOAT);
   virtual ~vtkCMFEDesiredPoints();
 
   // Description:
-  // TODO: add support vtkImageData
+  // Adds another variable with nc components whose values are stored as
+  // valueType.  The constructor adds the first one, if nc is positive.
+  // Has to be called before Finalize.
+  void AddVariable(int nc, int valueType);
+
+  // Description:
   // Registers a dataset with the internal storage.
   void AddDataset(vtkDataSet *);
 
@@ -107,16 +121,54 @@ public:
 
   // Description:
   //Gets the next point in the sequence that should be sampled.
-  void GetPoint(int index, float *point) const;
+  void GetPoint(vtkIdType index, float *point) const;
 
   // Description:
-  //Sets the value of the 'n'th point.
-  void SetValue(int index, float *point);
+  //Sets the values of the n points starting at 'index', converting them to
+  //the value types, for the points whose entry of found is nonzero.  The
+  //values of a point are those of all the variables one after the other,
+  //GetNumberOfComponents() doubles in all.  The found mask of all n points
+  //is updated.
+  void SetValues(vtkIdType index, int n, const double *values,
+                 const unsigned char *found);
   
   // Description:
-  //Gets the value for an index, where the index is a convenient indexing
-  //scheme when iterating over the final datasets.
-  const float *GetValue(int, int) const;
+  //Gets the value of a variable for an index, where the index is a
+  //convenient indexing scheme when iterating over the final datasets.  The
+  //value is a tuple of the value type of the variable, or NULL if the point
+  //was not found.
+  const void *GetValue(int var, int ds, vtkIdType) const;
+
+  // Description:
+  //The variables, the total number of components of their values, and the
+  //VTK type and the size in bytes of a tuple of each.
+  int GetNumberOfVariables() const { return (int) this->VariableTypes.size(); };
+  int GetNumberOfComponents() const { return this->NumberOfComps; };
+  int GetValueType(int var) const { return this->VariableTypes[var]; };
+  int GetTupleSize(int var) const { return this->VariableTupleSizes[var]; };
+
+  // Description:
+  //Gives direct access to the points and values, so that they can be
+  //evaluated in batches without copying them point by point.  Datasets
+  //[0, GetNumberOfPointLists()) are lists of interleaved xyz points; the
+  //datasets after them are the rectilinear grids, in the order of GetRGrid.
+  //The values of a dataset start at tuple GetDataSetStart(ds) of
+  //GetValues(var), and are only meaningful where GetFoundMask() is nonzero.
+  //GetDataSetIndex gives the index of the dataset that was added by the
+  //given call to AddDataset, which differs when both kinds were added.
+  int GetNumberOfDatasets() const { return this->NumberOfDatasets; };
+  int GetNumberOfPointLists() const { return (int) this->pt_list.size(); };
+  const float *GetPointList(int ds) const { return this->pt_list[ds]; };
+  vtkIdType GetDataSetStart(int ds) const { return this->DataSetStartIndices[ds]; };
+  vtkIdType GetDataSetSize(int ds) const;
+  int GetDataSetIndex(int added) const;
+  void *GetValues(int var) { return this->Values[var]; };
+  unsigned char *GetFoundMask() { return this->Found; };
+
+  // Description:
+  //Fills pts with n interleaved xyz points of a rectilinear grid, starting
+  //at point 'start' of the grid.
+  void GetRGridPoints(int idx, vtkIdType start, int n, float *pts) const;
 
   // Description:
   //Relocates the points to different processors to create a spatial partition.
@@ -129,11 +181,11 @@ public:
 
   // Description:
   // Get the total number of values being stored.
-  int GetNumberOfPoints() { return this->TotalNumberOfValues; };
+  vtkIdType GetNumberOfPoints() { return this->TotalNumberOfValues; };
 
   // Description:
   //get where the grids start in the values.
-  int GetRGridStart()  { return this->GridStart; };
+  vtkIdType GetRGridStart()  { return this->GridStart; };
 
   // Description:
   //get the number of grids that have been added.
@@ -143,28 +195,67 @@ public:
 private:
   bool IsNodal;
   int NumberOfComps;
-  int TotalNumberOfValues;
+  int TupleSize;
+  vtkIdType TotalNumberOfValues;
   int NumberOfDatasets;
   int NumberOfGrids;
-  int GridStart;
+  vtkIdType GridStart;
 
-  int *MapToDataSets;
-  int *DataSetStartIndices;
-  float *Values;
+  vtkIdType *DataSetStartIndices;
+  unsigned char *Found;
   
   //BTX
+  vtkstd::vector<int> VariableComps;
+  vtkstd::vector<int> VariableTypes;
+  vtkstd::vector<int> VariableTupleSizes;
+  vtkstd::vector<char *> Values;
+
   vtkstd::vector<float *> pt_list;
-  vtkstd::vector<int>  pt_list_size;
+  vtkstd::vector<vtkIdType>  pt_list_size;
+  vtkstd::vector<bool> pt_list_borrowed;
   vtkstd::vector<float *> rgrid_pts;
   vtkstd::vector<int>  rgrid_pts_size;
   
   vtkstd::vector<float *> orig_pt_list;
-  vtkstd::vector<int>  orig_pt_list_size;
+  vtkstd::vector<vtkIdType>  orig_pt_list_size;
+  vtkstd::vector<bool> orig_pt_list_borrowed;
   vtkstd::vector<float *> orig_rgrid_pts;
   vtkstd::vector<int>  orig_rgrid_pts_size;
   vtkstd::vector<int>  pt_list_came_from;
   vtkstd::vector<int>  rgrid_came_from;
+
+  // Description:
+  //For each call to AddDataset, the point list it added, or minus one
+  //minus the rectilinear grid it added.
+  vtkstd::vector<int> AddedDatasets;
+
+  // Description:
+  //The datasets whose points are borrowed by point lists.
+  vtkstd::vector<vtkDataSet *> BorrowedFrom;
   //ETX
+
+  // Description:
+  //Adds the coordinates of n points along an axis of a rectilinear grid,
+  //or the centers between them for cell data.
+  void AddRGridAxis(const double *coords, int n);
+
+  // Description:
+  //Adds the points, or the cell centers, of a structured grid.
+  void AddStructuredGrid(vtkStructuredGrid *sgrid);
+
+  // Description:
+  //Frees the point lists that are not borrowed.
+  void DeletePointLists();
+
+  // Description:
+  //Frees the values of the variables.
+  void DeleteValues();
+
+  // Description:
+  //Copies the values of all variables and the found mask of a point to a
+  //record of TupleSize+1 bytes, or back from one.
+  void PackRecord(vtkIdType index, char *record) const;
+  void UnpackRecord(vtkIdType index, const char *record);
   
   // Description:
   //Uses the spatial partition to determine which processors a rectilinear
@@ -173,6 +264,10 @@ private:
 
   bool GetSubgridForBoundary(int, float *, int *);
 
+  // Description:
+  //Number of points of the rectilinear grid.
+  vtkIdType GetRGridSize(int grid) const;
+
   vtkCMFEDesiredPoints(const vtkCMFEDesiredPoints&);  // Not implemented.
   void operator=(const vtkCMFEDesiredPoints&);  // Not implemented.
 };  
@@ -52,219 +52,2062 @@
 *****************************************************************************/
 
 #include "vtkCMFEFastLookupGrouping.h"
+#include "vtkCMFECellKernels.h"
 
 
 
-#include "vtkAppendFilter.h"
 #include "vtkCell.h"
+#include "vtkCellArray.h"
 #include "vtkCellData.h"
-#include "vtkCharArray.h"
 #include "vtkCMFEIntervalTree.h"
+#include "vtkCMFEKdTree.h"
 #include "vtkCMFESpatialPartition.h"
 #include "vtkCMFEUtility.h"
 #include "vtkDataArray.h"
 #include "vtkDataSet.h"
+#include "vtkGenericCell.h"
 #include "vtkHexahedron.h"
+#include "vtkIdList.h"
+#include "vtkIdTypeArray.h"
+#include "vtkImageData.h"
 #include "vtkMultiProcessController.h"
+#include "vtkOutputWindow.h"
 #include "vtkPointData.h"
+#include "vtkPointSet.h"
 #include "vtkPoints.h"
+#include "vtkRectilinearGrid.h"
 #include "vtkUnsignedCharArray.h"
 #include "vtkUnstructuredGrid.h"
-#include "vtkUnstructuredGridReader.h"
-#include "vtkUnstructuredGridRelevantPointsFilter.h"
-#include "vtkUnstructuredGridWriter.h"
 
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <sstream>
+#include <vtkstd/algorithm>
+
+namespace
+{
+  // Number of points of a batch that are sorted along the Morton curve
+  // together.
+  const int mortonBlockSize = 16384;
+
+  //----------------------------------------------------------------------------
+  // Maps a coordinate to one of 1024 bins between lo and lo+1023/scale.
+  unsigned int Quantize(float v, float lo, float scale)
+  {
+    float q = (v - lo) * scale;
+    return (q <= 0.f ? 0 : (q >= 1023.f ? 1023 : (unsigned int) q));
+  }
+
+  //----------------------------------------------------------------------------
+  // Interpolates the point values of a cell with the given weights.
+  template <class T>
+  void InterpolateValues(const T *values, int nComps, const vtkIdType *ids,
+                         const double *weights, int nPts, double *val)
+  {
+    for (int c = 0 ; c < nComps ; c++)
+      {
+      double sum = 0.;
+      for (int pt = 0 ; pt < nPts ; pt++)
+        {
+        sum += weights[pt]*values[ids[pt]*nComps + c];
+        }
+      val[c] = sum;
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  void InterpolateValues(vtkDataArray *arr, int nComps, const vtkIdType *ids,
+                         const double *weights, int nPts, double *val)
+  {
+    for (int c = 0 ; c < nComps ; c++)
+      {
+      double sum = 0.;
+      for (int pt = 0 ; pt < nPts ; pt++)
+        {
+        sum += weights[pt]*arr->GetComponent(ids[pt], c);
+        }
+      val[c] = sum;
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // Adds the values of a point, or of a cell, times a weight.
+  template <class T>
+  void AddWeightedValues(const T *values, int nComps, vtkIdType index,
+                         double weight, double *val)
+  {
+    for (int c = 0 ; c < nComps ; c++)
+      {
+      val[c] += weight*values[index*nComps + c];
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  void AddWeightedValues(vtkDataArray *arr, int nComps, vtkIdType index,
+                         double weight, double *val)
+  {
+    for (int c = 0 ; c < nComps ; c++)
+      {
+      val[c] += weight*arr->GetComponent(index, c);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // Copies the values of a cell.
+  template <class T>
+  void CopyValues(const T *values, int nComps, vtkIdType index, double *val)
+  {
+    for (int c = 0 ; c < nComps ; c++)
+      {
+      val[c] = values[index*nComps + c];
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  void CopyValues(vtkDataArray *arr, int nComps, vtkIdType index, double *val)
+  {
+    for (int c = 0 ; c < nComps ; c++)
+      {
+      val[c] = arr->GetComponent(index, c);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // A mesh that RelocateDataUsingPartition sends to another processor is
+  // packed as this header, followed by its sections, each of which starts
+  // on an 8 byte boundary so that the receiver can use them in place:
+  //   points         NumberOfPoints*3 values of PointType
+  //   connectivity   ConnectivitySize vtkIdTypes, in vtkCellArray layout
+  //   locations      NumberOfCells vtkIdTypes
+  //   types          NumberOfCells unsigned chars
+  //   ghost zones    NumberOfCells unsigned chars, if HasGhostZones
+  //   arrays         the type and number of components of each sampled
+  //                  variable, as ints, followed by a section with the
+  //                  tuples of each variable whose type is not VTK_VOID
+  // A block of an axis aligned grid has BlockDimensions set, and instead of
+  // points and cells it has the coordinates of its points along each axis
+  // as doubles, which make up a single section.
+  // Ghost cells are left out of pieces, so only blocks, which must cover
+  // whole extents, have ghost zones, set to 1 for the ghost cells.
+  // All processors run the same build, so the byte order and the size of
+  // vtkIdType are the same everywhere.
+  struct MeshMessageHeader
+  {
+    vtkIdType Size;
+    vtkIdType NumberOfPoints;
+    vtkIdType NumberOfCells;
+    vtkIdType ConnectivitySize;
+    int PointType;
+    int NumberOfArrays;
+    int HasGhostZones;
+    int BlockDimensions[3];
+  };
+
+  //----------------------------------------------------------------------------
+  vtkIdType AlignedSize(vtkIdType size)
+  {
+    return (size + 7) & ~((vtkIdType) 7);
+  }
+
+  //----------------------------------------------------------------------------
+  // Points of types other than float and double are sent as doubles.
+  int GetWirePointType(vtkDataSet *mesh)
+  {
+    vtkPointSet *ps = vtkPointSet::SafeDownCast(mesh);
+    if (ps != NULL && ps->GetPoints() != NULL &&
+        ps->GetPoints()->GetDataType() == VTK_FLOAT)
+      {
+      return VTK_FLOAT;
+      }
+    return VTK_DOUBLE;
+  }
+
+  //----------------------------------------------------------------------------
+  // Arrays that can not be addressed by byte, such as bit arrays, are sent
+  // as doubles.
+  int GetWireValueType(vtkDataArray *arr)
+  {
+    if (arr == NULL)
+      {
+      return VTK_VOID;
+      }
+    switch (arr->GetDataType())
+      {
+      vtkTemplateMacro(return arr->GetDataType());
+      }
+    return VTK_DOUBLE;
+  }
+
+  //----------------------------------------------------------------------------
+  template <class T>
+  void PackPoints(vtkDataSet *mesh, int type,
+                  const vtkstd::vector<vtkIdType> &ids, T *out)
+  {
+    vtkPointSet *ps = vtkPointSet::SafeDownCast(mesh);
+    vtkPoints *pts = (ps != NULL ? ps->GetPoints() : NULL);
+    if (pts != NULL && pts->GetDataType() == type)
+      {
+      const T *in = static_cast<const T *>(pts->GetVoidPointer(0));
+      for (size_t i = 0 ; i < ids.size() ; i++)
+        {
+        memcpy(out + 3*i, in + 3*ids[i], 3*sizeof(T));
+        }
+      return;
+      }
+    for (size_t i = 0 ; i < ids.size() ; i++)
+      {
+      double x[3];
+      mesh->GetPoint(ids[i], x);
+      out[3*i]   = static_cast<T>(x[0]);
+      out[3*i+1] = static_cast<T>(x[1]);
+      out[3*i+2] = static_cast<T>(x[2]);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  void PackTuples(vtkDataArray *arr, int type,
+                  const vtkstd::vector<vtkIdType> &ids, char *out)
+  {
+    int nComps = arr->GetNumberOfComponents();
+    if (type == arr->GetDataType())
+      {
+      size_t tupleSize = nComps * vtkDataArray::GetDataTypeSize(type);
+      const char *in = static_cast<const char *>(arr->GetVoidPointer(0));
+      for (size_t i = 0 ; i < ids.size() ; i++)
+        {
+        memcpy(out + i*tupleSize, in + ids[i]*tupleSize, tupleSize);
+        }
+      return;
+      }
+    double *values = reinterpret_cast<double *>(out);
+    for (size_t i = 0 ; i < ids.size() ; i++)
+      {
+      for (int c = 0 ; c < nComps ; c++)
+        {
+        values[i*nComps + c] = arr->GetComponent(ids[i], c);
+        }
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // Wraps nValues values of a received message into a new data array of the
+  // given type without copying them.  The message has to outlive the array.
+  vtkDataArray *WrapArray(int type, int nComps, char *ptr, vtkIdType nValues)
+  {
+    vtkDataArray *arr = vtkDataArray::CreateDataArray(type);
+    arr->SetNumberOfComponents(nComps);
+    arr->SetVoidArray(ptr, nValues, 1);
+    return arr;
+  }
+
+  //----------------------------------------------------------------------------
+  // The tag of the messages that carry relocated meshes.
+  const int relocationTag = 8811;
+
+  //----------------------------------------------------------------------------
+  // A sampled variable of a mesh and its wire type, which is VTK_VOID if the
+  // mesh does not have it.
+  struct WireArray
+  {
+    vtkDataArray *Array;
+    int ValueType;
+    int NumberOfComponents;
+  };
+
+  //----------------------------------------------------------------------------
+  // How the meshes of a processor are sent: the wire types of the points and
+  // of the variables, and the arrays that go along with the cells.
+  // Image data and rectilinear grids are sent in blocks, for which the
+  // dimensions and the coordinates along each axis of the whole mesh are
+  // kept.
+  struct MeshWireInfo
+  {
+    int PointType;
+    vtkstd::vector<WireArray> Arrays;
+    const unsigned char *Ghosts;
+    unsigned char GhostMask;
+    bool Block;
+    int Dimensions[3];
+    vtkstd::vector<double> Coordinates[3];
+  };
+
+  //----------------------------------------------------------------------------
+  // The cells of one mesh that go to one processor in one message, and the
+  // points they use.  A block is given by the extent of its cells instead.
+  struct MeshPiece
+  {
+    int Mesh;
+    vtkstd::vector<vtkIdType> Cells;
+    vtkstd::vector<vtkIdType> Points;
+    vtkIdType ConnectivitySize;
+    int CellExtent[6];
+  };
+
+  //----------------------------------------------------------------------------
+  // The number of bytes the variables of a piece with the given number of
+  // points and cells take in a message.
+  vtkIdType ArraysMessageSize(vtkIdType nPts, vtkIdType nCells,
+                              const MeshWireInfo &info, bool isNodal)
+  {
+    vtkIdType size = AlignedSize(2*info.Arrays.size()*sizeof(int));
+    for (size_t i = 0 ; i < info.Arrays.size() ; i++)
+      {
+      const WireArray &wa = info.Arrays[i];
+      if (wa.Array != NULL)
+        {
+        size += AlignedSize((isNodal ? nPts : nCells)*wa.NumberOfComponents*
+                            vtkDataArray::GetDataTypeSize(wa.ValueType));
+        }
+      }
+    return size;
+  }
+
+  //----------------------------------------------------------------------------
+  // Packs the variables of the points or cells with the given ids at
+  // section, and returns the end of what was packed.
+  char *PackArrays(const MeshWireInfo &info,
+                   const vtkstd::vector<vtkIdType> &ids, char *section)
+  {
+    int *table = reinterpret_cast<int *>(section);
+    section += AlignedSize(2*info.Arrays.size()*sizeof(int));
+    for (size_t i = 0 ; i < info.Arrays.size() ; i++)
+      {
+      const WireArray &wa = info.Arrays[i];
+      table[2*i] = wa.ValueType;
+      table[2*i+1] = wa.NumberOfComponents;
+      if (wa.Array != NULL)
+        {
+        PackTuples(wa.Array, wa.ValueType, ids, section);
+        section += AlignedSize((vtkIdType) ids.size()*wa.NumberOfComponents*
+                               vtkDataArray::GetDataTypeSize(wa.ValueType));
+        }
+      }
+    return section;
+  }
+
+  //----------------------------------------------------------------------------
+  // The number of bytes a piece with the given number of points, cells and
+  // connectivity entries takes in a message.
+  vtkIdType MessageSize(vtkIdType nPts, vtkIdType nCells,
+                        vtkIdType connectivitySize, const MeshWireInfo &info,
+                        bool isNodal)
+  {
+    vtkIdType size = AlignedSize(sizeof(MeshMessageHeader)) +
+      AlignedSize(3*nPts*vtkDataArray::GetDataTypeSize(info.PointType)) +
+      AlignedSize(connectivitySize*sizeof(vtkIdType)) +
+      AlignedSize(nCells*sizeof(vtkIdType)) +
+      AlignedSize(nCells);
+    size += ArraysMessageSize(nPts, nCells, info, isNodal);
+    return size;
+  }
+
+  //----------------------------------------------------------------------------
+  // The number of points along each axis of a block with the given cells.
+  void GetBlockDimensions(const MeshWireInfo &info, const int cellExtent[6],
+                          int dims[3])
+  {
+    for (int a = 0 ; a < 3 ; a++)
+      {
+      dims[a] = (info.Dimensions[a] == 1 ? 1 :
+                 cellExtent[2*a+1] - cellExtent[2*a] + 2);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // The number of bytes a block with the given cells takes in a message.
+  vtkIdType BlockMessageSize(const int cellExtent[6],
+                             const MeshWireInfo &info, bool isNodal)
+  {
+    int dims[3];
+    GetBlockDimensions(info, cellExtent, dims);
+    vtkIdType nPts = (vtkIdType) dims[0]*dims[1]*dims[2];
+    vtkIdType nCells = (vtkIdType) (cellExtent[1]-cellExtent[0]+1)*
+      (cellExtent[3]-cellExtent[2]+1)*(cellExtent[5]-cellExtent[4]+1);
+    vtkIdType size = AlignedSize(sizeof(MeshMessageHeader)) +
+      AlignedSize((dims[0]+dims[1]+dims[2])*sizeof(double));
+    if (info.Ghosts != NULL)
+      {
+      size += AlignedSize(nCells);
+      }
+    size += ArraysMessageSize(nPts, nCells, info, isNodal);
+    return size;
+  }
+
+  //----------------------------------------------------------------------------
+  // Each processor gets the smallest block of an axis aligned grid that
+  // holds all the cells it needs, so that it receives an axis aligned grid
+  // again.  The block is split along its outermost axis into pieces that
+  // fit in the limit.
+  void AddBlockPieces(int mesh, const MeshWireInfo &info, bool isNodal,
+                      vtkCMFESpatialPartition *spat_part, double margin,
+                      vtkIdType pieceLimit,
+                      vtkstd::vector<vtkstd::vector<MeshPiece> > &pieces)
+  {
+    int nProcs = (int) pieces.size();
+    int cellDims[3];
+    int a;
+    for (a = 0 ; a < 3 ; a++)
+      {
+      cellDims[a] = (info.Dimensions[a] > 1 ? info.Dimensions[a]-1 : 1);
+      }
+    vtkstd::vector<int> boxes(6*nProcs);
+    for (int p = 0 ; p < nProcs ; p++)
+      {
+      for (a = 0 ; a < 3 ; a++)
+        {
+        boxes[6*p+2*a] = cellDims[a];
+        boxes[6*p+2*a+1] = -1;
+        }
+      }
+
+    // The cell bounds come straight from the coordinates along each axis.
+    vtkstd::vector<int> list;
+    double bounds[6];
+    int ijk[3];
+    for (ijk[2] = 0 ; ijk[2] < cellDims[2] ; ijk[2]++)
+      {
+      for (ijk[1] = 0 ; ijk[1] < cellDims[1] ; ijk[1]++)
+        {
+        for (ijk[0] = 0 ; ijk[0] < cellDims[0] ; ijk[0]++)
+          {
+          for (a = 0 ; a < 3 ; a++)
+            {
+            const vtkstd::vector<double> &c = info.Coordinates[a];
+            double lo = c[ijk[a]];
+            double hi = (info.Dimensions[a] > 1 ? c[ijk[a]+1] : lo);
+            bounds[2*a] = vtkstd::min(lo, hi) - margin;
+            bounds[2*a+1] = vtkstd::max(lo, hi) + margin;
+            }
+          spat_part->GetProcessorList(bounds, list);
+          for (size_t l = 0 ; l < list.size() ; l++)
+            {
+            int *box = &boxes[6*list[l]];
+            for (a = 0 ; a < 3 ; a++)
+              {
+              box[2*a] = vtkstd::min(box[2*a], ijk[a]);
+              box[2*a+1] = vtkstd::max(box[2*a+1], ijk[a]);
+              }
+            }
+          }
+        }
+      }
+
+    for (int p = 0 ; p < nProcs ; p++)
+      {
+      const int *box = &boxes[6*p];
+      if (box[1] < 0)
+        {
+        continue;
+        }
+      int axis = 2;
+      while (axis > 0 && box[2*axis] == box[2*axis+1])
+        {
+        axis--;
+        }
+      int first = box[2*axis];
+      while (first <= box[2*axis+1])
+        {
+        pieces[p].push_back(MeshPiece());
+        MeshPiece &piece = pieces[p].back();
+        piece.Mesh = mesh;
+        piece.ConnectivitySize = 0;
+        for (a = 0 ; a < 6 ; a++)
+          {
+          piece.CellExtent[a] = box[a];
+          }
+        int last = box[2*axis+1];
+        for (;;)
+          {
+          piece.CellExtent[2*axis] = first;
+          piece.CellExtent[2*axis+1] = last;
+          if (last == first ||
+              BlockMessageSize(piece.CellExtent, info, isNodal) <= pieceLimit)
+            {
+            break;
+            }
+          last = first + (last - first) / 2;
+          }
+        first = last + 1;
+        }
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // Packs a block of an axis aligned grid at ptr and returns the number of
+  // bytes used.
+  vtkIdType PackBlock(const MeshPiece &piece, const MeshWireInfo &info,
+                      bool isNodal, char *ptr)
+  {
+    const int *ext = piece.CellExtent;
+    int dims[3];
+    GetBlockDimensions(info, ext, dims);
+
+    MeshMessageHeader *header = reinterpret_cast<MeshMessageHeader *>(ptr);
+    header->NumberOfPoints = (vtkIdType) dims[0]*dims[1]*dims[2];
+    header->NumberOfCells = (vtkIdType) (ext[1]-ext[0]+1)*
+      (ext[3]-ext[2]+1)*(ext[5]-ext[4]+1);
+    header->ConnectivitySize = 0;
+    header->PointType = VTK_DOUBLE;
+    header->NumberOfArrays = (int) info.Arrays.size();
+    header->HasGhostZones = (info.Ghosts != NULL ? 1 : 0);
+    char *section = ptr + AlignedSize(sizeof(MeshMessageHeader));
+
+    double *coords = reinterpret_cast<double *>(section);
+    int a;
+    for (a = 0 ; a < 3 ; a++)
+      {
+      header->BlockDimensions[a] = dims[a];
+      for (int i = 0 ; i < dims[a] ; i++)
+        {
+        *coords++ = info.Coordinates[a][ext[2*a] + i];
+        }
+      }
+    section += AlignedSize((dims[0]+dims[1]+dims[2])*sizeof(double));
+
+    // The ids of the cells, and of the points, of the block in the mesh.
+    vtkstd::vector<vtkIdType> ids;
+    ids.reserve(header->NumberOfCells);
+    int ijk[3];
+    for (ijk[2] = ext[4] ; ijk[2] <= ext[5] ; ijk[2]++)
+      {
+      for (ijk[1] = ext[2] ; ijk[1] <= ext[3] ; ijk[1]++)
+        {
+        for (ijk[0] = ext[0] ; ijk[0] <= ext[1] ; ijk[0]++)
+          {
+          ids.push_back(CMFECellKernels::CellIndex(info.Dimensions, ijk));
+          }
+        }
+      }
+    if (info.Ghosts != NULL)
+      {
+      for (size_t c = 0 ; c < ids.size() ; c++)
+        {
+        section[c] = ((info.Ghosts[ids[c]] & info.GhostMask) != 0 ? 1 : 0);
+        }
+      section += AlignedSize(header->NumberOfCells);
+      }
+    if (isNodal)
+      {
+      const vtkIdType nx = info.Dimensions[0];
+      const vtkIdType ny = info.Dimensions[1];
+      ids.clear();
+      for (int k = 0 ; k < dims[2] ; k++)
+        {
+        for (int j = 0 ; j < dims[1] ; j++)
+          {
+          for (int i = 0 ; i < dims[0] ; i++)
+            {
+            ids.push_back(ext[0] + i + nx*(ext[2] + j + ny*(ext[4] + k)));
+            }
+          }
+        }
+      }
+    section = PackArrays(info, ids, section);
+
+    header->Size = (vtkIdType) (section - ptr);
+    return header->Size;
+  }
+
+  //----------------------------------------------------------------------------
+  // Packs a piece of a mesh at ptr and returns the number of bytes used.
+  // pointMap has to be -1 for every point of the mesh, and is again on
+  // return.
+  vtkIdType PackPiece(vtkDataSet *mesh, const MeshPiece &piece,
+                      const MeshWireInfo &info, bool isNodal,
+                      vtkstd::vector<vtkIdType> &pointMap, vtkIdList *ptIds,
+                      char *ptr)
+  {
+    vtkIdType nPts = (vtkIdType) piece.Points.size();
+    vtkIdType nCells = (vtkIdType) piece.Cells.size();
+
+    MeshMessageHeader *header = reinterpret_cast<MeshMessageHeader *>(ptr);
+    header->NumberOfPoints = nPts;
+    header->NumberOfCells = nCells;
+    header->ConnectivitySize = piece.ConnectivitySize;
+    header->PointType = info.PointType;
+    header->NumberOfArrays = (int) info.Arrays.size();
+    header->HasGhostZones = 0;
+    header->BlockDimensions[0] = 0;
+    header->BlockDimensions[1] = 0;
+    header->BlockDimensions[2] = 0;
+    char *section = ptr + AlignedSize(sizeof(MeshMessageHeader));
+
+    if (info.PointType == VTK_FLOAT)
+      {
+      PackPoints(mesh, VTK_FLOAT, piece.Points,
+                 reinterpret_cast<float *>(section));
+      }
+    else
+      {
+      PackPoints(mesh, VTK_DOUBLE, piece.Points,
+                 reinterpret_cast<double *>(section));
+      }
+    section += AlignedSize(
+      3*nPts*vtkDataArray::GetDataTypeSize(info.PointType));
+
+    vtkIdType *connectivity = reinterpret_cast<vtkIdType *>(section);
+    section += AlignedSize(piece.ConnectivitySize*sizeof(vtkIdType));
+    vtkIdType *locations = reinterpret_cast<vtkIdType *>(section);
+    section += AlignedSize(nCells*sizeof(vtkIdType));
+    unsigned char *types = reinterpret_cast<unsigned char *>(section);
+    section += AlignedSize(nCells);
+
+    vtkIdType p;
+    for (p = 0 ; p < nPts ; p++)
+      {
+      pointMap[piece.Points[p]] = p;
+      }
+    vtkIdType loc = 0;
+    for (vtkIdType c = 0 ; c < nCells ; c++)
+      {
+      mesh->GetCellPoints(piece.Cells[c], ptIds);
+      vtkIdType nIds = ptIds->GetNumberOfIds();
+      locations[c] = loc;
+      connectivity[loc++] = nIds;
+      for (vtkIdType i = 0 ; i < nIds ; i++)
+        {
+        connectivity[loc++] = pointMap[ptIds->GetId(i)];
+        }
+      types[c] = (unsigned char) mesh->GetCellType(piece.Cells[c]);
+      }
+    for (p = 0 ; p < nPts ; p++)
+      {
+      pointMap[piece.Points[p]] = -1;
+      }
+
+    section = PackArrays(info, (isNodal ? piece.Points : piece.Cells),
+                         section);
+
+    header->Size = (vtkIdType) (section - ptr);
+    return header->Size;
+  }
+
+  //----------------------------------------------------------------------------
+  // Wraps the ghost zones and the values of a piece, which start at
+  // section, into arrays of the mesh.  The variables are named after
+  // varNames, in order.
+  void UnpackArrays(const MeshMessageHeader *header, char *section,
+                    bool isNodal, const vtkstd::vector<vtkStdString> &varNames,
+                    vtkDataSet *mesh)
+  {
+    vtkIdType nCells = header->NumberOfCells;
+    if (header->HasGhostZones)
+      {
+      vtkUnsignedCharArray *ghostZones = vtkUnsignedCharArray::New();
+      ghostZones->SetArray(reinterpret_cast<unsigned char *>(section),
+                           nCells, 1);
+      ghostZones->SetName("avtGhostZones");
+      mesh->GetCellData()->AddArray(ghostZones);
+      ghostZones->Delete();
+      section += AlignedSize(nCells);
+      }
+    const int *table = reinterpret_cast<const int *>(section);
+    section += AlignedSize(2*header->NumberOfArrays*sizeof(int));
+    for (int i = 0 ; i < header->NumberOfArrays ; i++)
+      {
+      int type = table[2*i];
+      int nComps = table[2*i+1];
+      if (type == VTK_VOID)
+        {
+        continue;
+        }
+      vtkIdType nValues = (isNodal ? header->NumberOfPoints : nCells) * nComps;
+      vtkDataArray *arr = WrapArray(type, nComps, section, nValues);
+      section += AlignedSize(nValues*vtkDataArray::GetDataTypeSize(type));
+      arr->SetName(varNames[i].c_str());
+      if (isNodal)
+        {
+        mesh->GetPointData()->AddArray(arr);
+        }
+      else
+        {
+        mesh->GetCellData()->AddArray(arr);
+        }
+      arr->Delete();
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // Wraps the block at ptr into a rectilinear grid without copying it.
+  // The message has to outlive the grid.
+  vtkRectilinearGrid *UnpackBlock(char *ptr, bool isNodal,
+    const vtkstd::vector<vtkStdString> &varNames)
+  {
+    MeshMessageHeader *header = reinterpret_cast<MeshMessageHeader *>(ptr);
+    const int *dims = header->BlockDimensions;
+    char *section = ptr + AlignedSize(sizeof(MeshMessageHeader));
+
+    vtkRectilinearGrid *rgrid = vtkRectilinearGrid::New();
+    rgrid->SetDimensions(dims[0], dims[1], dims[2]);
+    vtkDataArray *coords[3];
+    char *c = section;
+    for (int a = 0 ; a < 3 ; a++)
+      {
+      coords[a] = WrapArray(VTK_DOUBLE, 1, c, dims[a]);
+      c += dims[a]*sizeof(double);
+      }
+    rgrid->SetXCoordinates(coords[0]);
+    rgrid->SetYCoordinates(coords[1]);
+    rgrid->SetZCoordinates(coords[2]);
+    for (int a = 0 ; a < 3 ; a++)
+      {
+      coords[a]->Delete();
+      }
+    section += AlignedSize((dims[0]+dims[1]+dims[2])*sizeof(double));
+
+    UnpackArrays(header, section, isNodal, varNames, rgrid);
+    return rgrid;
+  }
+
+  //----------------------------------------------------------------------------
+  // Wraps the piece at ptr into an unstructured grid, or a rectilinear grid
+  // if it is a block, without copying it.  The message has to outlive the
+  // grid.
+  vtkDataSet *UnpackPiece(char *ptr, bool isNodal,
+                          const vtkstd::vector<vtkStdString> &varNames)
+  {
+    MeshMessageHeader *header = reinterpret_cast<MeshMessageHeader *>(ptr);
+    if (header->BlockDimensions[0] > 0)
+      {
+      return UnpackBlock(ptr, isNodal, varNames);
+      }
+    vtkIdType nPts = header->NumberOfPoints;
+    vtkIdType nCells = header->NumberOfCells;
+    char *section = ptr + AlignedSize(sizeof(MeshMessageHeader));
+
+    vtkUnstructuredGrid *ugrid = vtkUnstructuredGrid::New();
+    vtkDataArray *coords = WrapArray(header->PointType, 3, section, 3*nPts);
+    section += AlignedSize(
+      3*nPts*vtkDataArray::GetDataTypeSize(header->PointType));
+    vtkPoints *pts = vtkPoints::New();
+    pts->SetData(coords);
+    ugrid->SetPoints(pts);
+    pts->Delete();
+    coords->Delete();
+
+    vtkIdTypeArray *connectivity = vtkIdTypeArray::New();
+    connectivity->SetArray(reinterpret_cast<vtkIdType *>(section),
+                           header->ConnectivitySize, 1);
+    section += AlignedSize(header->ConnectivitySize*sizeof(vtkIdType));
+    vtkIdTypeArray *locations = vtkIdTypeArray::New();
+    locations->SetArray(reinterpret_cast<vtkIdType *>(section), nCells, 1);
+    section += AlignedSize(nCells*sizeof(vtkIdType));
+    vtkUnsignedCharArray *types = vtkUnsignedCharArray::New();
+    types->SetArray(reinterpret_cast<unsigned char *>(section), nCells, 1);
+    section += AlignedSize(nCells);
+    vtkCellArray *cells = vtkCellArray::New();
+    cells->SetCells(nCells, connectivity);
+    ugrid->SetCells(types, locations, cells);
+    cells->Delete();
+    types->Delete();
+    locations->Delete();
+    connectivity->Delete();
+
+    UnpackArrays(header, section, isNodal, varNames, ugrid);
+    return ugrid;
+  }
+
+  //----------------------------------------------------------------------------
+  // Computes the bounds of every cell of a grid straight from its points and
+  // connectivity, six values per cell.
+  template<class T>
+  void ComputeCellBounds(const T *coords, const vtkIdType *connectivity,
+                         vtkIdType nCells, double *bounds)
+  {
+    for (vtkIdType c = 0 ; c < nCells ; c++, bounds += 6)
+      {
+      vtkIdType nIds = *connectivity++;
+      bounds[0] = bounds[2] = bounds[4] = VTK_DOUBLE_MAX;
+      bounds[1] = bounds[3] = bounds[5] = -VTK_DOUBLE_MAX;
+      for (vtkIdType i = 0 ; i < nIds ; i++)
+        {
+        const T *pt = coords + 3*(*connectivity++);
+        for (int k = 0 ; k < 3 ; k++)
+          {
+          bounds[2*k] = vtkstd::min(bounds[2*k], (double) pt[k]);
+          bounds[2*k+1] = vtkstd::max(bounds[2*k+1], (double) pt[k]);
+          }
+        }
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  void ComputeCellBounds(vtkUnstructuredGrid *ugrid,
+                         vtkstd::vector<double> &bounds)
+  {
+    vtkIdType nCells = ugrid->GetNumberOfCells();
+    bounds.resize(6*nCells);
+    if (nCells == 0)
+      {
+      return;
+      }
+    vtkDataArray *coords = ugrid->GetPoints()->GetData();
+    const vtkIdType *connectivity = ugrid->GetCells()->GetPointer();
+    if (coords->GetDataType() == VTK_FLOAT)
+      {
+      ComputeCellBounds(static_cast<const float *>(coords->GetVoidPointer(0)),
+                        connectivity, nCells, &bounds[0]);
+      }
+    else
+      {
+      ComputeCellBounds(static_cast<const double *>(coords->GetVoidPointer(0)),
+                        connectivity, nCells, &bounds[0]);
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // Wraps every piece of a received message into a grid, and computes the
+  // bounds of the cells of the unstructured ones.
+  void UnpackMessage(char *msg, vtkIdType size, bool isNodal,
+                     const vtkstd::vector<vtkStdString> &varNames,
+                     vtkstd::vector<vtkDataSet *> &grids,
+                     vtkstd::vector<vtkstd::vector<double> > &bounds)
+  {
+    char *ptr = msg;
+    while (ptr < msg + size)
+      {
+      grids.push_back(UnpackPiece(ptr, isNodal, varNames));
+      bounds.push_back(vtkstd::vector<double>());
+      vtkUnstructuredGrid *ugrid =
+        vtkUnstructuredGrid::SafeDownCast(grids.back());
+      if (ugrid != NULL)
+        {
+        ComputeCellBounds(ugrid, bounds.back());
+        }
+      ptr += reinterpret_cast<MeshMessageHeader *>(ptr)->Size;
+      }
+  }
+}
 
 //----------------------------------------------------------------------------
 vtkCMFEFastLookupGrouping::vtkCMFEFastLookupGrouping(vtkStdString v,
                                                              bool isN)
 {
-  this->VarName   = v;
+  this->VarNames.push_back(v);
   this->IsNodal   = isN;
   this->IntervalTree     = NULL;
+  this->NumberOfTreeZones = 0;
   this->MapToDataSet = NULL;
+  this->NumberOfTreeElements = 0;
+  this->TreeElements = NULL;
   this->DataSetStart  = NULL;
+  this->RelocationMemoryBudget = 0;
+  this->FallbackTolerance = 0.;
+  this->Interpolation = CELL_CONTAINMENT;
+  this->NumberOfNeighbors = 8;
+  this->Radius = 0.;
+  this->NumberOfThreads = 0;
+  this->PointTree = NULL;
+  this->State = new SearchState;
+}
+
+//----------------------------------------------------------------------------
+vtkCMFEFastLookupGrouping::SearchState::SearchState()
+{
+  this->Cell = vtkGenericCell::New();
+  this->NeighborIds = vtkIdList::New();
+  this->LastCell = -1;
+  this->Record = false;
+  this->RecordedMesh = -1;
+  this->NumberOfPointsLocated = 0;
+  this->NumberOfPointsNearest = 0;
+  this->NumberOfPointsMissed = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkCMFEFastLookupGrouping::SearchState::~SearchState()
+{
+  this->Cell->Delete();
+  this->NeighborIds->Delete();
+}
+
+//----------------------------------------------------------------------------
+vtkCMFEFastLookupGrouping::~vtkCMFEFastLookupGrouping()
+{
+  this->ClearAllInputMeshes();
+  delete this->State;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::SetVariable(const vtkStdString &v, bool isN)
+{
+  this->SetVariables(vtkstd::vector<vtkStdString>(1, v), isN);
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::SetVariables(
+  const vtkstd::vector<vtkStdString> &v, bool isN)
+{
+  // The kd-tree of the point modes holds either the points or the cell
+  // centers, so it has to be rebuilt when the centering changes.
+  if (this->PointTree != NULL && isN != this->IsNodal)
+    {
+    this->ReleaseSearchStructure();
+    }
+  this->VarNames = v;
+  this->IsNodal = isN;
+  if (this->IsFinalized())
+    {
+    this->PrepareSamplingContexts();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::SetInterpolation(int mode)
+{
+  if ((mode == CELL_CONTAINMENT) != (this->Interpolation == CELL_CONTAINMENT))
+    {
+    this->ReleaseSearchStructure();
+    }
+  this->Interpolation = mode;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::AddMesh(vtkDataSet *mesh)
+{
+   // A new mesh invalidates any search structure built so far.
+   this->ReleaseSearchStructure();
+   mesh->Register(NULL);
+   this->Meshes.push_back(mesh);
+   this->CellBounds.push_back(vtkstd::vector<double>());
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::ReleaseSearchStructure(void)
+{
+  delete this->IntervalTree;
+  delete this->PointTree;
+  delete [] this->MapToDataSet;
+  delete [] this->TreeElements;
+  delete [] this->DataSetStart;
+  this->IntervalTree = NULL;
+  this->PointTree = NULL;
+  this->TupleStart.clear();
+  this->NumberOfTreeZones = 0;
+  this->MapToDataSet = NULL;
+  this->NumberOfTreeElements = 0;
+  this->TreeElements = NULL;
+  this->DataSetStart = NULL;
+  this->AxisGrids.clear();
+  this->State->LastCell = -1;
+  this->State->List.clear();
+  this->Contexts.clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::ClearAllInputMeshes(void)
+{
+  this->ReleaseSearchStructure();
+  for (int i = 0 ; i < this->Meshes.size() ; i++)
+    {
+    this->Meshes[i]->Delete();
+    }
+  this->Meshes.clear();
+  this->CellBounds.clear();
+  for (int i = 0 ; i < this->MessageBuffers.size() ; i++)
+    {
+    delete [] this->MessageBuffers[i];
+    }
+  this->MessageBuffers.clear();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFEFastLookupGrouping::Finalize(void)
+{
+  int   i, j;
+  int   index = 0;
+
+  // The interval tree only depends on the geometry of the meshes, so if it
+  // has already been built for the current set of meshes we can reuse it.
+  // The arrays may have changed since then though.
+  if (this->IsFinalized())
+    {
+    this->PrepareSamplingContexts();
+    return true;
+    }
+  if (this->Interpolation != CELL_CONTAINMENT)
+    {
+    this->BuildPointTree();
+    this->PrepareSamplingContexts();
+    return true;
+    }
+
+  // Image data and rectilinear grids stay out of the interval tree.  The
+  // cells of the other meshes are numbered first, so that the elements of
+  // the tree are the first NumberOfTreeZones elements.
+  int nMeshes = (int) this->Meshes.size();
+  vtkstd::vector<bool> isAxisGrid(nMeshes, false);
+  for (i = 0 ; i < nMeshes ; i++)
+    {
+    AxisAlignedGrid grid;
+    if (this->GetAxisAlignedGrid(this->Meshes[i], grid))
+      {
+      grid.Mesh = i;
+      this->AxisGrids.push_back(grid);
+      isAxisGrid[i] = true;
+      }
+    }
+
+  // Elements are 32 bit ids, so the cells a single processor searches are
+  // limited to what those can address.  The relocation spreads the cells
+  // over all processors, so only the share of one processor counts.
+  vtkIdType nZones = 0;
+  for (i = 0 ; i < nMeshes ; i++)
+    {
+    nZones += this->Meshes[i]->GetNumberOfCells();
+    }
+  if (nZones > VTK_INT_MAX)
+    {
+    std::ostringstream msg;
+    msg << "A processor has " << nZones << " cells to search, more than the "
+        << VTK_INT_MAX << " the interval tree can index.  Run on more "
+        << "processors.";
+    vtkOutputWindowDisplayErrorText(msg.str().c_str());
+    this->AxisGrids.clear();
+    return false;
+    }
+
+  nZones = 0;
+  this->DataSetStart = new int[nMeshes];
+  for (int pass = 0 ; pass < 2 ; pass++)
+    {
+    for (i = 0 ; i < nMeshes ; i++)
+      {
+      if (isAxisGrid[i] == (pass == 1))
+        {
+        this->DataSetStart[i] = (int) nZones;
+        nZones += this->Meshes[i]->GetNumberOfCells();
+        }
+      }
+    if (pass == 0)
+      {
+      this->NumberOfTreeZones = (int) nZones;
+      }
+    }
+  this->NumberOfZones = (int) nZones;
+
+  // Ghost cells belong to another piece, which samples them, so they stay
+  // out of the tree.  They are still numbered, since they may neighbor
+  // the cells of the tree.
+  vtkstd::vector<const unsigned char *> ghosts(nMeshes, NULL);
+  vtkstd::vector<unsigned char> ghostMasks(nMeshes, 0);
+  int nTreeElements = this->NumberOfTreeZones;
+  for (i = 0 ; i < nMeshes ; i++)
+    {
+    if (isAxisGrid[i])
+      {
+      continue;
+      }
+    ghosts[i] = CMFEUtility::GetGhostCells(this->Meshes[i], ghostMasks[i]);
+    int nCells = this->Meshes[i]->GetNumberOfCells();
+    for (j = 0 ; ghosts[i] != NULL && j < nCells ; j++)
+      {
+      nTreeElements -= ((ghosts[i][j] & ghostMasks[i]) != 0 ? 1 : 0);
+      }
+    }
+  this->NumberOfTreeElements = nTreeElements;
+  if (nTreeElements < this->NumberOfTreeZones)
+    {
+    this->TreeElements = new int[vtkstd::max(nTreeElements, 1)];
+    }
+
+  bool degenerate = (nTreeElements == 0);
+  this->IntervalTree = new vtkCMFEIntervalTree(degenerate ? 1 : nTreeElements,
+    3, true, vtkCMFEIntervalTree::FLAT_LAYOUT);
+  this->MapToDataSet = new int[vtkstd::max(this->NumberOfTreeZones, 1)];
+  int treeElement = 0;
+  for (i = 0 ; i < nMeshes ; i++)
+    {
+    if (isAxisGrid[i])
+      {
+      vtkstd::vector<double>().swap(this->CellBounds[i]);
+      continue;
+      }
+    index = this->DataSetStart[i];
+    int nCells = this->Meshes[i]->GetNumberOfCells();
+    // The bounds of the cells of relocated meshes were already computed as
+    // their messages arrived.
+    vtkstd::vector<double> &cellBounds = this->CellBounds[i];
+    bool haveBounds = (cellBounds.size() == 6*(size_t) nCells);
+    for (j = 0 ; j < nCells ; j++, index++)
+      {
+      this->MapToDataSet[index] = i;
+      if (ghosts[i] != NULL && (ghosts[i][j] & ghostMasks[i]) != 0)
+        {
+        continue;
+        }
+      if (haveBounds)
+        {
+        this->IntervalTree->AddElement(treeElement, &cellBounds[6*j]);
+        }
+      else
+        {
+        // Calling GetCell from a single thread here also builds whatever the
+        // mesh needs internally so that GetValue can later be threaded.
+        vtkCell *cell = this->Meshes[i]->GetCell(j);
+        double bounds[6];
+        cell->GetBounds(bounds);
+        this->IntervalTree->AddElement(treeElement, bounds);
+        }
+      if (this->TreeElements != NULL)
+        {
+        this->TreeElements[treeElement] = index;
+        }
+      treeElement++;
+      }
+    vtkstd::vector<double>().swap(cellBounds);
+
+    // Ask for the neighbors of a cell once so that the mesh builds its
+    // cell links now, rather than lazily from inside the threads.
+    if (nCells > 0)
+      {
+      vtkIdList *ptIds = vtkIdList::New();
+      vtkIdList *neighbors = vtkIdList::New();
+      this->Meshes[i]->GetCellPoints(0, ptIds);
+      ptIds->SetNumberOfIds(ptIds->GetNumberOfIds() > 0 ? 1 : 0);
+      this->Meshes[i]->GetCellNeighbors(0, ptIds, neighbors);
+      ptIds->Delete();
+      neighbors->Delete();
+      }
+    }
+  if (degenerate)
+    {
+    // The tree is never searched, but it has to have an element.
+    double bounds[6] = { 0, 1, 0, 1, 0, 1 };
+    this->IntervalTree->AddElement(0, bounds);
+    if (this->NumberOfTreeZones == 0)
+      {
+      this->MapToDataSet[0] = -1;
+      }
+    }    
+  this->IntervalTree->Calculate(true);    
+  this->PrepareSamplingContexts();
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+bool vtkCMFEFastLookupGrouping::GetValue(const float *pt, double *val)
+{
+  return this->GetValue(pt, val, *this->State);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFEFastLookupGrouping::GetValue(const float *pt, double *val,
+  SearchState &state)
+{  
+  double dpt[3] = {pt[0], pt[1] , pt[2]};
+  if (this->PointTree != NULL)
+    {
+    if (this->GetPointValue(dpt, val, state))
+      {
+      state.NumberOfPointsLocated++;
+      return true;
+      }
+    state.NumberOfPointsMissed++;
+    return false;
+    }
+  if (this->LocateValue(dpt, val, state))
+    {
+    state.NumberOfPointsLocated++;
+    return true;
+    }
+  if (this->FallbackTolerance > 0. && this->GetNearestValue(dpt, val, state))
+    {
+    state.NumberOfPointsNearest++;
+    return true;
+    }
+  state.NumberOfPointsMissed++;
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFEFastLookupGrouping::LocateValue(const double *dpt, double *val,
+  SearchState &state)
+{
+  // Start off by trying the cell that contained the previous point and then
+  // its neighbors.  Sample points usually come in a coherent order, so this
+  // avoids most of the searches of the interval tree, which are costly.
+  if (state.LastCell >= 0)
+    {
+    if (this->GetValueFromCell(state.LastCell, dpt, val, state))
+      {
+      return true;
+      }
+    if (this->GetValueFromNeighbors(state.LastCell, dpt, val, state))
+      {
+      return true;
+      }
+    }
+  
+  // Image data and rectilinear grids locate the point directly.
+  for (int g = 0 ; g < (int) this->AxisGrids.size() ; g++)
+    {
+    if (this->GetValueFromAxisGrid(g, dpt, val, state))
+      {
+      return true;
+      }
+    }
+  if (this->NumberOfTreeElements == 0)
+    {
+    return false;
+    }
+
+  // OK, we struck out with the neighborhood of the last winning cell.  So
+  // get the correct list from the interval tree.  
+  this->SearchTree(dpt, dpt, state.List);
+  for (int j = 0 ; j < state.List.size() ; j++)
+    {
+    if (this->GetValueFromCell(state.List[j], dpt, val, state))
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::GetValues(int n, const float *x,
+  const float *y, const float *z, int stride, double *values, int nComps,
+  unsigned char *found, SearchState &state)
+{
+  state.List.clear();
+
+  for (int blockStart = 0 ; blockStart < n ; blockStart += mortonBlockSize)
+    {
+    int blockSize = vtkstd::min(mortonBlockSize, n - blockStart);
+
+    // Sort the block along a Morton curve over its bounding box, so that
+    // consecutive points are close to each other.
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    int i;
+    for (i = blockStart ; i < blockStart + blockSize ; i++)
+      {
+      const float p[3] = { x[i*stride], y[i*stride], z[i*stride] };
+      for (int k = 0 ; k < 3 ; k++)
+        {
+        lo[k] = (p[k] < lo[k] ? p[k] : lo[k]);
+        hi[k] = (p[k] > hi[k] ? p[k] : hi[k]);
+        }
+      }
+    float scale[3];
+    for (int k = 0 ; k < 3 ; k++)
+      {
+      scale[k] = (hi[k] > lo[k] ? 1023.f / (hi[k] - lo[k]) : 0.f);
+      }
+    state.Order.resize(blockSize);
+    for (i = 0 ; i < blockSize ; i++)
+      {
+      int p = (blockStart + i) * stride;
+      state.Order[i].first =
+        CMFEUtility::MortonEncode(Quantize(x[p], lo[0], scale[0]),
+                                  Quantize(y[p], lo[1], scale[1]),
+                                  Quantize(z[p], lo[2], scale[2]));
+      state.Order[i].second = blockStart + i;
+      }
+    vtkstd::sort(state.Order.begin(), state.Order.end());
+
+    for (i = 0 ; i < blockSize ; i++)
+      {
+      int p = state.Order[i].second;
+      double dpt[3] = { x[p*stride], y[p*stride], z[p*stride] };
+      double *val = values + p*nComps;
+      if (this->PointTree != NULL)
+        {
+        if (this->GetPointValue(dpt, val, state))
+          {
+          found[p] = 1;
+          state.NumberOfPointsLocated++;
+          }
+        else
+          {
+          found[p] = 0;
+          state.NumberOfPointsMissed++;
+          }
+        continue;
+        }
+
+      // Same search as GetValue, except that the candidates of the previous
+      // point are tried before the interval tree is searched again.
+      bool gotValue = false;
+      if (state.LastCell >= 0)
+        {
+        gotValue = (this->GetValueFromCell(state.LastCell, dpt, val, state) ||
+          this->GetValueFromNeighbors(state.LastCell, dpt, val, state));
+        }
+      for (int j = 0 ; !gotValue && j < state.List.size() ; j++)
+        {
+        gotValue = this->GetValueFromCell(state.List[j], dpt, val, state);
+        }
+      for (int g = 0 ; !gotValue && g < (int) this->AxisGrids.size() ; g++)
+        {
+        gotValue = this->GetValueFromAxisGrid(g, dpt, val, state);
+        }
+      if (!gotValue && this->NumberOfTreeElements > 0)
+        {
+        this->SearchTree(dpt, dpt, state.List);
+        for (int j = 0 ; !gotValue && j < state.List.size() ; j++)
+          {
+          gotValue = this->GetValueFromCell(state.List[j], dpt, val, state);
+          }
+        }
+      if (gotValue)
+        {
+        state.NumberOfPointsLocated++;
+        }
+      else if (this->FallbackTolerance > 0. &&
+               this->GetNearestValue(dpt, val, state))
+        {
+        gotValue = true;
+        state.NumberOfPointsNearest++;
+        }
+      else
+        {
+        state.NumberOfPointsMissed++;
+        }
+      found[p] = (gotValue ? 1 : 0);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::BuildPointTree(void)
+{
+  int nMeshes = (int) this->Meshes.size();
+  this->TupleStart.resize(nMeshes + 1);
+  vtkIdType nTuples = 0;
+  for (int i = 0 ; i < nMeshes ; i++)
+    {
+    this->TupleStart[i] = nTuples;
+    nTuples += (this->IsNodal ? this->Meshes[i]->GetNumberOfPoints() :
+                                this->Meshes[i]->GetNumberOfCells());
+    }
+  this->TupleStart[nMeshes] = nTuples;
+
+  // Ghost cells belong to another piece, so their centers are left out.
+  vtkstd::vector<double> points;
+  vtkstd::vector<vtkIdType> ids;
+  points.reserve(3*nTuples);
+  ids.reserve(nTuples);
+  for (int i = 0 ; i < nMeshes ; i++)
+    {
+    vtkDataSet *mesh = this->Meshes[i];
+    vtkstd::vector<double>().swap(this->CellBounds[i]);
+    vtkIdType n = this->TupleStart[i+1] - this->TupleStart[i];
+    unsigned char ghostMask = 0;
+    const unsigned char *ghosts =
+      (this->IsNodal ? NULL : CMFEUtility::GetGhostCells(mesh, ghostMask));
+    for (vtkIdType j = 0 ; j < n ; j++)
+      {
+      if (ghosts != NULL && (ghosts[j] & ghostMask) != 0)
+        {
+        continue;
+        }
+      double x[3];
+      if (this->IsNodal)
+        {
+        mesh->GetPoint(j, x);
+        }
+      else
+        {
+        CMFEUtility::GetCellCenter(mesh->GetCell(j), x);
+        }
+      points.insert(points.end(), x, x + 3);
+      ids.push_back(this->TupleStart[i] + j);
+      }
+    }
+
+  this->PointTree = new vtkCMFEKdTree;
+  this->PointTree->Build((vtkIdType) ids.size(),
+    (ids.empty() ? NULL : &points[0]), (ids.empty() ? NULL : &ids[0]),
+    this->NumberOfThreads);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFEFastLookupGrouping::GetPointValue(const double *pt, double *val,
+  SearchState &state)
+{
+  vtkstd::vector<vtkstd::pair<double, vtkIdType> > &nearest =
+    state.NearestPoints;
+  switch (this->Interpolation)
+    {
+    case NEAREST_POINT:
+      {
+      double dist2;
+      vtkIdType id = this->PointTree->FindClosestPoint(pt, dist2);
+      nearest.clear();
+      if (id >= 0)
+        {
+        nearest.push_back(vtkstd::pair<double, vtkIdType>(dist2, id));
+        }
+      break;
+      }
+    case INVERSE_DISTANCE:
+      this->PointTree->FindClosestNPoints(this->NumberOfNeighbors, pt,
+                                          nearest);
+      break;
+    default:
+      this->PointTree->FindPointsWithinRadius(this->Radius, pt, nearest);
+      break;
+    }
+
+  // Replace the distances with the weights, leaving out the points beyond
+  // a positive radius and the points of meshes that lack a variable or
+  // whose variables have other numbers of components than those of the
+  // first point.  The nearest points come first, so once inverse distance
+  // has met a point at the position itself only such points are kept.
+  double r2 = this->Radius*this->Radius;
+  int firstMesh = -1;
+  bool exact = false;
+  double sum = 0.;
+  size_t nKept = 0;
+  for (size_t i = 0 ; i < nearest.size() ; i++)
+    {
+    double dist2 = nearest[i].first;
+    vtkIdType id = nearest[i].second;
+    if (this->Radius > 0. && dist2 > r2)
+      {
+      continue;
+      }
+    int mesh = (int) (vtkstd::upper_bound(this->TupleStart.begin(),
+      this->TupleStart.end(), id) - this->TupleStart.begin()) - 1;
+    const SamplingContext &context = this->Contexts[mesh];
+    if (!context.HasArrays)
+      {
+      continue;
+      }
+    if (firstMesh < 0)
+      {
+      firstMesh = mesh;
+      }
+    bool sameComponents = true;
+    for (size_t v = 0 ; v < context.Arrays.size() ; v++)
+      {
+      sameComponents = sameComponents &&
+        (context.Arrays[v].NumberOfComponents ==
+         this->Contexts[firstMesh].Arrays[v].NumberOfComponents);
+      }
+    if (!sameComponents)
+      {
+      continue;
+      }
+
+    double weight = 1.;
+    if (this->Interpolation == INVERSE_DISTANCE)
+      {
+      if (dist2 == 0.)
+        {
+        exact = true;
+        }
+      else if (exact)
+        {
+        break;
+        }
+      else
+        {
+        weight = 1. / dist2;
+        }
+      }
+    else if (this->Interpolation == GAUSSIAN_RADIUS && r2 > 0.)
+      {
+      weight = exp(-2.*dist2/r2);
+      }
+    nearest[nKept++] = vtkstd::pair<double, vtkIdType>(weight, id);
+    sum += weight;
+    }
+  nearest.resize(nKept);
+  if (nKept == 0 || sum <= 0.)
+    {
+    return false;
+    }
+
+  const SamplingContext &first = this->Contexts[firstMesh];
+  int nComps = 0;
+  for (size_t v = 0 ; v < first.Arrays.size() ; v++)
+    {
+    nComps += first.Arrays[v].NumberOfComponents;
+    }
+  for (int c = 0 ; c < nComps ; c++)
+    {
+    val[c] = 0.;
+    }
+  if (state.Record)
+    {
+    state.RecordedMesh = firstMesh;
+    state.RecordedIds.clear();
+    state.RecordedWeights.clear();
+    }
+
+  for (size_t i = 0 ; i < nKept ; i++)
+    {
+    double weight = nearest[i].first / sum;
+    vtkIdType id = nearest[i].second;
+    int mesh = (int) (vtkstd::upper_bound(this->TupleStart.begin(),
+      this->TupleStart.end(), id) - this->TupleStart.begin()) - 1;
+    vtkIdType index = id - this->TupleStart[mesh];
+    if (state.Record)
+      {
+      state.RecordedIds.push_back(index);
+      state.RecordedWeights.push_back(weight);
+      }
+
+    const SamplingContext &context = this->Contexts[mesh];
+    double *v = val;
+    for (size_t a = 0 ; a < context.Arrays.size() ; a++)
+      {
+      const SampledArray &sa = context.Arrays[a];
+      switch (sa.Values != NULL ? sa.ValueType : VTK_VOID)
+        {
+        vtkTemplateMacro(
+          AddWeightedValues(static_cast<const VTK_TT *>(sa.Values),
+                            sa.NumberOfComponents, index, weight, v));
+        default:
+          AddWeightedValues(sa.Array, sa.NumberOfComponents, index, weight,
+                            v);
+        }
+      v += sa.NumberOfComponents;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::SearchTree(const double *lo,
+  const double *hi, vtkstd::vector<int> &list)
+{
+  this->IntervalTree->GetElementsListFromRange(lo, hi, list);
+  if (this->TreeElements != NULL)
+    {
+    for (size_t i = 0 ; i < list.size() ; i++)
+      {
+      list[i] = this->TreeElements[list[i]];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFEFastLookupGrouping::GetValueUsingList(vtkstd::vector<int> &list, const float *pt, double *val)
+{
+  return this->GetValueUsingList(list, pt, val, *this->State);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFEFastLookupGrouping::GetValueUsingList(vtkstd::vector<int> &list,
+  const float *pt, double *val, SearchState &state)
+{
+  double dpt[3] = {pt[0], pt[1] , pt[2]};
+  for (int j = 0 ; j < list.size() ; j++)
+    {
+    if (this->GetValueFromCell(list[j], dpt, val, state))
+      {
+      return true;
+      }
+    }
+
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFEFastLookupGrouping::GetValueFromNeighbors(int element,
+  const double *pt, double *val, SearchState &state)
+{
+  // An axis aligned grid has already been searched as a whole.
+  if (element >= this->NumberOfTreeZones)
+    {
+    return false;
+    }
+
+  int mesh = this->MapToDataSet[element];
+  int index = element - this->DataSetStart[mesh];
+  vtkDataSet *ds = this->Meshes[mesh];
+
+  // Gather the cells that share a face (or an edge for 2D cells) with the
+  // element first, because evaluating a candidate overwrites the cell the
+  // faces come from.
+  vtkCell *cell = state.Cell;
+  ds->GetCell(index, state.Cell);
+  int dim = cell->GetCellDimension();
+  int nSides = (dim == 3 ? cell->GetNumberOfFaces() :
+    dim == 2 ? cell->GetNumberOfEdges() : 0);
+  state.Neighbors.clear();
+  for (int i = 0 ; i < nSides ; i++)
+    {
+    vtkCell *side = (dim == 3 ? cell->GetFace(i) : cell->GetEdge(i));
+    ds->GetCellNeighbors(index, side->GetPointIds(), state.NeighborIds);
+    for (vtkIdType j = 0 ; j < state.NeighborIds->GetNumberOfIds() ; j++)
+      {
+      state.Neighbors.push_back(this->DataSetStart[mesh] +
+        (int) state.NeighborIds->GetId(j));
+      }
+    }
+
+  for (int i = 0 ; i < state.Neighbors.size() ; i++)
+    {
+    if (this->GetValueFromCell(state.Neighbors[i], pt, val, state))
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFEFastLookupGrouping::GetValueFromCell(int element,
+  const double *pt, double *val, SearchState &state)
+{
+  double closestPt[3];
+  int subId;
+  double pcoords[3];
+  double dist2;
+  double weights[100]; // MUST BE BIGGER THAN NPTS IN A CELL (ie 8).
+  double non_const_pt[3];
+  non_const_pt[0] = pt[0];
+  non_const_pt[1] = pt[1];
+  non_const_pt[2] = pt[2];
+
+  if (element >= this->NumberOfTreeZones)
+    {
+    return this->GetValueFromAxisGrid(this->GetAxisGridOfElement(element),
+                                      pt, val, state);
+    }
+
+  int mesh = this->MapToDataSet[element];
+  int index = element - this->DataSetStart[mesh];
+  const SamplingContext &context = this->Contexts[mesh];
+  if (context.Ghosts != NULL && (context.Ghosts[index] & context.GhostMask) != 0)
+    {
+    return false;
+    }
+  if (!context.HasArrays)
+    {
+    return false;
+    }
+
+  // Linear cells of unstructured grids are located and interpolated in one
+  // pass, straight from the point coordinates.
+  if (context.Grid != NULL)
+    {
+    vtkIdType nPts, *ids;
+    context.Grid->GetCellPoints(index, nPts, ids);
+    int cellType = context.Grid->GetCellType(index);
+    int result = (context.PointType == VTK_FLOAT ?
+      CMFECellKernels::LocatePoint(cellType,
+        static_cast<const float *>(context.Points), ids, nPts, pt, weights) :
+      CMFECellKernels::LocatePoint(cellType,
+        static_cast<const double *>(context.Points), ids, nPts, pt, weights));
+    if (result == CMFECellKernels::OUTSIDE)
+      {
+      return false;
+      }
+    if (result == CMFECellKernels::INSIDE)
+      {
+      this->EvaluateValues(mesh, index, ids, weights, nPts, val, state);
+      state.LastCell = element;
+      return true;
+      }
+    }
+
+  // GetCell with a generic cell is thread safe once GetCell has been
+  // called from a single thread, which Finalize does.
+  vtkCell *cell = state.Cell;
+  this->Meshes[mesh]->GetCell(index, state.Cell);
+  bool inCell = CMFEUtility::CellContainsPoint(cell, non_const_pt);
+  if (!inCell)
+    {
+    return false;
+    }
+
+  if (this->IsNodal)
+    {
+    // Need the weights.
+    cell->EvaluatePosition(non_const_pt, closestPt, subId, pcoords, dist2, weights);
+    }
+  this->EvaluateValues(mesh, index, cell->GetPointIds()->GetPointer(0),
+                       weights, cell->GetNumberOfPoints(), val, state);
+  state.LastCell = element;
+  return true;
 }
 
 //----------------------------------------------------------------------------
-vtkCMFEFastLookupGrouping::~vtkCMFEFastLookupGrouping()
+int vtkCMFEFastLookupGrouping::GetAxisGridOfElement(int element) const
 {
-  this->ClearAllInputMeshes();
-  delete this->IntervalTree;
-  delete [] this->MapToDataSet;
-  delete [] this->DataSetStart;
+  // The grids are numbered in order, after the elements of the tree.
+  int g = (int) this->AxisGrids.size() - 1;
+  while (g > 0 && element < this->DataSetStart[this->AxisGrids[g].Mesh])
+    {
+    g--;
+    }
+  return g;
 }
 
 //----------------------------------------------------------------------------
-void vtkCMFEFastLookupGrouping::AddMesh(vtkDataSet *mesh)
+bool vtkCMFEFastLookupGrouping::GetValueFromAxisGrid(int g,
+  const double *pt, double *val, SearchState &state)
 {
-   mesh->Register(NULL);
-   this->Meshes.push_back(mesh);
+  const AxisAlignedGrid &grid = this->AxisGrids[g];
+  const SamplingContext &context = this->Contexts[grid.Mesh];
+  if (!context.HasArrays)
+    {
+    return false;
+    }
+
+  int ijk[3];
+  double t[3];
+  for (int a = 0 ; a < 3 ; a++)
+    {
+    bool inside = (grid.Uniform ?
+      CMFECellKernels::LocateOnUniformAxis(pt[a], grid.Origin[a],
+        grid.Spacing[a], grid.Dimensions[a], ijk[a], t[a]) :
+      CMFECellKernels::LocateOnAxis(pt[a], &grid.Coordinates[a][0],
+        grid.Dimensions[a], ijk[a], t[a]));
+    if (!inside)
+      {
+      return false;
+      }
+    }
+
+  return this->EvaluateAxisGridCell(g, ijk, t, val, state);
 }
 
 //----------------------------------------------------------------------------
-void vtkCMFEFastLookupGrouping::ClearAllInputMeshes(void)
+bool vtkCMFEFastLookupGrouping::EvaluateAxisGridCell(int g, const int ijk[3],
+  const double t[3], double *val, SearchState &state)
 {
-  for (int i = 0 ; i < this->Meshes.size() ; i++)
+  const AxisAlignedGrid &grid = this->AxisGrids[g];
+  const SamplingContext &context = this->Contexts[grid.Mesh];
+  vtkIdType index = CMFECellKernels::CellIndex(grid.Dimensions, ijk);
+  if (context.Ghosts != NULL && (context.Ghosts[index] & context.GhostMask) != 0)
     {
-    this->Meshes[i]->Delete();
+    return false;
     }
-  this->Meshes.clear();
+  vtkIdType ids[8];
+  double weights[8];
+  int nPts = CMFECellKernels::Trilinear(grid.Dimensions, ijk, t, ids, weights);
+  this->EvaluateValues(grid.Mesh, index, ids, weights, nPts, val, state);
+  state.LastCell = this->DataSetStart[grid.Mesh] + (int) index;
+  return true;
 }
 
 //----------------------------------------------------------------------------
-void vtkCMFEFastLookupGrouping::Finalize(void)
+bool vtkCMFEFastLookupGrouping::GetNearestValue(const double *pt,
+  double *val, SearchState &state)
 {
-  int   i, j;
-  int   index = 0;
-
-  this->NumberOfZones = 0;
-  for (i = 0 ; i < this->Meshes.size() ; i++)
-  this->NumberOfZones += this->Meshes[i]->GetNumberOfCells();
+  const double tol = this->FallbackTolerance;
+  double bestDist2 = tol*tol;
+  int bestElement = -1;
+  double bestPt[3];
 
-  this->DataSetStart = new int[this->Meshes.size()];
-  this->DataSetStart[0] = 0;
-  for (i = 1 ; i < this->Meshes.size() ; i++)
-  this->DataSetStart[i] = this->DataSetStart[i-1] + this->Meshes[i-1]->GetNumberOfCells();
-
-  bool degenerate = false;
-  if (this->NumberOfZones == 0)
+  if (this->NumberOfTreeElements > 0)
     {
-    degenerate = true;
-    this->NumberOfZones = 1;
+    double lo[3] = { pt[0]-tol, pt[1]-tol, pt[2]-tol };
+    double hi[3] = { pt[0]+tol, pt[1]+tol, pt[2]+tol };
+    this->SearchTree(lo, hi, state.Candidates);
+    for (size_t j = 0 ; j < state.Candidates.size() ; j++)
+      {
+      int element = state.Candidates[j];
+      int mesh = this->MapToDataSet[element];
+      int index = element - this->DataSetStart[mesh];
+      if (!this->Contexts[mesh].HasArrays)
+        {
+        continue;
+        }
+      vtkCell *cell = state.Cell;
+      this->Meshes[mesh]->GetCell(index, state.Cell);
+      state.Weights.resize(cell->GetNumberOfPoints());
+      double closestPt[3];
+      double pcoords[3];
+      double dist2;
+      int subId;
+      int inside = cell->EvaluatePosition(const_cast<double *>(pt), closestPt,
+        subId, pcoords, dist2, &state.Weights[0]);
+      if (inside == 1)
+        {
+        dist2 = 0.;
+        closestPt[0] = pt[0];
+        closestPt[1] = pt[1];
+        closestPt[2] = pt[2];
+        }
+      if (inside >= 0 && dist2 <= bestDist2)
+        {
+        bestDist2 = dist2;
+        bestElement = element;
+        bestPt[0] = closestPt[0];
+        bestPt[1] = closestPt[1];
+        bestPt[2] = closestPt[2];
+        }
+      }
     }
-  this->IntervalTree = new vtkCMFEIntervalTree(this->NumberOfZones, 3);
-  this->MapToDataSet = new int[this->NumberOfZones];
-  index = 0;
-  for (i = 0 ; i < this->Meshes.size() ; i++)
+
+  // The closest cell of an axis aligned grid is found by clamping the
+  // position to the grid along each axis.
+  int bestGrid = -1;
+  int bestIjk[3];
+  double bestT[3];
+  for (int g = 0 ; g < (int) this->AxisGrids.size() ; g++)
     {
-    int nCells = this->Meshes[i]->GetNumberOfCells();
-    for (j = 0 ; j < nCells ; j++)
+    const AxisAlignedGrid &grid = this->AxisGrids[g];
+    if (!this->Contexts[grid.Mesh].HasArrays)
       {
-      vtkCell *cell = this->Meshes[i]->GetCell(j);
-      double bounds[6];
-      cell->GetBounds(bounds);
-      this->IntervalTree->AddElement(index, bounds);
-
-      this->MapToDataSet[index] = i;
-      index++;
+      continue;
+      }
+    int ijk[3];
+    double t[3];
+    double dist2 = 0.;
+    for (int a = 0 ; a < 3 ; a++)
+      {
+      int n = grid.Dimensions[a];
+      double first = (grid.Uniform ? grid.Origin[a] : grid.Coordinates[a][0]);
+      double last = (grid.Uniform ? grid.Origin[a] + (n-1)*grid.Spacing[a] :
+                     grid.Coordinates[a][n-1]);
+      double lo = vtkstd::min(first, last);
+      double hi = vtkstd::max(first, last);
+      double v = vtkstd::max(lo, vtkstd::min(hi, pt[a]));
+      dist2 += (v - pt[a])*(v - pt[a]);
+      if (grid.Uniform)
+        {
+        CMFECellKernels::LocateOnUniformAxis(v, grid.Origin[a],
+          grid.Spacing[a], n, ijk[a], t[a]);
+        }
+      else
+        {
+        CMFECellKernels::LocateOnAxis(v, &grid.Coordinates[a][0], n,
+          ijk[a], t[a]);
+        }
+      t[a] = vtkstd::max(0., vtkstd::min(1., t[a]));
+      }
+    const SamplingContext &context = this->Contexts[grid.Mesh];
+    vtkIdType index = CMFECellKernels::CellIndex(grid.Dimensions, ijk);
+    if (context.Ghosts != NULL && (context.Ghosts[index] & context.GhostMask) != 0)
+      {
+      continue;
+      }
+    if (dist2 <= bestDist2)
+      {
+      bestDist2 = dist2;
+      bestGrid = g;
+      for (int a = 0 ; a < 3 ; a++)
+        {
+        bestIjk[a] = ijk[a];
+        bestT[a] = t[a];
+        }
       }
     }
-  if (degenerate)
+
+  if (bestGrid >= 0)
     {
-    double bounds[6] = { 0, 1, 0, 1, 0, 1 };
-    this->IntervalTree->AddElement(0, bounds);
-    }    
-  this->IntervalTree->Calculate(true);    
-}
+    return this->EvaluateAxisGridCell(bestGrid, bestIjk, bestT, val, state);
+    }
+  if (bestElement < 0)
+    {
+    return false;
+    }
 
+  // The weights are those of the closest point, which is in the cell.
+  int mesh = this->MapToDataSet[bestElement];
+  int index = bestElement - this->DataSetStart[mesh];
+  vtkCell *cell = state.Cell;
+  this->Meshes[mesh]->GetCell(index, state.Cell);
+  state.Weights.resize(cell->GetNumberOfPoints());
+  double closestPt[3];
+  double pcoords[3];
+  double dist2;
+  int subId;
+  cell->EvaluatePosition(bestPt, closestPt, subId, pcoords, dist2,
+                         &state.Weights[0]);
+  this->EvaluateValues(mesh, index, cell->GetPointIds()->GetPointer(0),
+    &state.Weights[0], cell->GetNumberOfPoints(), val, state);
+  return true;
+}
 
 //----------------------------------------------------------------------------
-bool vtkCMFEFastLookupGrouping::GetValue(const float *pt, float *val)
-{  
-  // Start off by using the list from the previous search.  Searching the
-  // interval tree is so costly that this is a worthwhile "guess".  
-  if (this->ListFromLastSuccessfulSearch.size() > 0)
+bool vtkCMFEFastLookupGrouping::GetAxisAlignedGrid(vtkDataSet *mesh,
+  AxisAlignedGrid &grid)
+{
+  vtkImageData *image = vtkImageData::SafeDownCast(mesh);
+  vtkRectilinearGrid *rgrid = vtkRectilinearGrid::SafeDownCast(mesh);
+  if (image != NULL)
     {
-    bool v = this->GetValueUsingList(this->ListFromLastSuccessfulSearch, pt, val);
-    if (v)
-      {
-      return true;
-      }
+    image->GetDimensions(grid.Dimensions);
     }
-  
-  // OK, we struck out with the list from the last winning search.  So
-  // get the correct list from the interval tree.  
-  vtkstd::vector<int> list;
-  double dpt[3] = {pt[0], pt[1] , pt[2]};
-  this->IntervalTree->GetElementsListFromRange(dpt, dpt, list);
-  bool v = this->GetValueUsingList(list, pt, val);
-  if (v == true)
+  else if (rgrid != NULL)
     {
-    this->ListFromLastSuccessfulSearch = list;
+    rgrid->GetDimensions(grid.Dimensions);
     }
   else
     {
-    this->ListFromLastSuccessfulSearch.clear();
+    return false;
+    }
+  if (grid.Dimensions[0] < 1 || grid.Dimensions[1] < 1 ||
+      grid.Dimensions[2] < 1)
+    {
+    return false;
     }
-  return v;
-}
 
-//----------------------------------------------------------------------------
-bool vtkCMFEFastLookupGrouping::GetValueUsingList(vtkstd::vector<int> &list, const float *pt, float *val)
-{
-  double closestPt[3];
-  int subId;
-  double pcoords[3];
-  double dist2;
-  double weights[100]; // MUST BE BIGGER THAN NPTS IN A CELL (ie 8).
-  double non_const_pt[3];
-  non_const_pt[0] = pt[0];
-  non_const_pt[1] = pt[1];
-  non_const_pt[2] = pt[2];
+  grid.Uniform = (image != NULL);
+  if (image != NULL)
+    {
+    // The origin is that of the whole extent, not of this piece of it.
+    int extent[6];
+    double origin[3];
+    image->GetExtent(extent);
+    image->GetOrigin(origin);
+    image->GetSpacing(grid.Spacing);
+    for (int a = 0 ; a < 3 ; a++)
+      {
+      if (grid.Spacing[a] == 0. && grid.Dimensions[a] > 1)
+        {
+        return false;
+        }
+      grid.Origin[a] = origin[a] + extent[2*a]*grid.Spacing[a];
+      }
+    return true;
+    }
 
-  for (int j = 0 ; j < list.size() ; j++)
+  vtkDataArray *coords[3] = { rgrid->GetXCoordinates(),
+    rgrid->GetYCoordinates(), rgrid->GetZCoordinates() };
+  for (int a = 0 ; a < 3 ; a++)
     {
-    int mesh = this->MapToDataSet[list[j]];
-    int index = list[j] - this->DataSetStart[mesh];
-    if (this->Meshes[mesh]->GetCellData()->GetArray("avtGhostZones") != NULL)
+    int n = grid.Dimensions[a];
+    if (coords[a] == NULL || coords[a]->GetNumberOfTuples() < n)
+      {
+      return false;
+      }
+    vtkstd::vector<double> &c = grid.Coordinates[a];
+    c.resize(n);
+    for (int i = 0 ; i < n ; i++)
       {
-      vtkUnsignedCharArray *arr = (vtkUnsignedCharArray *) this->Meshes[mesh]->GetCellData()->GetArray("avtGhostZones");
-      if (arr->GetValue(index) != 0)
+      c[i] = coords[a]->GetComponent(i, 0);
+      if (i > 0 && !(c[i] > c[i-1]))
         {
-        continue;
+        // The binary search needs increasing coordinates.
+        return false;
         }
       }
+    }
+  return true;
+}
 
-    vtkCell *cell = this->Meshes[mesh]->GetCell(index);
-    bool inCell = CMFEUtility::CellContainsPoint(cell, non_const_pt);
-    if (!inCell)
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::EvaluateValues(int mesh, vtkIdType index,
+  const vtkIdType *ids, const double *weights, int nPts, double *val,
+  SearchState &state)
+{
+  if (state.Record)
+    {
+    state.RecordedMesh = mesh;
+    if (this->IsNodal)
       {
-      continue;
+      state.RecordedIds.assign(ids, ids + nPts);
+      state.RecordedWeights.assign(weights, weights + nPts);
       }
+    else
+      {
+      state.RecordedIds.assign(1, index);
+      state.RecordedWeights.assign(1, 1.);
+      }
+    }
 
+  // The location is shared by all the variables, whose values are written
+  // one after the other.
+  const SamplingContext &context = this->Contexts[mesh];
+  for (size_t v = 0 ; v < context.Arrays.size() ; v++)
+    {
+    const SampledArray &sa = context.Arrays[v];
+    int nComponents = sa.NumberOfComponents;
     if (this->IsNodal)
       {
-      // Need the weights.
-      cell->EvaluatePosition(non_const_pt, closestPt, subId, pcoords, dist2, weights);
-      vtkDataArray *arr = this->Meshes[mesh]->GetPointData()->GetArray(this->VarName.c_str());
-      if (arr == NULL)
+      switch (sa.Values != NULL ? sa.ValueType : VTK_VOID)
         {
-        return false;        
+        vtkTemplateMacro(
+          InterpolateValues(static_cast<const VTK_TT *>(sa.Values),
+                            nComponents, ids, weights, nPts, val));
+        default:
+          InterpolateValues(sa.Array, nComponents, ids, weights, nPts, val);
         }
-
-      int nComponents = arr->GetNumberOfComponents();
-      int nPts = cell->GetNumberOfPoints();
-      for (int c = 0 ; c < nComponents ; c++)
+      }
+    else
+      {
+      switch (sa.Values != NULL ? sa.ValueType : VTK_VOID)
         {
-        val[c] = 0.;
-        for (int pt = 0 ; pt < nPts ; pt++)
-          {
-          vtkIdType id = cell->GetPointId(pt);
-          val[c] += weights[pt]*arr->GetComponent(id, c);
-          }
+        vtkTemplateMacro(
+          CopyValues(static_cast<const VTK_TT *>(sa.Values),
+                     nComponents, index, val));
+        default:
+          CopyValues(sa.Array, nComponents, index, val);
         }
       }
-    else
+    val += nComponents;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFastLookupGrouping::PrepareSamplingContexts(void)
+{
+  this->Contexts.resize(this->Meshes.size());
+  for (int i = 0 ; i < this->Meshes.size() ; i++)
+    {
+    vtkDataSet *ds = this->Meshes[i];
+    SamplingContext &context = this->Contexts[i];
+
+    context.Ghosts = CMFEUtility::GetGhostCells(ds, context.GhostMask);
+
+    // A mesh is only sampled if it has all of the variables.
+    context.Arrays.resize(this->VarNames.size());
+    context.HasArrays = true;
+    for (size_t v = 0 ; v < this->VarNames.size() ; v++)
       {
-      vtkDataArray *arr = this->Meshes[mesh]->GetCellData()->GetArray(this->VarName.c_str());
+      SampledArray &sa = context.Arrays[v];
+      vtkDataArray *arr = (this->IsNodal ?
+        ds->GetPointData()->GetArray(this->VarNames[v].c_str()) :
+        ds->GetCellData()->GetArray(this->VarNames[v].c_str()));
+      sa.Array = arr;
+      sa.Values = NULL;
+      sa.ValueType = VTK_VOID;
+      sa.NumberOfComponents = 0;
       if (arr == NULL)
         {
-        return false;        
+        context.HasArrays = false;
+        continue;
         }
-
-      int nComponents = arr->GetNumberOfComponents();
-      for (int c = 0 ; c < nComponents ; c++)
+      sa.ValueType = arr->GetDataType();
+      sa.NumberOfComponents = arr->GetNumberOfComponents();
+      switch (sa.ValueType)
         {
-        val[c] = arr->GetComponent(index, c);
+        vtkTemplateMacro(sa.Values = arr->GetVoidPointer(0));
         }
       }
-    return true;
-    }
 
-  return false;
+    context.Grid = NULL;
+    context.Points = NULL;
+    context.PointType = VTK_VOID;
+    vtkUnstructuredGrid *ugrid = vtkUnstructuredGrid::SafeDownCast(ds);
+    vtkPoints *pts = (ugrid != NULL ? ugrid->GetPoints() : NULL);
+    if (pts != NULL &&
+        (pts->GetDataType() == VTK_FLOAT || pts->GetDataType() == VTK_DOUBLE))
+      {
+      context.Grid = ugrid;
+      context.Points = pts->GetVoidPointer(0);
+      context.PointType = pts->GetDataType();
+      }
+    }
 }
 
+//----------------------------------------------------------------------------
+double vtkCMFEFastLookupGrouping::GetRelocationMargin(void)
+{
+  // A point that no cell contains takes its value from a cell within
+  // FallbackTolerance, which may lie in the region of another processor.
+  if (this->Interpolation == CELL_CONTAINMENT)
+    {
+    return vtkstd::max(this->FallbackTolerance, 0.);
+    }
+  // The point modes use the points within Radius.  Without a radius, the
+  // nearest points are only looked for among the points that were sent
+  // for the cells that overlap the region.
+  return vtkstd::max(this->Radius, 0.);
+}
 
 //----------------------------------------------------------------------------
 void vtkCMFEFastLookupGrouping::RelocateDataUsingPartition( vtkCMFESpatialPartition *spat_part)
@@ -272,197 +2115,331 @@ void vtkCMFEFastLookupGrouping::RelocateDataUsingPartition( vtkCMFESpatialPartit
   int  i, j, k;
   int   nProcs = CMFEUtility::PAR_Size();
 
-  vtkUnstructuredGrid **meshForProcP = new vtkUnstructuredGrid*[nProcs];
-  int                  *nCellsForP   = new int[nProcs];
-  vtkAppendFilter     **appenders    = new vtkAppendFilter*[nProcs];
-  for (i = 0 ; i < nProcs ; i++)
+  if (nProcs > 1 && CMFEUtility::PAR_Rank() == 0 &&
+      this->Interpolation != CELL_CONTAINMENT &&
+      this->Interpolation != GAUSSIAN_RADIUS && this->Radius <= 0.)
     {
-    appenders[i] = vtkAppendFilter::New();
+    vtkOutputWindowDisplayWarningText("Without a Radius, the nearest "
+      "points are only searched for near the region of each processor, so "
+      "positions near the boundaries of the regions may get other values "
+      "than in a serial run.  Set a Radius to make them agree.");
     }
 
-  vtkstd::vector<int> list;
-  for (i = 0 ; i < this->Meshes.size() ; i++)
+  // Only the variables being sampled and the ghost zones, which the search
+  // needs, are sent along with the mesh.
+  int nMeshes = (int) this->Meshes.size();
+  vtkstd::vector<MeshWireInfo> wireInfo(nMeshes);
+  for (i = 0 ; i < nMeshes ; i++)
     {
-
-    // Get the mesh from the input for this iteration.  During each 
-    // iteration, our goal is, for each cell in the mesh, to identify
-    // which processors need this cell to do their sampling and to add
-    // that cell to a data structure so we can do a large communication
-    // afterwards.
-
     vtkDataSet *mesh = this->Meshes[i];
-    const int nCells = mesh->GetNumberOfCells();
-
-    // 
-    // Reset the data structures that contain the cells from mesh i that
-    // need to be sent to processor P.
-
-    for (j = 0 ; j < nProcs ; j++)
+    MeshWireInfo &info = wireInfo[i];
+    info.Arrays.resize(this->VarNames.size());
+    for (j = 0 ; j < (int) this->VarNames.size() ; j++)
       {
-      meshForProcP[j] = NULL;
-      nCellsForP[j]   = 0;
+      WireArray &wa = info.Arrays[j];
+      wa.Array = (this->IsNodal ?
+        mesh->GetPointData()->GetArray(this->VarNames[j].c_str()) :
+        mesh->GetCellData()->GetArray(this->VarNames[j].c_str()));
+      wa.ValueType = GetWireValueType(wa.Array);
+      wa.NumberOfComponents =
+        (wa.Array != NULL ? wa.Array->GetNumberOfComponents() : 0);
       }
+    info.Ghosts = CMFEUtility::GetGhostCells(mesh, info.GhostMask);
+    info.PointType = GetWirePointType(mesh);
 
-
-    // For each cell in the input mesh, determine which processors that
-    // cell needs to be sent to (typically just one other processor).  Then
-    // add the cell to a data structure that will holds the cells.  In the
-    // next phase we will use this data structure to construct a large
-    // message to each of the other processors containing the cells it
-    // needs.
-
-    for (j = 0 ; j < nCells ; j++)
+    AxisAlignedGrid grid;
+    info.Block = this->GetAxisAlignedGrid(mesh, grid);
+    if (info.Block)
       {
-      vtkCell *cell = mesh->GetCell(j);
-      spat_part->GetProcessorList(cell, list);
-      for (k = 0 ; k < list.size() ; k++)
+      for (k = 0 ; k < 3 ; k++)
         {
-        if (meshForProcP[list[k]] == NULL)
+        info.Dimensions[k] = grid.Dimensions[k];
+        if (grid.Uniform)
           {
-          //delay the construction of the unstructured grid to as late as possible
-          //this way if we don't need the grid for a processor we won't construc it.
-          meshForProcP[list[k]] = vtkUnstructuredGrid::New();
-          vtkPoints *pts = CMFEUtility::GetPoints(mesh);
-          meshForProcP[list[k]]->SetPoints(pts);
-          meshForProcP[list[k]]->GetPointData()->ShallowCopy(
-            mesh->GetPointData());
-          meshForProcP[list[k]]->GetCellData()->CopyAllocate(
-            mesh->GetCellData());
-          meshForProcP[list[k]]->Allocate(nCells*9);
-          pts->Delete();
+          info.Coordinates[k].resize(grid.Dimensions[k]);
+          for (j = 0 ; j < grid.Dimensions[k] ; j++)
+            {
+            info.Coordinates[k][j] = grid.Origin[k] + j*grid.Spacing[k];
+            }
+          }
+        else
+          {
+          info.Coordinates[k].swap(grid.Coordinates[k]);
           }
-        int cellType = mesh->GetCellType(j);
-        vtkIdList *ids = cell->GetPointIds();
-        meshForProcP[list[k]]->InsertNextCell(cellType, ids);
-        meshForProcP[list[k]]->GetCellData()->CopyData(
-          mesh->GetCellData(), j, nCellsForP[list[k]]);
-        nCellsForP[list[k]]++;
         }
       }
+    }
 
+  // With a memory budget, the meshes are exchanged in rounds, and in each
+  // round a processor sends at most its share of the budget to each other
+  // processor.  That bounds both what it sends and what it receives.
+  vtkIdType pieceLimit = VTK_LARGE_ID;
+  if (this->RelocationMemoryBudget > 0)
+    {
+    pieceLimit = vtkstd::max((vtkIdType) this->RelocationMemoryBudget *
+                             1024 * 1024 / nProcs, (vtkIdType) 65536);
+    }
 
-    // The data structures we used for examining mesh 'i' are temporary.
-    // Put them in a more permanent location so we can move on to the
-    // next iteration.
+  // For each cell in each mesh, determine which processors need that cell
+  // to do their sampling (typically just one other processor), which are
+  // those whose regions are within the margin of its bounds.  The cells
+  // of mesh i that processor P needs are split into pieces that fit in the
+  // limit, each of which carries the points its cells use.
+  vtkstd::vector<vtkstd::vector<MeshPiece> > pieces(nProcs);
+  vtkstd::vector<vtkstd::vector<vtkIdType> > cellsForProcP(nProcs);
+  vtkstd::vector<int> list;
+  // pointMap is shared by the pieces of all the meshes, both while they
+  // are built and while they are packed, and is -1 again after each piece,
+  // so it is sized once for the largest mesh.
+  vtkIdType maxPoints = 0;
+  for (i = 0 ; i < nMeshes ; i++)
+    {
+    if (!wireInfo[i].Block)
+      {
+      maxPoints = vtkstd::max(maxPoints, this->Meshes[i]->GetNumberOfPoints());
+      }
+    }
+  vtkstd::vector<vtkIdType> pointMap(maxPoints, -1);
+  vtkIdList *ptIds = vtkIdList::New();
+  const double margin = this->GetRelocationMargin();
+  double bounds[6];
+  for (i = 0 ; i < nMeshes ; i++)
+    {
+    vtkDataSet *mesh = this->Meshes[i];
+    const MeshWireInfo &info = wireInfo[i];
+    if (info.Block)
+      {
+      AddBlockPieces(i, info, this->IsNodal, spat_part, margin, pieceLimit,
+                     pieces);
+      continue;
+      }
+    const vtkIdType nCells = mesh->GetNumberOfCells();
+    for (vtkIdType c = 0 ; c < nCells ; c++)
+      {
+      if (info.Ghosts != NULL && (info.Ghosts[c] & info.GhostMask) != 0)
+        {
+        continue;
+        }
+      mesh->GetCellBounds(c, bounds);
+      for (k = 0 ; k < 6 ; k += 2)
+        {
+        bounds[k] -= margin;
+        bounds[k+1] += margin;
+        }
+      spat_part->GetProcessorList(bounds, list);
+      for (k = 0 ; k < list.size() ; k++)
+        {
+        cellsForProcP[list[k]].push_back(c);
+        }
+      }
 
     for (j = 0 ; j < nProcs ; j++)
       {
-      if (meshForProcP[j] != NULL)
+      vtkstd::vector<vtkIdType> &cells = cellsForProcP[j];
+      MeshPiece *piece = NULL;
+      for (size_t c = 0 ; c < cells.size() ; c++)
+        {
+        mesh->GetCellPoints(cells[c], ptIds);
+        vtkIdType nIds = ptIds->GetNumberOfIds();
+
+        // Start a new piece if this cell might not fit in the current one.
+        if (piece != NULL && MessageSize(
+              (vtkIdType) piece->Points.size() + nIds,
+              (vtkIdType) piece->Cells.size() + 1,
+              piece->ConnectivitySize + 1 + nIds, info, this->IsNodal) >
+            pieceLimit)
+          {
+          for (size_t p = 0 ; p < piece->Points.size() ; p++)
+            {
+            pointMap[piece->Points[p]] = -1;
+            }
+          piece = NULL;
+          }
+        if (piece == NULL)
+          {
+          pieces[j].push_back(MeshPiece());
+          piece = &pieces[j].back();
+          piece->Mesh = i;
+          piece->ConnectivitySize = 0;
+          }
+
+        piece->Cells.push_back(cells[c]);
+        piece->ConnectivitySize += 1 + nIds;
+        for (vtkIdType p = 0 ; p < nIds ; p++)
+          {
+          vtkIdType id = ptIds->GetId(p);
+          if (pointMap[id] < 0)
+            {
+            pointMap[id] = (vtkIdType) piece->Points.size();
+            piece->Points.push_back(id);
+            }
+          }
+        }
+      if (piece != NULL)
         {
-        vtkUnstructuredGridRelevantPointsFilter *ugrpf = vtkUnstructuredGridRelevantPointsFilter::New();
-        ugrpf->SetInput(meshForProcP[j]);
-        ugrpf->Update();
-        appenders[j]->AddInput(ugrpf->GetOutput());
-        ugrpf->Delete();
-        meshForProcP[j]->Delete();
+        for (size_t p = 0 ; p < piece->Points.size() ; p++)
+          {
+          pointMap[piece->Points[p]] = -1;
+          }
         }
+      cells.clear();
       }
     }
-  delete [] meshForProcP;
-  delete [] nCellsForP;
-
 
-  // We now have, for each processor P, the list of cells from this processor
-  // that P will need to do its job.  So construct a big message containing
-  // these cell lists and then send it to P.  Of course, while we are busy
-  // composing messages to each of the processors, they are busy composing
-  // message to us.  So use an 'alltoallV' call that allows us to get the
-  // cells that are necessary for *this* processor to do its job.
-
-  int *sendcount = new int[nProcs];
-  char **msg_tmp = new char *[nProcs];
-  for (j = 0 ; j < nProcs ; j++)
+  // Exchange the pieces.  The received meshes are built as each round
+  // arrives, but they are only handed to the grouping at the end, since
+  // the meshes that are being sent are needed until the last round.
+  vtkstd::vector<vtkstd::vector<vtkDataSet *> > receivedFrom(nProcs);
+  vtkstd::vector<vtkstd::vector<vtkstd::vector<double> > > boundsFrom(nProcs);
+  vtkstd::vector<char *> receivedBuffers;
+  vtkstd::vector<size_t> nextPiece(nProcs, 0);
+  vtkIdType *sendcount = new vtkIdType[nProcs];
+  vtkIdType *recvcount = new vtkIdType[nProcs];
+  vtkIdType *senddisp  = new vtkIdType[nProcs];
+  char **recvmessages = new char*[nProcs];
+  for (;;)
     {
-    if (appenders[j]->GetTotalNumberOfInputConnections() == 0)
+    // Pick the pieces of this round and size the messages, so that the
+    // pieces can be packed straight into the buffer that is handed to MPI.
+    vtkstd::vector<size_t> roundEnd(nProcs);
+    int morePieces = 0;
+    vtkIdType total_msg_size = 0;
+    for (j = 0 ; j < nProcs ; j++)
       {
-      sendcount[j] = 0;
-      msg_tmp[j]   = NULL;
-      appenders[j]->Delete();
-      continue;
+      vtkIdType size = 0;
+      size_t p = nextPiece[j];
+      for ( ; p < pieces[j].size() ; p++)
+        {
+        MeshPiece &piece = pieces[j][p];
+        const MeshWireInfo &info = wireInfo[piece.Mesh];
+        vtkIdType pieceSize = (info.Block ?
+          BlockMessageSize(piece.CellExtent, info, this->IsNodal) :
+          MessageSize((vtkIdType) piece.Points.size(),
+            (vtkIdType) piece.Cells.size(), piece.ConnectivitySize, info,
+            this->IsNodal));
+        if (size > 0 && size + pieceSize > pieceLimit)
+          {
+          break;
+          }
+        size += pieceSize;
+        }
+      roundEnd[j] = p;
+      sendcount[j] = size;
+      total_msg_size += sendcount[j];
+      morePieces = (morePieces || p < pieces[j].size());
       }
-    appenders[j]->Update();
-    vtkUnstructuredGridWriter *wrtr = vtkUnstructuredGridWriter::New();
-    wrtr->SetInput(appenders[j]->GetOutput());
-    wrtr->SetWriteToOutputString(1);
-    wrtr->SetFileTypeToBinary();
-    wrtr->Write();
-    sendcount[j] = wrtr->GetOutputStringLength();
-    msg_tmp[j] = (char *) wrtr->RegisterAndGetOutputString();
-    wrtr->Delete();
-    appenders[j]->Delete();    
-    }
-  delete [] appenders;
 
-  int total_msg_size = 0;
-  for (j = 0 ; j < nProcs ; j++)
-    {
-    total_msg_size += sendcount[j];
-    }
+    // Of course, while we are busy composing messages to each of the
+    // processors, they are busy composing message to us.  So first exchange
+    // the sizes of the messages, so that every processor can post its
+    // receives before it starts packing.
+    CMFEUtility::AllToAllCounts(sendcount, recvcount);
 
-  char *big_send_msg = new char[total_msg_size];
-  char *ptr = big_send_msg;
-  for (j = 0 ; j < nProcs ; j++)
-    {
-    if (msg_tmp[j] != NULL)
+    char *big_recv_msg = CMFEUtility::CreateMessageStrings(recvmessages, recvcount, nProcs);
+    senddisp[0] = 0;
+    for (j = 1 ; j < nProcs ; j++)
       {
-      memcpy(ptr, msg_tmp[j], sendcount[j]*sizeof(char));
-      ptr += sendcount[j]*sizeof(char);
-      delete [] msg_tmp[j];
+      senddisp[j] = sendcount[j-1] + senddisp[j-1];
       }
-    }
-  delete [] msg_tmp;
+    // The arrays of the received meshes point straight into the message, so
+    // it is kept until the meshes are cleared.
+    receivedBuffers.push_back(big_recv_msg);
 
-  int *recvcount = new int[nProcs];
 #ifdef VTK_USE_MPI
-  MPI_Alltoall(sendcount, 1, MPI_INT, recvcount, 1, MPI_INT, *CMFEUtility::GetMPIComm());
+    // Messages of more than 2 GiB arrive in several chunks, so remember
+    // which processor each request receives from, and how many chunks of
+    // each message are still outstanding.
+    vtkstd::vector<MPI_Request> recvRequests;
+    vtkstd::vector<MPI_Request> sendRequests;
+    vtkstd::vector<int> requestSource;
+    vtkstd::vector<vtkIdType> pendingChunks(nProcs);
+    for (j = 0 ; j < nProcs ; j++)
+      {
+      CMFEUtility::PostReceive(recvmessages[j], recvcount[j], j,
+                               relocationTag, recvRequests);
+      pendingChunks[j] = CMFEUtility::GetNumberOfMessageChunks(recvcount[j]);
+      requestSource.resize(recvRequests.size(), j);
+      }
 #endif
 
-  char **recvmessages = new char*[nProcs];
-  char *big_recv_msg = CMFEUtility::CreateMessageStrings(recvmessages, recvcount, nProcs);
+    // Each message is sent as soon as it has been packed, so that the
+    // transfer overlaps with packing the messages to the other processors.
+    char *big_send_msg = new char[total_msg_size];
+    for (j = 0 ; j < nProcs ; j++)
+      {
+      char *ptr = big_send_msg + senddisp[j];
+      for (size_t p = nextPiece[j] ; p < roundEnd[j] ; p++)
+        {
+        MeshPiece &piece = pieces[j][p];
+        const MeshWireInfo &info = wireInfo[piece.Mesh];
+        ptr += (info.Block ?
+          PackBlock(piece, info, this->IsNodal, ptr) :
+          PackPiece(this->Meshes[piece.Mesh], piece, info, this->IsNodal,
+                    pointMap, ptIds, ptr));
+        // Release the lists of the piece as soon as it has been packed.
+        vtkstd::vector<vtkIdType>().swap(piece.Cells);
+        vtkstd::vector<vtkIdType>().swap(piece.Points);
+        }
+      nextPiece[j] = roundEnd[j];
+#ifdef VTK_USE_MPI
+      CMFEUtility::PostSend(big_send_msg + senddisp[j], sendcount[j], j,
+                            relocationTag, sendRequests);
+#endif
+      }
 
-  int *senddisp  = new int[nProcs];
-  int *recvdisp  = new int[nProcs];
-  senddisp[0] = 0;
-  recvdisp[0] = 0;
-  for (j = 1 ; j < nProcs ; j++)
-    {
-    senddisp[j] = sendcount[j-1] + senddisp[j-1];
-    recvdisp[j] = recvcount[j-1] + recvdisp[j-1];
-    }
+    // Unpack each message as it arrives, and compute the bounds of its cells
+    // for the interval tree, while the others are still in transit.
 #ifdef VTK_USE_MPI
-  MPI_Alltoallv(big_send_msg, sendcount, senddisp, MPI_CHAR,
-                big_recv_msg, recvcount, recvdisp, MPI_CHAR,
-                *CMFEUtility::GetMPIComm());
+    for (size_t r = 0 ; r < recvRequests.size() ; r++)
+      {
+      MPI_Status status;
+      int index;
+      MPI_Waitany((int) recvRequests.size(), &recvRequests[0], &index,
+                  &status);
+      int source = requestSource[index];
+      if (--pendingChunks[source] == 0)
+        {
+        UnpackMessage(recvmessages[source], recvcount[source], this->IsNodal,
+          this->VarNames, receivedFrom[source], boundsFrom[source]);
+        }
+      }
+    if (!sendRequests.empty())
+      {
+      MPI_Waitall((int) sendRequests.size(), &sendRequests[0],
+                  MPI_STATUSES_IGNORE);
+      }
+#else
+    for (j = 0 ; j < nProcs ; j++)
+      {
+      memcpy(recvmessages[j], big_send_msg + senddisp[j], recvcount[j]);
+      UnpackMessage(recvmessages[j], recvcount[j], this->IsNodal,
+        this->VarNames, receivedFrom[j], boundsFrom[j]);
+      }
 #endif
+    delete [] big_send_msg;
+
+    if (!CMFEUtility::MaximumIntAcrossAllProcessors(morePieces))
+      {
+      break;
+      }
+    }
+  ptIds->Delete();
   delete [] sendcount;
+  delete [] recvcount;
   delete [] senddisp;
-  delete [] big_send_msg;
+  delete [] recvmessages;
 
+  // The meshes are added in the order of the processors they came from, so
+  // that the result does not depend on the order the messages arrived in.
   this->ClearAllInputMeshes();
   for (j = 0 ; j < nProcs ; j++)
     {
-    if (recvcount[j] == 0)
+    for (i = 0 ; i < receivedFrom[j].size() ; i++)
       {
-      continue;
+      this->AddMesh(receivedFrom[j][i]);
+      this->CellBounds.back().swap(boundsFrom[j][i]);
+      receivedFrom[j][i]->Delete();
       }
-
-    vtkCharArray *charArray = vtkCharArray::New();
-    int iOwnIt = 1;  // 1 means we own it -- you don't delete it.
-    charArray->SetArray(recvmessages[j], recvcount[j], iOwnIt);
-    vtkUnstructuredGridReader *reader = vtkUnstructuredGridReader::New();
-    reader->SetReadFromInputString(1);
-    reader->SetInputArray(charArray);
-    vtkUnstructuredGrid *ugrid = reader->GetOutput();
-    ugrid->Update();
-    this->AddMesh(ugrid);
-
-    reader->Delete();
-    charArray->Delete();
     }
-  delete [] recvmessages;
-  delete [] big_recv_msg;
-  delete [] recvcount;
-  delete [] recvdisp;
-
-    
+  this->MessageBuffers = receivedBuffers;
 }
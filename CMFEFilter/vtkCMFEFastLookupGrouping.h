@@ -19,6 +19,15 @@
 // in vtkCMFEDesiredPoints. Unlike vtkCMFEDesiredPoints this class doesn't restore itself
 // after redistrubtion with the spatial partition.
 //
+// The cells of unstructured meshes are found through an interval tree.
+// Image data and rectilinear grids are left out of the tree; their cells
+// are found by index arithmetic and interpolated trilinearly.
+//
+// When the values of the meshes live on scattered points, such as a point
+// cloud of vertices, the grouping can instead interpolate from the points
+// nearest to a position, or the cell centers for zonal variables, which
+// are then found through a kd-tree.
+//
 // .SECTION See Also
 // vtkCMFEPosCMFEAlgorithm, vtkCMFEDesiredPoints
 
@@ -66,12 +75,17 @@
 #define __vtkCMFEFastLookupGrouping_h
 
 #include "vtkStdString.h"
+#include <vtkstd/utility>
 #include <vtkstd/vector>
 
 class vtkCell;
 class vtkDataArray;
 class vtkDataSet;
+class vtkGenericCell;
+class vtkIdList;
+class vtkUnstructuredGrid;
 class vtkCMFEIntervalTree;
+class vtkCMFEKdTree;
 class vtkCMFESpatialPartition;
 
 class vtkCMFEFastLookupGrouping
@@ -80,6 +94,78 @@ public:
   vtkCMFEFastLookupGrouping(vtkStdString varName, bool nodal);
   virtual ~vtkCMFEFastLookupGrouping();
 
+  // Description:
+  //How values are evaluated.  CELL_CONTAINMENT interpolates within the
+  //cell that contains a position.  The other modes take the values of
+  //the points of the meshes, or of their cell centers for zonal
+  //variables: NEAREST_POINT the value of the closest one,
+  //INVERSE_DISTANCE the average of the NumberOfNeighbors closest ones
+  //weighted by their inverse squared distance, and GAUSSIAN_RADIUS the
+  //average of the ones within Radius weighted by exp(-2 d^2 / Radius^2).
+  enum Interpolations
+    {
+    CELL_CONTAINMENT = 0,
+    NEAREST_POINT = 1,
+    INVERSE_DISTANCE = 2,
+    GAUSSIAN_RADIUS = 3
+    };
+
+  //BTX
+  // Description:
+  //Scratch space used while evaluating values.  Every thread that calls
+  //GetValue needs its own search state, which makes GetValue safe to call
+  //concurrently once Finalize has been called.  The state should be
+  //created before the threads are started.  It also remembers the cell
+  //that contained the last point, which is used as a hint for the next.
+  //When Record is set, the mesh and the point ids and weights, or the cell
+  //id and a weight of 1 for cell data, that the last value was evaluated
+  //from are kept as well.  The counters add up how many points were
+  //located in a cell, were given the value of the nearest cell within the
+  //fallback tolerance, or were not found.
+  class SearchState
+  {
+  public:
+    SearchState();
+    ~SearchState();
+
+    vtkGenericCell *Cell;
+    vtkIdList *NeighborIds;
+    int LastCell;
+    vtkstd::vector<int> Neighbors;
+    vtkstd::vector<int> List;
+    vtkstd::vector<vtkstd::pair<unsigned int, int> > Order;
+    bool Record;
+    int RecordedMesh;
+    vtkstd::vector<vtkIdType> RecordedIds;
+    vtkstd::vector<double> RecordedWeights;
+    vtkstd::vector<int> Candidates;
+    vtkstd::vector<double> Weights;
+    vtkstd::vector<vtkstd::pair<double, vtkIdType> > NearestPoints;
+    vtkIdType NumberOfPointsLocated;
+    vtkIdType NumberOfPointsNearest;
+    vtkIdType NumberOfPointsMissed;
+
+  private:
+    SearchState(const SearchState&);  // Not implemented.
+    void operator=(const SearchState&);  // Not implemented.
+  };
+  //ETX
+
+  // Description:
+  //Changes the variable that is sampled.  The search structure only depends
+  //on the geometry of the meshes, so a finalized grouping can be reused to
+  //sample a different variable without rebuilding the interval tree.
+  void SetVariable(const vtkStdString &varName, bool nodal);
+
+  // Description:
+  //Samples several variables at once.  Each point is located once, and
+  //the values of all the variables are evaluated from that location and
+  //written one after the other, in the order of varNames.  Only these
+  //variables are sent along when the meshes are relocated.  The variables
+  //have to be all nodal or all zonal.  Without variables, GetValue only
+  //locates the points, which is what a recording search state needs.
+  void SetVariables(const vtkstd::vector<vtkStdString> &varNames, bool nodal);
+
   // Description:
   //Gives the fast lookup grouping object another mesh to include in the grouping.
   void AddMesh(vtkDataSet *);
@@ -92,41 +178,276 @@ public:
   //Gives the fast lookup groupin object a chance to finish its
   //initializtion process.  This gives the object the cue that it will not
   //receive any more "AddMesh" calls and that it can initialize itself.
-  void Finalize();
+  //Returns false, and reports an error, if the meshes have more cells than
+  //the interval tree can index, in which case the grouping stays
+  //unfinalized and must not be sampled.
+  bool Finalize();
+
+  // Description:
+  //Returns true if the search structure has been built and is still valid,
+  //in which case Finalize only needs to look up the arrays again.
+  bool IsFinalized() const
+    { return this->IntervalTree != NULL || this->PointTree != NULL; };
   
   // Description:
   //Evaluates the value at a position.  Does this for the grouping of
   //this->Meshes its been given and does it with fast lookups.
   //This method is actually a thin layer on top of GetValueUsingList.
-  //It calls that method using the last successful list and then, if
-  //necessary, using a list that comes from the interval tree.
-  bool GetValue(const float *point, float *value);
+  //It first tries the cell that contained the last point and the cells
+  //that share a face with it, and then, if necessary, a list that comes
+  //from the interval tree.
+  bool GetValue(const float *point, double *value);
+
+  // Description:
+  //Thread safe version of GetValue that uses the given search state instead
+  //of the state owned by the grouping.
+  bool GetValue(const float *point, double *value, SearchState &state);
   
+  // Description:
+  //Evaluates the values at a batch of n positions.  Point i is
+  //(x[i*stride], y[i*stride], z[i*stride]), so separate coordinate arrays
+  //(stride 1) as well as interleaved points (stride 3) can be passed
+  //without copying them.  The value of point i is written to
+  //values+i*nComps, where nComps has to be the total number of components
+  //of the variables, and found[i]
+  //is set to 1 if the point was located and to 0 if it was not, in which
+  //case its value is left untouched.  The points are visited along a
+  //Morton curve so that each search can start from the cell and the
+  //candidate list of the previous one.
+  void GetValues(int n, const float *x, const float *y, const float *z,
+    int stride, double *values, int nComps, unsigned char *found,
+    SearchState &state);
+
   // Description:
   //Evaluates the value at a position.  Does this for the grouping of
   //this->Meshes its been given and does it with fast lookups.
-  bool GetValueUsingList(vtkstd::vector<int> &list, const float *pt, float *val);
+  bool GetValueUsingList(vtkstd::vector<int> &list, const float *pt, double *val);
+  bool GetValueUsingList(vtkstd::vector<int> &list, const float *pt, double *val,
+    SearchState &state);
 
   // Description:
   //Relocates the data to different processors to honor the spatial 
   //partition.
   void RelocateDataUsingPartition(vtkCMFESpatialPartition *spat_pat);
+
+  // Description:
+  //Approximate number of megabytes of messages that
+  //RelocateDataUsingPartition may have in flight at once.  The meshes are
+  //exchanged in as many rounds as that takes.  0, the default, exchanges
+  //everything in a single round.
+  void SetRelocationMemoryBudget(int mb) { this->RelocationMemoryBudget = mb; };
+  int GetRelocationMemoryBudget() { return this->RelocationMemoryBudget; };
+
+  // Description:
+  //A point that no cell contains is given the value at the closest point
+  //of the nearest cell, if that is within this distance.  The candidates
+  //are the cells of the interval tree whose bounds are within the
+  //distance, and the axis aligned grids.  0, the default, turns this off.
+  void SetFallbackTolerance(double tol) { this->FallbackTolerance = tol; };
+  double GetFallbackTolerance() { return this->FallbackTolerance; };
+
+  // Description:
+  //Selects one of the Interpolations.  Going from CELL_CONTAINMENT to
+  //one of the point modes, or back, throws away the search structure.
+  void SetInterpolation(int mode);
+  int GetInterpolation() { return this->Interpolation; };
+
+  // Description:
+  //The number of points that INVERSE_DISTANCE averages, 8 by default.
+  void SetNumberOfNeighbors(int n) { this->NumberOfNeighbors = n; };
+  int GetNumberOfNeighbors() { return this->NumberOfNeighbors; };
+
+  // Description:
+  //The radius of GAUSSIAN_RADIUS.  For the other point modes, points
+  //farther away than a positive radius are not used.  0 by default.  In
+  //parallel, each processor also receives the points within the radius
+  //of its region; without a radius, it only searches the points near its
+  //region, which RelocateDataUsingPartition warns about.
+  void SetRadius(double r) { this->Radius = r; };
+  double GetRadius() { return this->Radius; };
+
+  // Description:
+  //The number of threads the kd-tree of the point modes is built with.
+  //0, the default, uses vtkMultiThreader's default.
+  void SetNumberOfThreads(int n) { this->NumberOfThreads = n; };
+  int GetNumberOfThreads() { return this->NumberOfThreads; };
   
   // Description:
   // returns the collection of this->Meshes being stored
   vtkstd::vector<vtkDataSet *> GetMeshes(void) { return this->Meshes; };  
   
 protected:
-  vtkStdString VarName;
+  //BTX
+  vtkstd::vector<vtkStdString> VarNames;
+  //ETX
   bool IsNodal;
   int NumberOfZones;
 
   vtkstd::vector<vtkDataSet *> Meshes;
   vtkCMFEIntervalTree *IntervalTree;
+  int NumberOfTreeZones;
   int *MapToDataSet;
+
+  // Description:
+  //Ghost cells stay out of the interval tree, so its elements are the
+  //first NumberOfTreeElements of the NumberOfTreeZones elements, given by
+  //TreeElements.  TreeElements is NULL when there are no ghost cells.
+  int NumberOfTreeElements;
+  int *TreeElements;
   int *DataSetStart;
-  vtkstd::vector<int> ListFromLastSuccessfulSearch;
+  SearchState *State;
+
+  // Description:
+  //The messages that relocated meshes were received in.  The arrays of
+  //those meshes point into them, so they are freed along with the meshes.
+  vtkstd::vector<char *> MessageBuffers;
+  int RelocationMemoryBudget;
+  double FallbackTolerance;
+  int Interpolation;
+  int NumberOfNeighbors;
+  double Radius;
+  int NumberOfThreads;
+
+  // Description:
+  //The kd-tree of the point modes, which is built instead of the interval
+  //tree.  Its ids number the points, or the cells for zonal variables, of
+  //all the meshes, those of mesh i starting at TupleStart[i].
+  vtkCMFEKdTree *PointTree;
+  //BTX
+  vtkstd::vector<vtkIdType> TupleStart;
+  //ETX
 
+  // Description:
+  //The bounds of the cells of each mesh, six per cell, if they are already
+  //known when the mesh is added.  Finalize uses them instead of computing
+  //them through vtkCell, and frees them once they are in the tree.
+  vtkstd::vector<vtkstd::vector<double> > CellBounds;
+
+  //BTX
+  // Description:
+  //The arrays of a mesh that are read while evaluating values, resolved to
+  //raw pointers by Finalize.  There is one SampledArray per variable; its
+  //Values is NULL, and Array is read through GetComponent, if the array
+  //type has no typed kernel.  HasArrays is false if the mesh lacks one of
+  //the variables.  A cell is a ghost if its value in Ghosts has one of the
+  //bits of GhostMask set.  Grid is set for unstructured grids with float or double
+  //points, whose cells are located with the kernels of vtkCMFECellKernels.h
+  //instead of through vtkCell.
+  struct SampledArray
+  {
+    vtkDataArray *Array;
+    const void *Values;
+    int ValueType;
+    int NumberOfComponents;
+  };
+  struct SamplingContext
+  {
+    const unsigned char *Ghosts;
+    unsigned char GhostMask;
+    vtkstd::vector<SampledArray> Arrays;
+    bool HasArrays;
+    vtkUnstructuredGrid *Grid;
+    const void *Points;
+    int PointType;
+  };
+  vtkstd::vector<SamplingContext> Contexts;
+
+  // Description:
+  //The geometry of a mesh that is image data or a rectilinear grid, with
+  //the number of points along each axis.  The coordinates of the points
+  //are either Origin plus a multiple of Spacing, or listed in increasing
+  //order in Coordinates.  The elements of these meshes are numbered after
+  //those of the interval tree.
+  struct AxisAlignedGrid
+  {
+    int Mesh;
+    int Dimensions[3];
+    bool Uniform;
+    double Origin[3];
+    double Spacing[3];
+    vtkstd::vector<double> Coordinates[3];
+  };
+  vtkstd::vector<AxisAlignedGrid> AxisGrids;
+  //ETX
+
+  // Description:
+  //Fills in grid if the mesh is image data, or a rectilinear grid with
+  //increasing coordinates, and returns whether it did.
+  bool GetAxisAlignedGrid(vtkDataSet *mesh, AxisAlignedGrid &grid);
+
+  // Description:
+  //Returns the axis aligned grid an element beyond the interval tree
+  //belongs to.
+  int GetAxisGridOfElement(int element) const;
+
+  // Description:
+  //Evaluates the value at a position if the axis aligned grid contains it.
+  bool GetValueFromAxisGrid(int grid, const double *pt, double *val,
+    SearchState &state);
+
+  // Description:
+  //Evaluates the value at parametric coordinates t of cell ijk of an axis
+  //aligned grid, unless that cell is a ghost.
+  bool EvaluateAxisGridCell(int grid, const int ijk[3], const double t[3],
+    double *val, SearchState &state);
+
+  // Description:
+  //Locates a position with the cell that contained the last point, its
+  //neighbors, the axis aligned grids and the interval tree, in that order.
+  bool LocateValue(const double *pt, double *val, SearchState &state);
+
+  // Description:
+  //Evaluates the value at the closest point of the nearest cell, if it is
+  //within FallbackTolerance of the position.
+  bool GetNearestValue(const double *pt, double *val, SearchState &state);
+
+  // Description:
+  //Builds the kd-tree of the point modes over the points of the meshes,
+  //or their cell centers for zonal variables, leaving out ghost cells.
+  void BuildPointTree();
+
+  // Description:
+  //Evaluates the value at a position from the nearest points of the
+  //kd-tree, as the point mode asks.
+  bool GetPointValue(const double *pt, double *val, SearchState &state);
+
+  // Description:
+  //Evaluates the value at a position if the given element contains it.
+  bool GetValueFromCell(int element, const double *pt, double *val,
+    SearchState &state);
+
+  // Description:
+  //Interpolates the values of the points ids[0] to ids[nPts-1] of a mesh
+  //with the given weights, or, for cell data, copies the value of a cell.
+  void EvaluateValues(int mesh, vtkIdType index, const vtkIdType *ids,
+    const double *weights, int nPts, double *val, SearchState &state);
+
+  // Description:
+  //Evaluates the value at a position if one of the cells sharing a face
+  //with the given element contains it.
+  bool GetValueFromNeighbors(int element, const double *pt, double *val,
+    SearchState &state);
+
+  // Description:
+  //Looks up the ghost zone array and the array of the variable of every
+  //mesh, so that GetValueFromCell does not have to look them up by name.
+  void PrepareSamplingContexts();
+
+  // Description:
+  //Fills list with the elements of the interval tree whose bounds overlap
+  //the box from lo to hi.
+  void SearchTree(const double *lo, const double *hi, vtkstd::vector<int> &list);
+
+  // Description:
+  //Throws away the interval tree, or the kd-tree, and the lookup tables
+  //that go with it.
+  void ReleaseSearchStructure();
+
+  // Description:
+  //How far beyond its region a processor may look for the cells that
+  //give the values of its points.  RelocateDataUsingPartition sends a
+  //cell to every processor whose region is within this distance of it.
+  double GetRelocationMargin();
 
 private:
   vtkCMFEFastLookupGrouping(const vtkCMFEFastLookupGrouping&);  // Not implemented.
@@ -17,28 +17,407 @@
 #include "vtkCMFEFilter.h"
 
 #include "vtkCMFEAlgorithm.h"
+#include "vtkCMFEFastLookupGrouping.h"
+#include "vtkCMFERemapOperator.h"
+#include "vtkCMFEUtility.h"
+#include "vtkCellData.h"
+#include "vtkCompositeDataIterator.h"
+#include "vtkCompositeDataSet.h"
 #include "vtkDataArray.h"
 #include "vtkDataSet.h"
 #include "vtkInformation.h"
 #include "vtkInformationVector.h"
 #include "vtkObjectFactory.h"
+#include "vtkPointData.h"
 #include "vtkStdString.h"
 #include "vtkStreamingDemandDrivenPipeline.h"
 
 #include <sstream>
+#include <vtkstd/algorithm>
 vtkStandardNewMacro(vtkCMFEFilter);
 
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Appends the dataset, or the datasets that are the leaves of the
+  // composite dataset, in the order of a traversal.
+  void GetLeaves(vtkDataObject *dobj, vtkstd::vector<vtkDataSet *> &leaves)
+  {
+    vtkCompositeDataSet *composite = vtkCompositeDataSet::SafeDownCast(dobj);
+    if ( !composite )
+      {
+      if ( vtkDataSet::SafeDownCast(dobj) )
+        {
+        leaves.push_back(vtkDataSet::SafeDownCast(dobj));
+        }
+      return;
+      }
+    vtkCompositeDataIterator *iter = composite->NewIterator();
+    iter->SkipEmptyNodesOn();
+    for (iter->InitTraversal(); !iter->IsDoneWithTraversal(); iter->GoToNextItem())
+      {
+      vtkDataSet *ds = vtkDataSet::SafeDownCast(iter->GetCurrentDataObject());
+      if ( ds )
+        {
+        leaves.push_back(ds);
+        }
+      }
+    iter->Delete();
+  }
+
+  //----------------------------------------------------------------------------
+  bool HasArray(const vtkstd::vector<vtkDataSet *> &leaves, const char *name)
+  {
+    for (size_t i = 0 ; i < leaves.size() ; i++)
+      {
+      if ( leaves[i]->GetPointData()->GetArray(name) ||
+           leaves[i]->GetCellData()->GetArray(name) )
+        {
+        return true;
+        }
+      }
+    return false;
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkCMFEFilter::vtkCMFEFilter( )
 {
   this->SetNumberOfInputPorts(2);
+  this->CacheLookup = 1;
+  this->NumberOfThreads = 0;
+  this->RelocationMemoryBudget = 0;
+  this->PartitionMethod = 0;
+  this->PointWeight = 1.;
+  this->RemoveAllCellWeights();
+  this->UseMeasuredCosts = 0;
+  this->MeasuredPointCost = 0.;
+  this->MeasuredCellCost = 0.;
+  this->LookupCache = NULL;
+  this->CachedMesh = NULL;
+  this->CachedMeshGeometryMTime = 0;
+  this->CachedMeshNumberOfPoints = 0;
+  this->CachedMeshNumberOfCells = 0;
+  for (int i = 0 ; i < 6 ; i++)
+    {
+    this->CachedMeshBounds[i] = 0.;
+    }
+  this->UseRemapOperator = 0;
+  this->RemapOperatorFileName = NULL;
+  this->RemapOperator = NULL;
+  this->RemapMesh = NULL;
+  this->RemapTarget = NULL;
+  this->RemapMeshGeometryMTime = 0;
+  this->RemapTargetGeometryMTime = 0;
+  this->FallbackTolerance = 0.;
+  this->Interpolation = 0;
+  this->NumberOfNeighbors = 8;
+  this->Radius = 0.;
+  this->NumberOfPointsLocated = 0;
+  this->NumberOfPointsNearest = 0;
+  this->NumberOfPointsMissed = 0;
 }
 
 //----------------------------------------------------------------------------
 vtkCMFEFilter::~vtkCMFEFilter()
 {
+  this->ReleaseLookupCache();
+  this->ReleaseRemapOperator();
+  this->SetRemapOperatorFileName(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::ReleaseLookupCache()
+{
+  delete this->LookupCache;
+  this->LookupCache = NULL;
+  this->CachedMesh = NULL;
+}
+
+//----------------------------------------------------------------------------
+vtkCMFEFastLookupGrouping *vtkCMFEFilter::GetLookupCache(vtkDataSet *mesh,
+  const char *varName, bool isNodal)
+{
+  unsigned long geomMTime = CMFEUtility::GetGeometryMTime(mesh);
+  double bounds[6];
+  mesh->GetBounds(bounds);
+
+  // The cache is keyed on the mesh and its geometry. The grouping holds a
+  // reference to the mesh, so the pointer can not be reused by another
+  // dataset while the cache is alive.
+  bool valid = (this->LookupCache != NULL && this->CachedMesh == mesh &&
+    this->CachedMeshGeometryMTime == geomMTime &&
+    this->CachedMeshNumberOfPoints == mesh->GetNumberOfPoints() &&
+    this->CachedMeshNumberOfCells == mesh->GetNumberOfCells());
+  for (int i = 0 ; valid && i < 6 ; i++)
+    {
+    valid = (this->CachedMeshBounds[i] == bounds[i]);
+    }
+  if (valid)
+    {
+    return this->LookupCache;
+    }
+
+  this->ReleaseLookupCache();
+  this->LookupCache = new vtkCMFEFastLookupGrouping(varName, isNodal);
+  this->CachedMesh = mesh;
+  this->CachedMeshGeometryMTime = geomMTime;
+  this->CachedMeshNumberOfPoints = mesh->GetNumberOfPoints();
+  this->CachedMeshNumberOfCells = mesh->GetNumberOfCells();
+  for (int i = 0 ; i < 6 ; i++)
+    {
+    this->CachedMeshBounds[i] = bounds[i];
+    }
+  return this->LookupCache;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::SetFallbackTolerance(double tol)
+{
+  tol = vtkstd::max(tol, 0.);
+  if ( this->FallbackTolerance != tol )
+    {
+    // The kept weights depend on the tolerance.
+    this->FallbackTolerance = tol;
+    this->ReleaseRemapOperator();
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::SetInterpolation(int mode)
+{
+  mode = vtkstd::min(vtkstd::max(mode, 0), 3);
+  if ( this->Interpolation != mode )
+    {
+    // The kept weights depend on the interpolation, and so does the search
+    // structure.
+    this->Interpolation = mode;
+    this->ReleaseRemapOperator();
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::SetNumberOfNeighbors(int n)
+{
+  n = vtkstd::max(n, 1);
+  if ( this->NumberOfNeighbors != n )
+    {
+    this->NumberOfNeighbors = n;
+    this->ReleaseRemapOperator();
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::SetRadius(double r)
+{
+  r = vtkstd::max(r, 0.);
+  if ( this->Radius != r )
+    {
+    this->Radius = r;
+    this->ReleaseRemapOperator();
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::ReleaseRemapOperator()
+{
+  delete this->RemapOperator;
+  this->RemapOperator = NULL;
+  this->RemapMesh = NULL;
+  this->RemapTarget = NULL;
+  for (size_t i = 0 ; i < this->RemapResults.size() ; i++)
+    {
+    this->RemapResults[i].Result->Delete();
+    }
+  this->RemapResults.clear();
+}
 
+//----------------------------------------------------------------------------
+vtkCMFERemapOperator *vtkCMFEFilter::GetRemapOperator(vtkDataSet *mesh,
+  vtkDataSet *target, const char *varName, bool isNodal)
+{
+  unsigned long meshMTime = CMFEUtility::GetGeometryMTime(mesh);
+  unsigned long targetMTime = CMFEUtility::GetGeometryMTime(target);
+  vtkIdType nDonors = (isNodal ? mesh->GetNumberOfPoints() : mesh->GetNumberOfCells());
+  vtkIdType nTargets = (isNodal ? target->GetNumberOfPoints() : target->GetNumberOfCells());
 
+  // The weights are keyed on both meshes and their geometry.  A dataset
+  // that reuses the pointer of a released one has a newer geometry.
+  if ( this->RemapOperator && this->RemapMesh == mesh &&
+       this->RemapTarget == target &&
+       this->RemapMeshGeometryMTime == meshMTime &&
+       this->RemapTargetGeometryMTime == targetMTime &&
+       this->RemapOperator->GetIsNodal() == isNodal &&
+       this->RemapOperator->GetNumberOfDonors() == nDonors &&
+       this->RemapOperator->GetNumberOfTargets() == nTargets )
+    {
+    return this->RemapOperator;
+    }
+
+  this->ReleaseRemapOperator();
+  vtkCMFERemapOperator *op = new vtkCMFERemapOperator;
+
+  // Weights read from a file are only checked against the sizes of the
+  // meshes, it is up to the user to give the file of the same meshes.
+  bool done = false;
+  if ( this->RemapOperatorFileName && this->RemapOperatorFileName[0] &&
+       op->Read(this->RemapOperatorFileName) )
+    {
+    done = (op->GetIsNodal() == isNodal &&
+            op->GetNumberOfDonors() == nDonors &&
+            op->GetNumberOfTargets() == nTargets);
+    if ( !done )
+      {
+      vtkWarningMacro("The interpolation weights in "
+        << this->RemapOperatorFileName << " do not match the meshes");
+      }
+    }
+
+  if ( !done )
+    {
+    vtkCMFEFastLookupGrouping *localFlg = NULL;
+    vtkCMFEFastLookupGrouping *flg = NULL;
+    if ( this->CacheLookup )
+      {
+      flg = this->GetLookupCache(mesh, varName, isNodal);
+      if ( flg->GetMeshes().size() == 0 )
+        {
+        flg->AddMesh( mesh );
+        }
+      }
+    else
+      {
+      flg = localFlg = new vtkCMFEFastLookupGrouping(varName, isNodal);
+      localFlg->AddMesh( mesh );
+      }
+    flg->SetFallbackTolerance( this->FallbackTolerance );
+    flg->SetInterpolation( this->Interpolation );
+    flg->SetNumberOfNeighbors( this->NumberOfNeighbors );
+    flg->SetRadius( this->Radius );
+    flg->SetNumberOfThreads( this->NumberOfThreads );
+    done = op->Build(flg, target, isNodal);
+    delete localFlg;
+
+    if ( done && this->RemapOperatorFileName && this->RemapOperatorFileName[0] &&
+         !op->Write(this->RemapOperatorFileName) )
+      {
+      vtkWarningMacro("Unable to write the interpolation weights to "
+        << this->RemapOperatorFileName);
+      }
+    }
+
+  if ( !done )
+    {
+    delete op;
+    return NULL;
+    }
+  this->RemapOperator = op;
+  this->RemapMesh = mesh;
+  this->RemapTarget = target;
+  this->RemapMeshGeometryMTime = meshMTime;
+  this->RemapTargetGeometryMTime = targetMTime;
+  return op;
+}
+
+//----------------------------------------------------------------------------
+vtkDataSet *vtkCMFEFilter::ExecuteRemapOperator(vtkDataSet *target,
+  vtkDataSet *mesh, const vtkstd::vector<vtkstd::string> &outputVars,
+  const vtkstd::vector<vtkstd::string> &meshVars,
+  const vtkstd::vector<vtkstd::string> &outVars)
+{
+  // The weights interpolate either the points or the cells of the mesh, so
+  // all the arrays must have the centering of the first one.
+  bool isNodal = (mesh->GetPointData()->GetArray(meshVars[0].c_str()) != NULL);
+  vtkDataSetAttributes *meshData = (isNodal ?
+    static_cast<vtkDataSetAttributes *>(mesh->GetPointData()) :
+    static_cast<vtkDataSetAttributes *>(mesh->GetCellData()));
+  for (size_t i = 0 ; i < meshVars.size() ; i++)
+    {
+    if ( !meshData->GetArray(meshVars[i].c_str()) )
+      {
+      return NULL;
+      }
+    }
+
+  vtkCMFERemapOperator *op = this->GetRemapOperator(mesh, target,
+    meshVars[0].c_str(), isNodal);
+  if ( !op )
+    {
+    return NULL;
+    }
+
+  vtkDataSet *output = target->NewInstance();
+  output->ShallowCopy( target );
+  vtkstd::vector<RemapResult> results;
+  int nReused = 0;
+  for (size_t i = 0 ; i < meshVars.size() ; i++)
+    {
+    // As in vtkCMFEAlgorithm, the array of the target of the given name
+    // fills in the points that could not be located.
+    vtkDataArray *fallback = target->GetPointData()->GetArray( outputVars[i].c_str() );
+    if ( !fallback )
+      {
+      fallback = target->GetCellData()->GetArray( outputVars[i].c_str() );
+      }
+    vtkDataArray *donor = meshData->GetArray( meshVars[i].c_str() );
+
+    // The result of the last execution still holds if the weights and the
+    // arrays it was computed from are the same.  An array that replaces a
+    // deleted one at the same address has a newer modification time.
+    RemapResult entry;
+    entry.Name = outVars[i];
+    entry.Donor = donor;
+    entry.DonorMTime = donor->GetMTime();
+    entry.Fallback = fallback;
+    entry.FallbackMTime = (fallback ? fallback->GetMTime() : 0);
+    entry.Result = NULL;
+    for (size_t j = 0 ; j < this->RemapResults.size() ; j++)
+      {
+      RemapResult &old = this->RemapResults[j];
+      if ( old.Result && old.Name == entry.Name && old.Donor == entry.Donor &&
+           old.DonorMTime == entry.DonorMTime &&
+           old.Fallback == entry.Fallback &&
+           old.FallbackMTime == entry.FallbackMTime )
+        {
+        entry.Result = old.Result;
+        old.Result = NULL;
+        nReused++;
+        break;
+        }
+      }
+    if ( !entry.Result )
+      {
+      entry.Result = op->Apply(donor, fallback, outVars[i].c_str(),
+        this->NumberOfThreads);
+      }
+    if ( entry.Result )
+      {
+      (isNodal)? output->GetPointData()->AddArray( entry.Result ) : output->GetCellData()->AddArray( entry.Result );
+      results.push_back( entry );
+      }
+    else
+      {
+      vtkWarningMacro("Unable to map the array " << meshVars[i].c_str()
+        << " with the kept interpolation weights");
+      }
+    }
+
+  // Results that were not asked for this time are dropped.
+  for (size_t j = 0 ; j < this->RemapResults.size() ; j++)
+    {
+    if ( this->RemapResults[j].Result )
+      {
+      this->RemapResults[j].Result->Delete();
+      }
+    }
+  this->RemapResults.swap( results );
+  vtkDebugMacro("Mapped " << meshVars.size() - nReused << " arrays with the "
+    "kept interpolation weights and reused " << nReused);
+  return output;
 }
 
 //----------------------------------------------------------------------------
@@ -47,6 +426,63 @@ void vtkCMFEFilter::SetSourceConnection(vtkAlgorithmOutput* algOutput)
   this->SetInputConnection(1, algOutput);
 }
 
+//----------------------------------------------------------------------------
+vtkDataArray *vtkCMFEFilter::GetLeafArrayToProcess(int idx,
+  const vtkstd::vector<vtkDataSet *> &leaves)
+{
+  for (size_t i = 0 ; i < leaves.size() ; i++)
+    {
+    vtkDataArray *arr = this->GetInputArrayToProcess(idx, leaves[i]);
+    if ( arr )
+      {
+      return arr;
+      }
+    }
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+int vtkCMFEFilter::FillInputPortInformation(int vtkNotUsed(port),
+  vtkInformation *info)
+{
+  info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkDataSet");
+  info->Append(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkCompositeDataSet");
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkCMFEFilter::FillOutputPortInformation(int vtkNotUsed(port),
+  vtkInformation *info)
+{
+  info->Set(vtkDataObject::DATA_TYPE_NAME(), "vtkDataObject");
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkCMFEFilter::RequestDataObject(vtkInformation *vtkNotUsed(request),
+  vtkInformationVector **inputVector, vtkInformationVector *outputVector)
+{
+  // The output is the mesh that is mapped to with the results added, so it
+  // has its type, composite or not.
+  vtkInformation *sourceInfo = inputVector[1]->GetInformationObject(0);
+  vtkDataObject *source = (sourceInfo ?
+    sourceInfo->Get(vtkDataObject::DATA_OBJECT()) : NULL);
+  if ( !source )
+    {
+    return 0;
+    }
+
+  vtkInformation *outInfo = outputVector->GetInformationObject(0);
+  vtkDataObject *output = outInfo->Get(vtkDataObject::DATA_OBJECT());
+  if ( !output || !output->IsA(source->GetClassName()) )
+    {
+    output = source->NewInstance();
+    output->SetPipelineInformation(outInfo);
+    output->Delete();
+    }
+  return 1;
+}
+
 //----------------------------------------------------------------------------
 int vtkCMFEFilter::RequestInformation(vtkInformation *vtkNotUsed(request),
   vtkInformationVector **vtkNotUsed(inputVector),
@@ -69,28 +505,26 @@ int vtkCMFEFilter::RequestData(vtkInformation *vtkNotUsed(request),
   vtkInformation *sourceInfo = inputVector[1]->GetInformationObject(0);
   vtkInformation *outInfo = outputVector->GetInformationObject(0);
 
-  // get the input and output
-  vtkDataSet *input = vtkDataSet::SafeDownCast(
-    inInfo->Get(vtkDataObject::DATA_OBJECT()));
-  vtkDataSet *source = vtkDataSet::SafeDownCast(
-    sourceInfo->Get(vtkDataObject::DATA_OBJECT()));
-  vtkDataSet *output = vtkDataSet::SafeDownCast(
-    outInfo->Get(vtkDataObject::DATA_OBJECT()));
-
+  // get the input and output.  Composite datasets are mapped block by
+  // block, without merging them.
+  vtkDataObject *inputObj = inInfo->Get(vtkDataObject::DATA_OBJECT());
+  vtkDataObject *sourceObj = sourceInfo->Get(vtkDataObject::DATA_OBJECT());
+  vtkDataObject *outputObj = outInfo->Get(vtkDataObject::DATA_OBJECT());
 
-  if (!source || !input )
+  if (!sourceObj || !inputObj )
     {
     vtkErrorMacro("Source or Input was not found");
     return 0;
     }
 
-  //get the input arrays to mesh
-  vtkDataArray *inputProp = this->GetInputArrayToProcess(0,
-    inInfo->Get(vtkDataObject::DATA_OBJECT()));
-  vtkDataArray *sourceProp = this->GetInputArrayToProcess(1,
-    sourceInfo->Get(vtkDataObject::DATA_OBJECT()));
-
+  vtkstd::vector<vtkDataSet *> inputs;
+  vtkstd::vector<vtkDataSet *> sources;
+  GetLeaves(inputObj, inputs);
+  GetLeaves(sourceObj, sources);
 
+  //get the input arrays to mesh
+  vtkDataArray *inputProp = this->GetLeafArrayToProcess(0, inputs);
+  vtkDataArray *sourceProp = this->GetLeafArrayToProcess(1, sources);
 
   if ( !inputProp || !sourceProp )
     {
@@ -104,18 +538,213 @@ int vtkCMFEFilter::RequestData(vtkInformation *vtkNotUsed(request),
     outputName +="Result";
     }
 
-  vtkDataSet *temp = vtkCMFEAlgorithm::PerformCMFE( source, input , sourceProp->GetName(),
-    inputProp->GetName(), outputName );
+  // The selected array comes first, followed by the other arrays to map.
+  vtkstd::vector<vtkstd::string> outputVars(1, sourceProp->GetName());
+  vtkstd::vector<vtkstd::string> meshVars(1, inputProp->GetName());
+  vtkstd::vector<vtkstd::string> outVars(1, outputName);
+  for (size_t i = 0 ; i < this->ArraysToMap.size() ; i++)
+    {
+    const vtkStdString &name = this->ArraysToMap[i];
+    if ( name == inputProp->GetName() ||
+         vtkstd::find(meshVars.begin(), meshVars.end(), name) != meshVars.end() )
+      {
+      continue;
+      }
+    if ( !HasArray(inputs, name.c_str()) )
+      {
+      vtkWarningMacro("Unable to find the array " << name.c_str() << " to map");
+      continue;
+      }
+    vtkStdString resultName = name;
+    if ( HasArray(sources, name.c_str()) )
+      {
+      resultName += "Result";
+      }
+    outputVars.push_back(name);
+    meshVars.push_back(name);
+    outVars.push_back(resultName);
+    }
+
+  // The cached structures are built for a single mesh on either side.
+  bool singleMeshes = ( !vtkCompositeDataSet::SafeDownCast(inputObj) &&
+                        !vtkCompositeDataSet::SafeDownCast(sourceObj) );
+
+  // Serially, the arrays can be mapped with kept interpolation weights.
+  if ( this->UseRemapOperator && singleMeshes && CMFEUtility::PAR_Size() == 1 )
+    {
+    vtkDataSet *temp = this->ExecuteRemapOperator( sources[0], inputs[0],
+      outputVars, meshVars, outVars );
+    if ( temp )
+      {
+      outputObj->ShallowCopy( temp );
+      temp->Delete();
+      this->NumberOfPointsLocated = this->RemapOperator->GetNumberOfPointsLocated();
+      this->NumberOfPointsNearest = this->RemapOperator->GetNumberOfPointsNearest();
+      this->NumberOfPointsMissed = this->RemapOperator->GetNumberOfPointsMissed();
+      return 1;
+      }
+    }
+  else
+    {
+    this->ReleaseRemapOperator();
+    }
 
-  output->ShallowCopy( temp );
-  temp->Delete();
+  vtkCMFEAlgorithm alg;
+  alg.SetNumberOfThreads( this->NumberOfThreads );
+  alg.SetRelocationMemoryBudget( this->RelocationMemoryBudget );
+  alg.SetPartitionMethod( this->PartitionMethod );
+  alg.SetPointWeight( this->PointWeight );
+  alg.SetFallbackTolerance( this->FallbackTolerance );
+  alg.SetInterpolation( this->Interpolation );
+  alg.SetNumberOfNeighbors( this->NumberOfNeighbors );
+  alg.SetRadius( this->Radius );
+  for (int i = 0 ; i < VTK_NUMBER_OF_CELL_TYPES ; i++)
+    {
+    if ( this->CellWeights[i] != 1. )
+      {
+      alg.SetCellWeight( i, this->CellWeights[i] );
+      }
+    }
+  if ( this->UseMeasuredCosts )
+    {
+    alg.SetMeasuredCosts( this->MeasuredPointCost, this->MeasuredCellCost );
+    }
+  if ( this->CacheLookup && singleMeshes )
+    {
+    bool isNodal = (inputs[0]->GetPointData()->GetArray(inputProp->GetName()) != NULL);
+    alg.SetLookupCache( this->GetLookupCache(inputs[0], inputProp->GetName(), isNodal) );
+    }
+  else
+    {
+    this->ReleaseLookupCache();
+    }
+
+  vtkstd::vector<vtkDataSet *> results = alg.Execute( sources, inputs,
+    outputVars, meshVars, outVars );
+  if ( results.size() != sources.size() )
+    {
+    vtkErrorMacro("Unable to evaluate the mesh to map from");
+    return 0;
+    }
+  this->NumberOfPointsLocated = alg.GetNumberOfPointsLocated();
+  this->NumberOfPointsNearest = alg.GetNumberOfPointsNearest();
+  this->NumberOfPointsMissed = alg.GetNumberOfPointsMissed();
+  vtkDebugMacro("Located " << this->NumberOfPointsLocated
+    << " points, took the nearest cell for " << this->NumberOfPointsNearest
+    << " and missed " << this->NumberOfPointsMissed);
+  if ( alg.GetMeasuredPointCost() > 0. && alg.GetMeasuredCellCost() > 0. )
+    {
+    this->MeasuredPointCost = alg.GetMeasuredPointCost();
+    this->MeasuredCellCost = alg.GetMeasuredCellCost();
+    }
+
+  // The results go back into a composite dataset of the same structure,
+  // in the order the blocks were traversed.
+  vtkCompositeDataSet *sourceComposite = vtkCompositeDataSet::SafeDownCast(sourceObj);
+  if ( sourceComposite )
+    {
+    vtkCompositeDataSet *output = vtkCompositeDataSet::SafeDownCast(outputObj);
+    output->CopyStructure( sourceComposite );
+    vtkCompositeDataIterator *iter = sourceComposite->NewIterator();
+    iter->SkipEmptyNodesOn();
+    size_t leaf = 0;
+    for (iter->InitTraversal(); !iter->IsDoneWithTraversal(); iter->GoToNextItem())
+      {
+      if ( vtkDataSet::SafeDownCast(iter->GetCurrentDataObject()) )
+        {
+        output->SetDataSet( iter, results[leaf++] );
+        }
+      }
+    iter->Delete();
+    }
+  else
+    {
+    outputObj->ShallowCopy( results[0] );
+    }
+  for (size_t i = 0 ; i < results.size() ; i++)
+    {
+    results[i]->Delete();
+    }
 
   return 1;
 
 }
 
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::AddArrayToMap(const char *name)
+{
+  if ( name )
+    {
+    this->ArraysToMap.push_back(name);
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::RemoveAllArraysToMap()
+{
+  if ( !this->ArraysToMap.empty() )
+    {
+    this->ArraysToMap.clear();
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::SetCellWeight(int cellType, double weight)
+{
+  if ( cellType >= 0 && cellType < VTK_NUMBER_OF_CELL_TYPES &&
+       this->CellWeights[cellType] != weight )
+    {
+    this->CellWeights[cellType] = weight;
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkCMFEFilter::GetCellWeight(int cellType)
+{
+  if ( cellType >= 0 && cellType < VTK_NUMBER_OF_CELL_TYPES )
+    {
+    return this->CellWeights[cellType];
+    }
+  return 1.;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEFilter::RemoveAllCellWeights()
+{
+  for (int i = 0 ; i < VTK_NUMBER_OF_CELL_TYPES ; i++)
+    {
+    this->CellWeights[i] = 1.;
+    }
+  this->Modified();
+}
+
 //----------------------------------------------------------------------------
 void vtkCMFEFilter::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os,indent);
+  os << indent << "CacheLookup: " << this->CacheLookup << endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << endl;
+  os << indent << "RelocationMemoryBudget: " << this->RelocationMemoryBudget << endl;
+  os << indent << "PartitionMethod: " << this->PartitionMethod << endl;
+  os << indent << "PointWeight: " << this->PointWeight << endl;
+  os << indent << "UseMeasuredCosts: " << this->UseMeasuredCosts << endl;
+  os << indent << "ArraysToMap:";
+  for (size_t i = 0 ; i < this->ArraysToMap.size() ; i++)
+    {
+    os << " " << this->ArraysToMap[i].c_str();
+    }
+  os << endl;
+  os << indent << "UseRemapOperator: " << this->UseRemapOperator << endl;
+  os << indent << "FallbackTolerance: " << this->FallbackTolerance << endl;
+  os << indent << "Interpolation: " << this->Interpolation << endl;
+  os << indent << "NumberOfNeighbors: " << this->NumberOfNeighbors << endl;
+  os << indent << "Radius: " << this->Radius << endl;
+  os << indent << "NumberOfPointsLocated: " << this->NumberOfPointsLocated << endl;
+  os << indent << "NumberOfPointsNearest: " << this->NumberOfPointsNearest << endl;
+  os << indent << "NumberOfPointsMissed: " << this->NumberOfPointsMissed << endl;
+  os << indent << "RemapOperatorFileName: "
+     << (this->RemapOperatorFileName ? this->RemapOperatorFileName : "(none)") << endl;
 }
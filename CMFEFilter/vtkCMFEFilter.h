@@ -18,7 +18,16 @@
 
 #include "vtkCMFEExport.h"
 #include "vtkDataSetAlgorithm.h"
+#include "vtkCellType.h"
 #include "vtkMultiProcessController.h"
+#include "vtkStdString.h"
+
+#include <vtkstd/vector>
+
+class vtkCMFEFastLookupGrouping;
+class vtkCMFERemapOperator;
+class vtkDataArray;
+class vtkDataSet;
 
 class CMFEFILTER_EXPORT vtkCMFEFilter : public vtkDataSetAlgorithm
 {
@@ -28,16 +37,237 @@ public:
   void PrintSelf(ostream& os, vtkIndent indent);
 
   // Description:
-  // Specify the source connection object
+  // Specify the source connection object.  Both the mesh to map from and
+  // the mesh to map to may be composite datasets, whose blocks are used
+  // as they are; the output then has the structure of the mesh to map to.
   void SetSourceConnection(vtkAlgorithmOutput* algOutput);
 
+  // Description:
+  // When on, the search structure built over the mesh that is mapped from
+  // is kept between executions and reused as long as the geometry of that
+  // mesh does not change.  Changing the selected arrays or the mesh that is
+  // mapped to then does not require the interval tree to be rebuilt.
+  // Only used when running on a single processor.  On by default.
+  vtkSetMacro(CacheLookup, int);
+  vtkGetMacro(CacheLookup, int);
+  vtkBooleanMacro(CacheLookup, int);
+
+  // Description:
+  // Number of threads used to evaluate the sample points.  A value of 0
+  // uses the default number of threads of vtkMultiThreader.  Default is 0.
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+
+  // Description:
+  // Approximate number of megabytes of messages that each processor may
+  // have in flight at once while the source mesh is redistributed in
+  // parallel.  The mesh is exchanged in as many rounds as that takes.
+  // A value of 0 exchanges it in one round.  Default is 0.
+  vtkSetMacro(RelocationMemoryBudget, int);
+  vtkGetMacro(RelocationMemoryBudget, int);
+
+  // Description:
+  // How space is partitioned among the processors when running in
+  // parallel: 0 recursively bisects it, 1 cuts a space filling curve into
+  // pieces, which takes fewer collective calls on many processors.
+  // Default is 0.
+  vtkSetClampMacro(PartitionMethod, int, 0, 1);
+  vtkGetMacro(PartitionMethod, int);
+
+  // Description:
+  // When running in parallel, the mesh to map from and the points to map to
+  // are partitioned so that every processor gets the same cost.  These are
+  // the cost of a point to map to, and of a cell of the given type of the
+  // mesh to map from.  They all default to 1.
+  vtkSetMacro(PointWeight, double);
+  vtkGetMacro(PointWeight, double);
+  void SetCellWeight(int cellType, double weight);
+  double GetCellWeight(int cellType);
+  void RemoveAllCellWeights();
+
+  // Description:
+  // When on, the time per point and per cell measured by the previous
+  // parallel execution scales the point weight, so that the partition
+  // balances the work that was actually done.  Off by default.
+  vtkSetMacro(UseMeasuredCosts, int);
+  vtkGetMacro(UseMeasuredCosts, int);
+  vtkBooleanMacro(UseMeasuredCosts, int);
+
+  // Description:
+  // Further arrays of the mesh to map from that are mapped along with the
+  // selected one, in the same pass, so that the points are only located
+  // once.  Each result is named after its array, with "Result" appended if
+  // the mesh to map to already has an array of that name, which then
+  // fills in the points that could not be located.  Points of the other
+  // results that could not be located are set to 0.
+  void AddArrayToMap(const char *name);
+  void RemoveAllArraysToMap();
+
+  // Description:
+  // Releases the cached search structure.
+  void ReleaseLookupCache();
+
+  // Description:
+  // When on, the weights that interpolate the mesh to map from at the
+  // points to map to are kept after they have been computed once, and
+  // later executions only take weighted sums of the new values as long as
+  // the geometry of both meshes is unchanged.  This pays off when mapping
+  // many time steps of a fixed mesh.  The results are kept as well, and an
+  // array whose values, and those of the array of the mesh to map to that
+  // fills in its missing points, are unchanged since the last execution
+  // keeps its result, so only the arrays that changed are mapped again.
+  // Only used when running on a single processor and when all the arrays
+  // to map have the centering of the selected one.  Off by default.
+  vtkSetMacro(UseRemapOperator, int);
+  vtkGetMacro(UseRemapOperator, int);
+  vtkBooleanMacro(UseRemapOperator, int);
+
+  // Description:
+  // File the interpolation weights are read from, when it matches the
+  // meshes, or written to after they have been computed.  Lets another
+  // session skip locating the points altogether.  Only used with
+  // UseRemapOperator.  None by default.
+  vtkSetStringMacro(RemapOperatorFileName);
+  vtkGetStringMacro(RemapOperatorFileName);
+
+  // Description:
+  // Releases the kept interpolation weights.
+  void ReleaseRemapOperator();
+
+  // Description:
+  // Distance within which a point to map to that is outside of every cell
+  // of the mesh to map from takes the value at the closest point of the
+  // nearest cell, rather than the value of the mesh to map to.  0 turns
+  // this off.  Default is 0.
+  void SetFallbackTolerance(double tol);
+  vtkGetMacro(FallbackTolerance, double);
+
+  // Description:
+  // How the mesh to map from is evaluated.  0 interpolates within the cell
+  // that contains a point to map to.  The other modes suit point clouds:
+  // they take the values of the points of the mesh to map from, or of its
+  // cell centers for cell data, that are nearest to a point to map to.  1
+  // takes the value of the closest one, 2 averages the NumberOfNeighbors
+  // closest ones weighted by their inverse squared distance, and 3
+  // averages the ones within Radius with Gaussian weights.  Default is 0.
+  void SetInterpolation(int mode);
+  vtkGetMacro(Interpolation, int);
+
+  // Description:
+  // The number of points that inverse distance interpolation averages.
+  // Default is 8.
+  void SetNumberOfNeighbors(int n);
+  vtkGetMacro(NumberOfNeighbors, int);
+
+  // Description:
+  // The radius of Gaussian interpolation.  With the other point modes,
+  // points farther away than a positive radius are not used.  Default
+  // is 0.
+  void SetRadius(double r);
+  vtkGetMacro(Radius, double);
+
+  // Description:
+  // The number of points to map to that the last execution located in a
+  // cell, or interpolated from points, gave the value of the nearest cell,
+  // and did not find.  With kept interpolation weights, they are the
+  // counts of the execution that computed the weights; weights read from
+  // a file count every point that was found as located.
+  vtkGetMacro(NumberOfPointsLocated, vtkIdType);
+  vtkGetMacro(NumberOfPointsNearest, vtkIdType);
+  vtkGetMacro(NumberOfPointsMissed, vtkIdType);
+
 protected:
   vtkCMFEFilter();
   ~vtkCMFEFilter();
 
+  int FillInputPortInformation(int port, vtkInformation *info);
+  int FillOutputPortInformation(int port, vtkInformation *info);
+  int RequestDataObject(vtkInformation *, vtkInformationVector **, vtkInformationVector *);
   int RequestInformation(vtkInformation *, vtkInformationVector **, vtkInformationVector *);
   int RequestData(vtkInformation *, vtkInformationVector **, vtkInformationVector *);
 
+  // Description:
+  // Returns the selected array of the first of the datasets that has it.
+  //BTX
+  vtkDataArray *GetLeafArrayToProcess(int idx,
+    const vtkstd::vector<vtkDataSet *> &leaves);
+  //ETX
+
+  // Description:
+  // Returns the cached search structure for the given mesh, creating a new
+  // one when the cached structure was built for a different mesh or the
+  // geometry of the mesh has changed since.
+  vtkCMFEFastLookupGrouping *GetLookupCache(vtkDataSet *mesh,
+    const char *varName, bool isNodal);
+
+  // Description:
+  // Returns the interpolation weights from the given mesh to the points or
+  // cells of the target, computing them when the kept weights were
+  // computed for different meshes.  Returns NULL when they can not be
+  // computed.
+  vtkCMFERemapOperator *GetRemapOperator(vtkDataSet *mesh,
+    vtkDataSet *target, const char *varName, bool isNodal);
+
+  // Description:
+  // Maps the arrays with the interpolation weights.  Returns NULL when
+  // they do not apply, in which case the arrays are mapped as usual.
+  //BTX
+  vtkDataSet *ExecuteRemapOperator(vtkDataSet *target, vtkDataSet *mesh,
+    const vtkstd::vector<vtkstd::string> &outputVars,
+    const vtkstd::vector<vtkstd::string> &meshVars,
+    const vtkstd::vector<vtkstd::string> &outVars);
+  //ETX
+
+  int CacheLookup;
+  int NumberOfThreads;
+  int RelocationMemoryBudget;
+  int PartitionMethod;
+  double PointWeight;
+  double CellWeights[VTK_NUMBER_OF_CELL_TYPES];
+  int UseMeasuredCosts;
+  double MeasuredPointCost;
+  double MeasuredCellCost;
+  vtkCMFEFastLookupGrouping *LookupCache;
+  vtkDataSet *CachedMesh;
+  unsigned long CachedMeshGeometryMTime;
+  vtkIdType CachedMeshNumberOfPoints;
+  vtkIdType CachedMeshNumberOfCells;
+  double CachedMeshBounds[6];
+  //BTX
+  vtkstd::vector<vtkStdString> ArraysToMap;
+  //ETX
+  int UseRemapOperator;
+  char *RemapOperatorFileName;
+  vtkCMFERemapOperator *RemapOperator;
+  double FallbackTolerance;
+  int Interpolation;
+  int NumberOfNeighbors;
+  double Radius;
+  vtkIdType NumberOfPointsLocated;
+  vtkIdType NumberOfPointsNearest;
+  vtkIdType NumberOfPointsMissed;
+  vtkDataSet *RemapMesh;
+  vtkDataSet *RemapTarget;
+  unsigned long RemapMeshGeometryMTime;
+  unsigned long RemapTargetGeometryMTime;
+
+  //BTX
+  // Description:
+  // A result of the kept interpolation weights, with the arrays it was
+  // computed from and their modification times.  Each holds a reference
+  // to its result.  They are dropped along with the weights.
+  struct RemapResult
+  {
+    vtkstd::string Name;
+    vtkDataArray *Donor;
+    unsigned long DonorMTime;
+    vtkDataArray *Fallback;
+    unsigned long FallbackMTime;
+    vtkDataArray *Result;
+  };
+  vtkstd::vector<RemapResult> RemapResults;
+  //ETX
+
 private:
   vtkCMFEFilter(const vtkCMFEFilter&);  // Not implemented.
   void operator=(const vtkCMFEFilter&);  // Not implemented.
@@ -53,86 +53,452 @@
 
 
 #include <vtkCMFEIntervalTree.h>
+#include <vtkCMFETreeBuilder.h>
 #include <vtkCMFEUtility.h>
 
+#include <vtkMultiThreader.h>
+
 #include <vtkstd/algorithm>
 #include <float.h>
 #include <math.h>
 #include <stdlib.h>
 
+#if defined(__AVX__)
+#  define CMFE_INTERVAL_TREE_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define CMFE_INTERVAL_TREE_SSE2
+#endif
+
+#if defined(CMFE_INTERVAL_TREE_AVX)
+#  include <immintrin.h>
+#elif defined(CMFE_INTERVAL_TREE_SSE2)
+#  include <emmintrin.h>
+#endif
+
 
 
-//
-// Types and globals (needed for qsort). 
-//
 namespace
 {
-  typedef union
-  {
-      double f;
-      int   b;
-  } DoubleInt;
-
-  int globalCurrentDepth;
-  int globalNDims;
+// Below this many elements the tree is built on the calling thread only.
+const int minimumElementsForThreadedBuild = 65536;
 
-  
 // ****************************************************************************
-//  Function: QsortBoundsSorter
+//  Function: CompleteTreeSplit
 //
 //  Purpose:
-//      Sorts a vector of bounds with respect to the dimension that
-//      corresponds to the depth.
+//      Number of elements that go to the left subtree of a node covering
+//      size elements, so that the leaves fill the last level of the heap
+//      from the left.
+// ****************************************************************************
+
+int CompleteTreeSplit(int size)
+{
+  //
+  // Decompose size into 2^y + n where 0 <= n < 2^y
+  //
+  int power = 1;
+  while (power*2 <= size)
+    {
+    power *= 2;
+    }
+  int n = size - power;
+
+  if (n == 0)
+    {
+    return power/2;
+    }
+  if (n < power/2)
+    {
+    return (power/2 + n);
+    }
+
+  return power;
+}
+
+// ****************************************************************************
+//  Struct: BuildItem
 //
-//  Notes:
-//     Adapted from deprecated methods 'Sort' and 'Less' written in 
-//     August of 2000.
+//  Purpose:
+//      An element as seen by the tree build: the center of its bounds in
+//      the first three dimensions and its id.  The build partitions arrays
+//      of these rather than indices into the bounds, so nth_element streams
+//      through memory.
+// ****************************************************************************
+
+struct BuildItem
+{
+  float Center[3];
+  int   Element;
+};
+
+class CenterLess
+{
+public:
+  CenterLess(int axis) : Axis(axis) {}
+  bool operator()(const BuildItem &a, const BuildItem &b) const
+    {
+    return a.Center[this->Axis] < b.Center[this->Axis];
+    }
+private:
+  int Axis;
+};
+
+// ****************************************************************************
+//  Class: TreeBuilder
 //
-//  Programmer: Hank Childs
-//  Creation:   June 27, 2005
+//  Purpose:
+//      Builds the heap layout of an interval tree top down.  Each node
+//      splits its elements at the position dictated by the shape of the
+//      tree with nth_element along the axis where the element centers are
+//      most spread out, and takes its extents from its children on the way
+//      back up.
+// ****************************************************************************
+
+class TreeBuilder : public vtkCMFETreeBuilder
+{
+public:
+  int NumberOfDims;
+  int VectorSize;
+  const double *Bounds;
+  BuildItem *Items;
+  double *NodeExtents;
+  int *NodeIDs;
+
+  virtual vtkIdType Split(vtkIdType, vtkIdType offset, vtkIdType size)
+    {
+    // The split axis is picked among the first three dimensions.
+    int nDims = vtkstd::min(this->NumberOfDims, 3);
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    // The spread of a strided sample of the centers is enough to pick the
+    // axis, and keeps the scan from costing as much as the partition.
+    const BuildItem *items = this->Items + offset;
+    int stride = (size > 256 ? size / 256 : 1);
+    for (int i = 0 ; i < size ; i += stride)
+      {
+      for (int d = 0 ; d < nDims ; d++)
+        {
+        float c = items[i].Center[d];
+        lo[d] = (c < lo[d] ? c : lo[d]);
+        hi[d] = (c > hi[d] ? c : hi[d]);
+        }
+      }
+    int axis = 0;
+    for (int d = 1 ; d < nDims ; d++)
+      {
+      if (hi[d] - lo[d] > hi[axis] - lo[axis])
+        {
+        axis = d;
+        }
+      }
+
+    int leftSize = CompleteTreeSplit(static_cast<int>(size));
+    vtkstd::nth_element(this->Items + offset, this->Items + offset + leftSize,
+                        this->Items + offset + size, CenterLess(axis));
+    return leftSize;
+    }
+
+  void SetLeaf(int node, int element)
+    {
+    this->NodeIDs[node] = element;
+    for (int j = 0 ; j < this->VectorSize ; j++)
+      {
+      this->NodeExtents[node*this->VectorSize + j] =
+        this->Bounds[element*this->VectorSize + j];
+      }
+    }
+
+  void Merge(int node)
+    {
+    const double *left = this->NodeExtents + (2*node+1)*this->VectorSize;
+    const double *right = left + this->VectorSize;
+    double *parent = this->NodeExtents + node*this->VectorSize;
+    for (int k = 0 ; k < this->NumberOfDims ; k++)
+      {
+      parent[2*k] = vtkstd::min(left[2*k], right[2*k]);
+      parent[2*k+1] = vtkstd::max(left[2*k+1], right[2*k+1]);
+      }
+    }
+
+  virtual void Build(vtkIdType node, vtkIdType offset, vtkIdType size)
+    {
+    if (size <= 1)
+      {
+      this->SetLeaf(node, this->Items[offset].Element);
+      return;
+      }
+    vtkIdType leftSize = this->Split(node, offset, size);
+    this->Build(2*node+1, offset, leftSize);
+    this->Build(2*node+2, offset+leftSize, size-leftSize);
+    this->Merge(node);
+    }
+};
+
+// ****************************************************************************
+//  Functions: RoundDown, RoundUp
 //
-//  Modifications:
+//  Purpose:
+//      Converts a double bound to the nearest float that does not shrink
+//      the interval, so the float boxes of the flat layout always contain
+//      the double boxes they were built from.
+// ****************************************************************************
+
+inline float RoundDown(double d)
+{
+  if (d > FLT_MAX)
+    {
+    return FLT_MAX;
+    }
+  if (d < -FLT_MAX)
+    {
+    return -HUGE_VALF;
+    }
+  float f = (float) d;
+  if ((double) f > d)
+    {
+    f = nextafterf(f, -HUGE_VALF);
+    }
+  return f;
+}
+
+inline float RoundUp(double d)
+{
+  if (d > FLT_MAX)
+    {
+    return HUGE_VALF;
+    }
+  if (d < -FLT_MAX)
+    {
+    return -FLT_MAX;
+    }
+  float f = (float) d;
+  if ((double) f < d)
+    {
+    f = nextafterf(f, HUGE_VALF);
+    }
+  return f;
+}
+
+inline bool BoxOverlaps(const float *lo, const float *hi,
+                        const float *qlo, const float *qhi)
+{
+  return lo[0] <= qhi[0] && hi[0] >= qlo[0] &&
+         lo[1] <= qhi[1] && hi[1] >= qlo[1] &&
+         lo[2] <= qhi[2] && hi[2] >= qlo[2];
+}
+
+// ****************************************************************************
+//  Classes: FlatRangeTest, FlatRayTest, FlatAxialLineTest, FlatLinearTest
 //
-//    Mark C. Miller, Wed Aug 23 08:53:58 PDT 2006
-//    Changed return values from true/false to 1, -1, 0
+//  Purpose:
+//      The node tests used by vtkCMFEIntervalTree::TraverseFlat.  Each one
+//      receives the first float of a FlatNode, laid out as
+//        lo x,y,z of child 0 | lo x,y,z of child 1 |
+//        hi x,y,z of child 0 | hi x,y,z of child 1 | two zero floats
+//      and returns bit 0 set if child 0 passes and bit 1 if child 1 does.
+//      The ray, axial line and linear tests give the same answers as
+//      the CMFEUtility functions used by the heap layout, on the slightly
+//      larger float boxes.
 // ****************************************************************************
 
-int QsortBoundsSorter(const void *arg1, const void *arg2)
+class FlatRangeTest
 {
-  DoubleInt *A = (DoubleInt *) arg1;
-  DoubleInt *B = (DoubleInt *) arg2;
-
-  // Walk through the mid-points of the extents, starting with the current
-  // depth and moving forward.
-  int size = 2*globalNDims;
-  for (int i = 0 ; i < globalNDims ; i++)
-    {
-    double A_mid = (A[(2*globalCurrentDepth + 2*i) % size].f
-      + A[(2*globalCurrentDepth+1 + 2*i) % size].f) / 2;
-    double B_mid = (B[(2*globalCurrentDepth + 2*i) % size].f
-      + B[(2*globalCurrentDepth+1 + 2*i) % size].f) / 2;
-    if (A_mid < B_mid)
+public:
+  FlatRangeTest(const double *min_vec, const double *max_vec, int nDims)
+    {
+    //The query is rounded outwards as well, so the float test can only
+    //report more candidates than the double test, never fewer.
+    for (int i = 0 ; i < 4 ; i++)
       {
-      return 1;
+      this->Lo[i] = -HUGE_VALF;
+      this->Hi[i] = HUGE_VALF;
       }
-    else if (A_mid > B_mid)
+    for (int i = 0 ; i < nDims ; i++)
       {
-      return -1;
+      this->Lo[i] = RoundDown(min_vec[i]);
+      this->Hi[i] = RoundUp(max_vec[i]);
       }
+#if defined(CMFE_INTERVAL_TREE_AVX)
+    this->Lo8 = _mm256_setr_ps(this->Lo[0], this->Lo[1], this->Lo[2],
+                               this->Lo[0], this->Lo[1], this->Lo[2],
+                               -HUGE_VALF, -HUGE_VALF);
+    this->Hi8 = _mm256_setr_ps(this->Hi[0], this->Hi[1], this->Hi[2],
+                               this->Hi[0], this->Hi[1], this->Hi[2],
+                               HUGE_VALF, HUGE_VALF);
+#elif defined(CMFE_INTERVAL_TREE_SSE2)
+    this->Lo4 = _mm_loadu_ps(this->Lo);
+    this->Hi4 = _mm_loadu_ps(this->Hi);
+#endif
     }
 
-  // Bounds are exactly identical.  This can cause problems if you are
-  // not careful.
-  return 0;
-}
+  bool TestBox(const float *lo, const float *hi) const
+    {
+    return BoxOverlaps(lo, hi, this->Lo, this->Hi);
+    }
+
+  int TestChildren(const float *box) const
+    {
+#if defined(CMFE_INTERVAL_TREE_AVX)
+    // Lanes 0-2 are child 0 and lanes 3-5 child 1.
+    __m256 in = _mm256_and_ps(
+      _mm256_cmp_ps(_mm256_loadu_ps(box), this->Hi8, _CMP_LE_OQ),
+      _mm256_cmp_ps(_mm256_loadu_ps(box + 6), this->Lo8, _CMP_GE_OQ));
+    int m = _mm256_movemask_ps(in);
+    return ((m & 0x07) == 0x07 ? 1 : 0) | ((m & 0x38) == 0x38 ? 2 : 0);
+#elif defined(CMFE_INTERVAL_TREE_SSE2)
+    // The fourth lane of each load belongs to the next box and is ignored.
+    __m128 in0 = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(box), this->Hi4),
+                            _mm_cmpge_ps(_mm_loadu_ps(box + 6), this->Lo4));
+    __m128 in1 = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(box + 3), this->Hi4),
+                            _mm_cmpge_ps(_mm_loadu_ps(box + 9), this->Lo4));
+    return ((_mm_movemask_ps(in0) & 7) == 7 ? 1 : 0) |
+           ((_mm_movemask_ps(in1) & 7) == 7 ? 2 : 0);
+#else
+    return (BoxOverlaps(box, box + 6, this->Lo, this->Hi) ? 1 : 0) |
+           (BoxOverlaps(box + 3, box + 9, this->Lo, this->Hi) ? 2 : 0);
+#endif
+    }
+
+private:
+  float Lo[4];
+  float Hi[4];
+#if defined(CMFE_INTERVAL_TREE_AVX)
+  __m256 Lo8;
+  __m256 Hi8;
+#elif defined(CMFE_INTERVAL_TREE_SSE2)
+  __m128 Lo4;
+  __m128 Hi4;
+#endif
+};
+
+class FlatRayTest
+{
+public:
+  FlatRayTest(const double origin[3], const double dir[3])
+    {
+    for (int i = 0 ; i < 3 ; i++)
+      {
+      this->Origin[i] = origin[i];
+      this->Dir[i] = dir[i];
+      }
+    }
+
+  bool TestBox(const float *lo, const float *hi) const
+    {
+    double bounds[6] = { lo[0], hi[0], lo[1], hi[1], lo[2], hi[2] };
+    double coord[3];
+    return CMFEUtility::IntersectBox(bounds, this->Origin, this->Dir, coord) != 0;
+    }
+
+  int TestChildren(const float *box) const
+    {
+#if defined(CMFE_INTERVAL_TREE_SSE2)
+    // The slab test of CMFEUtility::IntersectBox with child 0 in the low
+    // lane and child 1 in the high lane.
+    __m128d tnear = _mm_set1_pd(-DBL_MAX);
+    __m128d tfar = _mm_set1_pd(DBL_MAX);
+    __m128d ok = _mm_cmpeq_pd(tnear, tnear);
+    for (int a = 0 ; a < 3 ; a++)
+      {
+      __m128d lo = _mm_setr_pd(box[a], box[3 + a]);
+      __m128d hi = _mm_setr_pd(box[6 + a], box[9 + a]);
+      __m128d o = _mm_set1_pd(this->Origin[a]);
+      if (this->Dir[a] == 0)
+        {
+        ok = _mm_and_pd(ok, _mm_and_pd(_mm_cmpge_pd(o, lo), _mm_cmple_pd(o, hi)));
+        }
+      else
+        {
+        __m128d d = _mm_set1_pd(this->Dir[a]);
+        __m128d t1 = _mm_div_pd(_mm_sub_pd(lo, o), d);
+        __m128d t2 = _mm_div_pd(_mm_sub_pd(hi, o), d);
+        tnear = _mm_max_pd(tnear, _mm_min_pd(t1, t2));
+        tfar = _mm_min_pd(tfar, _mm_max_pd(t1, t2));
+        ok = _mm_and_pd(ok, _mm_and_pd(_mm_cmplt_pd(tnear, tfar),
+                                       _mm_cmpge_pd(tfar, _mm_setzero_pd())));
+        }
+      }
+    return _mm_movemask_pd(ok);
+#else
+    return (this->TestBox(box, box + 6) ? 1 : 0) |
+           (this->TestBox(box + 3, box + 9) ? 2 : 0);
+#endif
+    }
+
+private:
+  double Origin[3];
+  double Dir[3];
+};
+
+class FlatAxialLineTest
+{
+public:
+  FlatAxialLineTest(const double *P1, const double *D1) : P1(P1), D1(D1) {}
+
+  bool TestBox(const float *lo, const float *hi) const
+    {
+    double extents[4] = { lo[0], hi[0], lo[1], hi[1] };
+    return CMFEUtility::AxiallySymmetricLineIntersection(this->P1, this->D1, 0, extents);
+    }
+
+  int TestChildren(const float *box) const
+    {
+    return (this->TestBox(box, box + 6) ? 1 : 0) |
+           (this->TestBox(box + 3, box + 9) ? 2 : 0);
+    }
+
+private:
+  const double *P1;
+  const double *D1;
+};
+
+class FlatLinearTest
+{
+public:
+  FlatLinearTest(const double *params, double solution, int nDims)
+    : Params(params), Solution(solution), NumberOfDims(nDims) {}
+
+  bool TestBox(const float *lo, const float *hi) const
+    {
+    double extents[6];
+    for (int i = 0 ; i < this->NumberOfDims ; i++)
+      {
+      extents[2*i] = lo[i];
+      extents[2*i+1] = hi[i];
+      }
+    return CMFEUtility::Intersects(this->Params, this->Solution, 0,
+                                   this->NumberOfDims, extents);
+    }
+
+  int TestChildren(const float *box) const
+    {
+    return (this->TestBox(box, box + 6) ? 1 : 0) |
+           (this->TestBox(box + 3, box + 9) ? 2 : 0);
+    }
+
+private:
+  const double *Params;
+  double Solution;
+  int NumberOfDims;
+};
 }
 
 
 //----------------------------------------------------------------------------
-vtkCMFEIntervalTree::vtkCMFEIntervalTree(int els, int dims, bool rc)
+vtkCMFEIntervalTree::vtkCMFEIntervalTree(int els, int dims, bool rc, int layout)
 {
   this->NumberOfElements    = els;
   this->NumberOfDims       = dims;
+  this->Layout = layout;
+  if (this->NumberOfDims > 3)
+    {
+    // The flat layout only has room for three dimensions.
+    this->Layout = HEAP_LAYOUT;
+    }
+  this->FlatNodes = NULL;
+  this->FlatNodeBuffer = NULL;
+  this->NumberOfFlatNodes = 0;
   this->HasBeenCalculated = false;
   this->RequiresCommunication = rc;
 
@@ -173,6 +539,10 @@ vtkCMFEIntervalTree::vtkCMFEIntervalTree(const vtkCMFEIntervalTree *it)
   this->NumberOfNodes = it->NumberOfNodes;
   this->NumberOfDims = it->NumberOfDims;
   this->VectorSize = it->VectorSize;
+  this->Layout = it->Layout;
+  this->FlatNodes = NULL;
+  this->FlatNodeBuffer = NULL;
+  this->NumberOfFlatNodes = 0;
   this->NodeExtents = new double[this->NumberOfNodes*this->VectorSize];
   this->NodeIDs     = new int[this->NumberOfNodes];
   for (int i = 0 ; i < this->NumberOfNodes ; i++)
@@ -185,6 +555,10 @@ vtkCMFEIntervalTree::vtkCMFEIntervalTree(const vtkCMFEIntervalTree *it)
     }
   this->HasBeenCalculated = it->HasBeenCalculated;
   this->RequiresCommunication = it->RequiresCommunication;
+  if (this->HasBeenCalculated && this->Layout == FLAT_LAYOUT)
+    {
+    this->ConstructFlatLayout();
+    }
 }
 
 
@@ -200,6 +574,10 @@ vtkCMFEIntervalTree::~vtkCMFEIntervalTree()
     {
     delete [] this->NodeIDs;
     }
+  if (this->FlatNodeBuffer != NULL)
+    {
+    delete [] this->FlatNodeBuffer;
+    }
 }
 
 
@@ -285,136 +663,201 @@ void vtkCMFEIntervalTree::CollectInformation(void)
 //----------------------------------------------------------------------------
 void vtkCMFEIntervalTree::ConstructTree(void)
 {
-  int    i, j;
+  int i;
 
-  //
-  // Make a local copy of the bounds so that we can move them around.
-  //
-  int totalSize = this->VectorSize+1;
-  globalNDims = this->NumberOfDims;
-  DoubleInt  *bounds = new DoubleInt[this->NumberOfElements*totalSize];
-  for (i = 0 ; i < this->NumberOfElements ; i++)
+  if (this->NumberOfElements <= 0)
     {
-    for (j = 0 ; j < this->VectorSize ; j++)
-      {
-      bounds[totalSize*i+j].f = this->NodeExtents[this->VectorSize*i+j];
-      }
-    bounds[totalSize*i+(totalSize-1)].b = i;
+    return;
     }
 
-  int offsetStack[100];   // Only need log this->NumberOfElements
-  int nodeStack  [100];   // Only need log this->NumberOfElements
-  int sizeStack  [100];   // Only need log this->NumberOfElements
-  int depthStack [100];   // Only need log this->NumberOfElements
-  int stackCount = 0;
-
   //
-  // Initialize the arguments for the stack
+  // AddElement stored the bounds in the first rows of NodeExtents, which
+  // the tree overwrites, so make a copy to build from.
   //
-  offsetStack[0]  = 0;
-  sizeStack[0]  = this->NumberOfElements;
-  depthStack[0]  = 0;
-  nodeStack[0]  = 0;
-  ++stackCount;
-
-  int currentOffset;
-  int currentSize; 
-  int currentDepth;
-  int leftSize;
-  int currentNode;
-  int count = 0;
-  int thresh = (this->NumberOfElements > 10 ? this->NumberOfElements/10 : 1);
-  while (stackCount > 0)
-    {
-    count++;
-    --stackCount;
-    currentOffset = offsetStack[stackCount];
-    currentSize   = sizeStack  [stackCount];
-    currentDepth  = depthStack [stackCount];
-    currentNode   = nodeStack  [stackCount];
-
-    if (currentSize <= 1)
-      {
-      this->NodeIDs[currentNode] =  bounds[currentOffset*totalSize + (totalSize-1)].b;
-      for (int j = 0 ; j < this->VectorSize ; j++)
-        {
-        this->NodeExtents[currentNode*this->VectorSize + j] = bounds[currentOffset*totalSize + j].f;
-        }
-      continue;
-      }
-
-    globalCurrentDepth = currentDepth;
-    if (count % thresh == 0)
+  int n = this->NumberOfElements;
+  double *bounds = new double[n*this->VectorSize];
+  for (i = 0 ; i < n*this->VectorSize ; i++)
+    {
+    bounds[i] = this->NodeExtents[i];
+    }
+  BuildItem *items = new BuildItem[n];
+  for (i = 0 ; i < n ; i++)
+    {
+    const double *b = bounds + i*this->VectorSize;
+    for (int d = 0 ; d < 3 ; d++)
       {
-      qsort(bounds + currentOffset*totalSize, currentSize, totalSize*sizeof(DoubleInt), QsortBoundsSorter);
+      items[i].Center[d] = (d < this->NumberOfDims ?
+                            (float) (0.5*(b[2*d] + b[2*d+1])) : 0.f);
       }
+    items[i].Element = i;
+    }
 
-    leftSize = this->SplitSize(currentSize);
-
-    offsetStack[stackCount]  = currentOffset;
-    sizeStack[stackCount]  = leftSize;
-    depthStack[stackCount]  = currentDepth + 1;
-    nodeStack[stackCount]  = 2*currentNode + 1;
-    ++stackCount;
+  TreeBuilder builder;
+  builder.NumberOfDims = this->NumberOfDims;
+  builder.VectorSize = this->VectorSize;
+  builder.Bounds = bounds;
+  builder.Items = items;
+  builder.NodeExtents = this->NodeExtents;
+  builder.NodeIDs = this->NodeIDs;
 
-    offsetStack[stackCount]  = currentOffset + leftSize;
-    sizeStack[stackCount]  = currentSize - leftSize;
-    depthStack[stackCount]  = currentDepth + 1;
-    nodeStack[stackCount]  = 2*currentNode + 2;
-    ++stackCount;
+  int nThreads = 1;
+  if (n >= minimumElementsForThreadedBuild)
+    {
+    nThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
     }
 
-  this->SetIntervals();
+  //
+  // The nodes split before the subtrees were handed out get their extents
+  // afterwards, children before parents.
+  //
+  vtkstd::vector<vtkIdType> topNodes;
+  builder.BuildTree(n, nThreads, minimumElementsForThreadedBuild / 4,
+                    &topNodes);
+  for (i = static_cast<int>(topNodes.size())-1 ; i >= 0 ; i--)
+    {
+    builder.Merge(static_cast<int>(topNodes[i]));
+    }
 
+  delete [] items;
   delete [] bounds;
+
+  if (this->Layout == FLAT_LAYOUT)
+    {
+    this->ConstructFlatLayout();
+    }
 }
 
 //----------------------------------------------------------------------------
-void vtkCMFEIntervalTree::SetIntervals()
+void vtkCMFEIntervalTree::ConstructFlatLayout(void)
 {
-  //Now that the intervals for all of the leaf nodes have been set and put
-  //in their proper place in the interval tree, calculate the bounds for
-  //all of the parenting nodes.
-  int parent;
+  //The heap layout needs the extents of a node and its id from two arrays
+  //and spends 48 bytes of doubles per box.  Here every interior node keeps
+  //the float boxes of both of its children in one cache line instead.  The
+  //nodes stay in heap order rather than being linked by pointers: since the
+  //address of a child does not depend on data loaded from its parent, the
+  //processor can fetch several levels of the tree ahead of the comparisons.
+  if (this->FlatNodeBuffer != NULL)
+    {
+    delete [] this->FlatNodeBuffer;
+    }
+  this->FlatNodes = NULL;
+  this->FlatNodeBuffer = NULL;
+  this->NumberOfFlatNodes = 0;
 
-  for (int i = this->NumberOfNodes-1 ; i > 0 ; i -= 2)
+  //Dimensions the tree does not have are zero, as in NodeExtents.
+  for (int i = 0 ; i < 3 ; i++)
     {
-    parent = (i - 2) / 2;
-    for (int k = 0 ; k < this->NumberOfDims ; k++)
+    this->FlatRootLo[i] = 0.f;
+    this->FlatRootHi[i] = 0.f;
+    }
+  if (this->NumberOfElements <= 0)
+    {
+    return;
+    }
+  for (int i = 0 ; i < this->NumberOfDims ; i++)
+    {
+    this->FlatRootLo[i] = RoundDown(this->NodeExtents[2*i]);
+    this->FlatRootHi[i] = RoundUp(this->NodeExtents[2*i+1]);
+    }
+
+  //ConstructTree puts the n leaves in the last n of the 2n-1 nodes, so
+  //the interior nodes are exactly the first n-1.
+  int nInterior = this->NumberOfElements - 1;
+  for (int i = 0 ; i < nInterior ; i++)
+    {
+    if (this->NodeIDs[i] >= 0)
       {
-      this->NodeExtents[parent*this->VectorSize + 2*k] =
-        vtkstd::min(this->NodeExtents[(i-1)*this->VectorSize + 2*k],
-        this->NodeExtents[i*this->VectorSize + 2*k]);
-      this->NodeExtents[parent*this->VectorSize + 2*k + 1] =
-        vtkstd::max(this->NodeExtents[(i-1)*this->VectorSize + 2*k + 1],
-        this->NodeExtents[i*this->VectorSize + 2*k + 1]);
+      this->Layout = HEAP_LAYOUT;
+      return;
+      }
+    }
+  if (nInterior == 0)
+    {
+    // A single element; the root is the leaf.
+    return;
+    }
+
+  const size_t lineSize = 64;
+  this->FlatNodeBuffer = new char[nInterior*sizeof(FlatNode) + lineSize];
+  size_t offset = reinterpret_cast<size_t>(this->FlatNodeBuffer) % lineSize;
+  this->FlatNodes = reinterpret_cast<FlatNode *>(this->FlatNodeBuffer +
+    (offset == 0 ? 0 : lineSize - offset));
+  this->NumberOfFlatNodes = nInterior;
+
+  for (int i = 0 ; i < nInterior ; i++)
+    {
+    FlatNode &node = this->FlatNodes[i];
+    node.Guard[0] = node.Guard[1] = 0.f;
+    for (int c = 0 ; c < 2 ; c++)
+      {
+      int child = 2*i + 1 + c;
+      for (int j = 0 ; j < 3 ; j++)
+        {
+        node.Lo[c][j] = 0.f;
+        node.Hi[c][j] = 0.f;
+        }
+      for (int j = 0 ; j < this->NumberOfDims ; j++)
+        {
+        node.Lo[c][j] = RoundDown(this->NodeExtents[child*this->VectorSize + 2*j]);
+        node.Hi[c][j] = RoundUp(this->NodeExtents[child*this->VectorSize + 2*j + 1]);
+        }
+      node.Element[c] = this->NodeIDs[child];
       }
     }
 }
 
 //----------------------------------------------------------------------------
-int vtkCMFEIntervalTree::SplitSize(int size)
+template <class ChildTest>
+void vtkCMFEIntervalTree::TraverseFlat(const ChildTest &test, vtkstd::vector<int> &list) const
 {
-  //
-  // Decompose size into 2^y + n where 0 <= n < 2^y
-  //
-  int power = 1;
-  while (power*2 <= size)
+  list.clear();
+
+  if (this->NumberOfElements <= 0 ||
+      !test.TestBox(this->FlatRootLo, this->FlatRootHi))
     {
-    power *= 2;
+    return;
     }
-  int n = size - power;
-
-  if (n == 0)
+  if (this->NumberOfFlatNodes == 0)
     {
-    return power/2;
+    // A single element; the root is the leaf.
+    list.push_back(this->NodeIDs[0]);
+    return;
     }
-  if (n < power/2)
+
+  int nodeStack[100]; // Only need log amount
+  int nodeStackSize = 0;
+  nodeStack[nodeStackSize++] = 0;
+
+  while (nodeStackSize > 0)
     {
-    return (power/2 + n);
+    int stackIndex = nodeStack[--nodeStackSize];
+    const FlatNode &node = this->FlatNodes[stackIndex];
+    int mask = test.TestChildren(&node.Lo[0][0]);
+
+    //Push the right child first so the left one is visited next.
+    for (int c = 1 ; c >= 0 ; c--)
+      {
+      if ((mask & (1 << c)) == 0)
+        {
+        continue;
+        }
+      int child = 2*stackIndex + 1 + c;
+      if (child >= this->NumberOfFlatNodes)
+        {
+        list.push_back(node.Element[c]);
+        }
+      else
+        {
+        nodeStack[nodeStackSize++] = child;
+        }
+      }
     }
+}
 
-  return power;
+//----------------------------------------------------------------------------
+int vtkCMFEIntervalTree::SplitSize(int size)
+{
+  return CompleteTreeSplit(size);
 }
 
 
@@ -426,6 +869,12 @@ void vtkCMFEIntervalTree::GetElementsList(const double *params, double solution,
     return;
     }
 
+  if (this->Layout == FLAT_LAYOUT)
+    {
+    this->TraverseFlat(FlatLinearTest(params, solution, this->NumberOfDims), list);
+    return;
+    }
+
   list.clear();
 
   int nodeStack[100]; // Only need log amount
@@ -477,6 +926,12 @@ void vtkCMFEIntervalTree::GetElementsList(double origin[3], double rayDir[3],
     return;
     }
 
+  if (this->Layout == FLAT_LAYOUT)
+    {
+    this->TraverseFlat(FlatRayTest(origin, rayDir), list);
+    return;
+    }
+
   list.clear();
 
   int nodeStack[100]; // Only need log amount
@@ -518,6 +973,12 @@ void vtkCMFEIntervalTree::GetElementsListFromRange(const double *min_vec, const
     return;
     }
 
+  if (this->Layout == FLAT_LAYOUT)
+    {
+    this->TraverseFlat(FlatRangeTest(min_vec, max_vec, this->NumberOfDims), list);
+    return;
+    }
+
   list.clear();
 
   int nodeStack[100]; // Only need log amount
@@ -593,6 +1054,12 @@ void vtkCMFEIntervalTree::GetElementsFromAxiallySymmetricLineIntersection( const
     return;
     }
 
+  if (this->Layout == FLAT_LAYOUT)
+    {
+    this->TraverseFlat(FlatAxialLineTest(P1, D1), list);
+    return;
+    }
+
   list.clear();
 
   int nodeStack[100]; // Only need log amount
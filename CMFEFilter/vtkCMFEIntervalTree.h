@@ -67,7 +67,21 @@
 class vtkCMFEIntervalTree
 {
 public:
-  vtkCMFEIntervalTree(int, int, bool = true);
+  // Description:
+  //Memory layout of the nodes used by the queries.  HEAP_LAYOUT stores
+  //the extents of node i as doubles at index i, with the children at 2i+1
+  //and 2i+2.  FLAT_LAYOUT additionally stores one cache line per interior
+  //node holding the float boxes of both of its children side by side, so
+  //a visited node costs a single load and both children are tested with
+  //one sequence of vector instructions where SSE2 or AVX is available.
+  //FLAT_LAYOUT is only supported for up to three dimensions.
+  enum NodeLayout
+    {
+    HEAP_LAYOUT = 0,
+    FLAT_LAYOUT = 1
+    };
+
+  vtkCMFEIntervalTree(int, int, bool = true, int layout = HEAP_LAYOUT);
   vtkCMFEIntervalTree(const vtkCMFEIntervalTree *);
   
   virtual ~vtkCMFEIntervalTree();
@@ -126,23 +140,63 @@ public:
   //Get the Number of leaves
   int GetNumberLeaves(void) const { return this->NumberOfElements; };
 
+  //Description:
+  //Get the node layout used by the range queries.
+  int GetLayout(void) const { return this->Layout; };
+
 protected:
   int NumberOfElements;
   int NumberOfNodes;
   int NumberOfDims;
   int VectorSize;
+  int Layout;
 
   double *NodeExtents;
   int *NodeIDs;
 
+  //BTX
+  // Description:
+  //An interior node of the flat layout, sized and aligned to one cache
+  //line.  Flat node i is heap node i, so its children are still found at
+  //2i+1 and 2i+2.  Lo and Hi hold the boxes of the two children with the
+  //bounds rounded outwards to float, and Element holds the element of a
+  //child that is a leaf.  Guard is zero so that vector loads running past
+  //Hi only ever see valid floats.
+  struct FlatNode
+    {
+    float Lo[2][3];
+    float Hi[2][3];
+    float Guard[2];
+    int   Element[2];
+    };
+  FlatNode *FlatNodes;
+  char     *FlatNodeBuffer;
+  int       NumberOfFlatNodes;
+  float     FlatRootLo[3];
+  float     FlatRootHi[3];
+  //ETX
+
   bool HasBeenCalculated;
   bool RequiresCommunication;
 
   void CollectInformation(void);
   void ConstructTree(void);
-  void SetIntervals(void);
   int  SplitSize(int);
 
+  // Description:
+  //Builds the flat layout from the heap layout.
+  void ConstructFlatLayout(void);
+
+  //BTX
+  // Description:
+  //Walks the flat layout for any of the queries.  ChildTest provides
+  //TestBox(lo, hi) for a single box and TestChildren(box), which returns a
+  //bit mask of the children of a FlatNode (passed as its first float) that
+  //satisfy the query.
+  template <class ChildTest>
+  void TraverseFlat(const ChildTest &test, vtkstd::vector<int> &list) const;
+  //ETX
+
 private:
   vtkCMFEIntervalTree(const vtkCMFEIntervalTree &) {;};
   vtkCMFEIntervalTree &operator=(const vtkCMFEIntervalTree &) { return *this; };
@@ -0,0 +1,373 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: vtkCMFEKdTree.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+/*****************************************************************************
+*
+* Copyright (c) 2000 - 2009, Lawrence Livermore National Security, LLC
+* Produced at the Lawrence Livermore National Laboratory
+* LLNL-CODE-400124
+* All rights reserved.
+*
+* This file is  part of VisIt. For  details, see https://visit.llnl.gov/.  The
+* full copyright notice is contained in the file COPYRIGHT located at the root
+* of the VisIt distribution or at http://www.llnl.gov/visit/copyright.html.
+*
+* Redistribution  and  use  in  source  and  binary  forms,  with  or  without
+* modification, are permitted provided that the following conditions are met:
+*
+*  - Redistributions of  source code must  retain the above  copyright notice,
+*    this list of conditions and the disclaimer below.
+*  - Redistributions in binary form must reproduce the above copyright notice,
+*    this  list of  conditions  and  the  disclaimer (as noted below)  in  the
+*    documentation and/or other materials provided with the distribution.
+*  - Neither the name of  the LLNS/LLNL nor the names of  its contributors may
+*    be used to endorse or promote products derived from this software without
+*    specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT  HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR  IMPLIED WARRANTIES, INCLUDING,  BUT NOT  LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND  FITNESS FOR A PARTICULAR  PURPOSE
+* ARE  DISCLAIMED. IN  NO EVENT  SHALL LAWRENCE  LIVERMORE NATIONAL  SECURITY,
+* LLC, THE  U.S.  DEPARTMENT OF  ENERGY  OR  CONTRIBUTORS BE  LIABLE  FOR  ANY
+* DIRECT,  INDIRECT,   INCIDENTAL,   SPECIAL,   EXEMPLARY,  OR   CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT  LIMITED TO, PROCUREMENT OF  SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF  USE, DATA, OR PROFITS; OR  BUSINESS INTERRUPTION) HOWEVER
+* CAUSED  AND  ON  ANY  THEORY  OF  LIABILITY,  WHETHER  IN  CONTRACT,  STRICT
+* LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY  WAY
+* OUT OF THE  USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+* DAMAGE.
+*
+*****************************************************************************/
+
+#include "vtkCMFEKdTree.h"
+#include "vtkCMFETreeBuilder.h"
+
+#include "vtkMultiThreader.h"
+
+#include <vtkstd/algorithm>
+
+namespace
+{
+// Below this many points the tree is built on the calling thread only.
+const vtkIdType minimumPointsForThreadedBuild = 65536;
+
+typedef vtkstd::pair<double, vtkIdType> Neighbor;
+
+//----------------------------------------------------------------------------
+inline double Distance2(const double *a, const double *b)
+{
+  double dx = a[0] - b[0];
+  double dy = a[1] - b[1];
+  double dz = a[2] - b[2];
+  return dx*dx + dy*dy + dz*dz;
+}
+
+class ItemLess
+{
+public:
+  ItemLess(int axis) : Axis(axis) {}
+  bool operator()(const vtkCMFEKdTree::Item &a,
+                  const vtkCMFEKdTree::Item &b) const
+    {
+    return a.X[this->Axis] < b.X[this->Axis];
+    }
+private:
+  int Axis;
+};
+
+//----------------------------------------------------------------------------
+// Builds the tree top down.  A node keeps the first size/2 of its points
+// on the left, partitioned with nth_element along the axis where the
+// points are most spread out, and splits at the coordinate of the first
+// point on the right.
+class TreeBuilder : public vtkCMFETreeBuilder
+{
+public:
+  vtkCMFEKdTree::Item *Items;
+  double *Splits;
+  unsigned char *Axes;
+
+  virtual vtkIdType Split(vtkIdType node, vtkIdType offset, vtkIdType size)
+    {
+    double lo[3] = { VTK_DOUBLE_MAX, VTK_DOUBLE_MAX, VTK_DOUBLE_MAX };
+    double hi[3] = { -VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+    // The spread of a strided sample of the points is enough to pick the
+    // axis, and keeps the scan from costing as much as the partition.
+    const vtkCMFEKdTree::Item *items = this->Items + offset;
+    vtkIdType stride = (size > 256 ? size / 256 : 1);
+    for (vtkIdType i = 0 ; i < size ; i += stride)
+      {
+      for (int d = 0 ; d < 3 ; d++)
+        {
+        double c = items[i].X[d];
+        lo[d] = (c < lo[d] ? c : lo[d]);
+        hi[d] = (c > hi[d] ? c : hi[d]);
+        }
+      }
+    int axis = 0;
+    for (int d = 1 ; d < 3 ; d++)
+      {
+      if (hi[d] - lo[d] > hi[axis] - lo[axis])
+        {
+        axis = d;
+        }
+      }
+
+    vtkIdType leftSize = size / 2;
+    vtkstd::nth_element(this->Items + offset, this->Items + offset + leftSize,
+                        this->Items + offset + size, ItemLess(axis));
+    this->Splits[node] = this->Items[offset + leftSize].X[axis];
+    this->Axes[node] = (unsigned char) axis;
+    return leftSize;
+    }
+
+  virtual void Build(vtkIdType node, vtkIdType offset, vtkIdType size)
+    {
+    if (size <= vtkCMFEKdTree::LeafSize)
+      {
+      return;
+      }
+    vtkIdType leftSize = this->Split(node, offset, size);
+    this->Build(2*node+1, offset, leftSize);
+    this->Build(2*node+2, offset+leftSize, size-leftSize);
+    }
+};
+}
+
+const int vtkCMFEKdTree::LeafSize;
+
+//----------------------------------------------------------------------------
+vtkCMFEKdTree::vtkCMFEKdTree()
+{
+  this->NumberOfPoints = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkCMFEKdTree::~vtkCMFEKdTree()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEKdTree::Initialize()
+{
+  this->NumberOfPoints = 0;
+  vtkstd::vector<Item>().swap(this->Items);
+  vtkstd::vector<double>().swap(this->Splits);
+  vtkstd::vector<unsigned char>().swap(this->Axes);
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEKdTree::Build(vtkIdType n, const double *points,
+                          const vtkIdType *ids, int nThreads)
+{
+  this->Initialize();
+  if (n <= 0)
+    {
+    return;
+    }
+  this->NumberOfPoints = n;
+  this->Items.resize(n);
+  for (vtkIdType i = 0 ; i < n ; i++)
+    {
+    Item &item = this->Items[i];
+    item.X[0] = points[3*i];
+    item.X[1] = points[3*i+1];
+    item.X[2] = points[3*i+2];
+    item.Id = ids[i];
+    }
+
+  // The nodes at depth d cover n/2^d points, rounded either way, so the
+  // tree splits down to the first depth where those fit in a leaf and
+  // the interior nodes are the ones above it.
+  int depth = 0;
+  for (vtkIdType size = n ; size > LeafSize ; size = (size + 1) / 2)
+    {
+    depth++;
+    }
+  vtkIdType nNodes = ((vtkIdType) 1 << depth) - 1;
+  this->Splits.resize(vtkstd::max<vtkIdType>(nNodes, 1));
+  this->Axes.resize(vtkstd::max<vtkIdType>(nNodes, 1));
+
+  TreeBuilder builder;
+  builder.Items = &this->Items[0];
+  builder.Splits = &this->Splits[0];
+  builder.Axes = &this->Axes[0];
+
+  if (nThreads <= 0)
+    {
+    nThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+    }
+  if (n < minimumPointsForThreadedBuild)
+    {
+    nThreads = 1;
+    }
+  builder.BuildTree(n, nThreads, minimumPointsForThreadedBuild / 4, NULL);
+}
+
+//----------------------------------------------------------------------------
+vtkIdType vtkCMFEKdTree::FindClosestPoint(const double *x,
+                                          double &dist2) const
+{
+  vtkIdType closest = -1;
+  dist2 = VTK_DOUBLE_MAX;
+  if (this->NumberOfPoints > 0)
+    {
+    this->SearchClosest(0, 0, this->NumberOfPoints, x, closest, dist2);
+    }
+  return closest;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEKdTree::SearchClosest(vtkIdType node, vtkIdType offset,
+  vtkIdType size, const double *x, vtkIdType &closest, double &dist2) const
+{
+  if (size <= LeafSize)
+    {
+    const Item *items = &this->Items[offset];
+    for (vtkIdType i = 0 ; i < size ; i++)
+      {
+      double d2 = Distance2(items[i].X, x);
+      if (d2 < dist2)
+        {
+        dist2 = d2;
+        closest = items[i].Id;
+        }
+      }
+    return;
+    }
+
+  // The points on the left are at or below the split and those on the
+  // right at or above it, so the far side can only hold a closer point
+  // if the split plane is closer than the best point so far.
+  vtkIdType leftSize = size / 2;
+  double diff = x[this->Axes[node]] - this->Splits[node];
+  if (diff < 0.)
+    {
+    this->SearchClosest(2*node+1, offset, leftSize, x, closest, dist2);
+    if (diff*diff < dist2)
+      {
+      this->SearchClosest(2*node+2, offset+leftSize, size-leftSize, x,
+                          closest, dist2);
+      }
+    }
+  else
+    {
+    this->SearchClosest(2*node+2, offset+leftSize, size-leftSize, x,
+                        closest, dist2);
+    if (diff*diff < dist2)
+      {
+      this->SearchClosest(2*node+1, offset, leftSize, x, closest, dist2);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEKdTree::FindClosestNPoints(int k, const double *x,
+  vtkstd::vector<Neighbor> &result) const
+{
+  result.clear();
+  if (k <= 0 || this->NumberOfPoints == 0)
+    {
+    return;
+    }
+  // result is kept as a max heap on the distance while searching, so the
+  // farthest of the k points found so far is at the front.
+  this->SearchClosestN(0, 0, this->NumberOfPoints, k, x, result);
+  vtkstd::sort_heap(result.begin(), result.end());
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEKdTree::SearchClosestN(vtkIdType node, vtkIdType offset,
+  vtkIdType size, int k, const double *x,
+  vtkstd::vector<Neighbor> &heap) const
+{
+  if (size <= LeafSize)
+    {
+    const Item *items = &this->Items[offset];
+    for (vtkIdType i = 0 ; i < size ; i++)
+      {
+      double d2 = Distance2(items[i].X, x);
+      if ((int) heap.size() < k)
+        {
+        heap.push_back(Neighbor(d2, items[i].Id));
+        vtkstd::push_heap(heap.begin(), heap.end());
+        }
+      else if (d2 < heap.front().first)
+        {
+        vtkstd::pop_heap(heap.begin(), heap.end());
+        heap.back() = Neighbor(d2, items[i].Id);
+        vtkstd::push_heap(heap.begin(), heap.end());
+        }
+      }
+    return;
+    }
+
+  vtkIdType leftSize = size / 2;
+  double diff = x[this->Axes[node]] - this->Splits[node];
+  vtkIdType nearNode = (diff < 0. ? 2*node+1 : 2*node+2);
+  vtkIdType nearOffset = (diff < 0. ? offset : offset+leftSize);
+  vtkIdType nearSize = (diff < 0. ? leftSize : size-leftSize);
+  this->SearchClosestN(nearNode, nearOffset, nearSize, k, x, heap);
+  if ((int) heap.size() < k || diff*diff < heap.front().first)
+    {
+    vtkIdType farNode = (diff < 0. ? 2*node+2 : 2*node+1);
+    vtkIdType farOffset = (diff < 0. ? offset+leftSize : offset);
+    this->SearchClosestN(farNode, farOffset, size-nearSize, k, x, heap);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEKdTree::FindPointsWithinRadius(double radius, const double *x,
+  vtkstd::vector<Neighbor> &result) const
+{
+  result.clear();
+  if (radius < 0. || this->NumberOfPoints == 0)
+    {
+    return;
+    }
+  this->SearchRadius(0, 0, this->NumberOfPoints, radius*radius, x, result);
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFEKdTree::SearchRadius(vtkIdType node, vtkIdType offset,
+  vtkIdType size, double r2, const double *x,
+  vtkstd::vector<Neighbor> &result) const
+{
+  if (size <= LeafSize)
+    {
+    const Item *items = &this->Items[offset];
+    for (vtkIdType i = 0 ; i < size ; i++)
+      {
+      double d2 = Distance2(items[i].X, x);
+      if (d2 <= r2)
+        {
+        result.push_back(Neighbor(d2, items[i].Id));
+        }
+      }
+    return;
+    }
+
+  vtkIdType leftSize = size / 2;
+  double diff = x[this->Axes[node]] - this->Splits[node];
+  if (diff <= 0. || diff*diff <= r2)
+    {
+    this->SearchRadius(2*node+1, offset, leftSize, r2, x, result);
+    }
+  if (diff >= 0. || diff*diff <= r2)
+    {
+    this->SearchRadius(2*node+2, offset+leftSize, size-leftSize, r2, x,
+                       result);
+    }
+}
@@ -0,0 +1,158 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: vtkCMFEKdTree.h,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+/*****************************************************************************
+*
+* Copyright (c) 2000 - 2009, Lawrence Livermore National Security, LLC
+* Produced at the Lawrence Livermore National Laboratory
+* LLNL-CODE-400124
+* All rights reserved.
+*
+* This file is  part of VisIt. For  details, see https://visit.llnl.gov/.  The
+* full copyright notice is contained in the file COPYRIGHT located at the root
+* of the VisIt distribution or at http://www.llnl.gov/visit/copyright.html.
+*
+* Redistribution  and  use  in  source  and  binary  forms,  with  or  without
+* modification, are permitted provided that the following conditions are met:
+*
+*  - Redistributions of  source code must  retain the above  copyright notice,
+*    this list of conditions and the disclaimer below.
+*  - Redistributions in binary form must reproduce the above copyright notice,
+*    this  list of  conditions  and  the  disclaimer (as noted below)  in  the
+*    documentation and/or other materials provided with the distribution.
+*  - Neither the name of  the LLNS/LLNL nor the names of  its contributors may
+*    be used to endorse or promote products derived from this software without
+*    specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT  HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR  IMPLIED WARRANTIES, INCLUDING,  BUT NOT  LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND  FITNESS FOR A PARTICULAR  PURPOSE
+* ARE  DISCLAIMED. IN  NO EVENT  SHALL LAWRENCE  LIVERMORE NATIONAL  SECURITY,
+* LLC, THE  U.S.  DEPARTMENT OF  ENERGY  OR  CONTRIBUTORS BE  LIABLE  FOR  ANY
+* DIRECT,  INDIRECT,   INCIDENTAL,   SPECIAL,   EXEMPLARY,  OR   CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT  LIMITED TO, PROCUREMENT OF  SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF  USE, DATA, OR PROFITS; OR  BUSINESS INTERRUPTION) HOWEVER
+* CAUSED  AND  ON  ANY  THEORY  OF  LIABILITY,  WHETHER  IN  CONTRACT,  STRICT
+* LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY  WAY
+* OUT OF THE  USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+* DAMAGE.
+*
+*****************************************************************************/
+
+
+
+// .NAME vtkCMFEKdTree -- Balanced kd-tree over the points of a donor cloud
+// .SECTION Description
+//
+// A kd-tree over points used when the values of the mesh to be sampled
+// live on scattered points rather than inside cells.  Every node splits
+// its points at the median along the axis where they are most spread
+// out, down to buckets of at most LeafSize points.  The shape of the tree
+// only depends on the number of points, so the nodes are stored as an
+// implicit heap, node i having its children at 2i+1 and 2i+2, and hold
+// nothing but the split.  The points themselves are reordered so that
+// the points of a bucket are next to each other in memory, with their
+// coordinates and ids side by side.
+//
+// Subtrees are built by several threads once the top of the tree is
+// split.  The queries only read the tree, so any number of threads can
+// search it at the same time.
+//
+// .SECTION See Also
+// vtkCMFEFastLookupGrouping vtkCMFEIntervalTree
+
+#ifndef __vtkCMFEKdTree_h
+#define __vtkCMFEKdTree_h
+
+#include <vtkType.h>
+#include <vtkstd/utility>
+#include <vtkstd/vector>
+
+class vtkCMFEKdTree
+{
+public:
+  vtkCMFEKdTree();
+  ~vtkCMFEKdTree();
+
+  // Description:
+  //Builds the tree over n points, given as n triples of coordinates, and
+  //the ids that the queries return for them.  A value of 0 or less for
+  //nThreads uses vtkMultiThreader's default.
+  void Build(vtkIdType n, const double *points, const vtkIdType *ids,
+             int nThreads);
+
+  // Description:
+  //Returns the id of the point closest to x and sets dist2 to its squared
+  //distance, or returns -1 if the tree is empty.
+  vtkIdType FindClosestPoint(const double *x, double &dist2) const;
+
+  //BTX
+  // Description:
+  //Fills result with the squared distances and ids of the k points
+  //closest to x, or of all the points if there are fewer, nearest first.
+  void FindClosestNPoints(int k, const double *x,
+    vtkstd::vector<vtkstd::pair<double, vtkIdType> > &result) const;
+
+  // Description:
+  //Fills result with the squared distances and ids of the points within
+  //radius of x, in no particular order.
+  void FindPointsWithinRadius(double radius, const double *x,
+    vtkstd::vector<vtkstd::pair<double, vtkIdType> > &result) const;
+  //ETX
+
+  // Description:
+  //Forgets the points.
+  void Initialize();
+
+  vtkIdType GetNumberOfPoints() const { return this->NumberOfPoints; };
+
+  // Description:
+  //The number of points that the leaves hold at most.
+  static const int LeafSize = 16;
+
+  //BTX
+  // Description:
+  //A point as stored in the tree.
+  struct Item
+  {
+    double X[3];
+    vtkIdType Id;
+  };
+  //ETX
+
+protected:
+  vtkIdType NumberOfPoints;
+  //BTX
+  vtkstd::vector<Item> Items;
+  vtkstd::vector<double> Splits;
+  vtkstd::vector<unsigned char> Axes;
+
+  void SearchClosest(vtkIdType node, vtkIdType offset, vtkIdType size,
+    const double *x, vtkIdType &closest, double &dist2) const;
+  void SearchClosestN(vtkIdType node, vtkIdType offset, vtkIdType size,
+    int k, const double *x,
+    vtkstd::vector<vtkstd::pair<double, vtkIdType> > &heap) const;
+  void SearchRadius(vtkIdType node, vtkIdType offset, vtkIdType size,
+    double r2, const double *x,
+    vtkstd::vector<vtkstd::pair<double, vtkIdType> > &result) const;
+  //ETX
+
+private:
+  vtkCMFEKdTree(const vtkCMFEKdTree&);  // Not implemented.
+  void operator=(const vtkCMFEKdTree&);  // Not implemented.
+};
+
+
+#endif
@@ -0,0 +1,440 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: vtkCMFERemapOperator.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+/*****************************************************************************
+*
+* Copyright (c) 2000 - 2009, Lawrence Livermore National Security, LLC
+* Produced at the Lawrence Livermore National Laboratory
+* LLNL-CODE-400124
+* All rights reserved.
+*
+* This file is  part of VisIt. For  details, see https://visit.llnl.gov/.  The
+* full copyright notice is contained in the file COPYRIGHT located at the root
+* of the VisIt distribution or at http://www.llnl.gov/visit/copyright.html.
+*
+* Redistribution  and  use  in  source  and  binary  forms,  with  or  without
+* modification, are permitted provided that the following conditions are met:
+*
+*  - Redistributions of  source code must  retain the above  copyright notice,
+*    this list of conditions and the disclaimer below.
+*  - Redistributions in binary form must reproduce the above copyright notice,
+*    this  list of  conditions  and  the  disclaimer (as noted below)  in  the
+*    documentation and/or other materials provided with the distribution.
+*  - Neither the name of  the LLNS/LLNL nor the names of  its contributors may
+*    be used to endorse or promote products derived from this software without
+*    specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT  HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR  IMPLIED WARRANTIES, INCLUDING,  BUT NOT  LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND  FITNESS FOR A PARTICULAR  PURPOSE
+* ARE  DISCLAIMED. IN  NO EVENT  SHALL LAWRENCE  LIVERMORE NATIONAL  SECURITY,
+* LLC, THE  U.S.  DEPARTMENT OF  ENERGY  OR  CONTRIBUTORS BE  LIABLE  FOR  ANY
+* DIRECT,  INDIRECT,   INCIDENTAL,   SPECIAL,   EXEMPLARY,  OR   CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT  LIMITED TO, PROCUREMENT OF  SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF  USE, DATA, OR PROFITS; OR  BUSINESS INTERRUPTION) HOWEVER
+* CAUSED  AND  ON  ANY  THEORY  OF  LIABILITY,  WHETHER  IN  CONTRACT,  STRICT
+* LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY  WAY
+* OUT OF THE  USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+* DAMAGE.
+*
+*****************************************************************************/
+
+
+#include "vtkCMFERemapOperator.h"
+
+#include "vtkCMFEDesiredPoints.h"
+#include "vtkCMFEFastLookupGrouping.h"
+#include "vtkCMFEUtility.h"
+
+#include "vtkDataArray.h"
+#include "vtkDataSet.h"
+#include "vtkDoubleArray.h"
+#include "vtkMultiThreader.h"
+
+#include <string.h>
+#include <vtkstd/algorithm>
+
+namespace
+{
+  // Below this many rows per thread it is not worth spawning threads.
+  const int minimumRowsPerThread = 4096;
+
+  //----------------------------------------------------------------------------
+  // The header of an operator file, which is followed by the offsets, the
+  // ids and the weights.  The byte order mark and the size of vtkIdType
+  // tell whether the file can be read as is.
+  const char fileMagic[8] = { 'C', 'M', 'F', 'E', 'R', 'O', 'P', '1' };
+  const int byteOrderMark = 0x01020304;
+
+  struct FileHeader
+  {
+    char Magic[8];
+    int ByteOrderMark;
+    int IdSize;
+    int IsNodal;
+    int Unused;
+    vtkIdType NumberOfTargets;
+    vtkIdType NumberOfDonors;
+    vtkIdType NumberOfEntries;
+  };
+
+  //----------------------------------------------------------------------------
+  struct ApplyThreadData
+  {
+    const vtkIdType *Offsets;
+    const vtkIdType *Ids;
+    const double *Weights;
+    vtkIdType NumberOfRows;
+    int NumberOfComponents;
+    int InputType;
+    const void *Input;
+    int OutputType;
+    void *Output;
+  };
+
+  //----------------------------------------------------------------------------
+  // Evaluates the rows [start, end).  Empty rows are left alone.
+  template <class T, class U>
+  void ApplyRows(const ApplyThreadData *data, vtkIdType start, vtkIdType end,
+                 const T *in, U *out)
+  {
+    int nComps = data->NumberOfComponents;
+    for (vtkIdType r = start ; r < end ; r++)
+      {
+      vtkIdType first = data->Offsets[r];
+      vtkIdType last = data->Offsets[r+1];
+      if (first == last)
+        {
+        continue;
+        }
+      for (int c = 0 ; c < nComps ; c++)
+        {
+        double sum = 0.;
+        for (vtkIdType e = first ; e < last ; e++)
+          {
+          sum += data->Weights[e]*in[data->Ids[e]*nComps + c];
+          }
+        out[r*nComps + c] = static_cast<U>(sum);
+        }
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // The result either has the type of the variable or is double.
+  template <class T>
+  void ApplyRows(const ApplyThreadData *data, vtkIdType start, vtkIdType end,
+                 const T *in)
+  {
+    if (data->OutputType == data->InputType)
+      {
+      ApplyRows(data, start, end, in, static_cast<T *>(data->Output));
+      }
+    else
+      {
+      ApplyRows(data, start, end, in, static_cast<double *>(data->Output));
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // Every thread evaluates a contiguous range of the rows, and so writes to
+  // a disjoint part of the result.
+  VTK_THREAD_RETURN_TYPE ApplyThread(void *arg)
+  {
+    vtkMultiThreader::ThreadInfo *info =
+      static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+    ApplyThreadData *data = static_cast<ApplyThreadData *>(info->UserData);
+
+    int tid = info->ThreadID;
+    int nThreads = info->NumberOfThreads;
+    vtkIdType start = data->NumberOfRows / nThreads * tid +
+      vtkstd::min<vtkIdType>(tid, data->NumberOfRows % nThreads);
+    vtkIdType end = start + data->NumberOfRows / nThreads +
+      (tid < data->NumberOfRows % nThreads ? 1 : 0);
+
+    switch (data->InputType)
+      {
+      vtkTemplateMacro(
+        ApplyRows(data, start, end, static_cast<const VTK_TT *>(data->Input)));
+      }
+    return VTK_THREAD_RETURN_VALUE;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkCMFERemapOperator::vtkCMFERemapOperator()
+{
+  this->Initialize();
+}
+
+//----------------------------------------------------------------------------
+vtkCMFERemapOperator::~vtkCMFERemapOperator()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFERemapOperator::Initialize()
+{
+  this->IsNodal = true;
+  this->NumberOfDonors = 0;
+  this->NumberOfPointsLocated = 0;
+  this->NumberOfPointsNearest = 0;
+  this->NumberOfPointsMissed = 0;
+  this->Offsets.assign(1, 0);
+  vtkstd::vector<vtkIdType>().swap(this->Ids);
+  vtkstd::vector<double>().swap(this->Weights);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFERemapOperator::Build(vtkCMFEFastLookupGrouping *flg,
+                                 vtkDataSet *output_mesh, bool isNodal)
+{
+  this->Initialize();
+  if (flg->GetMeshes().size() != 1)
+    {
+    return false;
+    }
+  vtkDataSet *donor = flg->GetMeshes()[0];
+
+  // Only the locations are needed, so no variable is looked up.
+  flg->SetVariables(vtkstd::vector<vtkStdString>(), isNodal);
+  if (!flg->Finalize())
+    {
+    return false;
+    }
+
+  // The desired points give the sample points of every kind of mesh in the
+  // order of its points or cells.
+  vtkCMFEDesiredPoints dp(isNodal, 0);
+  dp.AddDataset(output_mesh);
+  dp.Finalize();
+
+  this->IsNodal = isNodal;
+  this->NumberOfDonors =
+    (isNodal ? donor->GetNumberOfPoints() : donor->GetNumberOfCells());
+  vtkIdType nRows = dp.GetNumberOfPoints();
+  this->Offsets.reserve(nRows + 1);
+
+  vtkCMFEFastLookupGrouping::SearchState state;
+  state.Record = true;
+  double unused;
+  for (vtkIdType r = 0 ; r < nRows ; r++)
+    {
+    float pt[3];
+    dp.GetPoint(r, pt);
+    if (flg->GetValue(pt, &unused, state))
+      {
+      this->Ids.insert(this->Ids.end(), state.RecordedIds.begin(),
+                       state.RecordedIds.end());
+      this->Weights.insert(this->Weights.end(), state.RecordedWeights.begin(),
+                           state.RecordedWeights.end());
+      }
+    this->Offsets.push_back((vtkIdType) this->Ids.size());
+    }
+  this->NumberOfPointsLocated = state.NumberOfPointsLocated;
+  this->NumberOfPointsNearest = state.NumberOfPointsNearest;
+  this->NumberOfPointsMissed = state.NumberOfPointsMissed;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+vtkDataArray *vtkCMFERemapOperator::Apply(vtkDataArray *donor,
+  vtkDataArray *fallback, const char *name, int nThreads)
+{
+  if (donor == NULL || donor->GetNumberOfTuples() != this->NumberOfDonors)
+    {
+    return NULL;
+    }
+  // The fallback values are copied as whole tuples into the result.
+  if (fallback != NULL &&
+      fallback->GetNumberOfComponents() != donor->GetNumberOfComponents())
+    {
+    return NULL;
+    }
+
+  // Arrays that can not be addressed by value, such as bit arrays, are read
+  // as doubles.
+  vtkDataArray *input = donor;
+  int inputType = VTK_VOID;
+  switch (donor->GetDataType())
+    {
+    vtkTemplateMacro(inputType = donor->GetDataType());
+    }
+  if (inputType == VTK_VOID)
+    {
+    input = vtkDoubleArray::New();
+    input->DeepCopy(donor);
+    inputType = VTK_DOUBLE;
+    }
+
+  int nComps = donor->GetNumberOfComponents();
+  vtkIdType nRows = this->GetNumberOfTargets();
+  vtkDataArray *result = vtkDataArray::CreateDataArray(
+    CMFEUtility::GetResultType(inputType, this->IsNodal));
+  result->SetName(name);
+  result->SetNumberOfComponents(nComps);
+  result->SetNumberOfTuples(nRows);
+
+  ApplyThreadData data;
+  data.Offsets = &this->Offsets[0];
+  data.Ids = (this->Ids.empty() ? NULL : &this->Ids[0]);
+  data.Weights = (this->Weights.empty() ? NULL : &this->Weights[0]);
+  data.NumberOfRows = nRows;
+  data.NumberOfComponents = nComps;
+  data.InputType = inputType;
+  data.Input = input->GetVoidPointer(0);
+  data.OutputType = result->GetDataType();
+  data.Output = result->GetVoidPointer(0);
+
+  if (nThreads <= 0)
+    {
+    nThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+    }
+  nThreads = (int) vtkstd::min<vtkIdType>(nThreads, nRows / minimumRowsPerThread);
+  nThreads = vtkstd::max(vtkstd::min(nThreads, VTK_MAX_THREADS), 1);
+  vtkMultiThreader *threader = vtkMultiThreader::New();
+  threader->SetNumberOfThreads(nThreads);
+  threader->SetSingleMethod(ApplyThread, &data);
+  threader->SingleMethodExecute();
+  threader->Delete();
+  if (input != donor)
+    {
+    input->Delete();
+    }
+
+  // The values that were not found.
+  if (fallback != NULL && fallback->GetNumberOfTuples() < nRows)
+    {
+    fallback = NULL;
+    }
+  char *out = static_cast<char *>(data.Output);
+  int tupleSize = nComps*vtkDataArray::GetDataTypeSize(data.OutputType);
+  for (vtkIdType r = 0 ; r < nRows ; r++)
+    {
+    if (this->Offsets[r] != this->Offsets[r+1])
+      {
+      continue;
+      }
+    if (fallback != NULL)
+      {
+      result->SetTuple(r, fallback->GetTuple(r));
+      }
+    else
+      {
+      memset(out + r*tupleSize, 0, tupleSize);
+      }
+    }
+  return result;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFERemapOperator::Write(const char *fileName) const
+{
+  ofstream file(fileName, ios::out | ios::binary);
+  if (!file)
+    {
+    return false;
+    }
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.Magic, fileMagic, sizeof(fileMagic));
+  header.ByteOrderMark = byteOrderMark;
+  header.IdSize = (int) sizeof(vtkIdType);
+  header.IsNodal = (this->IsNodal ? 1 : 0);
+  header.NumberOfTargets = this->GetNumberOfTargets();
+  header.NumberOfDonors = this->NumberOfDonors;
+  header.NumberOfEntries = (vtkIdType) this->Ids.size();
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(&this->Offsets[0]),
+             this->Offsets.size()*sizeof(vtkIdType));
+  if (!this->Ids.empty())
+    {
+    file.write(reinterpret_cast<const char *>(&this->Ids[0]),
+               this->Ids.size()*sizeof(vtkIdType));
+    file.write(reinterpret_cast<const char *>(&this->Weights[0]),
+               this->Weights.size()*sizeof(double));
+    }
+  return !file.fail();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCMFERemapOperator::Read(const char *fileName)
+{
+  this->Initialize();
+  ifstream file(fileName, ios::in | ios::binary);
+  if (!file)
+    {
+    return false;
+    }
+
+  FileHeader header;
+  file.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (file.fail() || memcmp(header.Magic, fileMagic, sizeof(fileMagic)) != 0 ||
+      header.ByteOrderMark != byteOrderMark ||
+      header.IdSize != (int) sizeof(vtkIdType) ||
+      header.NumberOfTargets < 0 || header.NumberOfEntries < 0)
+    {
+    return false;
+    }
+
+  this->Offsets.resize(header.NumberOfTargets + 1);
+  this->Ids.resize(header.NumberOfEntries);
+  this->Weights.resize(header.NumberOfEntries);
+  file.read(reinterpret_cast<char *>(&this->Offsets[0]),
+            this->Offsets.size()*sizeof(vtkIdType));
+  if (header.NumberOfEntries > 0)
+    {
+    file.read(reinterpret_cast<char *>(&this->Ids[0]),
+              this->Ids.size()*sizeof(vtkIdType));
+    file.read(reinterpret_cast<char *>(&this->Weights[0]),
+              this->Weights.size()*sizeof(double));
+    }
+
+  // A truncated or inconsistent file would index past the arrays, and the
+  // counts of the header have to account for the whole file.
+  bool valid = !file.fail();
+  char extra;
+  file.read(&extra, 1);
+  valid = valid && file.gcount() == 0 && this->Offsets[0] == 0 &&
+    this->Offsets[header.NumberOfTargets] == header.NumberOfEntries;
+  for (vtkIdType r = 0 ; valid && r < header.NumberOfTargets ; r++)
+    {
+    valid = (this->Offsets[r] <= this->Offsets[r+1]);
+    }
+  for (vtkIdType e = 0 ; valid && e < header.NumberOfEntries ; e++)
+    {
+    valid = (this->Ids[e] >= 0 && this->Ids[e] < header.NumberOfDonors);
+    }
+  if (!valid)
+    {
+    this->Initialize();
+    return false;
+    }
+  this->IsNodal = (header.IsNodal != 0);
+  this->NumberOfDonors = header.NumberOfDonors;
+  for (vtkIdType r = 0 ; r < header.NumberOfTargets ; r++)
+    {
+    if (this->Offsets[r] != this->Offsets[r+1])
+      {
+      this->NumberOfPointsLocated++;
+      }
+    else
+      {
+      this->NumberOfPointsMissed++;
+      }
+    }
+  return true;
+}
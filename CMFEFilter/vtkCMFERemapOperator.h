@@ -0,0 +1,165 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: vtkCMFERemapOperator.h,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+/*****************************************************************************
+*
+* Copyright (c) 2000 - 2009, Lawrence Livermore National Security, LLC
+* Produced at the Lawrence Livermore National Laboratory
+* LLNL-CODE-400124
+* All rights reserved.
+*
+* This file is  part of VisIt. For  details, see https://visit.llnl.gov/.  The
+* full copyright notice is contained in the file COPYRIGHT located at the root
+* of the VisIt distribution or at http://www.llnl.gov/visit/copyright.html.
+*
+* Redistribution  and  use  in  source  and  binary  forms,  with  or  without
+* modification, are permitted provided that the following conditions are met:
+*
+*  - Redistributions of  source code must  retain the above  copyright notice,
+*    this list of conditions and the disclaimer below.
+*  - Redistributions in binary form must reproduce the above copyright notice,
+*    this  list of  conditions  and  the  disclaimer (as noted below)  in  the
+*    documentation and/or other materials provided with the distribution.
+*  - Neither the name of  the LLNS/LLNL nor the names of  its contributors may
+*    be used to endorse or promote products derived from this software without
+*    specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT  HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR  IMPLIED WARRANTIES, INCLUDING,  BUT NOT  LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND  FITNESS FOR A PARTICULAR  PURPOSE
+* ARE  DISCLAIMED. IN  NO EVENT  SHALL LAWRENCE  LIVERMORE NATIONAL  SECURITY,
+* LLC, THE  U.S.  DEPARTMENT OF  ENERGY  OR  CONTRIBUTORS BE  LIABLE  FOR  ANY
+* DIRECT,  INDIRECT,   INCIDENTAL,   SPECIAL,   EXEMPLARY,  OR   CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT  LIMITED TO, PROCUREMENT OF  SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF  USE, DATA, OR PROFITS; OR  BUSINESS INTERRUPTION) HOWEVER
+* CAUSED  AND  ON  ANY  THEORY  OF  LIABILITY,  WHETHER  IN  CONTRACT,  STRICT
+* LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY  WAY
+* OUT OF THE  USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+* DAMAGE.
+*
+*****************************************************************************/
+
+
+// .NAME vtkCMFERemapOperator -- Cross mesh field evaluation as a sparse matrix
+// .SECTION Description
+//
+// When the mesh to be sampled and the mesh to map to keep their geometry,
+// every execution of the cross mesh field evaluation locates the same
+// sample points in the same cells.  This operator keeps the outcome of
+// that search: for every point (or cell) of the mesh to map to, the
+// points (or the cell) of the mesh to be sampled that its value is
+// evaluated from and their weights.  The rows are stored in compressed
+// sparse row form, and an empty row marks a sample point that was not
+// found.  Mapping a variable is then a sparse matrix-vector product, which
+// is split among threads.  The operator can be written to a file and read
+// back, so that later sessions skip the search altogether.
+//
+// The ids refer to a single mesh to be sampled on a single processor.
+//
+// .SECTION See Also
+// vtkCMFEAlgorithm vtkCMFEFastLookupGrouping
+
+#ifndef __vtkCMFERemapOperator_h
+#define __vtkCMFERemapOperator_h
+
+#include <vtkType.h>
+#include <vtkstd/vector>
+
+class vtkCMFEFastLookupGrouping;
+class vtkDataArray;
+class vtkDataSet;
+
+class vtkCMFERemapOperator
+{
+public:
+  vtkCMFERemapOperator();
+  ~vtkCMFERemapOperator();
+
+  // Description:
+  //Locates every point of output_mesh, or the center of every cell if
+  //isNodal is false, in the grouping, which has to hold a single mesh, and
+  //keeps how each value is evaluated.  The variables of the grouping are
+  //cleared.  Returns false if the operator could not be built.
+  bool Build(vtkCMFEFastLookupGrouping *flg, vtkDataSet *output_mesh,
+             bool isNodal);
+
+  // Description:
+  //Evaluates a variable of the mesh the operator was built on, which has
+  //to have GetNumberOfDonors() tuples, at the points of the mesh to map
+  //to.  Values that were not found are taken from fallback, if it is not
+  //NULL and has a tuple per target, and are 0 otherwise.  The result has
+  //the type that CMFEUtility::GetResultType gives for the variable; the
+  //caller owns it.  Returns NULL if donor has the wrong number of tuples,
+  //or if fallback has another number of components than donor.  A value
+  //of 0 or less for nThreads uses vtkMultiThreader's default.
+  vtkDataArray *Apply(vtkDataArray *donor, vtkDataArray *fallback,
+                      const char *name, int nThreads);
+
+  // Description:
+  //Writes the operator to a binary file, or reads it back.  A file can only
+  //be read on a machine with the same byte order and size of vtkIdType.
+  //Both return false on failure, in which case Read leaves the operator
+  //empty.  Read fails on a file whose size does not match the counts in
+  //its header.
+  bool Write(const char *fileName) const;
+  bool Read(const char *fileName);
+
+  // Description:
+  //Forgets the operator.
+  void Initialize();
+
+  // Description:
+  //Whether the rows are points of the mesh to map to, and the ids points
+  //of the mesh to be sampled, or both are cells.
+  bool GetIsNodal() const { return this->IsNodal; };
+
+  // Description:
+  //The number of rows, which is the number of points or cells of the mesh
+  //to map to, and the number of points or cells of the mesh to be sampled.
+  vtkIdType GetNumberOfTargets() const { return (vtkIdType) this->Offsets.size() - 1; };
+  vtkIdType GetNumberOfDonors() const { return this->NumberOfDonors; };
+
+  // Description:
+  //Returns true if the operator holds rows.
+  bool IsValid() const { return this->Offsets.size() > 1; };
+
+  // Description:
+  //The number of rows whose position Build located in a cell, or
+  //interpolated from points, gave the value of the nearest cell, and did
+  //not find.  The file does not tell the first two apart, so after Read
+  //every row that was found counts as located.
+  vtkIdType GetNumberOfPointsLocated() const { return this->NumberOfPointsLocated; };
+  vtkIdType GetNumberOfPointsNearest() const { return this->NumberOfPointsNearest; };
+  vtkIdType GetNumberOfPointsMissed() const { return this->NumberOfPointsMissed; };
+
+protected:
+  bool IsNodal;
+  vtkIdType NumberOfDonors;
+  vtkIdType NumberOfPointsLocated;
+  vtkIdType NumberOfPointsNearest;
+  vtkIdType NumberOfPointsMissed;
+  //BTX
+  vtkstd::vector<vtkIdType> Offsets;
+  vtkstd::vector<vtkIdType> Ids;
+  vtkstd::vector<double> Weights;
+  //ETX
+
+private:
+  vtkCMFERemapOperator(const vtkCMFERemapOperator&);  // Not implemented.
+  void operator=(const vtkCMFERemapOperator&);  // Not implemented.
+};
+
+
+#endif
@@ -0,0 +1,342 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: vtkCMFESFCPartition.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+/*****************************************************************************
+*
+* Copyright (c) 2000 - 2009, Lawrence Livermore National Security, LLC
+* Produced at the Lawrence Livermore National Laboratory
+* LLNL-CODE-400124
+* All rights reserved.
+*
+* This file is  part of VisIt. For  details, see https://visit.llnl.gov/.  The
+* full copyright notice is contained in the file COPYRIGHT located at the root
+* of the VisIt distribution or at http://www.llnl.gov/visit/copyright.html.
+*
+* Redistribution  and  use  in  source  and  binary  forms,  with  or  without
+* modification, are permitted provided that the following conditions are met:
+*
+*  - Redistributions of  source code must  retain the above  copyright notice,
+*    this list of conditions and the disclaimer below.
+*  - Redistributions in binary form must reproduce the above copyright notice,
+*    this  list of  conditions  and  the  disclaimer (as noted below)  in  the
+*    documentation and/or other materials provided with the distribution.
+*  - Neither the name of  the LLNS/LLNL nor the names of  its contributors may
+*    be used to endorse or promote products derived from this software without
+*    specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT  HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR  IMPLIED WARRANTIES, INCLUDING,  BUT NOT  LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND  FITNESS FOR A PARTICULAR  PURPOSE
+* ARE  DISCLAIMED. IN  NO EVENT  SHALL LAWRENCE  LIVERMORE NATIONAL  SECURITY,
+* LLC, THE  U.S.  DEPARTMENT OF  ENERGY  OR  CONTRIBUTORS BE  LIABLE  FOR  ANY
+* DIRECT,  INDIRECT,   INCIDENTAL,   SPECIAL,   EXEMPLARY,  OR   CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT  LIMITED TO, PROCUREMENT OF  SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF  USE, DATA, OR PROFITS; OR  BUSINESS INTERRUPTION) HOWEVER
+* CAUSED  AND  ON  ANY  THEORY  OF  LIABILITY,  WHETHER  IN  CONTRACT,  STRICT
+* LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY  WAY
+* OUT OF THE  USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+* DAMAGE.
+*
+*****************************************************************************/
+
+
+#include "vtkCMFESFCPartition.h"
+
+#include "vtkCMFEUtility.h"
+
+#include <vtkstd/algorithm>
+#include <vtkstd/vector>
+
+namespace
+{
+  // Every axis is split into 1024 cells, so a key has 30 bits.
+  const int levels = 10;
+  const int keyBits = 3*levels;
+
+  // Number of bits of the buckets that the second pass splits each bucket
+  // that holds a cut into.
+  const int refineBits = 6;
+
+  //----------------------------------------------------------------------------
+  // Maps points to their position along the Morton curve over a box.
+  class CurveKey
+  {
+  public:
+    CurveKey(const float *bounds)
+    {
+      for (int i = 0 ; i < 3 ; i++)
+        {
+        this->Origin[i] = bounds[2*i];
+        float extent = bounds[2*i+1] - bounds[2*i];
+        this->Scale[i] = (extent > 0.f ? (1 << levels) / extent : 0.f);
+        }
+    }
+
+    unsigned int operator()(const float *pt) const
+    {
+      unsigned int ijk[3];
+      for (int i = 0 ; i < 3 ; i++)
+        {
+        float q = (pt[i] - this->Origin[i]) * this->Scale[i];
+        ijk[i] = (q <= 0.f ? 0 : (q >= (1 << levels) - 1 ?
+                  (1 << levels) - 1 : (unsigned int) q));
+        }
+      return CMFEUtility::MortonEncode(ijk[0], ijk[1], ijk[2]);
+    }
+
+  private:
+    float Origin[3];
+    float Scale[3];
+  };
+
+  //----------------------------------------------------------------------------
+  // Adds the cost of every key to the bucket given by its top bits.  Keys
+  // whose bucket has no slot in bucketSlot are skipped.  Each slot is split
+  // into 2^subBits sub-buckets by the next bits of the key.
+  void AddToHistogram(const vtkstd::vector<unsigned int> &keys,
+                      const double *costs, double cost, int bucketBits,
+                      const vtkstd::vector<int> *bucketSlot, int subBits,
+                      vtkstd::vector<double> &histogram)
+  {
+    for (size_t i = 0 ; i < keys.size() ; i++)
+      {
+      unsigned int bucket = keys[i] >> (keyBits - bucketBits);
+      int bin = (int) bucket;
+      if (bucketSlot != NULL)
+        {
+        int slot = (*bucketSlot)[bucket];
+        if (slot < 0)
+          {
+          continue;
+          }
+        unsigned int sub = (keys[i] >> (keyBits - bucketBits - subBits)) &
+                           ((1u << subBits) - 1);
+        bin = (slot << subBits) + (int) sub;
+        }
+      histogram[bin] += (costs != NULL ? costs[i] : cost);
+      }
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkCMFESFCPartition::vtkCMFESFCPartition()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkCMFESFCPartition::~vtkCMFESFCPartition()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFESFCPartition::CreatePartition(vtkCMFEDesiredPoints *dp,
+                                       vtkCMFEFastLookupGrouping *flg, double *bounds)
+{
+  int   i;
+  int   nProcs = CMFEUtility::PAR_Size();
+
+  float fbounds[6];
+  for (i = 0 ; i < 6 ; i++)
+    {
+    fbounds[i] = bounds[i];
+    }
+  if (bounds[4] == bounds[5])
+    {
+    fbounds[4] -= 1.;
+    fbounds[5] += 1.;
+    }
+  CurveKey key(fbounds);
+
+  //
+  // Find where the sample points and the cells of the mesh to be sampled
+  // lie along the curve.  The cells are placed at their centers.
+  //
+  vtkstd::vector<unsigned int> pointKeys;
+  pointKeys.reserve(dp->GetNumberOfPoints());
+  vtkstd::vector<float> gridPts;
+  for (i = 0 ; i < dp->GetNumberOfDatasets() ; i++)
+    {
+    vtkIdType n = dp->GetDataSetSize(i);
+    if (i < dp->GetNumberOfPointLists())
+      {
+      const float *pts = dp->GetPointList(i);
+      for (vtkIdType q = 0 ; q < n ; q++)
+        {
+        pointKeys.push_back(key(pts + 3*q));
+        }
+      continue;
+      }
+    const vtkIdType batchSize = 4096;
+    gridPts.resize(3*batchSize);
+    for (vtkIdType q = 0 ; q < n ; q += batchSize)
+      {
+      int nBatch = (int) vtkstd::min(batchSize, n - q);
+      dp->GetRGridPoints(i - dp->GetNumberOfPointLists(), q, nBatch,
+                         &gridPts[0]);
+      for (int p = 0 ; p < nBatch ; p++)
+        {
+        pointKeys.push_back(key(&gridPts[3*p]));
+        }
+      }
+    }
+
+  vtkstd::vector<float> cellCenters;
+  vtkstd::vector<double> cellCosts;
+  this->GetCellCentersAndCosts(flg, cellCenters, cellCosts);
+  vtkstd::vector<unsigned int> cellKeys(cellCosts.size());
+  for (size_t c = 0 ; c < cellKeys.size() ; c++)
+    {
+    cellKeys[c] = key(&cellCenters[3*c]);
+    }
+  const double *cellCostPtr = (cellCosts.empty() ? NULL : &cellCosts[0]);
+
+  //
+  // First pass: the cost of each of about 16 buckets per processor along
+  // the curve, summed over all processors.
+  //
+  int bucketBits = 1;
+  while ((1 << bucketBits) < 16*nProcs && bucketBits < keyBits - refineBits)
+    {
+    bucketBits++;
+    }
+  int nBuckets = 1 << bucketBits;
+  vtkstd::vector<double> histogram(nBuckets, 0.);
+  AddToHistogram(pointKeys, NULL, this->PointWeight, bucketBits, NULL, 0,
+                 histogram);
+  AddToHistogram(cellKeys, cellCostPtr, 0., bucketBits, NULL, 0, histogram);
+  vtkstd::vector<double> cost(nBuckets);
+  CMFEUtility::SumDoubleArrayAcrossAllProcessors(&histogram[0], &cost[0],
+                                                 nBuckets);
+
+  // Every processor should get the same share of the total cost, so the
+  // k-th cut is where the cost along the curve reaches k/nProcs of it.
+  double total = 0.;
+  for (i = 0 ; i < nBuckets ; i++)
+    {
+    total += cost[i];
+    }
+  vtkstd::vector<double> target(nProcs+1);
+  for (i = 0 ; i <= nProcs ; i++)
+    {
+    target[i] = total * i / nProcs;
+    }
+
+  vtkstd::vector<int> cutBucket(nProcs+1, nBuckets);
+  vtkstd::vector<double> costBefore(nProcs+1, total);
+  vtkstd::vector<int> bucketSlot(nBuckets, -1);
+  int nSlots = 0;
+  double soFar = 0.;
+  int cut = 1;
+  for (i = 0 ; i < nBuckets && cut < nProcs ; i++)
+    {
+    while (cut < nProcs && soFar + cost[i] >= target[cut])
+      {
+      cutBucket[cut] = i;
+      costBefore[cut] = soFar;
+      if (bucketSlot[i] < 0)
+        {
+        bucketSlot[i] = nSlots++;
+        }
+      cut++;
+      }
+    soFar += cost[i];
+    }
+
+  //
+  // Second pass: split the buckets that hold a cut into finer buckets, so
+  // that the cuts can be placed more precisely.
+  //
+  vtkstd::vector<double> subCost(nSlots << refineBits, 0.);
+  if (nSlots > 0)
+    {
+    vtkstd::vector<double> subHistogram(nSlots << refineBits, 0.);
+    AddToHistogram(pointKeys, NULL, this->PointWeight, bucketBits,
+                   &bucketSlot, refineBits, subHistogram);
+    AddToHistogram(cellKeys, cellCostPtr, 0., bucketBits, &bucketSlot,
+                   refineBits, subHistogram);
+    CMFEUtility::SumDoubleArrayAcrossAllProcessors(&subHistogram[0],
+      &subCost[0], (int) subHistogram.size());
+    }
+
+  // The cuts are keys: processor p gets [cutKey[p], cutKey[p+1]).
+  const int subShift = keyBits - bucketBits - refineBits;
+  vtkstd::vector<unsigned int> cutKey(nProcs+1);
+  cutKey[0] = 0;
+  cutKey[nProcs] = 1u << keyBits;
+  for (i = 1 ; i < nProcs ; i++)
+    {
+    unsigned int bucket = cutBucket[i];
+    if ((int) bucket >= nBuckets)
+      {
+      cutKey[i] = 1u << keyBits;
+      continue;
+      }
+    const double *sub = &subCost[bucketSlot[bucket] << refineBits];
+    double before = costBefore[i];
+    int s = 0;
+    while (s < (1 << refineBits) - 1 && before + sub[s] < target[i])
+      {
+      before += sub[s];
+      s++;
+      }
+    // Cut at whichever end of the sub-bucket is closer to the target.
+    if (target[i] - before > before + sub[s] - target[i])
+      {
+      s++;
+      }
+    cutKey[i] = vtkstd::max(cutKey[i-1],
+      (bucket << (keyBits - bucketBits)) + ((unsigned int) s << subShift));
+    }
+
+  //
+  // Turn the piece of the curve of each processor into the largest octree
+  // boxes that make it up.  A range of Morton keys that starts at a
+  // multiple of 8^k and holds 8^k keys is a box of 2^k cells on a side.
+  //
+  vtkstd::vector<double> boxes;
+  vtkstd::vector<int> processors;
+  double cellSize[3];
+  for (i = 0 ; i < 3 ; i++)
+    {
+    cellSize[i] = ((double) fbounds[2*i+1] - fbounds[2*i]) / (1 << levels);
+    }
+  for (int p = 0 ; p < nProcs ; p++)
+    {
+    unsigned int start = cutKey[p];
+    while (start < cutKey[p+1])
+      {
+      int k = 0;
+      while (k < levels && (start & ((1u << 3*(k+1)) - 1)) == 0 &&
+             start + (1u << 3*(k+1)) <= cutKey[p+1])
+        {
+        k++;
+        }
+      unsigned int ijk[3];
+      CMFEUtility::MortonDecode(start, ijk);
+      for (i = 0 ; i < 3 ; i++)
+        {
+        unsigned int end = ijk[i] + (1u << k);
+        boxes.push_back(ijk[i] == 0 ? fbounds[2*i] :
+                        fbounds[2*i] + ijk[i]*cellSize[i]);
+        boxes.push_back(end == (1u << levels) ? fbounds[2*i+1] :
+                        fbounds[2*i] + end*cellSize[i]);
+        }
+      processors.push_back(p);
+      start += 1u << 3*k;
+      }
+    }
+
+  this->SetRegions(boxes, processors);
+}
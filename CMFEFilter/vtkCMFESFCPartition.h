@@ -0,0 +1,92 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: vtkCMFESFCPartition.h,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+/*****************************************************************************
+*
+* Copyright (c) 2000 - 2009, Lawrence Livermore National Security, LLC
+* Produced at the Lawrence Livermore National Laboratory
+* LLNL-CODE-400124
+* All rights reserved.
+*
+* This file is  part of VisIt. For  details, see https://visit.llnl.gov/.  The
+* full copyright notice is contained in the file COPYRIGHT located at the root
+* of the VisIt distribution or at http://www.llnl.gov/visit/copyright.html.
+*
+* Redistribution  and  use  in  source  and  binary  forms,  with  or  without
+* modification, are permitted provided that the following conditions are met:
+*
+*  - Redistributions of  source code must  retain the above  copyright notice,
+*    this list of conditions and the disclaimer below.
+*  - Redistributions in binary form must reproduce the above copyright notice,
+*    this  list of  conditions  and  the  disclaimer (as noted below)  in  the
+*    documentation and/or other materials provided with the distribution.
+*  - Neither the name of  the LLNS/LLNL nor the names of  its contributors may
+*    be used to endorse or promote products derived from this software without
+*    specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT  HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR  IMPLIED WARRANTIES, INCLUDING,  BUT NOT  LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND  FITNESS FOR A PARTICULAR  PURPOSE
+* ARE  DISCLAIMED. IN  NO EVENT  SHALL LAWRENCE  LIVERMORE NATIONAL  SECURITY,
+* LLC, THE  U.S.  DEPARTMENT OF  ENERGY  OR  CONTRIBUTORS BE  LIABLE  FOR  ANY
+* DIRECT,  INDIRECT,   INCIDENTAL,   SPECIAL,   EXEMPLARY,  OR   CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT  LIMITED TO, PROCUREMENT OF  SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF  USE, DATA, OR PROFITS; OR  BUSINESS INTERRUPTION) HOWEVER
+* CAUSED  AND  ON  ANY  THEORY  OF  LIABILITY,  WHETHER  IN  CONTRACT,  STRICT
+* LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY  WAY
+* OUT OF THE  USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+* DAMAGE.
+*
+*****************************************************************************/
+
+
+// .NAME vtkCMFESFCPartition -- Partitions space along a Morton curve
+// .SECTION Description
+//
+// Alternative to the recursive bisection of vtkCMFESpatialPartition for
+// large numbers of processors.  The sample points and the centers of the
+// cells of the mesh to be sampled are ordered along a Morton curve over
+// the bounds, and the curve is cut into one piece of equal cost per
+// processor.  The cuts are found with two collective calls, regardless of
+// the number of processors: one over a coarse histogram of the cost along
+// the curve, and one that refines the buckets the cuts fall in.  Every
+// piece of the curve is a union of octree boxes, which become the regions
+// of the processor, so the partition is queried like any other.
+//
+// .SECTION See Also
+// vtkCMFESpatialPartition
+
+#ifndef __vtkCMFESFCPartition_h
+#define __vtkCMFESFCPartition_h
+
+#include "vtkCMFESpatialPartition.h"
+
+class vtkCMFESFCPartition : public vtkCMFESpatialPartition
+{
+public:
+  vtkCMFESFCPartition();
+  virtual ~vtkCMFESFCPartition();
+
+  // Description:
+  //Cuts the Morton curve over the bounds into pieces of equal cost.
+  virtual void CreatePartition(vtkCMFEDesiredPoints *, vtkCMFEFastLookupGrouping *, double *);
+
+private:
+  vtkCMFESFCPartition(const vtkCMFESFCPartition&);  // Not implemented.
+  void operator=(const vtkCMFESFCPartition&);  // Not implemented.
+};
+
+
+#endif
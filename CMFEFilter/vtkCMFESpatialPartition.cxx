@@ -60,6 +60,8 @@
 #include "vtkDataSet.h"
 #include "vtkMultiProcessController.h"
 
+#include <vtkstd/algorithm>
+
 
 // ****************************************************************************
 //  Class: Boundary
@@ -80,7 +82,10 @@ typedef enum
     Z_AXIS
 } Axis;
 
-const int npivots = 5;
+// A boundary starts with a few pivots, and every time none of them is close
+// enough to the split it wants, it zooms in with more of them.
+const int initialPivots = 5;
+const int maximumPivots = 63;
 class Boundary
 {
    public:
@@ -91,25 +96,31 @@ class Boundary
      bool             AttemptSplit(Boundary *&, Boundary *&);
      bool             IsDone(void) { return isDone; };
      bool             IsLeaf(void) { return (numProcs == 1); };
-     void             AddCell(const float *);
-     void             AddPoint(const float *);
+     void             AddPoint(const float *, double);
      void             AddRGrid(const float *, const float *, const float *,
-                               int, int, int);
+                               int, int, int, double);
      static void      SetIs2D(bool b) { is2D = b; };
+     static void      SetMaximumAttempts(int n) { maximumAttempts = n; };
      static void      PrepareSplitQuery(Boundary **, int);
      
    protected:
      float            bounds[6];
-     float            pivots[npivots];
-     int              numCells[npivots+1];
+     float            pivots[maximumPivots];
+     double           cost[maximumPivots+1];
+     int              nPivots;
      int              numProcs;
      int              nAttempts;
      Axis             axis;
      bool             isDone;
      static bool      is2D;
+     static int       maximumAttempts;
+
+     void             SetPivots(float, float, int);
+     void             Split(float, Boundary *&, Boundary *&);
 };
 
 bool Boundary::is2D = false;
+int Boundary::maximumAttempts = 4;
 
 
 
@@ -139,16 +150,22 @@ Boundary::Boundary(const float *b, int n, Axis a)
     {
     index = 4;
     }
-  float min = bounds[index];
-  float max = bounds[index+1];
-  float step = (max-min) / (npivots+1);
-  for (i = 0 ; i < npivots ; i++)
+  SetPivots(bounds[index], bounds[index+1], initialPivots);
+}
+
+//----------------------------------------------------------------------------
+void Boundary::SetPivots(float min, float max, int n)
+{
+  //spread n pivots evenly over (min, max) and reset the costs of the bins
+  nPivots = n;
+  float step = (max-min) / (nPivots+1);
+  for (int i = 0 ; i < nPivots ; i++)
     {
     pivots[i] = min + (i+1)*step;
     }
-  for (i = 0 ; i < npivots+1 ; i++)
+  for (int i = 0 ; i < nPivots+1 ; i++)
     {
-    numCells[i] = 0;
+    cost[i] = 0.;
     }
 }
 
@@ -160,29 +177,35 @@ void Boundary::PrepareSplitQuery(Boundary **b_list, int listSize)
   //from each processor needs to be unified.  That is the purpose of this
   //method.  It unifies the information so that Boundaries can later make
   //good decisions regarding whether or not they can split themselves.
+  //The costs of all the boundaries go in a single message, so there is
+  //one collective call per round.
   int   i, j;
   int   idx;
 
-  int  num_vals = listSize*(npivots+1);
-  int *in_vals = new int[num_vals];
+  int  num_vals = 0;
+  for (i = 0 ; i < listSize ; i++)
+    {
+    num_vals += b_list[i]->nPivots+1;
+    }
+  double *in_vals = new double[num_vals];
   idx = 0;
   for (i = 0 ; i < listSize ; i++)
     {
-    for (j = 0 ; j < npivots+1 ; j++)
+    for (j = 0 ; j < b_list[i]->nPivots+1 ; j++)
       {
-      in_vals[idx++] = b_list[i]->numCells[j];
+      in_vals[idx++] = b_list[i]->cost[j];
       }
     }
 
-  int *out_vals = new int[num_vals];   
-  CMFEUtility::SumIntArrayAcrossAllProcessors(in_vals, out_vals, num_vals);
+  double *out_vals = new double[num_vals];   
+  CMFEUtility::SumDoubleArrayAcrossAllProcessors(in_vals, out_vals, num_vals);
 
   idx = 0;
   for (i = 0 ; i < listSize ; i++)
     {
-    for (j = 0 ; j < npivots+1 ; j++)
+    for (j = 0 ; j < b_list[i]->nPivots+1 ; j++)
       {
-      b_list[i]->numCells[j] = out_vals[idx++];
+      b_list[i]->cost[j] = out_vals[idx++];
       }
     }
 
@@ -193,23 +216,17 @@ void Boundary::PrepareSplitQuery(Boundary **b_list, int listSize)
 
 
 //----------------------------------------------------------------------------
-void Boundary::AddPoint(const float *pt)
+void Boundary::AddPoint(const float *pt, double weight)
 {
-  //add a point to the boundary
+  //add the cost of a point to the bin of the boundary it falls in
   float p = (axis == X_AXIS ? pt[0] : axis == Y_AXIS ? pt[1] : pt[2]);
-  for (int i = 0 ; i < npivots ; i++)
-    {
-    if (p < pivots[i])
-      {
-      numCells[i]++;
-      return;
-      }
-    }
-  numCells[npivots]++;
+  int bin = (int) (vtkstd::upper_bound(pivots, pivots+nPivots, p) - pivots);
+  cost[bin] += weight;
 }
 
 //----------------------------------------------------------------------------
-void Boundary::AddRGrid(const float *x, const float *y, const float *z, int nX, int nY, int nZ)
+void Boundary::AddRGrid(const float *x, const float *y, const float *z, int nX, int nY, int nZ,
+                        double weight)
 {
   //
   // Start by narrowing the total rgrid down to just the portion that is
@@ -273,17 +290,18 @@ void Boundary::AddRGrid(const float *x, const float *y, const float *z, int nX,
       break;
     }
 
+  double slabCost = slab*weight;
   int curIdx = arrStart;
-  for (int i = 0 ; i < npivots ; i++)
+  for (int i = 0 ; i < nPivots ; i++)
   while (curIdx <= arrEnd && arr[curIdx] < pivots[i])
     {
     curIdx++;
-    numCells[i] += slab;
+    cost[i] += slabCost;
     }
   while (curIdx <= arrEnd)
     {
     curIdx++;
-    numCells[npivots] += slab;
+    cost[nPivots] += slabCost;
     }
 }
 
@@ -294,31 +312,30 @@ bool Boundary::AttemptSplit(Boundary *&b1, Boundary *&b2)
   int  i;
 
   int numProcs1 = numProcs/2;
-  int numProcs2 = numProcs-numProcs1;
 
-  int totalCells = 0;
-  for (i = 0 ; i < npivots+1 ; i++)
-  totalCells += numCells[i]; 
+  double totalCost = 0.;
+  for (i = 0 ; i < nPivots+1 ; i++)
+  totalCost += cost[i]; 
 
-  if (totalCells == 0)
+  if (totalCost <= 0.)
     {
     // Should never happen...
     isDone = true;
     return false;
     }
 
-  int cellsSoFar = 0;
-  float amtSeen[npivots];
-  for (i = 0 ; i < npivots ; i++)
+  double costSoFar = 0.;
+  float amtSeen[maximumPivots];
+  for (i = 0 ; i < nPivots ; i++)
     {
-    cellsSoFar += numCells[i];
-    amtSeen[i] = cellsSoFar / ((float) totalCells);
+    costSoFar += cost[i];
+    amtSeen[i] = costSoFar / totalCost;
     }
 
   float proportion = ((float) numProcs1) / ((float) numProcs);
   float closest  = fabs(proportion - amtSeen[0]); // == proportion
   int   closestI = 0;
-  for (i = 1 ; i < npivots ; i++)
+  for (i = 1 ; i < nPivots ; i++)
     {
     float diff = fabs(proportion - amtSeen[i]);
     if (diff < closest)
@@ -328,101 +345,96 @@ bool Boundary::AttemptSplit(Boundary *&b1, Boundary *&b2)
       }
     }
 
-  nAttempts++;
-  if (closest < 0.02 || nAttempts > 3)
+  // The bin in which the share of the first half is reached.
+  int firstBigger = nPivots;
+  for (i = 0 ; i < nPivots ; i++)
     {
-    float b_tmp[6];
-    for (i = 0 ; i < 6 ; i++)
-      {
-      b_tmp[i] = bounds[i];
-      }
-    if (axis == X_AXIS)
-      {
-      b_tmp[1] = pivots[closestI];
-      b1 = new Boundary(b_tmp, numProcs1, Y_AXIS);
-      b_tmp[0] = pivots[closestI];
-      b_tmp[1] = bounds[1];
-      b2 = new Boundary(b_tmp, numProcs2, Y_AXIS);
-      }
-    else if (axis == Y_AXIS)
-      {
-      Axis next_axis = (is2D ? X_AXIS : Z_AXIS);
-      b_tmp[3] = pivots[closestI];
-      b1 = new Boundary(b_tmp, numProcs1, next_axis);
-      b_tmp[2] = pivots[closestI];
-      b_tmp[3] = bounds[3];
-      b2 = new Boundary(b_tmp, numProcs2, next_axis);
-      }
-    else
+    if (amtSeen[i] > proportion)
       {
-      b_tmp[5] = pivots[closestI];
-      b1 = new Boundary(b_tmp, numProcs1, X_AXIS);
-      b_tmp[4] = pivots[closestI];
-      b_tmp[5] = bounds[5];
-      b2 = new Boundary(b_tmp, numProcs2, X_AXIS);
+      firstBigger = i;
+      break;
       }
-    isDone = true;
     }
-  else
-    {
-    //
-    // Set up the pivots.  We are going to reset the pivot positions to be
-    // in between the two closest pivots.
-    //
-    int firstBigger = -1;
-    int amtSeen = 0;
-    for (i = 0 ; i < npivots+1 ; i++)
-      {
-      amtSeen += numCells[i];
-      float soFar = ((float) amtSeen) / ((float) totalCells);
-      if (soFar > proportion)
-        {
-        firstBigger = i;
-        break;
-        }
-      }
 
-    float min, max;
+  int index = 0;
+  if (axis == Y_AXIS)
+    {
+    index = 2;
+    }
+  else if (axis == Z_AXIS)
+    {
+    index = 4;
+    }
+  float step = (nPivots > 1 ? pivots[1] - pivots[0] :
+                (bounds[index+1] - bounds[index]) / 2);
+  float min = (firstBigger <= 0 ? pivots[0] - step : pivots[firstBigger-1]);
+  float max = (firstBigger >= nPivots ? pivots[nPivots-1] + step :
+                                        pivots[firstBigger]);
 
-    int index = 0;
-    if (axis == Y_AXIS)
-      {
-      index = 2;
-      }
-    else if (axis == Z_AXIS)
-      {
-      index = 4;
-      }
+  nAttempts++;
+  if (closest < 0.02)
+    {
+    Split(pivots[closestI], b1, b2);
+    return true;
+    }
+  if (nAttempts >= maximumAttempts)
+    {
+    // Out of attempts: assume the cost is spread evenly over the bin that
+    // holds the split, rather than settling for the closest pivot.
+    double before = (firstBigger > 0 ? amtSeen[firstBigger-1] : 0.);
+    double inBin = cost[firstBigger] / totalCost;
+    float t = (inBin > 0. ? (float) ((proportion - before) / inBin) : 0.5f);
+    t = (t < 0.f ? 0.f : (t > 1.f ? 1.f : t));
+    Split(min + t*(max-min), b1, b2);
+    return true;
+    }
 
-    if (firstBigger <= 0)
-      {
-      min = pivots[0] - (pivots[1] - pivots[0]);
-      max = pivots[0];
-      } 
-    else if (firstBigger >= npivots)
-      {
-      min = pivots[npivots-1];
-      max = pivots[npivots-1] + (pivots[1] - pivots[0]);
-      }
-    else
-      {
-      min = pivots[firstBigger-1];
-      max = pivots[firstBigger];
-      }
-    float step = (max-min) / (npivots+1);
-    for (i = 0 ; i < npivots ; i++)
-      {
-      pivots[i] = min + (i+1)*step;
-      }
-    for (i = 0 ; i < npivots+1 ; i++)
-      {
-      numCells[i] = 0;
-      }
+  //
+  // Set up the pivots.  We are going to reset the pivot positions to be
+  // in between the two pivots that bracket the split, with more of them
+  // every time, so that the remaining attempts narrow it down faster.
+  //
+  SetPivots(min, max, vtkstd::min(2*nPivots+1, maximumPivots));
+  return false;
+}
 
-    return false;
+//----------------------------------------------------------------------------
+void Boundary::Split(float pivot, Boundary *&b1, Boundary *&b2)
+{
+  //create the two boundaries on either side of the pivot
+  int numProcs1 = numProcs/2;
+  int numProcs2 = numProcs-numProcs1;
+  float b_tmp[6];
+  for (int i = 0 ; i < 6 ; i++)
+    {
+    b_tmp[i] = bounds[i];
     }
-
-  return true;
+  if (axis == X_AXIS)
+    {
+    b_tmp[1] = pivot;
+    b1 = new Boundary(b_tmp, numProcs1, Y_AXIS);
+    b_tmp[0] = pivot;
+    b_tmp[1] = bounds[1];
+    b2 = new Boundary(b_tmp, numProcs2, Y_AXIS);
+    }
+  else if (axis == Y_AXIS)
+    {
+    Axis next_axis = (is2D ? X_AXIS : Z_AXIS);
+    b_tmp[3] = pivot;
+    b1 = new Boundary(b_tmp, numProcs1, next_axis);
+    b_tmp[2] = pivot;
+    b_tmp[3] = bounds[3];
+    b2 = new Boundary(b_tmp, numProcs2, next_axis);
+    }
+  else
+    {
+    b_tmp[5] = pivot;
+    b1 = new Boundary(b_tmp, numProcs1, X_AXIS);
+    b_tmp[4] = pivot;
+    b_tmp[5] = bounds[5];
+    b2 = new Boundary(b_tmp, numProcs2, X_AXIS);
+    }
+  isDone = true;
 }
 
 //----------------------------------------------------------------------------
@@ -431,8 +443,6 @@ void vtkCMFESpatialPartition::CreatePartition(vtkCMFEDesiredPoints *dp,
 {
   //Creates a partition that is balanced for both the desired points and the fast lookup grouping.
   int   i, j, k;   
-  if (this->IntervalTree != NULL)
-  delete this->IntervalTree;
 
   //
   // Here's the gameplan:
@@ -465,6 +475,15 @@ void vtkCMFESpatialPartition::CreatePartition(vtkCMFEDesiredPoints *dp,
     fbounds[4] -= 1.;
     fbounds[5] += 1.;
     }
+  Boundary::SetMaximumAttempts(this->MaximumSplitAttempts);
+
+  // The centers and the costs of the cells do not change from one round to
+  // the next, so they are computed once up front.
+  vtkstd::vector<float> cellCenters;
+  vtkstd::vector<double> cellCosts;
+  this->GetCellCentersAndCosts(flg, cellCenters, cellCosts);
+  const int nCells = (int) cellCosts.size();
+
   b_list[0] = new Boundary(fbounds, nProcs, X_AXIS);
   int listSize = 1;
   int *bin_lookup = new int[2*nProcs];
@@ -500,18 +519,18 @@ void vtkCMFESpatialPartition::CreatePartition(vtkCMFEDesiredPoints *dp,
 
       // Now add each point to the boundary it falls in.  Start by doing
       // the points that come from unstructured or structured meshes.
-      const int nPoints = dp->GetRGridStart();
+      const vtkIdType nPoints = dp->GetRGridStart();
       vtkstd::vector<int> list;
       float pt[3];
-      for (i = 0 ; i < nPoints ; i++)
+      for (vtkIdType p = 0 ; p < nPoints ; p++)
         {
-        dp->GetPoint(i, pt);
+        dp->GetPoint(p, pt);
         double dpt[3] = {pt[0], pt[1], pt[2]};
         it.GetElementsListFromRange(dpt, dpt, list);
         for (j = 0 ; j < list.size() ; j++)
           {
           Boundary *b = b_list[bin_lookup[list[j]]];
-          b->AddPoint(pt);
+          b->AddPoint(pt, this->PointWeight);
           }
         }
 
@@ -529,37 +548,26 @@ void vtkCMFESpatialPartition::CreatePartition(vtkCMFEDesiredPoints *dp,
         double max[3];
         max[0] = x[nX-1];
         max[1] = y[nY-1];
-        max[2] = z[nY-1];
+        max[2] = z[nZ-1];
         it.GetElementsListFromRange(min, max, list);
         for (j = 0 ; j < list.size() ; j++)
           {
           Boundary *b = b_list[bin_lookup[list[j]]];
-          b->AddRGrid(x, y, z, nX, nY, nZ);
+          b->AddRGrid(x, y, z, nX, nY, nZ, this->PointWeight);
           }
         }
 
       // Now do the cells.  We are using the cell centers, which is a decent
       // approximation.
-      vtkstd::vector<vtkDataSet *> meshes = flg->GetMeshes();
-      for (i = 0 ; i < meshes.size() ; i++)
+      for (i = 0 ; i < nCells ; i++)
         {
-        const int ncells = meshes[i]->GetNumberOfCells();
-        double bbox[6];
-        double pt[3];
-        for (j = 0 ; j < ncells ; j++)
+        const float *fpt = &cellCenters[3*i];
+        double pt[3] = {fpt[0], fpt[1], fpt[2]};
+        it.GetElementsListFromRange(pt, pt, list);
+        for (k = 0 ; k < list.size() ; k++)
           {
-          vtkCell *cell = meshes[i]->GetCell(j);
-          cell->GetBounds(bbox);
-          pt[0] = (bbox[0] + bbox[1]) / 2.;
-          pt[1] = (bbox[2] + bbox[3]) / 2.;
-          pt[2] = (bbox[4] + bbox[5]) / 2.;
-          it.GetElementsListFromRange(pt, pt, list);
-          float fpt[3] = {pt[0], pt[1], pt[2]};
-          for (k = 0 ; k < list.size() ; k++)
-            {
-            Boundary *b = b_list[bin_lookup[list[k]]];
-            b->AddPoint(fpt);
-            }
+          Boundary *b = b_list[bin_lookup[list[k]]];
+          b->AddPoint(fpt, cellCosts[i]);
           }
         }
 
@@ -595,42 +603,33 @@ void vtkCMFESpatialPartition::CreatePartition(vtkCMFEDesiredPoints *dp,
 
   // Construct an interval tree out of the boundaries.  This interval tree
   // contains the actual spatial partitioning.
-  this->IntervalTree = new vtkCMFEIntervalTree(nProcs, 3);
-  int count = 0;
+  vtkstd::vector<double> boxes;
+  vtkstd::vector<int> processors;
   for (i = 0 ; i < listSize ; i++)
     {
     if (b_list[i]->IsLeaf())
       {
       float *b = b_list[i]->GetBoundary();
-      double db[6] = {b[0], b[1], b[2], b[3], b[4], b[5]};
-      this->IntervalTree->AddElement(count++, db);
+      boxes.insert(boxes.end(), b, b+6);
+      processors.push_back((int) processors.size());
       }
     }
-  this->IntervalTree->Calculate(true);
+  this->SetRegions(boxes, processors);
 
   bool determineBalance = false;
   if (determineBalance)
     {
-    count = 0;
-    for (i = 0 ; i < listSize ; i++)
-      {
-      if (b_list[i]->IsLeaf())
-        {
-        float *b = b_list[i]->GetBoundary();
-        }
-      }
-
     int *cnts = new int[nProcs];
     for (i = 0 ; i < nProcs ; i++)
       {
       cnts[i] = 0;
       }
-    const int nPoints = dp->GetNumberOfPoints();
+    const vtkIdType nPoints = dp->GetNumberOfPoints();
     vtkstd::vector<int> list;
     float pt[3];
-    for (i = 0 ; i < nPoints ; i++)
+    for (vtkIdType p = 0 ; p < nPoints ; p++)
       {
-      dp->GetPoint(i, pt);
+      dp->GetPoint(p, pt);
       double dpt[3] = {(double)pt[0], (double)pt[1], (double)pt[2]};
       this->IntervalTree->GetElementsListFromRange(dpt, dpt, list);
       for (j = 0 ; j < list.size() ; j++)
@@ -658,6 +657,28 @@ void vtkCMFESpatialPartition::CreatePartition(vtkCMFEDesiredPoints *dp,
 vtkCMFESpatialPartition::vtkCMFESpatialPartition()
 {
   this->IntervalTree = NULL;
+  this->PointWeight = 1.;
+  this->CellWeights.assign(VTK_NUMBER_OF_CELL_TYPES, 1.);
+  this->MaximumSplitAttempts = 4;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFESpatialPartition::SetCellWeight(int cellType, double w)
+{
+  if (cellType >= 0 && cellType < VTK_NUMBER_OF_CELL_TYPES)
+    {
+    this->CellWeights[cellType] = w;
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkCMFESpatialPartition::GetCellWeight(int cellType) const
+{
+  if (cellType >= 0 && cellType < VTK_NUMBER_OF_CELL_TYPES)
+    {
+    return this->CellWeights[cellType];
+    }
+  return 1.;
 }
 
 //----------------------------------------------------------------------------
@@ -681,26 +702,15 @@ int vtkCMFESpatialPartition::GetProcessor(float *pt)
     return -1;
     }
 
-  return list[0];
+  return this->RegionProcessors[list[0]];
 }
 
 
 //----------------------------------------------------------------------------
 int vtkCMFESpatialPartition::GetProcessor(vtkCell *cell)
 {
-  double bounds[6];
-  cell->GetBounds(bounds);
-  double mins[3];
-  mins[0] = bounds[0];
-  mins[1] = bounds[2];
-  mins[2] = bounds[4];
-  double maxs[3];
-  maxs[0] = bounds[1];
-  maxs[1] = bounds[3];
-  maxs[2] = bounds[5];
-
   vtkstd::vector<int> list;
-  this->IntervalTree->GetElementsListFromRange(mins, maxs, list);
+  this->GetProcessorList(cell, list);
   if (list.size() <= 0)
     {
     return -2;
@@ -716,10 +726,17 @@ int vtkCMFESpatialPartition::GetProcessor(vtkCell *cell)
 //----------------------------------------------------------------------------
 void vtkCMFESpatialPartition::GetProcessorList(vtkCell *cell,  std::vector<int> &list)
 {
-  list.clear();
-
   double bounds[6];
   cell->GetBounds(bounds);
+  this->GetProcessorList(bounds, list);
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFESpatialPartition::GetProcessorList(const double bounds[6],
+                                               vtkstd::vector<int> &list)
+{
+  list.clear();
+
   double mins[3];
   mins[0] = bounds[0];
   mins[1] = bounds[2];
@@ -730,6 +747,17 @@ void vtkCMFESpatialPartition::GetProcessorList(vtkCell *cell,  std::vector<int>
   maxs[2] = bounds[5];
 
   this->IntervalTree->GetElementsListFromRange(mins, maxs, list);
+
+  // A processor can own several of the regions the cell overlaps.
+  for (size_t i = 0 ; i < list.size() ; i++)
+    {
+    list[i] = this->RegionProcessors[list[i]];
+    }
+  if (list.size() > 1)
+    {
+    vtkstd::sort(list.begin(), list.end());
+    list.erase(vtkstd::unique(list.begin(), list.end()), list.end());
+    }
 }
 
 
@@ -757,6 +785,56 @@ void vtkCMFESpatialPartition::GetProcessorBoundaries(float *bounds, std::vector<
     this->IntervalTree->GetElementExtents(list[i], domBounds);
     for (int j = 0 ; j < 6 ; j++)
       db[6*i+j] = domBounds[j];
+    list[i] = this->RegionProcessors[list[i]];
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFESpatialPartition::SetRegions(const vtkstd::vector<double> &boxes,
+                                         const vtkstd::vector<int> &processors)
+{
+  delete this->IntervalTree;
+  int nRegions = (int) processors.size();
+  this->IntervalTree = new vtkCMFEIntervalTree(nRegions, 3, true,
+                                       vtkCMFEIntervalTree::FLAT_LAYOUT);
+  for (int i = 0 ; i < nRegions ; i++)
+    {
+    double db[6];
+    for (int j = 0 ; j < 6 ; j++)
+      {
+      db[j] = boxes[6*i+j];
+      }
+    this->IntervalTree->AddElement(i, db);
+    }
+  this->IntervalTree->Calculate(true);
+  this->RegionProcessors = processors;
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFESpatialPartition::GetCellCentersAndCosts(
+  vtkCMFEFastLookupGrouping *flg, vtkstd::vector<float> &centers,
+  vtkstd::vector<double> &costs)
+{
+  vtkstd::vector<vtkDataSet *> meshes = flg->GetMeshes();
+  for (size_t i = 0 ; i < meshes.size() ; i++)
+    {
+    const vtkIdType ncells = meshes[i]->GetNumberOfCells();
+    // Ghost cells are not relocated, so they do not cost anything.
+    unsigned char ghostMask;
+    const unsigned char *ghosts = CMFEUtility::GetGhostCells(meshes[i], ghostMask);
+    double bbox[6];
+    for (vtkIdType j = 0 ; j < ncells ; j++)
+      {
+      if (ghosts != NULL && (ghosts[j] & ghostMask) != 0)
+        {
+        continue;
+        }
+      meshes[i]->GetCellBounds(j, bbox);
+      centers.push_back((bbox[0] + bbox[1]) / 2.);
+      centers.push_back((bbox[2] + bbox[3]) / 2.);
+      centers.push_back((bbox[4] + bbox[5]) / 2.);
+      costs.push_back(this->GetCellWeight(meshes[i]->GetCellType(j)));
+      }
     }
 }
 
@@ -77,7 +77,13 @@ class vtkCMFESpatialPartition
 public:
   vtkCMFESpatialPartition();
   virtual ~vtkCMFESpatialPartition();
-  void CreatePartition(vtkCMFEDesiredPoints *, vtkCMFEFastLookupGrouping *, double *);
+
+  // Description:
+  //Creates the partition by recursively bisecting the bounds along
+  //alternating axes.  Subclasses can partition space differently, as long
+  //as they describe every region with a box and the processor it belongs
+  //to, see SetRegions.
+  virtual void CreatePartition(vtkCMFEDesiredPoints *, vtkCMFEFastLookupGrouping *, double *);
 
   // Description:
   //Get the processor that contains this point
@@ -92,13 +98,53 @@ public:
   //when a list of processors contain a cell.
   void GetProcessorList(vtkCell *cell, vtkstd::vector<int> &list);
 
+  // Description:
+  //Gets the processors whose regions overlap the given bounds.
+  void GetProcessorList(const double bounds[6], vtkstd::vector<int> &list);
+
   // Description:
   //Gets the processor that contains this cell.  This should be called
   //when a list of processors contain a cell.
   void GetProcessorBoundaries(float *bounds, vtkstd::vector<int> &list, vtkstd::vector<float> &db);
 
+  // Description:
+  //The partition balances the cost of the sample points and of the cells
+  //of the mesh to be sampled that fall in each region.  These are the
+  //costs of a sample point and of a cell of the given type.  They all
+  //default to 1.
+  void SetPointWeight(double w) { this->PointWeight = w; };
+  double GetPointWeight() const { return this->PointWeight; };
+  void SetCellWeight(int cellType, double w);
+  double GetCellWeight(int cellType) const;
+
+  // Description:
+  //Number of rounds a region gets to find a pivot that splits its cost in
+  //the right proportion.  Each round is one collective call.  In the last
+  //round the region splits where the cost is estimated to be balanced.
+  //Default is 4.
+  void SetMaximumSplitAttempts(int n) { this->MaximumSplitAttempts = (n < 1 ? 1 : n); };
+  int GetMaximumSplitAttempts() const { return this->MaximumSplitAttempts; };
+
 protected:
+  // Description:
+  //Replaces the regions of the partition.  Region i covers the box
+  //boxes[6*i] to boxes[6*i+5] and belongs to processor processors[i].  A
+  //processor may own any number of regions.
+  void SetRegions(const vtkstd::vector<double> &boxes,
+                  const vtkstd::vector<int> &processors);
+
+  // Description:
+  //Appends the center, three values per cell, and the cost of every cell
+  //of the meshes in the fast lookup grouping that will be relocated.
+  void GetCellCentersAndCosts(vtkCMFEFastLookupGrouping *flg,
+                              vtkstd::vector<float> &centers,
+                              vtkstd::vector<double> &costs);
+
   vtkCMFEIntervalTree  *IntervalTree;
+  vtkstd::vector<int> RegionProcessors;
+  double PointWeight;
+  vtkstd::vector<double> CellWeights;
+  int MaximumSplitAttempts;
 
 private:
   vtkCMFESpatialPartition(const vtkCMFESpatialPartition&);  // Not implemented.
@@ -0,0 +1,149 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: vtkCMFETreeBuilder.cxx,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+/*****************************************************************************
+*
+* Copyright (c) 2000 - 2009, Lawrence Livermore National Security, LLC
+* Produced at the Lawrence Livermore National Laboratory
+* LLNL-CODE-400124
+* All rights reserved.
+*
+* This file is  part of VisIt. For  details, see https://visit.llnl.gov/.  The
+* full copyright notice is contained in the file COPYRIGHT located at the root
+* of the VisIt distribution or at http://www.llnl.gov/visit/copyright.html.
+*
+* Redistribution  and  use  in  source  and  binary  forms,  with  or  without
+* modification, are permitted provided that the following conditions are met:
+*
+*  - Redistributions of  source code must  retain the above  copyright notice,
+*    this list of conditions and the disclaimer below.
+*  - Redistributions in binary form must reproduce the above copyright notice,
+*    this  list of  conditions  and  the  disclaimer (as noted below)  in  the
+*    documentation and/or other materials provided with the distribution.
+*  - Neither the name of  the LLNS/LLNL nor the names of  its contributors may
+*    be used to endorse or promote products derived from this software without
+*    specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT  HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR  IMPLIED WARRANTIES, INCLUDING,  BUT NOT  LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND  FITNESS FOR A PARTICULAR  PURPOSE
+* ARE  DISCLAIMED. IN  NO EVENT  SHALL LAWRENCE  LIVERMORE NATIONAL  SECURITY,
+* LLC, THE  U.S.  DEPARTMENT OF  ENERGY  OR  CONTRIBUTORS BE  LIABLE  FOR  ANY
+* DIRECT,  INDIRECT,   INCIDENTAL,   SPECIAL,   EXEMPLARY,  OR   CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT  LIMITED TO, PROCUREMENT OF  SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF  USE, DATA, OR PROFITS; OR  BUSINESS INTERRUPTION) HOWEVER
+* CAUSED  AND  ON  ANY  THEORY  OF  LIABILITY,  WHETHER  IN  CONTRACT,  STRICT
+* LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY  WAY
+* OUT OF THE  USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+* DAMAGE.
+*
+*****************************************************************************/
+
+#include "vtkCMFETreeBuilder.h"
+
+#include <vtkstd/algorithm>
+
+//----------------------------------------------------------------------------
+vtkCMFETreeBuilder::vtkCMFETreeBuilder()
+{
+  this->NextTask = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkCMFETreeBuilder::~vtkCMFETreeBuilder()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkCMFETreeBuilder::BuildTree(vtkIdType n, int nThreads,
+                                   vtkIdType minimumSize,
+                                   vtkstd::vector<vtkIdType> *topNodes)
+{
+  if (topNodes != NULL)
+    {
+    topNodes->clear();
+    }
+  nThreads = vtkstd::max(vtkstd::min(nThreads, VTK_MAX_THREADS), 1);
+  if (nThreads == 1)
+    {
+    this->Build(0, 0, n);
+    return;
+    }
+
+  // Split the top of the tree breadth first until there are a few
+  // subtrees per thread, then build the subtrees concurrently.
+  vtkstd::vector<Task> frontier(1);
+  frontier[0].Node = 0;
+  frontier[0].Offset = 0;
+  frontier[0].Size = n;
+  bool split = true;
+  while (split && static_cast<int>(frontier.size()) < 4*nThreads)
+    {
+    split = false;
+    vtkstd::vector<Task> next;
+    for (size_t t = 0 ; t < frontier.size() ; t++)
+      {
+      Task task = frontier[t];
+      if (task.Size < minimumSize)
+        {
+        next.push_back(task);
+        continue;
+        }
+      vtkIdType leftSize = this->Split(task.Node, task.Offset, task.Size);
+      if (topNodes != NULL)
+        {
+        topNodes->push_back(task.Node);
+        }
+      Task left = { 2*task.Node+1, task.Offset, leftSize };
+      Task right = { 2*task.Node+2, task.Offset+leftSize, task.Size-leftSize };
+      next.push_back(left);
+      next.push_back(right);
+      split = true;
+      }
+    frontier.swap(next);
+    }
+
+  this->Tasks = frontier;
+  this->NextTask = 0;
+  vtkMultiThreader *threader = vtkMultiThreader::New();
+  threader->SetNumberOfThreads(nThreads);
+  threader->SetSingleMethod(vtkCMFETreeBuilder::BuildThread, this);
+  threader->SingleMethodExecute();
+  threader->Delete();
+  vtkstd::vector<Task>().swap(this->Tasks);
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkCMFETreeBuilder::BuildThread(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkCMFETreeBuilder *builder =
+    static_cast<vtkCMFETreeBuilder *>(info->UserData);
+
+  while (true)
+    {
+    builder->TaskLock.Lock();
+    int task = builder->NextTask++;
+    builder->TaskLock.Unlock();
+    if (task >= static_cast<int>(builder->Tasks.size()))
+      {
+      break;
+      }
+    const Task &t = builder->Tasks[task];
+    builder->Build(t.Node, t.Offset, t.Size);
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
@@ -0,0 +1,123 @@
+/*=========================================================================
+
+  Program:   ParaView
+  Module:    $RCSfile: vtkCMFETreeBuilder.h,v $
+
+  Copyright (c) Kitware, Inc.
+  All rights reserved.
+  See Copyright.txt or http://www.paraview.org/HTML/Copyright.html for details.
+
+     This software is distributed WITHOUT ANY WARRANTY; without even
+     the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+     PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+/*****************************************************************************
+*
+* Copyright (c) 2000 - 2009, Lawrence Livermore National Security, LLC
+* Produced at the Lawrence Livermore National Laboratory
+* LLNL-CODE-400124
+* All rights reserved.
+*
+* This file is  part of VisIt. For  details, see https://visit.llnl.gov/.  The
+* full copyright notice is contained in the file COPYRIGHT located at the root
+* of the VisIt distribution or at http://www.llnl.gov/visit/copyright.html.
+*
+* Redistribution  and  use  in  source  and  binary  forms,  with  or  without
+* modification, are permitted provided that the following conditions are met:
+*
+*  - Redistributions of  source code must  retain the above  copyright notice,
+*    this list of conditions and the disclaimer below.
+*  - Redistributions in binary form must reproduce the above copyright notice,
+*    this  list of  conditions  and  the  disclaimer (as noted below)  in  the
+*    documentation and/or other materials provided with the distribution.
+*  - Neither the name of  the LLNS/LLNL nor the names of  its contributors may
+*    be used to endorse or promote products derived from this software without
+*    specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT  HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR  IMPLIED WARRANTIES, INCLUDING,  BUT NOT  LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND  FITNESS FOR A PARTICULAR  PURPOSE
+* ARE  DISCLAIMED. IN  NO EVENT  SHALL LAWRENCE  LIVERMORE NATIONAL  SECURITY,
+* LLC, THE  U.S.  DEPARTMENT OF  ENERGY  OR  CONTRIBUTORS BE  LIABLE  FOR  ANY
+* DIRECT,  INDIRECT,   INCIDENTAL,   SPECIAL,   EXEMPLARY,  OR   CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT  LIMITED TO, PROCUREMENT OF  SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF  USE, DATA, OR PROFITS; OR  BUSINESS INTERRUPTION) HOWEVER
+* CAUSED  AND  ON  ANY  THEORY  OF  LIABILITY,  WHETHER  IN  CONTRACT,  STRICT
+* LIABILITY, OR TORT  (INCLUDING NEGLIGENCE OR OTHERWISE)  ARISING IN ANY  WAY
+* OUT OF THE  USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+* DAMAGE.
+*
+*****************************************************************************/
+
+
+
+// .NAME vtkCMFETreeBuilder -- Threaded top down build of a heap shaped tree
+// .SECTION Description
+//
+// Builds the trees whose nodes are stored as an implicit heap, node i
+// having its children at 2i+1 and 2i+2, and that split a contiguous range
+// of items at every node.  Subclasses say how a node splits its range and
+// how a whole subtree is built.  Once the top of the tree is split
+// breadth first into a few subtrees per thread, the subtrees are
+// independent and are handed out to threads from a shared queue.
+//
+// .SECTION See Also
+// vtkCMFEIntervalTree vtkCMFEKdTree
+
+#ifndef __vtkCMFETreeBuilder_h
+#define __vtkCMFETreeBuilder_h
+
+#include <vtkCriticalSection.h>
+#include <vtkMultiThreader.h>
+#include <vtkType.h>
+#include <vtkstd/vector>
+
+class vtkCMFETreeBuilder
+{
+public:
+  vtkCMFETreeBuilder();
+  virtual ~vtkCMFETreeBuilder();
+
+  // Description:
+  //Partitions the size items starting at offset that belong to node and
+  //returns how many of them go to the left child.
+  virtual vtkIdType Split(vtkIdType node, vtkIdType offset,
+                          vtkIdType size) = 0;
+
+  // Description:
+  //Builds the whole subtree rooted at node over the size items starting
+  //at offset.
+  virtual void Build(vtkIdType node, vtkIdType offset, vtkIdType size) = 0;
+
+  // Description:
+  //Builds the tree over n items with up to nThreads threads.  Subtrees of
+  //fewer than minimumSize items are not split any further on the calling
+  //thread.  topNodes, if not NULL, is set to the nodes that were split
+  //on the calling thread, parents before children; Build was not called
+  //on them.
+  void BuildTree(vtkIdType n, int nThreads, vtkIdType minimumSize,
+                 vtkstd::vector<vtkIdType> *topNodes);
+
+private:
+  //BTX
+  struct Task
+  {
+    vtkIdType Node;
+    vtkIdType Offset;
+    vtkIdType Size;
+  };
+
+  static VTK_THREAD_RETURN_TYPE BuildThread(void *arg);
+
+  vtkstd::vector<Task> Tasks;
+  int NextTask;
+  vtkSimpleCriticalSection TaskLock;
+  //ETX
+
+  vtkCMFETreeBuilder(const vtkCMFETreeBuilder&);  // Not implemented.
+  void operator=(const vtkCMFETreeBuilder&);  // Not implemented.
+};
+
+#endif
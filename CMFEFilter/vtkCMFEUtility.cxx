@@ -54,7 +54,9 @@
 #include <vtkCMFEUtility.h>
 
 #include <float.h>
+#include <string.h>
 #include <vtkCell.h>
+#include <vtkCellArray.h>
 #include <vtkCellData.h>
 #include <vtkCharArray.h>
 #include <vtkDataSetWriter.h>
@@ -67,11 +69,15 @@
 #include <vtkMultiProcessController.h>
 #include <vtkPointData.h>
 #include <vtkPointSet.h>
+#include <vtkPolyData.h>
 #include <vtkRectilinearGrid.h>
 #include <vtkShortArray.h>
 #include <vtkStructuredGrid.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkUnstructuredGrid.h>
 
 #include <cstring>
+#include <vtkstd/algorithm>
   
 
 namespace
@@ -79,6 +85,7 @@ namespace
 #ifdef VTK_USE_MPI  
   static MPI_Op MPI_MINMAX_FUNC = MPI_OP_NULL;  
   static int numberOfProcesses = 1;
+  static int localProcessId = 0;
   static bool mpiOn = true;
   MPI_Comm *comm;
 
@@ -116,6 +123,38 @@ namespace
     return;
   }
 #endif
+  // Messages are sent in pieces of at most this many bytes, since MPI
+  // counts are ints.
+  const vtkIdType messageChunkSize = 1 << 30;
+
+  // The tag of the messages sent by AllToAllMessages.
+  const int allToAllTag = 8812;
+
+  //----------------------------------------------------------------------------
+  // Spreads the lower 10 bits of v so that there are two zero bits between
+  // each of them.
+  unsigned int SpreadBits(unsigned int v)
+  {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+  }
+
+  //----------------------------------------------------------------------------
+  // Inverse of SpreadBits: gathers every third bit of v.
+  unsigned int CompactBits(unsigned int v)
+  {
+    v &= 0x09249249;
+    v = (v | (v >> 2)) & 0x030c30c3;
+    v = (v | (v >> 4)) & 0x0300f00f;
+    v = (v | (v >> 8)) & 0x030000ff;
+    v = (v | (v >> 16)) & 0x3ff;
+    return v;
+  }
+
   //----------------------------------------------------------------------------
   double EquationsValueAtPoint(const double *params, int block, int point, int nDims, const double *nodeExtents)
   {
@@ -164,12 +203,14 @@ void CMFEUtility::Setup( )
   if ( communicator )
     {
     numberOfProcesses = communicator->GetNumberOfProcesses();    
+    localProcessId = communicator->GetLocalProcessId();
     comm = communicator->GetMPIComm()->GetHandle();
     mpiOn = true;
     }
   else
     {    
     numberOfProcesses = 1;
+    localProcessId = 0;
     comm = NULL;
     mpiOn = false;
     }
@@ -194,6 +235,16 @@ int CMFEUtility::PAR_Size(void)
 #endif
 }
 
+//----------------------------------------------------------------------------
+int CMFEUtility::PAR_Rank(void)
+{
+#ifdef VTK_USE_MPI
+  return localProcessId;
+#else
+  return 0;
+#endif
+}
+
 //----------------------------------------------------------------------------
 bool CMFEUtility::UnifyMinMax(double *buff, int size)
 {
@@ -272,6 +323,20 @@ int CMFEUtility::SumIntAcrossAllProcessors(int value)
   return value;
 }
 
+//----------------------------------------------------------------------------
+int CMFEUtility::MaximumIntAcrossAllProcessors(int value)
+{
+#ifdef VTK_USE_MPI
+  if ( mpiOn ) 
+    {
+    int allmax;
+    MPI_Allreduce(&value, &allmax, 1, MPI_INT, MPI_MAX, *CMFEUtility::GetMPIComm());
+    return allmax;
+    }
+#endif
+  return value;
+}
+
 //----------------------------------------------------------------------------
 void CMFEUtility::SumIntArrayAcrossAllProcessors(int *inArray, int *outArray, int size)
 {
@@ -291,10 +356,28 @@ void CMFEUtility::SumIntArrayAcrossAllProcessors(int *inArray, int *outArray, in
 }
 
 //----------------------------------------------------------------------------
-char * CMFEUtility::CreateMessageStrings(char **lists, int *count, int nl)
+void CMFEUtility::SumDoubleArrayAcrossAllProcessors(double *inArray, double *outArray, int size)
+{
+#ifdef VTK_USE_MPI
+  if ( mpiOn ) 
+    {
+    MPI_Allreduce(inArray, outArray, size, MPI_DOUBLE, MPI_SUM, *CMFEUtility::GetMPIComm());
+    return;
+    }
+  //fall through for both compiled && enabled
+#endif
+  for (int i = 0 ; i < size ; i++)
+    {
+    outArray[i] = inArray[i];
+    }
+  return;
+}
+
+//----------------------------------------------------------------------------
+char * CMFEUtility::CreateMessageStrings(char **lists, const vtkIdType *count, int nl)
 {  
   // Determine how big the big array should be.  
-  int total = 0;
+  vtkIdType total = 0;
   for (int i = 0 ; i < nl ; i++)
     {
     total += count[i];
@@ -313,6 +396,89 @@ char * CMFEUtility::CreateMessageStrings(char **lists, int *count, int nl)
   return totallist;
 }
  
+//----------------------------------------------------------------------------
+vtkIdType CMFEUtility::GetNumberOfMessageChunks(vtkIdType size)
+{
+  return (size + messageChunkSize - 1) / messageChunkSize;
+}
+
+//----------------------------------------------------------------------------
+void CMFEUtility::AllToAllCounts(const vtkIdType *sendCounts, vtkIdType *recvCounts)
+{
+#ifdef VTK_USE_MPI
+  if ( mpiOn ) 
+    {
+    // vtkIdType has no MPI type of its own, so it is sent as bytes.
+    MPI_Alltoall(const_cast<vtkIdType *>(sendCounts), sizeof(vtkIdType), MPI_BYTE,
+                 recvCounts, sizeof(vtkIdType), MPI_BYTE, *CMFEUtility::GetMPIComm());
+    return;
+    }
+  //fall through for both compiled && enabled
+#endif
+  recvCounts[0] = sendCounts[0];
+}
+
+//----------------------------------------------------------------------------
+void CMFEUtility::AllToAllMessages(const char *sendBuffer, const vtkIdType *sendCounts,
+                                   char **recvMessages, const vtkIdType *recvCounts)
+{
+#ifdef VTK_USE_MPI
+  if ( mpiOn ) 
+    {
+    int nProcs = CMFEUtility::PAR_Size();
+    vtkstd::vector<MPI_Request> requests;
+    for (int i = 0 ; i < nProcs ; i++)
+      {
+      CMFEUtility::PostReceive(recvMessages[i], recvCounts[i], i,
+                               allToAllTag, requests);
+      }
+    const char *msg = sendBuffer;
+    for (int i = 0 ; i < nProcs ; i++)
+      {
+      CMFEUtility::PostSend(msg, sendCounts[i], i, allToAllTag, requests);
+      msg += sendCounts[i];
+      }
+    if (!requests.empty())
+      {
+      MPI_Waitall((int) requests.size(), &requests[0], MPI_STATUSES_IGNORE);
+      }
+    return;
+    }
+  //fall through for both compiled && enabled
+#endif
+  memcpy(recvMessages[0], sendBuffer, recvCounts[0]);
+}
+
+#ifdef VTK_USE_MPI
+//----------------------------------------------------------------------------
+void CMFEUtility::PostSend(const char *buffer, vtkIdType size, int proc, int tag,
+                           vtkstd::vector<MPI_Request> &requests)
+{
+  for (vtkIdType offset = 0 ; offset < size ; offset += messageChunkSize)
+    {
+    int n = (int) vtkstd::min(messageChunkSize, size - offset);
+    requests.push_back(MPI_REQUEST_NULL);
+    MPI_Isend(const_cast<char *>(buffer) + offset, n, MPI_CHAR, proc, tag,
+              *CMFEUtility::GetMPIComm(), &requests.back());
+    }
+}
+
+//----------------------------------------------------------------------------
+void CMFEUtility::PostReceive(char *buffer, vtkIdType size, int proc, int tag,
+                              vtkstd::vector<MPI_Request> &requests)
+{
+  // Messages between two processors with the same tag arrive in the order
+  // they were sent, so the chunks line up with those of PostSend.
+  for (vtkIdType offset = 0 ; offset < size ; offset += messageChunkSize)
+    {
+    int n = (int) vtkstd::min(messageChunkSize, size - offset);
+    requests.push_back(MPI_REQUEST_NULL);
+    MPI_Irecv(buffer + offset, n, MPI_CHAR, proc, tag,
+              *CMFEUtility::GetMPIComm(), &requests.back());
+    }
+}
+#endif
+
 //----------------------------------------------------------------------------
 vtkPoints * CMFEUtility::GetPoints(vtkDataSet *dataset)
 {
@@ -332,6 +498,99 @@ vtkPoints * CMFEUtility::GetPoints(vtkDataSet *dataset)
   return pts;
 }
 
+//----------------------------------------------------------------------------
+unsigned long CMFEUtility::GetGeometryMTime(vtkDataSet *dataset)
+{
+  unsigned long mtime = 0;
+  if ( !dataset )
+    {
+    return mtime;
+    }
+
+  // Implicit geometry (origin, spacing, extents) is stored on the dataset
+  // itself, so callers should also compare the bounds and sizes.
+  vtkPointSet *ps = vtkPointSet::SafeDownCast(dataset);
+  if ( ps && ps->GetPoints() )
+    {
+    mtime = vtkstd::max(mtime, ps->GetPoints()->GetMTime());
+    }
+
+  vtkUnstructuredGrid *ugrid = vtkUnstructuredGrid::SafeDownCast(dataset);
+  if ( ugrid && ugrid->GetCells() )
+    {
+    mtime = vtkstd::max(mtime, ugrid->GetCells()->GetMTime());
+    if ( ugrid->GetCellTypesArray() )
+      {
+      mtime = vtkstd::max(mtime, ugrid->GetCellTypesArray()->GetMTime());
+      }
+    }
+
+  vtkPolyData *pd = vtkPolyData::SafeDownCast(dataset);
+  if ( pd )
+    {
+    vtkCellArray *cells[4] = { pd->GetVerts(), pd->GetLines(),
+      pd->GetPolys(), pd->GetStrips() };
+    for (int i = 0 ; i < 4 ; i++)
+      {
+      if ( cells[i] )
+        {
+        mtime = vtkstd::max(mtime, cells[i]->GetMTime());
+        }
+      }
+    }
+
+  vtkRectilinearGrid *rgrid = vtkRectilinearGrid::SafeDownCast(dataset);
+  if ( rgrid )
+    {
+    vtkDataArray *coords[3] = { rgrid->GetXCoordinates(),
+      rgrid->GetYCoordinates(), rgrid->GetZCoordinates() };
+    for (int i = 0 ; i < 3 ; i++)
+      {
+      if ( coords[i] )
+        {
+        mtime = vtkstd::max(mtime, coords[i]->GetMTime());
+        }
+      }
+    }
+
+  return mtime;
+}
+
+//----------------------------------------------------------------------------
+int CMFEUtility::GetResultType(int type, bool isNodal)
+{
+  if (type == VTK_FLOAT || type == VTK_DOUBLE ||
+      (!isNodal && type >= 0 && type != VTK_BIT))
+    {
+    return type;
+    }
+  return (type >= 0 ? VTK_DOUBLE : VTK_FLOAT);
+}
+
+//----------------------------------------------------------------------------
+const unsigned char *CMFEUtility::GetGhostCells(vtkDataSet *dataset,
+                                               unsigned char &mask)
+{
+  // The bits of vtkDataSetAttributes::DUPLICATECELL, REFINEDCELL and
+  // HIDDENCELL, which newer versions of VTK store in vtkGhostType.
+  const unsigned char ghostTypeMask = 1 | 8 | 32;
+
+  const char *names[3] = { "avtGhostZones", "vtkGhostLevels", "vtkGhostType" };
+  const unsigned char masks[3] = { 0xff, 0xff, ghostTypeMask };
+  for (int i = 0 ; i < 3 ; i++)
+    {
+    vtkUnsignedCharArray *ghosts = vtkUnsignedCharArray::SafeDownCast(
+      dataset->GetCellData()->GetArray(names[i]));
+    if ( ghosts && ghosts->GetNumberOfTuples() >= dataset->GetNumberOfCells() )
+      {
+      mask = masks[i];
+      return ghosts->GetPointer(0);
+      }
+    }
+  mask = 0;
+  return NULL;
+}
+
 //----------------------------------------------------------------------------
 void CMFEUtility::GetCellCenter(vtkCell* cell, double center[3])
 {
@@ -359,86 +618,15 @@ void CMFEUtility::GetCellCenter(vtkCell* cell, double center[3])
 //----------------------------------------------------------------------------
 bool CMFEUtility::CellContainsPoint(vtkCell *cell, const double *point)
 {
-  int   i;
   int cellType = cell->GetCellType();
   if (cellType == VTK_HEXAHEDRON)
     {
-    vtkHexahedron *hex = (vtkHexahedron *) cell;
-    vtkPoints *pts = hex->GetPoints();
+    // Use the vtkCell interface rather than casting, since the cell may
+    // be a vtkGenericCell.
+    vtkPoints *pts = cell->GetPoints();
     // vtkCell sets its points object data type to double. 
     double *pts_ptr = (double *) pts->GetVoidPointer(0);
-    static int faces[6][4] = { {0,4,7,3}, {1,2,6,5},
-                       {0,1,5,4}, {3,7,6,2},
-                       {0,3,2,1}, {4,5,6,7} };
-
-    double center[3] = { 0., 0., 0. };
-    for (i = 0 ; i < 8 ; i++)
-      {
-      center[0] += pts_ptr[3*i];
-      center[1] += pts_ptr[3*i+1];
-      center[2] += pts_ptr[3*i+2];
-      }
-    center[0] /= 8.;
-    center[1] /= 8.;
-    center[2] /= 8.;
-
-    for (i = 0 ; i < 6 ; i++)
-      {
-      double dir1[3], dir2[3];
-      int idx0 = faces[i][0];
-      int idx1 = faces[i][1];
-      int idx2 = faces[i][3];
-      dir1[0] = pts_ptr[3*idx1] - pts_ptr[3*idx0];
-      dir1[1] = pts_ptr[3*idx1+1] - pts_ptr[3*idx0+1];
-      dir1[2] = pts_ptr[3*idx1+2] - pts_ptr[3*idx0+2];
-      dir2[0] = pts_ptr[3*idx0] - pts_ptr[3*idx2];
-      dir2[1] = pts_ptr[3*idx0+1] - pts_ptr[3*idx2+1];
-      dir2[2] = pts_ptr[3*idx0+2] - pts_ptr[3*idx2+2];
-      double cross[3];
-      cross[0] = dir1[1]*dir2[2] - dir1[2]*dir2[1];
-      cross[1] = dir1[2]*dir2[0] - dir1[0]*dir2[2];
-      cross[2] = dir1[0]*dir2[1] - dir1[1]*dir2[0];
-      double origin[3];
-      origin[0] = pts_ptr[3*idx0];
-      origin[1] = pts_ptr[3*idx0+1];
-      origin[2] = pts_ptr[3*idx0+2];
-
-      //
-      // The plane is of the form Ax + By + Cz - D = 0.
-      //
-      // Using the origin, we can calculate D:
-      // D = A*origin[0] + B*origin[1] + C*origin[2]
-      //
-      // We want to know if 'point' gives:
-      // A*point[0] + B*point[1] + C*point[2] - D >=? 0.
-      //
-      // We can substitute in D to get
-      // A*(point[0]-origin[0]) + B*(point[1]-origin[1]) + C*(point[2-origin[2])
-      //    ?>= 0
-      //
-      double val1 = cross[0]*(point[0] - origin[0])
-                 + cross[1]*(point[1] - origin[1])
-                 + cross[2]*(point[2] - origin[2]);
-
-      //
-      // If the hexahedron is inside out, then val1 could be
-      // negative, because the face orientation is wrong.
-      // Find the sign for the cell center.
-      //
-      double val2 = cross[0]*(center[0] - origin[0])
-                 + cross[1]*(center[1] - origin[1])
-                 + cross[2]*(center[2] - origin[2]);
-
-      // 
-      // If the point in question (point) and the center are on opposite
-      // sides of the cell, then declare the point outside the cell.
-      //      
-      if (val1*val2 < 0.)
-        {
-        return false;
-        }
-      }
-    return true;
+    return CMFEUtility::HexahedronContainsPoint(pts_ptr, point);
     }
 
 
@@ -456,6 +644,100 @@ bool CMFEUtility::CellContainsPoint(vtkCell *cell, const double *point)
 }
 
 
+//----------------------------------------------------------------------------
+bool CMFEUtility::HexahedronContainsPoint(const double *pts_ptr,
+                                          const double *point)
+{
+  int   i;
+  static int faces[6][4] = { {0,4,7,3}, {1,2,6,5},
+                     {0,1,5,4}, {3,7,6,2},
+                     {0,3,2,1}, {4,5,6,7} };
+
+  double center[3] = { 0., 0., 0. };
+  for (i = 0 ; i < 8 ; i++)
+    {
+    center[0] += pts_ptr[3*i];
+    center[1] += pts_ptr[3*i+1];
+    center[2] += pts_ptr[3*i+2];
+    }
+  center[0] /= 8.;
+  center[1] /= 8.;
+  center[2] /= 8.;
+
+  for (i = 0 ; i < 6 ; i++)
+    {
+    double dir1[3], dir2[3];
+    int idx0 = faces[i][0];
+    int idx1 = faces[i][1];
+    int idx2 = faces[i][3];
+    dir1[0] = pts_ptr[3*idx1] - pts_ptr[3*idx0];
+    dir1[1] = pts_ptr[3*idx1+1] - pts_ptr[3*idx0+1];
+    dir1[2] = pts_ptr[3*idx1+2] - pts_ptr[3*idx0+2];
+    dir2[0] = pts_ptr[3*idx0] - pts_ptr[3*idx2];
+    dir2[1] = pts_ptr[3*idx0+1] - pts_ptr[3*idx2+1];
+    dir2[2] = pts_ptr[3*idx0+2] - pts_ptr[3*idx2+2];
+    double cross[3];
+    cross[0] = dir1[1]*dir2[2] - dir1[2]*dir2[1];
+    cross[1] = dir1[2]*dir2[0] - dir1[0]*dir2[2];
+    cross[2] = dir1[0]*dir2[1] - dir1[1]*dir2[0];
+    double origin[3];
+    origin[0] = pts_ptr[3*idx0];
+    origin[1] = pts_ptr[3*idx0+1];
+    origin[2] = pts_ptr[3*idx0+2];
+
+    //
+    // The plane is of the form Ax + By + Cz - D = 0.
+    //
+    // Using the origin, we can calculate D:
+    // D = A*origin[0] + B*origin[1] + C*origin[2]
+    //
+    // We want to know if 'point' gives:
+    // A*point[0] + B*point[1] + C*point[2] - D >=? 0.
+    //
+    // We can substitute in D to get
+    // A*(point[0]-origin[0]) + B*(point[1]-origin[1]) + C*(point[2-origin[2])
+    //    ?>= 0
+    //
+    double val1 = cross[0]*(point[0] - origin[0])
+               + cross[1]*(point[1] - origin[1])
+               + cross[2]*(point[2] - origin[2]);
+
+    //
+    // If the hexahedron is inside out, then val1 could be
+    // negative, because the face orientation is wrong.
+    // Find the sign for the cell center.
+    //
+    double val2 = cross[0]*(center[0] - origin[0])
+               + cross[1]*(center[1] - origin[1])
+               + cross[2]*(center[2] - origin[2]);
+
+    // 
+    // If the point in question (point) and the center are on opposite
+    // sides of the cell, then declare the point outside the cell.
+    //      
+    if (val1*val2 < 0.)
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+
+//----------------------------------------------------------------------------
+unsigned int CMFEUtility::MortonEncode(unsigned int i, unsigned int j, unsigned int k)
+{
+  return SpreadBits(i) | (SpreadBits(j) << 1) | (SpreadBits(k) << 2);
+}
+
+//----------------------------------------------------------------------------
+void CMFEUtility::MortonDecode(unsigned int key, unsigned int ijk[3])
+{
+  ijk[0] = CompactBits(key);
+  ijk[1] = CompactBits(key >> 1);
+  ijk[2] = CompactBits(key >> 2);
+}
+
 //----------------------------------------------------------------------------
 int CMFEUtility::IntersectBox(const double bounds[6],  const double origin[3], const double dir[3], double coord[3]) 
 {
@@ -55,6 +55,8 @@
 #define __vtkCMFEUtility_h
 
 #include <vtkToolkits.h>
+#include <vtkType.h>
+#include <vtkstd/vector>
 
 class vtkCell;
 class vtkDataSet;
@@ -85,6 +87,10 @@ namespace CMFEUtility
   // Get the number of processors 
   int PAR_Size(void);
 
+  // Description:
+  // Get the rank of this processor
+  int PAR_Rank(void);
+
   // Description:
   //Collective call across all processors to unify an array that
   //has alternating minimum and maximum values.
@@ -102,21 +108,79 @@ namespace CMFEUtility
   // Description:
   //Collective call across all processors to find the sum of the integer.
   int SumIntAcrossAllProcessors(int value);
+
+  // Description:
+  //Collective call across all processors to find the maximum of the integer.
+  int MaximumIntAcrossAllProcessors(int value);
  
   // Description:
   //Collective call across all processors to find the sum of each component of the integer array.
   void SumIntArrayAcrossAllProcessors(int *inArray, int *outArray, int size);  
 
+  // Description:
+  //Collective call across all processors to find the sum of each component of the double array.
+  void SumDoubleArrayAcrossAllProcessors(double *inArray, double *outArray, int size);
+
   // Description:
   // Constructs a single large character array so that all the messages
   //can be stored in the same array. 
-  char* CreateMessageStrings(char **lists, int *count, int nl);
+  char* CreateMessageStrings(char **lists, const vtkIdType *count, int nl);
+
+  // Description:
+  //Collective call that tells every processor how many bytes each other
+  //processor is going to send it.  Counts are 64 bit where vtkIdType is.
+  void AllToAllCounts(const vtkIdType *sendCounts, vtkIdType *recvCounts);
+
+  // Description:
+  //Collective call that sends message j of the send buffer to processor j,
+  //and receives the message from processor j at recvMessages[j].  The
+  //messages follow each other in the send buffer.  Unlike MPI_Alltoallv
+  //neither the messages nor the buffers are limited to 2 GiB.
+  void AllToAllMessages(const char *sendBuffer, const vtkIdType *sendCounts,
+                        char **recvMessages, const vtkIdType *recvCounts);
+
+  // Description:
+  //Number of point to point messages a message of the given size is split
+  //into, since a single MPI message holds at most 2 GiB.
+  vtkIdType GetNumberOfMessageChunks(vtkIdType size);
+
+#ifdef VTK_USE_MPI
+  // Description:
+  //Starts sending, or receiving, a message of any size in as many chunks
+  //as it takes, and appends a request per chunk.
+  void PostSend(const char *buffer, vtkIdType size, int proc, int tag,
+                vtkstd::vector<MPI_Request> &requests);
+  void PostReceive(char *buffer, vtkIdType size, int proc, int tag,
+                   vtkstd::vector<MPI_Request> &requests);
+#endif
 
   // Description:
   // returns a copy of the vtkPoints that are contained in the dataset.
   // An empty vtkPoints will be returned if the input dataset is NULL or empty
   vtkPoints *GetPoints(vtkDataSet *dataset);
 
+  // Description:
+  // returns the modification time of the geometry and topology of the
+  // dataset.  Unlike vtkDataSet::GetMTime this ignores the point and
+  // cell data, so it only changes when the mesh itself changes.
+  unsigned long GetGeometryMTime(vtkDataSet *dataset);
+
+  // Description:
+  // The VTK type of the result of sampling a variable of the given type,
+  // or of no variable if type is negative.  Floating point variables keep
+  // their type.  Integer variables keep it when they are zonal, since
+  // their values are copied, and become double when they are interpolated.
+  // Bit arrays are not stored bytewise, so they always become double.
+  int GetResultType(int type, bool isNodal);
+
+  // Description:
+  // returns the array that marks the cells of the dataset that belong to
+  // another piece, or NULL if it has none.  That is VisIt's avtGhostZones,
+  // VTK's vtkGhostLevels, or the flags of vtkGhostType, of which only the
+  // duplicate, refined and hidden cells are left out.  A cell is a ghost
+  // if its value has one of the bits of mask set.
+  const unsigned char *GetGhostCells(vtkDataSet *dataset, unsigned char &mask);
+
   // Description:
   // calculates the cell center coordinates.
   void GetCellCenter(vtkCell* cell, double center[3]);
@@ -126,6 +190,21 @@ namespace CMFEUtility
   //the side the point lies on each face of the cell.
   bool CellContainsPoint(vtkCell *cell, const double *point);
 
+  //Description:
+  //Tests whether or not a hexahedron, given by the coordinates of its eight
+  //points in VTK order, contains a point.  This is the test that
+  //CellContainsPoint uses for hexahedra.
+  bool HexahedronContainsPoint(const double *pts, const double *point);
+
+  //Description:
+  //Interleaves the bits of three 10 bit integers into a 30 bit Morton key,
+  //with the bits of i lowest.
+  unsigned int MortonEncode(unsigned int i, unsigned int j, unsigned int k);
+
+  //Description:
+  //Splits a 30 bit Morton key back into its three 10 bit integers.
+  void MortonDecode(unsigned int key, unsigned int ijk[3]);
+
   //Description:
   //Tests whether or not a point intersects a box bounds
   int IntersectBox(const double bounds[6], const double origin[3], const double dir[3], double coord[3]);